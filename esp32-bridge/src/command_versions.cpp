@@ -0,0 +1,91 @@
+/**
+ * Lumina ESP32 Bridge - Command Versioning
+ *
+ * Fixed-size table of the recently applied commands per controller.
+ * Commands applied at the same version share an entry; a new version
+ * takes the slot of the oldest. Controllers beyond MAX_TRACKED_CONTROLLERS
+ * evict the least recently used entry, which only costs us the ability to
+ * drop stale commands for that controller until it is seen again.
+ */
+
+#include "command_versions.h"
+
+#include <string.h>
+
+CommandVersionTable::CommandVersionTable() {
+  clear();
+}
+
+void CommandVersionTable::clear() {
+  memset(entries_, 0, sizeof(entries_));
+  useCounter_ = 0;
+}
+
+bool CommandVersionTable::isSuperseded(const char* controller, const FieldWrites& writes,
+                                       uint64_t version) const {
+  if (version == 0 || !writes.supersedable()) return false;
+
+  const Entry* entry = find(controller);
+  if (entry == nullptr) return false;
+
+  FieldSet newer;
+  newer.clear();
+  for (const Applied& applied : entry->applied) {
+    if (applied.version > version) newer.add(applied.overwritten);
+  }
+  return writes.coveredBy(newer);
+}
+
+void CommandVersionTable::recordApplied(const char* controller, const FieldWrites& writes,
+                                        uint64_t version) {
+  if (version == 0 || writes.overwritten.empty()) return;
+
+  Entry* entry = findOrEvict(controller);
+  entry->lastUsed = ++useCounter_;
+
+  Applied* slot = &entry->applied[0];
+  for (Applied& applied : entry->applied) {
+    if (applied.version == version) {
+      applied.overwritten.add(writes.overwritten);
+      return;
+    }
+    if (applied.version < slot->version) slot = &applied;
+  }
+  // Older than everything remembered. Dropping it only means fewer
+  // commands are found superseded later.
+  if (slot->version > version) return;
+  slot->version = version;
+  slot->overwritten = writes.overwritten;
+}
+
+const CommandVersionTable::Entry* CommandVersionTable::find(const char* controller) const {
+  for (int i = 0; i < MAX_TRACKED_CONTROLLERS; i++) {
+    if (entries_[i].used &&
+        strncmp(entries_[i].controller, controller, CONTROLLER_KEY_MAX_LEN - 1) == 0) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+CommandVersionTable::Entry* CommandVersionTable::findOrEvict(const char* controller) {
+  Entry* existing = const_cast<Entry*>(find(controller));
+  if (existing != nullptr) return existing;
+
+  // Take a free slot, or the least recently used one
+  Entry* victim = &entries_[0];
+  for (int i = 0; i < MAX_TRACKED_CONTROLLERS; i++) {
+    if (!entries_[i].used) {
+      victim = &entries_[i];
+      break;
+    }
+    if (entries_[i].lastUsed < victim->lastUsed) {
+      victim = &entries_[i];
+    }
+  }
+
+  memset(victim, 0, sizeof(*victim));
+  strncpy(victim->controller, controller, CONTROLLER_KEY_MAX_LEN - 1);
+  victim->used = true;
+  return victim;
+}
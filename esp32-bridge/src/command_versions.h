@@ -0,0 +1,63 @@
+// Lumina ESP32 Bridge - Command Versioning
+//
+// Commands can reach a controller from the LAN app, the cloud relay,
+// schedules and voice assistants, and Firestore polling returns them in no
+// particular order. Each command carries a per-controller version (the
+// app uses its client timestamp in milliseconds). The bridge remembers the
+// fields (field_groups.h) each of the last APPLIED_HISTORY commands applied
+// to a controller overwrote, and drops commands that newer ones have
+// already overwritten completely. Forgetting older history only means
+// fewer commands are dropped, never a wrong drop.
+
+#ifndef COMMAND_VERSIONS_H
+#define COMMAND_VERSIONS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <field_groups.h>
+
+#include "config.h"
+
+// ============================================================================
+// Version Table
+// ============================================================================
+
+class CommandVersionTable {
+ public:
+  CommandVersionTable();
+
+  // True if commands applied to this controller at a strictly newer
+  // version overwrote every field the command touches. Versions are
+  // millisecond timestamps, so two commands sent in the same millisecond
+  // never supersede each other; the queue orders them by arrival. Reads,
+  // opaque and unversioned commands (version == 0) are never superseded.
+  bool isSuperseded(const char* controller, const FieldWrites& writes, uint64_t version) const;
+
+  // Record that a command at `version` was applied to `controller`. Call
+  // once WLED has taken it, not when it is queued or handed off.
+  void recordApplied(const char* controller, const FieldWrites& writes, uint64_t version);
+
+  void clear();
+
+ private:
+  struct Applied {
+    uint64_t version;  // 0 = free
+    FieldSet overwritten;
+  };
+
+  struct Entry {
+    char controller[CONTROLLER_KEY_MAX_LEN];
+    Applied applied[APPLIED_HISTORY];
+    uint32_t lastUsed;
+    bool used;
+  };
+
+  const Entry* find(const char* controller) const;
+  Entry* findOrEvict(const char* controller);
+
+  Entry entries_[MAX_TRACKED_CONTROLLERS];
+  uint32_t useCounter_;
+};
+
+#endif // COMMAND_VERSIONS_H
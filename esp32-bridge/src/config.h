@@ -40,15 +40,435 @@
 // How often to poll Firestore for new commands (in milliseconds)
 #define POLL_INTERVAL_MS 2000
 
+// Backoff after a failed poll. The first retry waits a per-bridge offset
+// up to POLL_BACKOFF_SPREAD_MS, so a fleet that lost Firestore together
+// does not return together; later retries wait a random POLL_BACKOFF_BASE_MS
+// to 3x the previous wait, up to POLL_BACKOFF_CAP_MS, or longer if
+// Firestore sends Retry-After. See esp32-common/tools/reconnect_sim.cpp.
+#define POLL_BACKOFF_BASE_MS 2000
+#define POLL_BACKOFF_CAP_MS 30000
+#define POLL_BACKOFF_SPREAD_MS 10000
+
 // Timeout for HTTP requests to WLED devices (in milliseconds)
 #define WLED_HTTP_TIMEOUT_MS 10000
 
-// Maximum number of pending commands to process per poll cycle
+// Pending commands a normal poll asks for. A page that comes back full
+// means more is waiting: the next poll runs as soon as the queues have room
+// and asks for twice as many, up to POLL_MAX_COMMANDS, as far as the heap
+// allows (PollSizer in esp32-common; tools/backlog_sim.cpp measures it).
 #define MAX_COMMANDS_PER_POLL 5
+#define POLL_MAX_COMMANDS 40
+
+// Heap a poll may use: the free heap less this reserve (TLS connections,
+// status pipeline, WLED requests), at POLL_BYTES_PER_COMMAND per command
+// for its share of the response and the parsed document
+#define POLL_HEAP_RESERVE_BYTES 60000
+#define POLL_BYTES_PER_COMMAND 2048
 
 // LED pin for status indication (built-in LED on most ESP32 dev boards)
 #define STATUS_LED_PIN 2
 
+// ============================================================================
+// Command Versioning
+// ============================================================================
+// Commands carry a `version` field (the app's client timestamp in ms).
+// A command whose every field (per segment and property) was overwritten
+// by newer commands already applied is marked "superseded" without
+// contacting WLED.
+
+// Number of controllers whose applied versions are remembered
+#define MAX_TRACKED_CONTROLLERS 16
+
+// Applied commands remembered per controller (about 28 bytes each)
+#define APPLIED_HISTORY 8
+
+// Maximum length of a controller key (controller ID or IP)
+#define CONTROLLER_KEY_MAX_LEN 40
+
+// ============================================================================
+// Command Queues
+// ============================================================================
+// WLED commands wait in a fixed-size queue per controller and run one at a
+// time, taking controllers in turn. A state write replaces queued state
+// writes it fully overwrites. Queue memory is fixed at build time, roughly
+// COMMAND_QUEUE_CONTROLLERS x COMMAND_QUEUE_DEPTH x COMMAND_BODY_MAX_LEN.
+
+// Controllers that can have commands queued at the same time
+#define COMMAND_QUEUE_CONTROLLERS 8
+
+// Commands queued per controller; more stay pending in Firestore until
+// there is room
+#define COMMAND_QUEUE_DEPTH 4
+
+// Largest WLED JSON body a queued command can carry
+#define COMMAND_BODY_MAX_LEN 1024
+
+// Longest command reference, "{uid}/commands/{commandId}"
+#define COMMAND_REF_MAX_LEN 72
+
+// ============================================================================
+// State Reconciliation
+// ============================================================================
+// State writes update each controller's desired state instead of going to
+// WLED as they are. The bridge sends only what the controller lacks, keeps
+// settings changed at the controller, and resends everything after a
+// reboot (see esp32-common reconciler.h). A command completes once its
+// controller has converged.
+
+// 0 sends every state write to WLED as it comes, as older firmware did
+#define RECONCILE_STATE 1
+
+// Changes that arrive this long after the first unsent one share a request
+#define RECONCILE_SETTLE_MS 50
+
+// An idle controller is checked for reboots and local changes this often
+#define RECONCILE_AUDIT_MS 15000
+
+// Retry delay after a failed request: random, growing from base to cap
+#define RECONCILE_RETRY_BASE_MS 500
+#define RECONCILE_RETRY_CAP_MS 10000
+
+// Commands waiting for their controller to converge, and how long before
+// such a command is reported failed (the bridge keeps converging)
+#define RECONCILE_WAITING_MAX 16
+#define RECONCILE_COMMAND_TIMEOUT_MS 30000
+
+// ============================================================================
+// Site Bridge Mode
+// ============================================================================
+// For managed communities on one network (apartment complexes, HOA common
+// areas), one bridge can serve every property at a site. With SITE_ID set,
+// the bridge runs a single collection-group query for all commands whose
+// `siteId` matches, from any user, instead of polling FIREBASE_USER_UID's
+// commands. Reads per poll no longer grow with the number of properties.
+
+// Site document ID (/sites/{siteId}); leave empty for a single-home bridge
+#define SITE_ID ""
+
+// Commands fetched per poll in site mode
+#define SITE_MAX_COMMANDS_PER_POLL 20
+
+// Commands one property may add to the queues per poll
+#define SITE_MAX_COMMANDS_PER_PROPERTY 4
+
+// Properties tracked at once for fair dispatch and status batching
+#define SITE_MAX_PROPERTIES 16
+
+// Finished-command statuses held for batching, and the longest wait (ms)
+#define SITE_STATUS_BATCH_MAX 16
+#define SITE_STATUS_FLUSH_MS 1000
+
+// Longest error message kept for a batched status
+#define SITE_STATUS_ERROR_MAX_LEN 64
+
+// ============================================================================
+// Zones
+// ============================================================================
+// The app syncs its zone map (zones of controllers and segments) to the
+// bridge with a `syncZones` command, and a `zoneState` command then names
+// a zone instead of carrying one command per controller. The bridge queues
+// one merged state write per controller in the zone.
+
+// Zones held, and controllers per zone
+#define ZONE_MAX 16
+#define ZONE_MAX_CONTROLLERS 8
+
+// zoneState commands with parts still queued; more stay pending
+#define ZONE_COMMANDS_MAX 4
+
+// Longest zone ID
+#define ZONE_ID_MAX_LEN 32
+
+// ============================================================================
+// Status Write Pipeline
+// ============================================================================
+// Command statuses are written by a background task on a second TLS
+// connection (about 40 KB of heap), so the next command's WLED call does not
+// wait for the previous command's status round trip to Firestore.
+
+// Statuses that may wait behind the one being written; 0 writes every
+// status inline, one after the other, as older firmware did
+#define STATUS_PIPELINE_DEPTH 4
+
+// Longest error message a pipelined status carries; longer ones are written
+// inline once the pipeline is empty
+#define STATUS_PIPELINE_ERROR_MAX_LEN 128
+
+// A failed status write (no connection, 429, 5xx) is sent again this many
+// times, the first after STATUS_PIPELINE_RETRY_MS and then twice as long
+// each time; nothing behind it is written meanwhile
+#define STATUS_PIPELINE_RETRIES 3
+#define STATUS_PIPELINE_RETRY_MS 500
+
+// ============================================================================
+// Hedged Delivery
+// ============================================================================
+// With hedged delivery on in the app, each command is written to Firestore
+// and also published over MQTT (through the Lumina Backend) with the same
+// command reference. The bridge listens on both, runs whichever copy comes
+// first and drops the other, so a stall on one link does not delay it. Final
+// statuses go to Firestore and to MQTT. Costs a second TLS connection
+// (about 40 KB of heap) and a Firestore write per status instead of a
+// batched one for commands that come over MQTT.
+
+// 1 = also take commands from MQTT
+#define HEDGED_DELIVERY 0
+
+// Broker and account; the same HiveMQ Cloud cluster the backend publishes to
+#define HEDGE_MQTT_BROKER ""
+#define HEDGE_MQTT_PORT 8883
+#define HEDGE_MQTT_USERNAME ""
+#define HEDGE_MQTT_PASSWORD ""
+
+// Command topics; the backend publishes to lumina/{controllerId}/command.
+// Only messages carrying a reference to one of this bridge's commands run.
+#define HEDGE_MQTT_TOPIC "lumina/+/command"
+
+// Final statuses are published to {prefix}{uid}/commands/{commandId}/status
+#define HEDGE_MQTT_ACK_PREFIX "lumina/"
+
+// Messages waiting for the loop, and statuses waiting to be published
+#define HEDGE_INBOX_DEPTH 4
+#define HEDGE_OUTBOX_DEPTH 8
+
+// Reconnect timing after losing the broker (see POLL_BACKOFF_*)
+#define HEDGE_RECONNECT_BASE_MS 2000
+#define HEDGE_RECONNECT_CAP_MS 30000
+#define HEDGE_RECONNECT_SPREAD_MS 10000
+
+// Longest a poll waits on Firestore in hedged mode. MQTT messages are only
+// run between polls, so a stalled poll would hold them up.
+#define HEDGE_POLL_TIMEOUT_MS 4000
+
+// ============================================================================
+// Usage Metering
+// ============================================================================
+// The bridge counts bytes per transport and Firestore reads/writes/deletes
+// per hour and writes the totals to /users/{uid}/bridges/{BRIDGE_ID}.
+
+// Bridge document ID; leave empty to use the WiFi MAC address
+#define BRIDGE_ID ""
+
+// 0 = off, 1 = always metered, 2 = metered once the daily budget is used
+#define METERED_MODE 2
+
+// Cloud bytes per 24 hours before METERED_MODE 2 switches to frugal settings
+#define METERED_DAILY_BUDGET_BYTES (50UL * 1024 * 1024)
+
+// Longest idle poll interval in metered mode (doubles from POLL_INTERVAL_MS)
+#define METERED_IDLE_POLL_MAX_MS 30000
+
+// How often to publish usage totals (milliseconds)
+#define USAGE_PUBLISH_INTERVAL_MS 3600000UL
+
+// Estimated HTTP request + response header bytes per Firestore call
+#define HTTP_HEADER_OVERHEAD_BYTES 600
+
+// ============================================================================
+// Latency Canary
+// ============================================================================
+// Every CANARY_INTERVAL_MS the bridge writes a getInfo command to the
+// user's commands collection and times it through the poll, the queue and
+// WLED, as a command from the app travels. The series goes out with the
+// usage totals. Each canary costs a read and a few writes (the command and
+// its statuses), so none are sent while the bridge is metered.
+
+// 0 = off. 300000 (5 minutes) gives 12 samples an hour.
+#define CANARY_INTERVAL_MS 0
+
+// Controller the canary reads; "" = the controller commanded last
+#define CANARY_CONTROLLER_IP ""
+
+// A canary not completed by then counts as failed
+#define CANARY_TIMEOUT_MS 60000
+
+// ============================================================================
+// Controller Health
+// ============================================================================
+// Every HEALTH_SAMPLE_MS each controller the bridge has commanded is read
+// (GET /json/info) for frame rate, free heap, WiFi signal, uptime and LED
+// current, plus the request's round trip. Reads wait while commands are
+// queued. Rollups go out with the usage totals, flagged against the
+// thresholds below.
+
+// 0 = off. 60000 fills the hour between usage publishes (60 samples).
+#define HEALTH_SAMPLE_MS 60000
+
+// Timeout of a health read; short, so a dead controller does not hold the loop
+#define HEALTH_HTTP_TIMEOUT_MS 1500
+
+// Flagged when a window's mean is below these
+#define HEALTH_MIN_FPS 15
+#define HEALTH_MIN_FREE_HEAP 12000
+#define HEALTH_MIN_RSSI -75
+
+// ============================================================================
+// Remote Logs
+// ============================================================================
+// Lines from polling, command execution and the queues are printed as
+// before and also kept in a RAM ring, then shipped LZ4-compressed to
+// /users/{uid}/bridges/{bridgeId}/logs. A shipment goes every
+// LOG_SHIP_INTERVAL_MS, when the ring is half full, or on a `shipLogs`
+// command. Shipping waits while commands are queued.
+
+// 0 = off (lines are only printed)
+#define REMOTE_LOGS 1
+
+// Lines kept: 0 errors, 1 + warnings, 2 + info, 3 + debug. A shipLogs
+// command can change it until the next restart.
+#define LOG_CAPTURE_LEVEL 2
+
+// Per call site: a burst of LOG_SITE_BURST lines, refilled one per
+// LOG_SITE_REFILL_MS; past that one line in LOG_SAMPLE_EVERY is kept.
+// Errors are always kept.
+#define LOG_SITE_BURST 20
+#define LOG_SITE_REFILL_MS 3000
+#define LOG_SAMPLE_EVERY 10
+
+// Microseconds per second logging may spend (formatting, storing,
+// compressing) before lines other than errors are dropped
+#define LOG_CPU_BUDGET_US 5000
+
+// Compressed bytes shipped per 24 hours
+#define LOG_DAILY_BYTES (256UL * 1024)
+
+#define LOG_SHIP_INTERVAL_MS 900000UL
+#define LOG_SHIP_BATCH_BYTES 2048   // Text per shipment, before compression
+#define LOG_SHIP_SLOTS 32           // Log documents, reused round robin
+
+// ============================================================================
+// Arrival Pre-warm
+// ============================================================================
+// A `prewarm` command (sent by the app when the customer is approaching
+// home) switches the bridge to fast polling for a while, so the arrival
+// command is picked up quickly, and has the reconciler read the target
+// controllers' state ahead of it.
+
+// Poll interval while pre-warmed (milliseconds)
+#define PREWARM_POLL_INTERVAL_MS 500
+
+// Default and maximum pre-warm window (milliseconds)
+#define PREWARM_WINDOW_MS 300000UL
+#define PREWARM_MAX_WINDOW_MS 900000UL
+
+// ============================================================================
+// Installer Network Diagnostics
+// ============================================================================
+// Run by a `runDiagnostics` command. Each section of the report passes or
+// fails against these thresholds.
+
+// Most controllers checked in one run
+#define DIAG_MAX_CONTROLLERS 8
+
+// LAN round-trip probes per controller, and their spacing/timeout (ms)
+#define DIAG_PROBE_COUNT 20
+#define DIAG_PROBE_SPACING_MS 50
+#define DIAG_PROBE_TIMEOUT_MS 1000
+
+// Back-to-back WLED JSON writes per controller
+#define DIAG_BURST_COUNT 10
+
+// UDP frame test: pixels per frame, duration, and target port (discard)
+#define DIAG_FRAME_PIXELS 480
+#define DIAG_FRAME_TEST_MS 2000
+#define DIAG_FRAME_PORT 9
+
+// ICMP echoes sent alongside the frame test to measure delivery: spacing,
+// and how long to wait for each reply (ms)
+#define DIAG_ECHO_INTERVAL_MS 20
+#define DIAG_ECHO_TIMEOUT_MS 500
+
+// Cloud endpoint and round-trip probes over one TLS session
+#define DIAG_CLOUD_HOST "firestore.googleapis.com"
+#define DIAG_CLOUD_PROBE_COUNT 5
+
+// Pass/fail thresholds
+#define DIAG_MAX_RTT_P90_MS 30
+#define DIAG_MAX_LOSS_PERCENT 2
+#define DIAG_MAX_APPLY_P90_MS 150
+#define DIAG_MIN_FRAME_RATE 40
+#define DIAG_MAX_TLS_HANDSHAKE_MS 1500
+#define DIAG_MAX_CLOUD_RTT_MS 400
+#define DIAG_MIN_RSSI -70
+#define DIAG_MAX_COCHANNEL_APS 8
+
+// ============================================================================
+// Realtime Output
+// ============================================================================
+// A `realtimeStart` command streams a pattern over DDP to controllers that
+// share one strip, latching each frame on all of them together.
+
+// Pixels across all controllers of one stream (3 bytes each of static RAM)
+#define REALTIME_MAX_PIXELS 2400
+
+// Frame rate when the command gives none, and the highest accepted
+#define REALTIME_DEFAULT_FPS 40
+#define REALTIME_MAX_FPS 60
+
+// Longest stream; a command with no duration runs this long
+#define REALTIME_MAX_DURATION_MS 600000
+
+// Latch with one broadcast push instead of one push per controller. Fewer
+// packets and less skew, but some access points delay or drop broadcasts.
+#define REALTIME_BROADCAST_PUSH 0
+
+// ============================================================================
+// State Store
+// ============================================================================
+// State that has to survive a restart goes to a log-structured store on
+// the `state` partition (see partitions.csv). It holds the final status
+// of recent commands, so a command that finished just before a power cut
+// is not run again when the next poll still finds it pending. It also
+// holds the log shipment sequence. Changes are committed together, one
+// flash write for a burst of commands.
+
+// 0 = off (nothing is kept across a restart)
+#define STATE_STORE 1
+
+// Changes are committed this long after the first one
+#define STATE_COMMIT_MS 500
+
+// Flash bytes programmed per 24 hours, compaction included. Past that,
+// changes wait in RAM (a restart loses them) and later writes to the
+// same key replace them.
+#define STATE_DAILY_WRITE_BYTES (256UL * 1024)
+
+// Finished commands remembered, reused round robin
+#define STATE_JOURNAL_SLOTS 32
+
+// ============================================================================
+// File Transfers
+// ============================================================================
+// A `fileFetch` command names a file in Cloud Storage; the bridge downloads
+// it in Range requests, one per loop() pass, so polling and dispatch carry
+// on between them. The download resumes where it stopped after an error or
+// a restart (the command is then sent again).
+
+// Largest range per request. Larger ranges need fewer requests but hold
+// up the loop longer each.
+#define FILE_FETCH_RANGE_BYTES 16384
+
+// Spool chunk size for fetched files; the largest file is 256 chunks
+#define FILE_FETCH_CHUNK_BYTES 4096
+
+// Failed range requests in a row before the command fails; the wait
+// before each retry doubles from FILE_FETCH_RETRY_MS
+#define FILE_FETCH_RETRIES 5
+#define FILE_FETCH_RETRY_MS 1000
+
+// ============================================================================
+// Firmware Updates
+// ============================================================================
+// `otaUpdate` installs only deltas fetched over HTTPS and signed with the
+// Ed25519 key whose public half is below. Print it with
+// `esp32-common/tools/make_delta.py --public-key signing.pem`. All zeros
+// refuses every update.
+
+#define OTA_SIGNING_KEY {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+
 // ============================================================================
 // Debug Configuration
 // ============================================================================
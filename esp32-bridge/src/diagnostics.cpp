@@ -0,0 +1,322 @@
+/**
+ * Lumina ESP32 Bridge - Installer Network Diagnostics
+ *
+ * Report layout (times in milliseconds, "rtt" and "apply" are
+ * [p50, p90, max]):
+ *
+ *   {"v":1,"pass":true,"ms":5230,
+ *    "wifi":{"rssi":-58,"ch":6,"coch":2,"overlap":5,"pass":true},
+ *    "cloud":{"tls":640,"rtt":[88,95,102],"pass":true},
+ *    "ctl":[{"ip":"192.168.1.50","rtt":[3.1,5.2,9.8],"loss":0,
+ *            "apply":[24,31,40],"fail":0,"fps":198,"sent":210,"echoLoss":6,
+ *            "pass":true}]}
+ *
+ * The UDP frame test sends DDP-sized datagrams to the controller's discard
+ * port, so it loads the WiFi path without lighting anything up. Nothing
+ * reports what arrives there, so frame-sized ICMP echoes run alongside the
+ * stream: "sent" is the rate the local stack accepted, "echoLoss" the
+ * echoes lost under that load, and "fps" the rate delivered after that
+ * loss.
+ */
+
+#include "diagnostics.h"
+
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <WiFiUdp.h>
+#include <HTTPClient.h>
+#include <latency_stats.h>
+#include <ddp.h>
+#include <ping/ping_sock.h>
+
+#include "config.h"
+
+static float usToMs(uint32_t us) {
+  return roundf(us / 100.0f) / 10.0f;
+}
+
+// ============================================================================
+// Controller Checks
+// ============================================================================
+
+// TCP connect time to the WLED web server approximates one LAN round trip
+// without needing raw ICMP sockets.
+static void probeRoundTrip(const IPAddress& addr, LatencyStats& stats) {
+  for (int i = 0; i < DIAG_PROBE_COUNT; i++) {
+    WiFiClient client;
+    unsigned long start = micros();
+    if (client.connect(addr, 80, DIAG_PROBE_TIMEOUT_MS)) {
+      stats.add(micros() - start);
+    } else {
+      stats.addFailure();
+    }
+    client.stop();
+    delay(DIAG_PROBE_SPACING_MS);
+  }
+}
+
+// Back-to-back empty state writes: WLED parses and applies the request but
+// nothing visible changes.
+static void probeApplyBurst(const String& ip, LatencyStats& stats) {
+  HTTPClient http;
+  String url = "http://" + ip + "/json/state";
+
+  for (int i = 0; i < DIAG_BURST_COUNT; i++) {
+    http.begin(url);
+    http.setTimeout(WLED_HTTP_TIMEOUT_MS);
+    http.addHeader("Content-Type", "application/json");
+
+    unsigned long start = micros();
+    int httpCode = http.POST("{}");
+    if (httpCode == 200) {
+      http.getString();
+      stats.add(micros() - start);
+    } else {
+      stats.addFailure();
+    }
+    http.end();
+  }
+}
+
+struct EchoProbe {
+  volatile bool done;
+};
+
+static void onEchoEnd(esp_ping_handle_t, void* args) {
+  ((EchoProbe*)args)->done = true;
+}
+
+// Starts DIAG_FRAME_TEST_MS of frame-sized ICMP echoes to the controller
+static esp_ping_handle_t startEchoes(const IPAddress& addr, size_t frameBytes,
+                                     EchoProbe& probe) {
+  esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+  IP_ADDR4(&config.target_addr, addr[0], addr[1], addr[2], addr[3]);
+  config.count = DIAG_FRAME_TEST_MS / DIAG_ECHO_INTERVAL_MS;
+  config.interval_ms = DIAG_ECHO_INTERVAL_MS;
+  config.timeout_ms = DIAG_ECHO_TIMEOUT_MS;
+  // One unfragmented packet, like a DDP frame
+  config.data_size = frameBytes < 1472 ? frameBytes : 1472;
+
+  esp_ping_callbacks_t callbacks = {};
+  callbacks.cb_args = &probe;
+  callbacks.on_ping_end = onEchoEnd;
+
+  esp_ping_handle_t ping = nullptr;
+  probe.done = false;
+  if (esp_ping_new_session(&config, &callbacks, &ping) != ESP_OK) return nullptr;
+  esp_ping_start(ping);
+  return ping;
+}
+
+// Frames per second that reach the controller. The stream's send rate is
+// what the local stack accepted; echoes over the same path at the same
+// time give the share that arrives.
+static uint32_t probeFrameRate(const IPAddress& addr, uint32_t& sentFps,
+                               uint32_t& echoLossPercent) {
+  static uint8_t frame[DDP_HEADER_LEN + DIAG_FRAME_PIXELS * 3];
+  ddpEncode(frame, sizeof(frame), nullptr, DIAG_FRAME_PIXELS * 3, 0, 0, true);
+
+  EchoProbe probe;
+  esp_ping_handle_t ping = startEchoes(addr, sizeof(frame), probe);
+
+  WiFiUDP udp;
+  uint32_t sent = 0;
+  unsigned long start = millis();
+
+  while (millis() - start < DIAG_FRAME_TEST_MS) {
+    if (udp.beginPacket(addr, DIAG_FRAME_PORT) &&
+        udp.write(frame, sizeof(frame)) == sizeof(frame) &&
+        udp.endPacket()) {
+      sent++;
+    }
+    yield();
+  }
+  sentFps = sent * 1000 / DIAG_FRAME_TEST_MS;
+
+  // Without echoes nothing is known to have arrived
+  echoLossPercent = 100;
+  if (ping == nullptr) return 0;
+
+  // Echoes held up by timeouts would run on after the load is gone; wait
+  // only for the one in flight
+  start = millis();
+  while (!probe.done && millis() - start < DIAG_ECHO_TIMEOUT_MS) delay(10);
+  esp_ping_stop(ping);
+
+  uint32_t requests = 0;
+  uint32_t replies = 0;
+  esp_ping_get_profile(ping, ESP_PING_PROF_REQUEST, &requests, sizeof(requests));
+  esp_ping_get_profile(ping, ESP_PING_PROF_REPLY, &replies, sizeof(replies));
+  esp_ping_delete_session(ping);
+
+  if (requests == 0) return 0;
+  if (replies > requests) replies = requests;
+  echoLossPercent = (requests - replies) * 100 / requests;
+  return (uint64_t)sentFps * replies / requests;
+}
+
+static bool checkController(const String& ip, JsonObject out) {
+  out["ip"] = ip;
+
+  IPAddress addr;
+  if (!addr.fromString(ip)) {
+    out["error"] = "bad address";
+    out["pass"] = false;
+    return false;
+  }
+
+  LatencyStats rtt;
+  probeRoundTrip(addr, rtt);
+  JsonArray rttOut = out["rtt"].to<JsonArray>();
+  rttOut.add(usToMs(rtt.percentile(50)));
+  rttOut.add(usToMs(rtt.percentile(90)));
+  rttOut.add(usToMs(rtt.max()));
+  out["loss"] = rtt.lossPercent();
+
+  LatencyStats apply;
+  probeApplyBurst(ip, apply);
+  JsonArray applyOut = out["apply"].to<JsonArray>();
+  applyOut.add(apply.percentile(50) / 1000);
+  applyOut.add(apply.percentile(90) / 1000);
+  applyOut.add(apply.max() / 1000);
+  out["fail"] = apply.failures();
+
+  uint32_t sentFps;
+  uint32_t echoLoss;
+  uint32_t fps = probeFrameRate(addr, sentFps, echoLoss);
+  out["fps"] = fps;
+  out["sent"] = sentFps;
+  out["echoLoss"] = echoLoss;
+
+  bool pass = rtt.count() > 0 &&
+              rtt.percentile(90) <= DIAG_MAX_RTT_P90_MS * 1000UL &&
+              rtt.lossPercent() <= DIAG_MAX_LOSS_PERCENT &&
+              apply.failures() == 0 &&
+              apply.percentile(90) <= DIAG_MAX_APPLY_P90_MS * 1000UL &&
+              fps >= DIAG_MIN_FRAME_RATE;
+  out["pass"] = pass;
+  return pass;
+}
+
+// ============================================================================
+// Cloud Check
+// ============================================================================
+
+// Fresh TLS session to Firestore, then HEAD requests on it. GFE answers
+// HEAD / without touching Firestore, so nothing is billed.
+static bool checkCloud(JsonObject out) {
+  WiFiClientSecure tls;
+  tls.setInsecure();
+  tls.setHandshakeTimeout(30);
+
+  unsigned long start = millis();
+  if (!tls.connect(DIAG_CLOUD_HOST, 443)) {
+    out["error"] = "TLS connect failed";
+    out["pass"] = false;
+    return false;
+  }
+  uint32_t handshakeMs = millis() - start;
+  out["tls"] = handshakeMs;
+
+  LatencyStats rtt;
+  for (int i = 0; i < DIAG_CLOUD_PROBE_COUNT; i++) {
+    start = millis();
+    tls.print("HEAD / HTTP/1.1\r\nHost: " DIAG_CLOUD_HOST "\r\nConnection: keep-alive\r\n\r\n");
+
+    while (!tls.available() && tls.connected() && millis() - start < DIAG_PROBE_TIMEOUT_MS * 2) {
+      delay(1);
+    }
+    if (!tls.available()) {
+      rtt.addFailure();
+      continue;
+    }
+    rtt.add(millis() - start);
+
+    // Drain the headers; a HEAD response has no body
+    while (tls.connected()) {
+      String line = tls.readStringUntil('\n');
+      if (line.length() <= 1) break;
+    }
+  }
+  tls.stop();
+
+  JsonArray rttOut = out["rtt"].to<JsonArray>();
+  rttOut.add(rtt.percentile(50));
+  rttOut.add(rtt.percentile(90));
+  rttOut.add(rtt.max());
+
+  bool pass = rtt.count() > 0 &&
+              handshakeMs <= DIAG_MAX_TLS_HANDSHAKE_MS &&
+              rtt.percentile(90) <= DIAG_MAX_CLOUD_RTT_MS;
+  out["pass"] = pass;
+  return pass;
+}
+
+// ============================================================================
+// WiFi Check
+// ============================================================================
+
+static bool checkWiFi(JsonObject out) {
+  int32_t rssiSum = 0;
+  for (int i = 0; i < 10; i++) {
+    rssiSum += WiFi.RSSI();
+    delay(50);
+  }
+  int rssi = rssiSum / 10;
+  int channel = WiFi.channel();
+  String ownBssid = WiFi.BSSIDstr();
+
+  // Other access points on our channel, and on overlapping 2.4 GHz channels
+  int coChannel = 0;
+  int overlapping = 0;
+  int found = WiFi.scanNetworks(false, true);
+  for (int i = 0; i < found; i++) {
+    if (WiFi.BSSIDstr(i) == ownBssid) continue;
+    int distance = abs(WiFi.channel(i) - channel);
+    if (distance == 0) {
+      coChannel++;
+    } else if (distance < 5) {
+      overlapping++;
+    }
+  }
+  WiFi.scanDelete();
+
+  out["rssi"] = rssi;
+  out["ch"] = channel;
+  out["coch"] = coChannel;
+  out["overlap"] = overlapping;
+
+  bool pass = rssi >= DIAG_MIN_RSSI && coChannel <= DIAG_MAX_COCHANNEL_APS;
+  out["pass"] = pass;
+  return pass;
+}
+
+// ============================================================================
+// Entry Point
+// ============================================================================
+
+bool runNetworkDiagnostics(const String* controllers, int controllerCount,
+                           JsonDocument& report) {
+  Serial.println("Running network diagnostics...");
+  unsigned long start = millis();
+
+  report["v"] = 1;
+  bool pass = true;
+
+  pass &= checkWiFi(report["wifi"].to<JsonObject>());
+  pass &= checkCloud(report["cloud"].to<JsonObject>());
+
+  JsonArray ctl = report["ctl"].to<JsonArray>();
+  for (int i = 0; i < controllerCount; i++) {
+    Serial.print("  Controller ");
+    Serial.println(controllers[i]);
+    pass &= checkController(controllers[i], ctl.add<JsonObject>());
+  }
+
+  report["pass"] = pass;
+  report["ms"] = millis() - start;
+
+  Serial.print("Diagnostics ");
+  Serial.println(pass ? "PASSED" : "FAILED");
+  return pass;
+}
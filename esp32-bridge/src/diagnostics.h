@@ -0,0 +1,21 @@
+// Lumina ESP32 Bridge - Installer Network Diagnostics
+//
+// An on-demand check an installer runs before leaving a site, triggered by
+// a `runDiagnostics` command. It measures whether the customer's WiFi can
+// support responsive control: LAN round trips and loss to every controller,
+// WLED JSON apply latency under a burst, sustained UDP frame rate, cloud
+// TLS handshake and round trip, and WiFi signal and channel congestion.
+// Each section is scored against the DIAG_* thresholds in config.h.
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Runs every check and fills `report` with a compact summary for the
+// installer app. Returns true if every section passed.
+bool runNetworkDiagnostics(const String* controllers, int controllerCount,
+                           JsonDocument& report);
+
+#endif // DIAGNOSTICS_H
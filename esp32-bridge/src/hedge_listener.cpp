@@ -0,0 +1,196 @@
+/**
+ * Lumina ESP32 Bridge - Hedged Delivery MQTT Listener
+ *
+ * Only the task touches the PubSubClient. The rings are shared with the
+ * loop under one mutex, which is never held across network I/O: messages
+ * are copied in from the callback (PubSubClient calls it from loop(), on
+ * this task), and statuses are copied out before they are published.
+ */
+
+#include "hedge_listener.h"
+
+#include <ArduinoJson.h>
+#include <WiFi.h>
+
+static const uint32_t LISTENER_TASK_STACK = 8192;
+static const UBaseType_t LISTENER_TASK_PRIORITY = 1;
+static const BaseType_t LISTENER_TASK_CORE = 0;  // The loop task runs on core 1
+static const uint16_t MQTT_KEEPALIVE_SEC = 60;
+
+HedgeListener::HedgeListener()
+    : mqtt_(client_),
+      backoff_(HEDGE_RECONNECT_BASE_MS, HEDGE_RECONNECT_CAP_MS, HEDGE_RECONNECT_SPREAD_MS),
+      inHead_(0), inCount_(0), outHead_(0), outCount_(0), lock_(nullptr), task_(nullptr),
+      usageOut_(0), usageIn_(0) {
+  clientId_[0] = '\0';
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool HedgeListener::begin(const char* clientId) {
+  if (task_ != nullptr) return true;
+
+  strlcpy(clientId_, clientId, sizeof(clientId_));
+  lock_ = xSemaphoreCreateMutex();
+  if (lock_ == nullptr) return false;
+
+  client_.setInsecure();
+  client_.setHandshakeTimeout(30);
+  mqtt_.setServer(HEDGE_MQTT_BROKER, HEDGE_MQTT_PORT);
+  mqtt_.setBufferSize(HEDGE_MESSAGE_MAX_LEN + 128);  // Topic and header too
+  mqtt_.setKeepAlive(MQTT_KEEPALIVE_SEC);
+  mqtt_.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+    onMessage(topic, payload, length);
+  });
+  backoff_.begin(clientId_, esp_random());
+
+  if (xTaskCreatePinnedToCore(taskEntry, "hedgeListener", LISTENER_TASK_STACK, this,
+                              LISTENER_TASK_PRIORITY, &task_, LISTENER_TASK_CORE) != pdPASS) {
+    task_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool HedgeListener::take(char* out, size_t size, size_t& length) {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  bool have = inCount_ > 0;
+  if (have) {
+    const Message& message = inbox_[inHead_];
+    length = message.length < size ? message.length : size - 1;
+    memcpy(out, message.data, length);
+    out[length] = '\0';
+    inHead_ = (inHead_ + 1) % HEDGE_INBOX_DEPTH;
+    inCount_--;
+  }
+  xSemaphoreGive(lock_);
+  return have;
+}
+
+void HedgeListener::ack(const char* ref, const char* status, const char* error) {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  if (outCount_ == HEDGE_OUTBOX_DEPTH) {
+    outHead_ = (outHead_ + 1) % HEDGE_OUTBOX_DEPTH;
+    outCount_--;
+    stats_.acksDropped++;
+  }
+  Ack& entry = outbox_[(outHead_ + outCount_) % HEDGE_OUTBOX_DEPTH];
+  strlcpy(entry.ref, ref, sizeof(entry.ref));
+  strlcpy(entry.status, status, sizeof(entry.status));
+  strlcpy(entry.error, error != nullptr ? error : "", sizeof(entry.error));
+  outCount_++;
+  xSemaphoreGive(lock_);
+}
+
+HedgeListenerStats HedgeListener::stats() {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  HedgeListenerStats copy = stats_;
+  xSemaphoreGive(lock_);
+  return copy;
+}
+
+void HedgeListener::takeUsage(uint32_t& bytesOut, uint32_t& bytesIn) {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  bytesOut = usageOut_;
+  bytesIn = usageIn_;
+  usageOut_ = usageIn_ = 0;
+  xSemaphoreGive(lock_);
+}
+
+void HedgeListener::taskEntry(void* arg) {
+  ((HedgeListener*)arg)->run();
+}
+
+void HedgeListener::run() {
+  for (;;) {
+    if (WiFi.status() != WL_CONNECTED) {
+      delay(500);
+      continue;
+    }
+    if (!mqtt_.connected()) {
+      // Only this task writes stats_.connected, so it may read it unlocked
+      if (stats_.connected) {
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        stats_.connected = false;
+        xSemaphoreGive(lock_);
+        backoff_.failed(millis());
+      }
+      if (!backoff_.due(millis()) || !connect()) {
+        delay(100);
+        continue;
+      }
+    }
+    mqtt_.loop();
+    publishAcks();
+    delay(5);
+  }
+}
+
+bool HedgeListener::connect() {
+  bool ok = mqtt_.connect(clientId_, HEDGE_MQTT_USERNAME, HEDGE_MQTT_PASSWORD) &&
+            mqtt_.subscribe(HEDGE_MQTT_TOPIC);
+
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  stats_.connected = ok;
+  if (ok) stats_.connects++;
+  xSemaphoreGive(lock_);
+
+  if (ok) {
+    backoff_.succeeded();
+  } else {
+    DEBUG_PRINT("Hedge MQTT connect failed, rc=");
+    DEBUG_PRINTLN(mqtt_.state());
+    mqtt_.disconnect();
+    backoff_.failed(millis());
+  }
+  return ok;
+}
+
+void HedgeListener::onMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  // MQTT fixed header + topic length prefix
+  usageIn_ += length + strlen(topic) + 4;
+  if (length >= HEDGE_MESSAGE_MAX_LEN || inCount_ == HEDGE_INBOX_DEPTH) {
+    stats_.dropped++;
+  } else {
+    Message& message = inbox_[(inHead_ + inCount_) % HEDGE_INBOX_DEPTH];
+    message.length = length;
+    memcpy(message.data, payload, length);
+    inCount_++;
+    stats_.received++;
+  }
+  xSemaphoreGive(lock_);
+}
+
+void HedgeListener::publishAcks() {
+  for (;;) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool have = outCount_ > 0;
+    if (have) {
+      sending_ = outbox_[outHead_];
+      outHead_ = (outHead_ + 1) % HEDGE_OUTBOX_DEPTH;
+      outCount_--;
+    }
+    xSemaphoreGive(lock_);
+    if (!have) return;
+
+    char topic[sizeof(HEDGE_MQTT_ACK_PREFIX) + COMMAND_REF_MAX_LEN + 8];
+    snprintf(topic, sizeof(topic), "%s%s/status", HEDGE_MQTT_ACK_PREFIX, sending_.ref);
+
+    JsonDocument doc;
+    doc["status"] = sending_.status;
+    if (sending_.error[0] != '\0') doc["error"] = sending_.error;
+    char body[128];
+    size_t length = serializeJson(doc, body, sizeof(body));
+
+    bool sent = mqtt_.publish(topic, (const uint8_t*)body, length, false);
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (sent) {
+      stats_.acks++;
+      usageOut_ += length + strlen(topic) + 4;
+    } else {
+      stats_.acksDropped++;
+    }
+    xSemaphoreGive(lock_);
+  }
+}
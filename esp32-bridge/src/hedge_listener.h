@@ -0,0 +1,98 @@
+// Lumina ESP32 Bridge - Hedged Delivery MQTT Listener
+//
+// The MQTT half of hedged delivery (see HEDGED_DELIVERY in config.h and
+// hedged_intake.h). A task of its own keeps the MQTT session up on its own
+// TLS connection and moves messages through two small rings: command
+// messages in, for the loop to take(), and final statuses out, published as
+// they come. The loop never waits on the broker, and a poll stuck on
+// Firestore does not stop the session from reading.
+//
+// A message that does not fit, or arrives with the inbox full, is dropped;
+// its Firestore copy still delivers the command.
+
+#ifndef HEDGE_LISTENER_H
+#define HEDGE_LISTENER_H
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <PubSubClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <reconnect_backoff.h>
+
+#include "config.h"
+
+// Largest command message: the body plus the command's other fields
+#define HEDGE_MESSAGE_MAX_LEN (COMMAND_BODY_MAX_LEN + 512)
+
+struct HedgeListenerStats {
+  uint32_t received;     // Command messages put in the inbox
+  uint32_t dropped;      // Too large, or the inbox was full
+  uint32_t acks;         // Statuses published
+  uint32_t acksDropped;  // Outbox full, or the broker unreachable
+  uint32_t connects;     // Sessions opened
+  bool connected;
+};
+
+class HedgeListener {
+ public:
+  HedgeListener();
+
+  // Creates the lock and starts the task, which connects as `clientId`.
+  // False if either could not be created.
+  bool begin(const char* clientId);
+  bool running() const { return task_ != nullptr; }
+
+  // Moves the oldest waiting message into `out`; false if there is none
+  bool take(char* out, size_t size, size_t& length);
+
+  // Queues a command's final status for publishing. The oldest waiting one
+  // is dropped when the outbox is full.
+  void ack(const char* ref, const char* status, const char* error);
+
+  HedgeListenerStats stats();
+
+  // MQTT bytes since the last call, for the usage meter (which is only
+  // touched from the main loop)
+  void takeUsage(uint32_t& bytesOut, uint32_t& bytesIn);
+
+ private:
+  struct Message {
+    uint16_t length;
+    char data[HEDGE_MESSAGE_MAX_LEN];
+  };
+
+  struct Ack {
+    char ref[COMMAND_REF_MAX_LEN];
+    char status[12];
+    char error[64];
+  };
+
+  static void taskEntry(void* arg);
+  void run();
+  bool connect();
+  void onMessage(const char* topic, const uint8_t* payload, unsigned int length);
+  void publishAcks();
+
+  WiFiClientSecure client_;
+  PubSubClient mqtt_;
+  ReconnectBackoff backoff_;
+  char clientId_[48];
+
+  Message inbox_[HEDGE_INBOX_DEPTH];
+  size_t inHead_;
+  size_t inCount_;
+  Ack outbox_[HEDGE_OUTBOX_DEPTH];
+  size_t outHead_;
+  size_t outCount_;
+  Ack sending_;
+
+  SemaphoreHandle_t lock_;
+  TaskHandle_t task_;
+  HedgeListenerStats stats_;
+  uint32_t usageOut_;
+  uint32_t usageIn_;
+};
+
+#endif // HEDGE_LISTENER_H
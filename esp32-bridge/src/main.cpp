@@ -7,7 +7,8 @@
  * How it works:
  * 1. Connects to local WiFi network
  * 2. Polls Firestore for pending commands
- * 3. Executes commands by making HTTP requests to WLED devices
+ * 3. Queues them per controller and executes them by making HTTP
+ *    requests to WLED devices
  * 4. Updates command status in Firestore
  */
 
@@ -17,18 +18,250 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
+#include <LittleFS.h>
 #include <time.h>
+#include <stdarg.h>
+#include <mbedtls/base64.h>
+#include <usage_meter.h>
+#include <delta_ota.h>
+#include <command_queue.h>
+#include <coop.h>
+#include <coop_tcp.h>
+#include <coop_bench.h>
+#include <file_spool.h>
+#include <reconnect_backoff.h>
+#include <firestore_json.h>
+#include <kernel_bench.h>
+#include <reconciler.h>
+#include <reconcile_wled.h>
+#include <latency_canary.h>
+#include <hedged_intake.h>
+#include <poll_sizer.h>
+#include <health_series.h>
+#include <log_ring.h>
+#include <lz4_block.h>
+#include <state_store.h>
 
 #include "config.h"
+#include "command_versions.h"
+#include "diagnostics.h"
+#include "status_writer.h"
+#include "status_pipeline.h"
+#include "site_bridge.h"
+#include "zone_map.h"
+#include "realtime_output.h"
+#include "hedge_listener.h"
 
 // ============================================================================
 // Global Variables
 // ============================================================================
 
 WiFiClientSecure secureClient;
+StatusWriter statusWriter(secureClient);
+
+// Background status writes on their own connection (STATUS_PIPELINE_DEPTH)
+WiFiClientSecure statusClient;
+StatusWriter pipelineWriter(statusClient);
+StatusPipeline statusPipeline(pipelineWriter);
 bool firebaseReady = false;
+bool recoverQueuedCommands = true;  // First poll also picks up "queued" commands
 unsigned long lastPollTime = 0;
-unsigned long lastBlinkTime = 0;
+unsigned long lastUsagePublish = 0;
+
+// Current poll interval; grows while idle in metered mode
+unsigned long pollIntervalMs = POLL_INTERVAL_MS;
+ReconnectBackoff pollBackoff(POLL_BACKOFF_BASE_MS, POLL_BACKOFF_CAP_MS, POLL_BACKOFF_SPREAD_MS);
+
+// Cloud bytes and Firestore operations per hour
+UsageMeter usageMeter;
+
+// Arrival pre-warm: fast polling until prewarmUntil, and the arrival scene
+unsigned long prewarmUntil = 0;
+String prewarmSceneId;
+String prewarmSceneBody;
+
+// Last applied command version per controller and field group
+CommandVersionTable appliedVersions;
+
+// Resumable file transfers to WLED /edit, spooled to LittleFS
+FileSpool fileSpool;
+
+// The fileFetch download in progress, one range per loop() pass
+struct FileFetchJob {
+  bool active;
+  String commandId;
+  String transferId;
+  String url;
+  String controllerIp;
+  uint32_t startedAt;
+  uint32_t retryAt;
+  uint32_t bytes;     // Downloaded for this command
+  uint8_t failures;   // Range requests failed in a row
+};
+FileFetchJob fileFetch;
+
+// Zones synced from the app, kept on flash across restarts
+ZoneMap zoneMap;
+const char* ZONE_MAP_FILE = "/zones.json";
+
+// A zoneState command whose per-controller parts are queued; its status is
+// written once every part has settled
+struct ZoneCommand {
+  char id[COMMAND_REF_MAX_LEN];  // "" = free slot
+  uint8_t parts;                 // Queued
+  uint8_t waiting;               // Not settled yet
+  uint8_t failed;
+  uint8_t superseded;
+  char error[SITE_STATUS_ERROR_MAX_LEN];  // First part's failure
+} zoneCommands[ZONE_COMMANDS_MAX];
+
+// Controller key last seen with each controller IP. Zone maps name
+// controllers by IP; their parts use the key direct commands use, so both
+// share a queue and a version history.
+struct ControllerAlias {
+  char ip[16];
+  char key[CONTROLLER_KEY_MAX_LEN];
+} controllerAliases[COMMAND_QUEUE_CONTROLLERS];
+
+// Desired state per controller, converged by stepReconciler()
+Reconciler reconciler(RECONCILE_SETTLE_MS, RECONCILE_AUDIT_MS, RECONCILE_RETRY_BASE_MS,
+                      RECONCILE_RETRY_CAP_MS);
+
+// A state write whose status waits for its controller to converge
+struct ReconcileWaiter {
+  char id[COMMAND_REF_MAX_LEN];  // "" = free slot
+  int8_t property;
+  int8_t controller;
+  uint32_t since;
+  // Recorded in appliedVersions once the controller converges
+  char controllerKey[CONTROLLER_KEY_MAX_LEN];
+  uint64_t version;
+  FieldWrites writes;
+  int8_t zone;  // zoneCommands slot of a zone part; -1 otherwise
+} reconcileWaiters[RECONCILE_WAITING_MAX];
+
+// Synthetic getInfo commands through Firestore, timed end to end
+LatencyCanary canary(CANARY_INTERVAL_MS, CANARY_TIMEOUT_MS);
+String lastControllerIp;  // Of the last dispatched command, for the canary
+
+// /json/info samples of every commanded controller, rolled up per publish
+HealthSeries healthSeries(HEALTH_SAMPLE_MS);
+
+// Diagnostic lines kept for shipping to Firestore, by call site
+enum LogSite : uint8_t { SITE_POLL, SITE_EXECUTE, SITE_BRIDGE, SITE_QUEUE, LOG_SITE_COUNT };
+const char* const LOG_SITE_NAMES[LOG_SITE_COUNT] = {"poll", "execute", "bridge", "queue"};
+LogRing remoteLog(LOG_SITE_NAMES, LOG_SITE_COUNT, (LogLevel)LOG_CAPTURE_LEVEL, LOG_SITE_BURST,
+                  LOG_SITE_REFILL_MS, LOG_SAMPLE_EVERY, LOG_CPU_BUDGET_US, LOG_DAILY_BYTES);
+unsigned long lastLogShip = 0;
+uint32_t logShipSeq = 0;
+bool logShipRequested = false;  // A shipLogs command: ship everything now
+
+// State kept across restarts on the `state` partition (STATE_STORE)
+PartitionStateFlash stateFlash;
+StateStore stateStore(STATE_COMMIT_MS, STATE_DAILY_WRITE_BYTES);
+
+// Final statuses of recent commands: "done/NN" in the store, mirrored here
+const char* const FINAL_STATUSES[] = {"completed", "failed", "superseded"};
+const uint8_t FINAL_STATUS_COUNT = sizeof(FINAL_STATUSES) / sizeof(FINAL_STATUSES[0]);
+struct JournalEntry {
+  uint32_t seq;    // 0 = free slot
+  uint8_t status;  // FINAL_STATUSES index
+  char ref[COMMAND_REF_MAX_LEN];
+} commandJournal[STATE_JOURNAL_SLOTS];
+uint32_t journalSeq = 1;
+
+// Hedged delivery: commands also come over MQTT; the first copy runs
+HedgedIntake hedgedIntake;
+HedgeListener hedgeListener;
+
+// DDP stream to controllers sharing one strip, on its own task
+RealtimeOutput realtimeOutput;
+
+// Coroutines stepped from loop(): the status LED heartbeat, and LAN
+// requests that run side by side on the loop task's stack
+CoopScheduler coop;
+
+// Heartbeat every 5 s: 1 blink = connected to Firebase, 2 = WiFi only,
+// 3 = no WiFi. Runs between other work instead of blocking the loop.
+class HeartbeatLed : public Coroutine {
+ protected:
+  CoroWait resume() override;
+
+ private:
+  int blinks_;
+  int i_;
+} heartbeatLed;
+
+// Time the loop spends executing each dispatched command, statuses included.
+// 64-bit: 32 bits of microseconds wrap after 71 minutes of execution.
+struct DispatchStats {
+  uint32_t commands;
+  uint64_t busyMicros;
+  uint32_t maxMicros;
+} dispatchStats = {0, 0, 0};
+
+// Site bridge mode: one collection-group query for every property at SITE_ID
+#define SITE_MODE (sizeof(SITE_ID) > 1)
+#define POLL_BATCH_MAX \
+  (SITE_MAX_COMMANDS_PER_POLL > POLL_MAX_COMMANDS ? SITE_MAX_COMMANDS_PER_POLL \
+                                                   : POLL_MAX_COMMANDS)
+
+// Page size and pace of the pending-command query
+PollSizer pollSizer(SITE_MODE ? SITE_MAX_COMMANDS_PER_POLL : MAX_COMMANDS_PER_POLL,
+                    POLL_BATCH_MAX, POLL_BYTES_PER_COMMAND);
+
+SiteProperties siteProperties;
+SiteStatus dueStatuses[SITE_STATUS_BATCH_MAX];
+
+// A command picked up by one poll, before execution
+struct PendingCommand {
+  String id;          // Reference relative to /users: "{uid}/commands/{commandId}"
+  String property;    // propertyId, or the owner's uid (site mode only)
+  String controller;  // controllerId, or controllerIp for older producers
+  JsonObject fields;
+  uint64_t version;   // 0 = unversioned, never superseded
+  FieldWrites writes;
+  bool superseded;
+  const char* journaled;  // Final status from before a restart, or nullptr
+};
+
+// A WLED command waiting in its controller's queue
+struct QueuedCommand {
+  char id[COMMAND_REF_MAX_LEN];  // "{uid}/commands/{commandId}"
+  int8_t property;               // SiteProperties index; -1 outside site mode
+  char controller[CONTROLLER_KEY_MAX_LEN];
+  char controllerIp[CONTROLLER_KEY_MAX_LEN];
+  char type[20];
+  uint64_t version;
+  FieldWrites writes;
+  bool overwritable;  // State write; a newer one may replace it in the queue
+  int8_t zone;        // zoneCommands slot of a zone part; -1 otherwise
+  char body[COMMAND_BODY_MAX_LEN];
+};
+
+CommandQueues<QueuedCommand, COMMAND_QUEUE_CONTROLLERS, COMMAND_QUEUE_DEPTH> commandQueues;
+
+// Staging for push/pop, kept off the loop task's stack
+QueuedCommand incomingCommand;
+QueuedCommand dispatchedCommand;
+
+// Status changes from one poll, written in a single Firestore commit
+// A status change waiting in a batch. Its strings are copies: the command
+// may have left the queue by the time the batch is committed.
+struct StatusBatchWrite {
+  char ref[COMMAND_REF_MAX_LEN];
+  char status[12];
+  char error[SITE_STATUS_ERROR_MAX_LEN];
+};
+
+// Writes of the open batch; one batch is open at a time
+StatusBatchWrite statusBatchWrites[POLL_BATCH_MAX];
+
+struct StatusBatch {
+  String timestamp;
+  int count = 0;
+  bool pipelined = false;  // Each status goes to the pipeline instead
+};
 
 // Firestore base URL
 String firestoreBaseUrl() {
@@ -43,13 +276,80 @@ String firestoreBaseUrl() {
 void setupWiFi();
 void setupFirebase();
 void pollCommands();
-void executeCommand(const String& commandId, JsonObject& fields);
+bool executeBridgeCommand(const String& commandId, JsonObject& fields);
+bool executeCommand(const QueuedCommand& cmd);
+bool enqueueCommand(PendingCommand& cmd, StatusBatch& batch);
+bool queueCommand(QueuedCommand& queued, StatusBatch& batch);
+void addQueuedStatus(StatusBatch& batch, const QueuedCommand& cmd, const char* status);
+void settleZonePart(int8_t zone, const char* status, const char* error);
+void rememberControllerKey(const char* ip, const char* key);
+const char* controllerKeyForIp(const char* ip);
+void dispatchQueuedCommand();
+void markSupersededCommands(PendingCommand* commands, int count);
+void addStatusWrite(StatusBatch& batch, const char* commandRef, const char* status,
+                    const char* error = nullptr);
+void commitStatusBatch(StatusBatch& batch);
+void reportCommandStatus(const QueuedCommand& cmd, const char* status, const char* error = "");
+void reportCommandStatus(const char* id, int8_t property, const char* status,
+                         const char* error = "");
+bool reconcileQueuedCommand(const QueuedCommand& cmd);
+void stepReconciler();
+void finishReconciledCommands();
+void flushSiteStatuses();
+uint64_t commandVersion(JsonObject& fields);
+FieldWrites commandFieldWrites(JsonObject& fields);
+String commandControllerKey(JsonObject& fields);
+String isoTimestamp();
+String bridgeId();
+void meterFirestore(uint32_t up, uint32_t down);
+void updateMeteredMode();
+void publishUsage();
+void addCanaryFields(JsonObject fields);
+void sampleControllerHealth();
+void logLine(LogLevel level, LogSite site, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void shipLogs();
+bool runShipLogsCommand(const String& commandId, JsonObject& fields);
+void addHealthFields(JsonObject fields);
+void sendCanary();
+String canaryRef();
+void takeHedgedCommands();
+bool isOwnCommandRef(const String& ref, const char* siteId);
+void settleHedged(const char* ref, const char* status, const char* error);
+void answerLateCopy(const String& ref);
+void meterHedgeListener();
+void addHedgeFields(JsonObject fields);
 String makeWledRequest(const String& ip, const String& method,
                        const String& endpoint, const String& body);
-void updateCommandStatus(const String& commandId, const String& status,
-                         const String& error = "");
+void updateCommandStatus(const String& commandRef, const String& status,
+                         const String& error = "", const String& result = "");
+void loadStateStore();
+void journalCommand(const char* ref, const char* status);
+const char* journaledStatus(const char* ref);
+void addStateStoreFields(JsonObject fields);
+void meterStatusPipeline();
+bool isBridgeCommand(const char* type);
+bool runDiagnosticsCommand(const String& commandId, JsonObject& fields,
+                           const String& controllerIp);
+bool runOtaCommand(const String& commandId, JsonObject& fields);
+bool runPrewarmCommand(const String& commandId, JsonObject& fields,
+                       const String& controllerIp);
+bool runBenchmarkCommand(const String& commandId, JsonObject& fields);
+bool runKernelBenchCommand(const String& commandId, JsonObject& fields);
+String kernelBenchReport(uint32_t iterations, const char* wledIp);
+void checkSerialCommand();
+bool runFileCommand(const String& commandId, const String& type, JsonObject& fields,
+                    const String& controllerIp);
+void stepFileFetch();
+void finishFileFetch(bool ok, const String& error, const FileUploadResult* upload = nullptr);
+bool runZoneSyncCommand(const String& commandId, JsonObject& fields);
+bool runZoneStateCommand(const String& commandId, JsonObject& fields);
+bool runRealtimeCommand(const String& commandId, const String& type, JsonObject& fields);
+void loadZoneMap();
+int warmControllers(JsonArray controllers, const String& fallbackIp, int& targets);
+bool prewarmActive();
+unsigned long currentPollInterval();
 void blinkLed(int times, int delayMs);
-void statusBlink();
 String convertFirestorePayloadToJson(JsonObject& fields);
 
 // ============================================================================
@@ -73,6 +373,17 @@ void setup() {
 
   setupWiFi();
   setupFirebase();
+  if (HEDGED_DELIVERY && !hedgeListener.begin(("lumina-bridge-" + bridgeId()).c_str())) {
+    Serial.println("Hedge listener not started; taking commands from Firestore only");
+  }
+  pollBackoff.begin(bridgeId().c_str(), esp_random());
+  canary.begin(millis(), CANARY_INTERVAL_MS > 0 ? esp_random() % CANARY_INTERVAL_MS : 0);
+
+  if (!fileSpool.begin()) {
+    Serial.println("LittleFS unavailable; file transfers disabled");
+  }
+  loadZoneMap();
+  if (STATE_STORE) loadStateStore();
 
   Serial.println();
   Serial.println("Bridge initialized and ready!");
@@ -82,6 +393,8 @@ void setup() {
   digitalWrite(STATUS_LED_PIN, HIGH);
   delay(1000);
   digitalWrite(STATUS_LED_PIN, LOW);
+
+  coop.spawn(heartbeatLed);
 }
 
 // ============================================================================
@@ -89,18 +402,47 @@ void setup() {
 // ============================================================================
 
 void loop() {
-  statusBlink();
+  coop.runOnce();
+  checkSerialCommand();
+  updateMeteredMode();
 
-  if (millis() - lastPollTime >= POLL_INTERVAL_MS) {
+  if (millis() - lastPollTime >= currentPollInterval() && pollBackoff.due(millis())) {
     lastPollTime = millis();
 
     if (firebaseReady && WiFi.status() == WL_CONNECTED) {
       pollCommands();
+      // A backlog's next poll waits for queue room, counted from now
+      if (pollSizer.backlog()) lastPollTime = millis();
     } else {
       DEBUG_PRINTLN("Not ready, skipping poll");
     }
   }
 
+  // One queued command per pass keeps polling responsive during bursts
+  if (firebaseReady && WiFi.status() == WL_CONNECTED) {
+    if (HEDGED_DELIVERY) takeHedgedCommands();
+    dispatchQueuedCommand();
+    stepFileFetch();
+    stepReconciler();
+    finishReconciledCommands();
+    if (SITE_MODE) flushSiteStatuses();
+    if (canary.due(millis())) sendCanary();
+    // Health reads and log shipments only fill idle time
+    if (healthSeries.enabled() && commandQueues.empty()) sampleControllerHealth();
+    if (REMOTE_LOGS && commandQueues.empty()) shipLogs();
+  }
+
+  meterStatusPipeline();
+  meterHedgeListener();
+
+  // Commits due changes; compacts only while no command waits on the flash
+  if (STATE_STORE) stateStore.step(millis(), commandQueues.empty());
+
+  if (firebaseReady && millis() - lastUsagePublish >= USAGE_PUBLISH_INTERVAL_MS) {
+    lastUsagePublish = millis();
+    publishUsage();
+  }
+
   delay(10);
 }
 
@@ -151,8 +493,20 @@ void setupFirebase() {
 
   // SSL configuration for ESP32
   secureClient.setInsecure();
-  secureClient.setHandshakeTimeout(30);
+  // Hedged: a stalled Firestore must not hold up commands from MQTT for long
+  secureClient.setHandshakeTimeout(HEDGED_DELIVERY ? HEDGE_POLL_TIMEOUT_MS / 1000 : 30);
   secureClient.setTimeout(15);
+  statusWriter.begin("firestore.googleapis.com", FIREBASE_PROJECT_ID, FIREBASE_API_KEY);
+
+  if (STATUS_PIPELINE_DEPTH > 0) {
+    statusClient.setInsecure();
+    statusClient.setHandshakeTimeout(30);
+    statusClient.setTimeout(15);
+    pipelineWriter.begin("firestore.googleapis.com", FIREBASE_PROJECT_ID, FIREBASE_API_KEY);
+    if (!statusPipeline.begin()) {
+      Serial.println("Status pipeline not started; writing statuses inline");
+    }
+  }
 
   // Sync time for timestamps
   configTime(0, 0, "pool.ntp.org", "time.nist.gov");
@@ -174,6 +528,8 @@ void setupFirebase() {
 
   http.begin(secureClient, testUrl);
   int httpCode = http.GET();
+  meterFirestore(testUrl.length(), http.getSize() > 0 ? http.getSize() : 0);
+  usageMeter.addFirestoreOps(FIRESTORE_READ);
   http.end();
 
   if (httpCode == 200 || httpCode == 404) {
@@ -191,71 +547,228 @@ void setupFirebase() {
 // ============================================================================
 
 void pollCommands() {
-  DEBUG_PRINTLN("Polling for commands...");
+  logLine(LOG_DEBUG, SITE_POLL, "Polling for commands...");
 
   HTTPClient http;
   // Use structured query to only fetch pending commands
-  String url = firestoreBaseUrl() + ":runQuery?key=" + String(FIREBASE_API_KEY);
+  String url;
+
+  // Larger pages while a backlog lasts, within the heap and queue room
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t heapBytes = freeHeap > POLL_HEAP_RESERVE_BYTES ? freeHeap - POLL_HEAP_RESERVE_BYTES : 0;
+  int limit = pollSizer.limit(heapBytes, commandQueues.CAPACITY - commandQueues.stats().depth);
 
-  // Build query: SELECT * FROM commands WHERE status == "pending" LIMIT 5
+  // Build query: SELECT * FROM commands WHERE status == "pending" LIMIT {limit}
+  // Site mode: SELECT * FROM ** /commands WHERE siteId == SITE_ID AND
+  // status == "pending" LIMIT {limit}, across every user
   JsonDocument queryDoc;
-  queryDoc["structuredQuery"]["from"][0]["collectionId"] = "commands";
-  queryDoc["structuredQuery"]["where"]["fieldFilter"]["field"]["fieldPath"] = "status";
-  queryDoc["structuredQuery"]["where"]["fieldFilter"]["op"] = "EQUAL";
-  queryDoc["structuredQuery"]["where"]["fieldFilter"]["value"]["stringValue"] = "pending";
-  queryDoc["structuredQuery"]["limit"] = MAX_COMMANDS_PER_POLL;
+  JsonObject statusFilter;
+  if (SITE_MODE) {
+    url = "https://firestore.googleapis.com/v1/projects/" + String(FIREBASE_PROJECT_ID) +
+          "/databases/(default)/documents:runQuery?key=" + String(FIREBASE_API_KEY);
+    queryDoc["structuredQuery"]["from"][0]["collectionId"] = "commands";
+    queryDoc["structuredQuery"]["from"][0]["allDescendants"] = true;
+    JsonObject where = queryDoc["structuredQuery"]["where"]["compositeFilter"].to<JsonObject>();
+    where["op"] = "AND";
+    JsonArray filters = where["filters"].to<JsonArray>();
+    JsonObject siteFilter = filters.add<JsonObject>()["fieldFilter"].to<JsonObject>();
+    siteFilter["field"]["fieldPath"] = "siteId";
+    siteFilter["op"] = "EQUAL";
+    siteFilter["value"]["stringValue"] = SITE_ID;
+    statusFilter = filters.add<JsonObject>()["fieldFilter"].to<JsonObject>();
+  } else {
+    url = firestoreBaseUrl() + ":runQuery?key=" + String(FIREBASE_API_KEY);
+    queryDoc["structuredQuery"]["from"][0]["collectionId"] = "commands";
+    statusFilter = queryDoc["structuredQuery"]["where"]["fieldFilter"].to<JsonObject>();
+  }
+
+  statusFilter["field"]["fieldPath"] = "status";
+  if (recoverQueuedCommands) {
+    // Commands queued before a restart were lost with the RAM queues
+    statusFilter["op"] = "IN";
+    JsonArray statuses = statusFilter["value"]["arrayValue"]["values"].to<JsonArray>();
+    statuses.add<JsonObject>()["stringValue"] = "pending";
+    statuses.add<JsonObject>()["stringValue"] = "queued";
+  } else {
+    statusFilter["op"] = "EQUAL";
+    statusFilter["value"]["stringValue"] = "pending";
+  }
+  queryDoc["structuredQuery"]["limit"] = limit;
+
+  // Metered: only download the fields the bridge reads
+  if (usageMeter.metered()) {
+    JsonArray select = queryDoc["structuredQuery"]["select"]["fields"].to<JsonArray>();
+    const char* selected[] = {"type",       "controllerId", "controllerIp", "payload",
+                              "version",    "propertyId",   "canarySeq",    "hedged"};
+    for (const char* field : selected) {
+      select.add<JsonObject>()["fieldPath"] = field;
+    }
+  }
 
   String queryBody;
   serializeJson(queryDoc, queryBody);
 
   http.begin(secureClient, url);
   http.addHeader("Content-Type", "application/json");
+  if (HEDGED_DELIVERY) {
+    http.setConnectTimeout(HEDGE_POLL_TIMEOUT_MS);
+    http.setTimeout(HEDGE_POLL_TIMEOUT_MS);
+  }
+  const char* responseHeaders[] = {"Retry-After"};
+  http.collectHeaders(responseHeaders, 1);
 
   int httpCode = http.POST(queryBody);
 
   if (httpCode == 200) {
     String response = http.getString();
     http.end();
+    meterFirestore(url.length() + queryBody.length(), response.length());
+    recoverQueuedCommands = false;
+    pollBackoff.succeeded();
 
     JsonDocument doc;
     DeserializationError error = deserializeJson(doc, response);
 
     if (error) {
-      DEBUG_PRINT("JSON parse error: ");
-      DEBUG_PRINTLN(error.c_str());
+      logLine(LOG_ERROR, SITE_POLL, "JSON parse error: %s", error.c_str());
       return;
     }
 
     JsonArray results = doc.as<JsonArray>();
+    // Static: a page of POLL_BATCH_MAX would crowd the loop task's stack
+    static PendingCommand pending[POLL_BATCH_MAX];
     int pendingCount = 0;
+    int documents = 0;
 
     for (JsonObject result : results) {
       JsonObject document = result["document"];
       if (document.isNull()) continue;
+      documents++;
+      if (pendingCount >= limit) continue;
+
+      // ".../documents/users/{uid}/commands/{commandId}"; in site mode the
+      // collection-group query could also match other "commands" collections
+      String docName = document["name"].as<String>();
+      int usersAt = docName.indexOf("/documents/users/");
+      if (usersAt < 0) continue;
+      String ref = docName.substring(usersAt + 17);
+      int slash = ref.indexOf('/');
+      if (slash < 0 || !ref.substring(slash).startsWith("/commands/") ||
+          ref.length() >= COMMAND_REF_MAX_LEN) {
+        continue;
+      }
+
+      // Hedged: skip a command whose MQTT copy was taken first
+      if (HEDGED_DELIVERY && (document["fields"]["hedged"]["booleanValue"] | false) &&
+          !hedgedIntake.arrive(ref.c_str(), HEDGE_FIRESTORE, millis())) {
+        answerLateCopy(ref);
+        continue;
+      }
+
+      PendingCommand& cmd = pending[pendingCount++];
+      cmd.id = ref;
+      cmd.fields = document["fields"];
+      if (SITE_MODE) {
+        const char* propertyId = cmd.fields["propertyId"]["stringValue"] | "";
+        cmd.property = propertyId[0] != '\0' ? String(propertyId) : ref.substring(0, slash);
+      }
+      cmd.controller = commandControllerKey(cmd.fields);
+      cmd.version = commandVersion(cmd.fields);
+      cmd.writes = commandFieldWrites(cmd.fields);
+      cmd.superseded = false;
+      cmd.journaled = STATE_STORE ? journaledStatus(ref.c_str()) : nullptr;
+
+      if (canary.inFlight() && cmd.id == canaryRef()) {
+        const char* sequence = cmd.fields["canarySeq"]["integerValue"] | "0";
+        canary.received(strtoul(sequence, nullptr, 10), millis());
+      }
+    }
 
-      pendingCount++;
-      digitalWrite(STATUS_LED_PIN, HIGH);
+    // Firestore bills a query that matches nothing as one read
+    usageMeter.addFirestoreOps(FIRESTORE_READ, documents > 0 ? documents : 1);
 
-      const char* docName = document["name"];
-      String fullPath = String(docName);
-      int lastSlash = fullPath.lastIndexOf('/');
-      String commandId = fullPath.substring(lastSlash + 1);
+    if (pendingCount == 0) {
+      pollSizer.polled(limit, documents, 0);
+      logLine(LOG_DEBUG, SITE_POLL, "No pending commands");
+      if (usageMeter.metered()) {
+        pollIntervalMs = min(pollIntervalMs * 2, (unsigned long)METERED_IDLE_POLL_MAX_MS);
+      }
+      return;
+    }
 
-      JsonObject fields = document["fields"];
-      executeCommand(commandId, fields);
+    pollIntervalMs = POLL_INTERVAL_MS;
+
+    // Drop anything a newer command has already overwritten, queue WLED
+    // commands, and write all resulting status changes in one commit
+    markSupersededCommands(pending, pendingCount);
+
+    StatusBatch batch;
+    batch.timestamp = isoTimestamp();
+
+    // Site mode: commands each property may queue this poll; the rest
+    // stay pending for the next one
+    int8_t admitted[SITE_MAX_PROPERTIES] = {0};
+
+    int bridgeCount = 0;
+    int deferred = 0;  // Left pending until the queues have room
+    for (int i = 0; i < pendingCount; i++) {
+      PendingCommand& cmd = pending[i];
+      if (cmd.journaled != nullptr) {
+        // Finished before a restart that lost its status write
+        logLine(LOG_INFO, SITE_POLL, "Already %s: %s", cmd.journaled, cmd.id.c_str());
+        addStatusWrite(batch, cmd.id.c_str(), cmd.journaled,
+                       strcmp(cmd.journaled, "failed") == 0 ? "Failed before a bridge restart"
+                                                            : nullptr);
+      } else if (cmd.superseded) {
+        logLine(LOG_INFO, SITE_POLL, "Superseded command: %s", cmd.id.c_str());
+        addStatusWrite(batch, cmd.id.c_str(), "superseded");
+      } else if (isBridgeCommand(cmd.fields["type"]["stringValue"] | "")) {
+        bridgeCount++;
+      } else if (!commandQueues.contains(cmd.id.c_str())) {
+        if (SITE_MODE) {
+          int property = siteProperties.track(cmd.property.c_str());
+          if (property < 0 || admitted[property] >= SITE_MAX_COMMANDS_PER_PROPERTY) {
+            hedgedIntake.forget(cmd.id.c_str());
+            deferred++;
+            continue;
+          }
+          admitted[property]++;
+        }
+        if (!enqueueCommand(cmd, batch)) deferred++;
+      }
+    }
 
+    commitStatusBatch(batch);
+    pollSizer.polled(limit, documents, deferred);
+
+    // Bridge commands do not touch a controller and run straight away
+    for (int i = 0; i < pendingCount && bridgeCount > 0; i++) {
+      PendingCommand& cmd = pending[i];
+      if (cmd.superseded || cmd.journaled != nullptr ||
+          !isBridgeCommand(cmd.fields["type"]["stringValue"] | "")) {
+        continue;
+      }
+
+      digitalWrite(STATUS_LED_PIN, HIGH);
+      executeBridgeCommand(cmd.id, cmd.fields);
       digitalWrite(STATUS_LED_PIN, LOW);
     }
 
-    if (pendingCount == 0) {
-      DEBUG_PRINTLN("No pending commands");
-    } else {
-      DEBUG_PRINTF("Processed %d command(s)\n", pendingCount);
-    }
+    CommandQueueStats stats = commandQueues.stats();
+    logLine(LOG_INFO, SITE_POLL, "Polled %d command(s); %d queued for %d controller(s)",
+            pendingCount, (int)stats.depth, (int)stats.controllers);
   } else {
-    DEBUG_PRINT("HTTP error: ");
-    DEBUG_PRINTLN(httpCode);
+    logLine(LOG_WARN, SITE_POLL, "HTTP error: %d", httpCode);
+    meterFirestore(url.length() + queryBody.length(), 0);
+
+    // Back off, and at least as long as Firestore asks (429/503)
+    pollBackoff.failed(millis());
+    long retryAfterSec = http.header("Retry-After").toInt();
+    if (retryAfterSec > 0) pollBackoff.retryAfter(millis(), retryAfterSec * 1000);
     http.end();
+
+    logLine(LOG_INFO, SITE_POLL, "Next poll in %lu ms",
+            (unsigned long)pollBackoff.msUntilDue(millis()));
   }
 }
 
@@ -263,69 +776,1048 @@ void pollCommands() {
 // Command Execution
 // ============================================================================
 
-void executeCommand(const String& commandId, JsonObject& fields) {
+// Commands the bridge handles itself instead of forwarding to WLED
+bool executeBridgeCommand(const String& commandId, JsonObject& fields) {
+  String commandType = fields["type"]["stringValue"] | "";
+  String controllerIp = fields["controllerIp"]["stringValue"] | "";
+
+  Serial.println();
+  logLine(LOG_INFO, SITE_BRIDGE, "Executing bridge command: %s (%s)", commandId.c_str(),
+          commandType.c_str());
+
+  if (commandType == "runDiagnostics") {
+    return runDiagnosticsCommand(commandId, fields, controllerIp);
+  }
+  if (commandType == "prewarm") {
+    return runPrewarmCommand(commandId, fields, controllerIp);
+  }
+  if (commandType == "otaUpdate") {
+    return runOtaCommand(commandId, fields);
+  }
+  if (commandType == "benchRuntime") {
+    return runBenchmarkCommand(commandId, fields);
+  }
+  if (commandType == "benchKernels") {
+    return runKernelBenchCommand(commandId, fields);
+  }
+  if (commandType.startsWith("file")) {
+    return runFileCommand(commandId, commandType, fields, controllerIp);
+  }
+  if (commandType == "syncZones") {
+    return runZoneSyncCommand(commandId, fields);
+  }
+  if (commandType == "zoneState") {
+    return runZoneStateCommand(commandId, fields);
+  }
+  if (commandType.startsWith("realtime")) {
+    return runRealtimeCommand(commandId, commandType, fields);
+  }
+  if (commandType == "shipLogs") {
+    return runShipLogsCommand(commandId, fields);
+  }
+
+  updateCommandStatus(commandId, "failed", "Unknown bridge command");
+  return false;
+}
+
+bool executeCommand(const QueuedCommand& cmd) {
   Serial.println();
-  Serial.print("Executing command: ");
-  Serial.println(commandId);
+  logLine(LOG_INFO, SITE_EXECUTE, "Executing command: %s (%s) on %s", cmd.id, cmd.type,
+          cmd.controllerIp);
+
+  reportCommandStatus(cmd, "executing");
+
+  // Build the WLED endpoint and method
+  String endpoint = "/json/state";
+  String method = "POST";
+
+  if (strcmp(cmd.type, "getState") == 0) {
+    method = "GET";
+  } else if (strcmp(cmd.type, "getInfo") == 0) {
+    endpoint = "/json/info";
+    method = "GET";
+  }
 
-  // Extract command fields from Firestore format
-  String commandType = "";
-  String controllerIp = "";
+  logLine(LOG_DEBUG, SITE_EXECUTE, "  -> %s http://%s%s", method.c_str(), cmd.controllerIp,
+          endpoint.c_str());
 
-  if (fields["type"]["stringValue"]) {
-    commandType = fields["type"]["stringValue"].as<String>();
+  uint32_t started = millis();
+  String response = makeWledRequest(cmd.controllerIp, method, endpoint, cmd.body);
+
+  if (response.startsWith("ERROR:")) {
+    logLine(LOG_ERROR, SITE_EXECUTE, "%s %s on %s: %s", cmd.type, cmd.id, cmd.controllerIp,
+            response.c_str());
+    reportCommandStatus(cmd, "failed", response.c_str());
+    return false;
   }
 
-  if (fields["controllerIp"]["stringValue"]) {
-    controllerIp = fields["controllerIp"]["stringValue"].as<String>();
+  logLine(LOG_INFO, SITE_EXECUTE, "  SUCCESS (%lu ms)", (unsigned long)(millis() - started));
+  reportCommandStatus(cmd, "completed");
+  return true;
+}
+
+// ============================================================================
+// Command Queues
+// ============================================================================
+
+void onQueuedCommandReplaced(const QueuedCommand& replaced, void* context) {
+  logLine(LOG_INFO, SITE_QUEUE, "Replaced queued command: %s", replaced.id);
+  addQueuedStatus(*(StatusBatch*)context, replaced, "superseded");
+  siteProperties.queuedChanged(replaced.property, -1);
+}
+
+// A queued command's status; a zone part's counts towards its zone command
+void addQueuedStatus(StatusBatch& batch, const QueuedCommand& cmd, const char* status) {
+  if (cmd.zone >= 0) {
+    settleZonePart(cmd.zone, status, nullptr);
+    return;
   }
+  addStatusWrite(batch, cmd.id, status);
+}
 
-  Serial.print("  Type: ");
-  Serial.println(commandType);
-  Serial.print("  Controller IP: ");
-  Serial.println(controllerIp);
+// False if the command stays pending because its queue is full
+bool enqueueCommand(PendingCommand& cmd, StatusBatch& batch) {
+  QueuedCommand& queued = incomingCommand;
+  memset(&queued, 0, sizeof(queued));
 
+  String controllerIp = cmd.fields["controllerIp"]["stringValue"] | "";
   if (controllerIp.isEmpty()) {
-    Serial.println("  ERROR: No controller IP specified");
-    updateCommandStatus(commandId, "failed", "No controller IP specified");
+    updateCommandStatus(cmd.id, "failed", "No controller IP specified");
+    return true;
+  }
+
+  strlcpy(queued.id, cmd.id.c_str(), sizeof(queued.id));
+  strlcpy(queued.controller, cmd.controller.c_str(), sizeof(queued.controller));
+  strlcpy(queued.controllerIp, controllerIp.c_str(), sizeof(queued.controllerIp));
+  strlcpy(queued.type, cmd.fields["type"]["stringValue"] | "", sizeof(queued.type));
+  queued.property = SITE_MODE ? siteProperties.find(cmd.property.c_str()) : -1;
+  queued.version = cmd.version;
+  queued.writes = cmd.writes;
+  queued.zone = -1;
+  rememberControllerKey(queued.controllerIp, queued.controller);
+
+  bool isRead = strcmp(queued.type, "getState") == 0 || strcmp(queued.type, "getInfo") == 0;
+  queued.overwritable = !isRead && strcmp(queued.type, "applyConfig") != 0;
+
+  if (!isRead) {
+    String body = convertFirestorePayloadToJson(cmd.fields);
+
+    // An arrival command may name the scene preloaded by a pre-warm hint
+    const char* sceneId = cmd.fields["sceneId"]["stringValue"] | "";
+    if (body == "{}" && sceneId[0] != '\0' && prewarmSceneId == sceneId &&
+        !prewarmSceneBody.isEmpty()) {
+      Serial.println("  Using preloaded scene");
+      body = prewarmSceneBody;
+      JsonDocument sceneDoc;
+      queued.writes = deserializeJson(sceneDoc, body)
+                          ? fieldWritesOpaque()
+                          : fieldWritesForState(sceneDoc.as<JsonObjectConst>());
+    }
+
+    if (body.length() >= sizeof(queued.body)) {
+      updateCommandStatus(cmd.id, "failed",
+                          "Payload too large (max " + String(COMMAND_BODY_MAX_LEN - 1) + " bytes)");
+      return true;
+    }
+    strlcpy(queued.body, body.c_str(), sizeof(queued.body));
+  }
+
+  return queueCommand(queued, batch);
+}
+
+// Pushes onto the controller's queue. False if the queue is full.
+bool queueCommand(QueuedCommand& queued, StatusBatch& batch) {
+  switch (commandQueues.push(queued, onQueuedCommandReplaced, &batch)) {
+    case QUEUE_ADDED:
+    case QUEUE_REPLACED:
+      addQueuedStatus(batch, queued, "queued");
+      siteProperties.queuedChanged(queued.property, 1);
+      break;
+    case QUEUE_COVERED:
+      Serial.print("Superseded command: ");
+      Serial.println(queued.id);
+      addQueuedStatus(batch, queued, "superseded");
+      break;
+    case QUEUE_FULL:
+      // Stays pending in Firestore; a later poll picks it up
+      DEBUG_PRINT("Queue full, deferring command: ");
+      DEBUG_PRINTLN(queued.id);
+      hedgedIntake.forget(queued.id);
+      return false;
+  }
+  return true;
+}
+
+// Site mode: the controller whose head command belongs to the property
+// served longest ago. Otherwise plain round robin over controllers.
+bool popFairCommand(QueuedCommand& out) {
+  if (!SITE_MODE) return commandQueues.popNext(out);
+
+  int best = -1;
+  uint32_t bestServed = 0;
+  for (size_t i = 0; i < commandQueues.slotCount(); i++) {
+    const QueuedCommand* head = commandQueues.peekSlot(i);
+    if (head == nullptr) continue;
+    uint32_t served = siteProperties.lastServed(head->property);
+    if (best < 0 || served < bestServed) {
+      best = i;
+      bestServed = served;
+    }
+  }
+  if (best < 0 || !commandQueues.popSlot(best, out)) return false;
+
+  siteProperties.markServed(out.property);
+  siteProperties.queuedChanged(out.property, -1);
+  return true;
+}
+
+void dispatchQueuedCommand() {
+  if (!popFairCommand(dispatchedCommand)) return;
+  QueuedCommand& cmd = dispatchedCommand;
+
+  // A command applied since this one was queued may have overwritten it
+  if (appliedVersions.isSuperseded(cmd.controller, cmd.writes, cmd.version)) {
+    logLine(LOG_INFO, SITE_QUEUE, "Superseded command: %s", cmd.id);
+    reportCommandStatus(cmd, "superseded");
+    return;
+  }
+
+  digitalWrite(STATUS_LED_PIN, HIGH);
+  uint32_t started = micros();
+  lastControllerIp = cmd.controllerIp;
+  healthSeries.controller(cmd.controllerIp, true);
+
+  // State writes join the controller's desired state and count as applied
+  // once it converges (finishReconciledCommands); the rest go as they are
+  bool reconciling = RECONCILE_STATE && cmd.overwritable && reconcileQueuedCommand(cmd);
+  if (!reconciling && executeCommand(cmd)) {
+    appliedVersions.recordApplied(cmd.controller, cmd.writes, cmd.version);
+  }
+
+  uint32_t elapsed = micros() - started;
+  dispatchStats.commands++;
+  dispatchStats.busyMicros += elapsed;
+  if (elapsed > dispatchStats.maxMicros) dispatchStats.maxMicros = elapsed;
+  pollSizer.executed(elapsed);
+
+  digitalWrite(STATUS_LED_PIN, LOW);
+}
+
+// Site mode holds final statuses for a per-property commit and skips the
+// intermediate "executing" write; otherwise each status is written now.
+void reportCommandStatus(const QueuedCommand& cmd, const char* status, const char* error) {
+  if (cmd.zone >= 0) {
+    settleZonePart(cmd.zone, status, error);
+    return;
+  }
+  reportCommandStatus(cmd.id, cmd.property, status, error);
+}
+
+void reportCommandStatus(const char* id, int8_t property, const char* status,
+                         const char* error) {
+  bool done = strcmp(status, "completed") == 0 || strcmp(status, "failed") == 0 ||
+              strcmp(status, "superseded") == 0;
+  if (done && canary.inFlight() && canaryRef() == id) {
+    canary.finished(canary.sequence(), strcmp(status, "completed") == 0, millis());
+  }
+
+  if (SITE_MODE && property >= 0) {
+    if (strcmp(status, "executing") == 0) return;
+    if (siteProperties.addStatus(property, id, status, error, millis())) return;
+  }
+  updateCommandStatus(id, status, error);
+}
+
+// ============================================================================
+// State Reconciliation
+// ============================================================================
+
+// Hands a state write to the reconciler. False if it cannot take it (no
+// slot, or a body that does not fit the desired state); the caller then
+// sends it to WLED directly.
+bool reconcileQueuedCommand(const QueuedCommand& cmd) {
+  ReconcileWaiter* waiter = nullptr;
+  for (ReconcileWaiter& candidate : reconcileWaiters) {
+    if (candidate.id[0] == '\0') waiter = &candidate;
+  }
+  int controller = reconciler.controller(cmd.controllerIp, true);
+  JsonDocument body;
+  if (waiter == nullptr || controller < 0 || deserializeJson(body, cmd.body) ||
+      !body.is<JsonObject>() ||
+      !reconcileCommand(reconciler, controller, body.as<JsonObjectConst>(), millis())) {
+    return false;
+  }
+
+  strlcpy(waiter->id, cmd.id, sizeof(waiter->id));
+  waiter->property = cmd.property;
+  waiter->controller = controller;
+  waiter->since = millis();
+  strlcpy(waiter->controllerKey, cmd.controller, sizeof(waiter->controllerKey));
+  waiter->version = cmd.version;
+  waiter->writes = cmd.writes;
+  waiter->zone = cmd.zone;
+  reportCommandStatus(cmd, "executing");
+  return true;
+}
+
+// Makes the one WLED request the reconciler wants next, if any
+void stepReconciler() {
+  int controller;
+  ReconcileAction action = reconciler.next(millis(), controller);
+  if (action == RECONCILE_NONE) return;
+
+  String response;
+  if (action == RECONCILE_APPLY) {
+    JsonDocument body;
+    reconcileRequestBody(reconciler, controller, body);
+    String json;
+    serializeJson(body, json);
+    response = makeWledRequest(reconciler.ip(controller), "POST", "/json/state", json);
+  } else {
+    response = makeWledRequest(reconciler.ip(controller), "GET", "/json/si", "");
+  }
+
+  bool ok = !response.startsWith("ERROR:");
+  if (!ok) {
+    Serial.print("Reconcile ");
+    Serial.print(reconciler.ip(controller));
+    Serial.print(": ");
+    Serial.println(response);
+  }
+  reconcileResponse(reconciler, controller, action, ok, response.c_str(), millis());
+}
+
+// Completes waiting commands whose controller has converged (WLED took the
+// apply), and fails those that waited too long
+void finishReconciledCommands() {
+  for (ReconcileWaiter& waiter : reconcileWaiters) {
+    if (waiter.id[0] == '\0') continue;
+    const char* status;
+    const char* error = "";
+    if (reconciler.converged(waiter.controller)) {
+      appliedVersions.recordApplied(waiter.controllerKey, waiter.writes, waiter.version);
+      status = "completed";
+    } else if (millis() - waiter.since >= RECONCILE_COMMAND_TIMEOUT_MS) {
+      status = "failed";
+      error = "Controller unreachable (the bridge keeps retrying)";
+    } else {
+      continue;
+    }
+    if (waiter.zone >= 0) {
+      settleZonePart(waiter.zone, status, error);
+    } else {
+      reportCommandStatus(waiter.id, waiter.property, status, error);
+    }
+    waiter.id[0] = '\0';
+  }
+}
+
+// Writes each property's finished statuses with one commit, once the
+// property has nothing left queued or its oldest status has waited long
+// enough
+void flushSiteStatuses() {
+  int count;
+  while ((count = siteProperties.takeDue(millis(), dueStatuses, SITE_STATUS_BATCH_MAX)) > 0) {
+    StatusBatch batch;
+    batch.timestamp = isoTimestamp();
+
+    for (int i = 0; i < count; i++) {
+      addStatusWrite(batch, dueStatuses[i].ref, dueStatuses[i].status, dueStatuses[i].error);
+    }
+    commitStatusBatch(batch);
+  }
+}
+
+// ============================================================================
+// Command Versioning
+// ============================================================================
+
+// Firestore's REST API encodes int64 values as strings
+uint64_t commandVersion(JsonObject& fields) {
+  const char* version = fields["version"]["integerValue"];
+  if (version == nullptr) return 0;
+  return strtoull(version, nullptr, 10);
+}
+
+String commandControllerKey(JsonObject& fields) {
+  const char* controllerId = fields["controllerId"]["stringValue"] | "";
+  if (controllerId[0] != '\0') return String(controllerId);
+  return fields["controllerIp"]["stringValue"] | "";
+}
+
+FieldWrites commandFieldWrites(JsonObject& fields) {
+  const char* type = fields["type"]["stringValue"] | "";
+  bool isRead = strcmp(type, "getState") == 0 || strcmp(type, "getInfo") == 0;
+  if (isRead || isBridgeCommand(type) || strcmp(type, "applyConfig") == 0) {
+    return fieldWritesOpaque();
+  }
+
+  // The same body executeCommand() sends
+  JsonDocument body;
+  if (deserializeJson(body, convertFirestorePayloadToJson(fields))) return fieldWritesOpaque();
+  return fieldWritesForState(body.as<JsonObjectConst>());
+}
+
+// Only commands already applied can supersede: two commands in one batch
+// both queue, and the queue coalesces them (command_queue.h).
+void markSupersededCommands(PendingCommand* commands, int count) {
+  // Apply in version order; unversioned commands keep their query order
+  for (int i = 1; i < count; i++) {
+    for (int j = i; j > 0 && commands[j - 1].version > commands[j].version; j--) {
+      PendingCommand tmp = commands[j];
+      commands[j] = commands[j - 1];
+      commands[j - 1] = tmp;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    PendingCommand& cmd = commands[i];
+    cmd.superseded = appliedVersions.isSuperseded(cmd.controller.c_str(), cmd.writes, cmd.version);
+  }
+}
+
+void addStatusWrite(StatusBatch& batch, const char* commandRef, const char* status,
+                    const char* error) {
+  if (batch.pipelined) {
+    updateCommandStatus(commandRef, status, error != nullptr ? error : "");
     return;
   }
+  settleHedged(commandRef, status, error);
+  if (STATE_STORE) journalCommand(commandRef, status);
+
+  if (batch.count == POLL_BATCH_MAX) commitStatusBatch(batch);
+  StatusBatchWrite& write = statusBatchWrites[batch.count++];
+  strlcpy(write.ref, commandRef, sizeof(write.ref));
+  strlcpy(write.status, status, sizeof(write.status));
+  strlcpy(write.error, error != nullptr ? error : "", sizeof(write.error));
+}
 
+// Writes every status change in the batch with one Firestore commit,
+// streamed like a single status write
+void commitStatusBatch(StatusBatch& batch) {
+  if (batch.count == 0) return;
+
+  // A commit must land after the statuses submitted before it, like an
+  // inline write
+  if (statusPipeline.running()) statusPipeline.drain(STATUS_PIPELINE_DRAIN_MS);
+
+  static StatusCommitWrite writes[POLL_BATCH_MAX];
+  for (int i = 0; i < batch.count; i++) {
+    writes[i].ref = statusBatchWrites[i].ref;
+    writes[i].status = statusBatchWrites[i].status;
+    writes[i].error = statusBatchWrites[i].error;
+  }
+
+  StatusWriteStats before = statusWriter.stats();
+  int httpCode = statusWriter.commit(writes, batch.count, batch.timestamp.c_str());
+  const StatusWriteStats& after = statusWriter.stats();
+  usageMeter.addBytes(USAGE_FIRESTORE, after.bytesOut - before.bytesOut,
+                      after.bytesIn - before.bytesIn);
+
+  if (httpCode == 200) {
+    usageMeter.addFirestoreOps(FIRESTORE_WRITE, batch.count);
+  } else {
+    DEBUG_PRINT("Status commit failed: ");
+    DEBUG_PRINTLN(httpCode);
+  }
+  batch.count = 0;
+}
+
+// ============================================================================
+// Bridge Commands
+// ============================================================================
+
+bool isBridgeCommand(const char* type) {
+  return strcmp(type, "runDiagnostics") == 0 || strcmp(type, "prewarm") == 0 ||
+         strcmp(type, "otaUpdate") == 0 || strcmp(type, "benchRuntime") == 0 ||
+         strcmp(type, "benchKernels") == 0 || strcmp(type, "shipLogs") == 0 ||
+         strcmp(type, "fileFetch") == 0 || strcmp(type, "fileAbort") == 0 ||
+         strcmp(type, "syncZones") == 0 || strcmp(type, "zoneState") == 0 ||
+         strcmp(type, "realtimeStart") == 0 || strcmp(type, "realtimeStop") == 0;
+}
+
+// Installer network check. Payload: {"controllers": ["192.168.1.50", ...]};
+// without it only the command's controllerIp is tested.
+bool runDiagnosticsCommand(const String& commandId, JsonObject& fields,
+                           const String& controllerIp) {
   updateCommandStatus(commandId, "executing");
 
-  // Build the WLED endpoint and method
-  String endpoint;
-  String method;
-  String body = "";
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
 
-  if (commandType == "getState") {
-    endpoint = "/json/state";
-    method = "GET";
-  } else if (commandType == "getInfo") {
-    endpoint = "/json/info";
-    method = "GET";
+  String controllers[DIAG_MAX_CONTROLLERS];
+  int controllerCount = 0;
+  for (JsonVariant ip : payload["controllers"].as<JsonArray>()) {
+    if (controllerCount >= DIAG_MAX_CONTROLLERS) break;
+    controllers[controllerCount++] = ip.as<String>();
+  }
+  if (controllerCount == 0 && !controllerIp.isEmpty()) {
+    controllers[controllerCount++] = controllerIp;
+  }
+
+  JsonDocument report;
+  bool pass = runNetworkDiagnostics(controllers, controllerCount, report);
+
+  String result;
+  serializeJson(report, result);
+  Serial.println(result);
+
+  // The check ran either way; pass/fail is in the report
+  updateCommandStatus(commandId, "completed", pass ? "" : "Diagnostics failed", result);
+  return true;
+}
+
+// Arrival pre-warm hint, sent when the app predicts the customer is about to
+// arrive. Payload: {"sceneId": "...", "scene": {...}, "controllers": [...],
+// "windowMs": 300000}. The bridge polls fast for the window (overriding any
+// idle backoff) so the arrival command is picked up within
+// PREWARM_POLL_INTERVAL_MS; each poll is still its own HTTPS request. It
+// warms the controllers (warmControllers) and keeps the scene so the
+// arrival command can refer to it by sceneId.
+bool runPrewarmCommand(const String& commandId, JsonObject& fields,
+                       const String& controllerIp) {
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+
+  unsigned long windowMs = payload["windowMs"] | (unsigned long)PREWARM_WINDOW_MS;
+  if (windowMs > PREWARM_MAX_WINDOW_MS) windowMs = PREWARM_MAX_WINDOW_MS;
+  prewarmUntil = millis() + windowMs;
+
+  prewarmSceneId = payload["sceneId"] | "";
+  prewarmSceneBody = "";
+  if (payload["scene"].is<JsonObject>()) {
+    serializeJson(payload["scene"], prewarmSceneBody);
+  }
+  // Checked now rather than failing the arrival command
+  if (prewarmSceneBody.length() >= COMMAND_BODY_MAX_LEN) prewarmSceneBody = "";
+
+  Serial.print("  Pre-warming for ");
+  Serial.print(windowMs / 1000);
+  Serial.println(" s");
+
+  int targets = 0;
+  int warmed = warmControllers(payload["controllers"].as<JsonArray>(), controllerIp, targets);
+
+  String result = "{\"warmed\":" + String(warmed) + ",\"controllers\":" + String(targets) +
+                  ",\"scene\":" + String(prewarmSceneBody.isEmpty() ? "false" : "true") +
+                  ",\"windowMs\":" + String(windowMs) + "}";
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
+
+// With RECONCILE_STATE, hands each controller to the reconciler and asks
+// for an audit: over the next loops it reads the controller's state and
+// keeps it, so the arrival command's state write goes out at once (no
+// first-contact audit) and carries only what differs. Otherwise fetches
+// /json/state from every controller at once, as coroutines on this task's
+// stack; that only checks each one answers, the body is not kept. Returns
+// how many were taken on or answered; `targets` is how many were tried.
+int warmControllers(JsonArray controllers, const String& fallbackIp, int& targets) {
+  static CoopHttpGet probes[COMMAND_QUEUE_CONTROLLERS];
+  CoopScheduler scheduler;
+  int warmed = 0;
+  int count = 0;
+  targets = 0;
+
+  auto runBatch = [&]() {
+    scheduler.runAll(WLED_HTTP_TIMEOUT_MS + 1000);
+    for (int i = 0; i < count; i++) {
+      usageMeter.addBytes(USAGE_WLED, probes[i].bytesOut(), probes[i].bytesIn());
+      if (probes[i].status() == 200) warmed++;
+    }
+    count = 0;
+  };
+  auto add = [&](const char* ip) {
+    if (RECONCILE_STATE) {
+      targets++;
+      int controller = reconciler.controller(ip, true);
+      if (controller < 0) return;
+      reconciler.auditSoon(controller, millis());
+      warmed++;
+      return;
+    }
+    probes[count].begin(ip, "/json/state", WLED_HTTP_TIMEOUT_MS);
+    scheduler.spawn(probes[count]);
+    targets++;
+    if (++count == COMMAND_QUEUE_CONTROLLERS) runBatch();
+  };
+
+  if (controllers.size() > 0) {
+    for (JsonVariant ip : controllers) add(ip | "");
+  } else if (!fallbackIp.isEmpty()) {
+    add(fallbackIp.c_str());
+  }
+  if (count > 0) runBatch();
+  return warmed;
+}
+
+// Coroutine runtime benchmark. Payload (all optional): {"operations": 16,
+// "taskStack": 4096, "rounds": 10000}. Reports heap per concurrent
+// operation and switch cost, as coroutines and as FreeRTOS tasks.
+bool runBenchmarkCommand(const String& commandId, JsonObject& fields) {
+  updateCommandStatus(commandId, "executing");
+
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+  uint16_t operations = payload["operations"] | 16;
+  uint32_t taskStack = payload["taskStack"] | 4096;
+  uint32_t rounds = payload["rounds"] | 10000;
+
+  CoopBenchResult bench = runCoopBenchmark(operations, taskStack, rounds);
+
+  JsonDocument report;
+  report["operations"] = bench.operations;
+  report["coroutineBytes"] = bench.coroutineBytes;
+  report["coroutineSwitchNs"] = bench.coroutineSwitchNs;
+  report["tasks"] = bench.tasks;
+  report["taskStack"] = bench.taskStack;
+  report["taskBytes"] = bench.taskBytes;
+  report["taskSwitchNs"] = bench.taskSwitchNs;
+  String result;
+  serializeJson(report, result);
+
+  Serial.print("  Runtime benchmark: ");
+  Serial.println(result);
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
+
+// Zone map from the app (format in zone_map.h). Kept on flash, so zone
+// commands work after a restart without another sync.
+bool runZoneSyncCommand(const String& commandId, JsonObject& fields) {
+  String json = convertFirestorePayloadToJson(fields);
+  String error;
+  if (!zoneMap.load(json.c_str(), error)) {
+    updateCommandStatus(commandId, "failed", error);
+    return false;
+  }
+
+  File file = LittleFS.open(ZONE_MAP_FILE, "w");
+  if (file) {
+    file.print(json);
+    file.close();
   } else {
-    endpoint = "/json/state";
-    method = "POST";
-    body = convertFirestorePayloadToJson(fields);
+    Serial.println("  Could not save zone map");
   }
 
-  Serial.print("  -> ");
-  Serial.print(method);
-  Serial.print(" http://");
-  Serial.print(controllerIp);
-  Serial.println(endpoint);
+  Serial.print("  Zone map version ");
+  Serial.print(zoneMap.version());
+  Serial.print(", zones: ");
+  Serial.println(zoneMap.zoneCount());
 
-  String response = makeWledRequest(controllerIp, method, endpoint, body);
+  String result = "{\"version\":" + String(zoneMap.version()) +
+                  ",\"zones\":" + String(zoneMap.zoneCount()) + "}";
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
 
-  if (response.startsWith("ERROR:")) {
-    Serial.print("  ERROR: ");
-    Serial.println(response);
-    updateCommandStatus(commandId, "failed", response);
+void loadZoneMap() {
+  File file = LittleFS.open(ZONE_MAP_FILE, "r");
+  if (!file) return;
+  String json = file.readString();
+  file.close();
+
+  String error;
+  if (!zoneMap.load(json.c_str(), error)) {
+    Serial.print("Saved zone map ignored: ");
+    Serial.println(error);
+  }
+}
+
+// State for a zone. Payload: {"zoneId", "zoneMapVersion", "state": {...}}.
+// Fails with "Zone map out of date" when the app's map is newer than the
+// bridge's, so the app can sync and resend. Each controller in the zone
+// gets one part: a state write with the zone command's version, queued and
+// reconciled like any other. The command settles with its last part; the
+// result counts the parts that failed or were superseded. Left pending if
+// a controller's queue has no room.
+bool runZoneStateCommand(const String& commandId, JsonObject& fields) {
+  for (const ZoneCommand& zone : zoneCommands) {
+    if (strcmp(zone.id, commandId.c_str()) == 0) return true;  // Already queued
+  }
+
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+  const char* zoneId = payload["zoneId"] | "";
+
+  if ((payload["zoneMapVersion"] | 0UL) != zoneMap.version()) {
+    updateCommandStatus(commandId, "failed", "Zone map out of date");
+    return false;
+  }
+  int count;
+  const ZoneTarget* targets = zoneMap.targets(zoneId, count);
+  if (targets == nullptr || count == 0) {
+    updateCommandStatus(commandId, "failed", "Unknown zone");
+    return false;
+  }
+
+  int8_t slot = -1;
+  for (int i = 0; i < ZONE_COMMANDS_MAX; i++) {
+    if (zoneCommands[i].id[0] == '\0') slot = i;
+  }
+  for (int i = 0; i < count && slot >= 0; i++) {
+    if (commandQueues.room(controllerKeyForIp(targets[i].ip)) == 0) slot = -1;
+  }
+  if (slot < 0) {
+    logLine(LOG_INFO, SITE_QUEUE, "No room, deferring zone command: %s", commandId.c_str());
+    hedgedIntake.forget(commandId.c_str());
+    return false;
+  }
+
+  // Every part is checked before any is queued
+  JsonObjectConst state = payload["state"];
+  String bodies[ZONE_MAX_CONTROLLERS];
+  for (int i = 0; i < count; i++) {
+    ZoneMap::buildRequest(state, targets[i], bodies[i]);
+    if (bodies[i].length() >= COMMAND_BODY_MAX_LEN) {
+      updateCommandStatus(commandId, "failed",
+                          "Payload too large (max " + String(COMMAND_BODY_MAX_LEN - 1) + " bytes)");
+      return false;
+    }
+  }
+
+  ZoneCommand& zone = zoneCommands[slot];
+  memset(&zone, 0, sizeof(zone));
+  strlcpy(zone.id, commandId.c_str(), sizeof(zone.id));
+  zone.parts = zone.waiting = count;
+  updateCommandStatus(commandId, "queued");
+
+  StatusBatch batch;
+  batch.pipelined = true;
+  uint64_t version = commandVersion(fields);
+  for (int i = 0; i < count; i++) {
+    QueuedCommand& part = incomingCommand;
+    memset(&part, 0, sizeof(part));
+    strlcpy(part.id, commandId.c_str(), sizeof(part.id));
+    strlcpy(part.controller, controllerKeyForIp(targets[i].ip), sizeof(part.controller));
+    strlcpy(part.controllerIp, targets[i].ip, sizeof(part.controllerIp));
+    strlcpy(part.type, "setState", sizeof(part.type));
+    part.property = -1;
+    part.version = version;
+    part.overwritable = true;
+    part.zone = slot;
+    strlcpy(part.body, bodies[i].c_str(), sizeof(part.body));
+
+    JsonDocument body;
+    part.writes = deserializeJson(body, part.body) ? fieldWritesOpaque()
+                                                   : fieldWritesForState(body.as<JsonObjectConst>());
+    if (!queueCommand(part, batch)) {
+      settleZonePart(slot, "failed", (String(targets[i].ip) + " queue full").c_str());
+    }
+  }
+  return true;
+}
+
+// One part of a zone command reached `status`. Only final statuses count;
+// the last one writes the zone command's: failed if any part failed,
+// superseded if all were, completed otherwise.
+void settleZonePart(int8_t zoneSlot, const char* status, const char* error) {
+  bool failed = strcmp(status, "failed") == 0;
+  bool superseded = strcmp(status, "superseded") == 0;
+  if (!failed && !superseded && strcmp(status, "completed") != 0) return;
+
+  ZoneCommand& zone = zoneCommands[zoneSlot];
+  if (zone.id[0] == '\0' || zone.waiting == 0) return;
+  if (failed && zone.failed++ == 0) {
+    strlcpy(zone.error, error != nullptr ? error : "", sizeof(zone.error));
+  }
+  if (superseded) zone.superseded++;
+  if (--zone.waiting > 0) return;
+
+  String result = "{\"controllers\":" + String(zone.parts) + ",\"failed\":" +
+                  String(zone.failed) + ",\"superseded\":" + String(zone.superseded) + "}";
+  const char* outcome = zone.failed > 0                   ? "failed"
+                        : zone.superseded == zone.parts ? "superseded"
+                                                        : "completed";
+  logLine(LOG_INFO, SITE_QUEUE, "Zone command %s: %s", outcome, zone.id);
+  updateCommandStatus(zone.id, outcome, zone.failed > 0 ? zone.error : "", result);
+  zone.id[0] = '\0';
+}
+
+void rememberControllerKey(const char* ip, const char* key) {
+  static uint8_t next = 0;
+  if (ip[0] == '\0' || key[0] == '\0') return;
+
+  ControllerAlias* alias = nullptr;
+  for (ControllerAlias& candidate : controllerAliases) {
+    if (strcmp(candidate.ip, ip) == 0) alias = &candidate;
+  }
+  for (ControllerAlias& candidate : controllerAliases) {
+    if (alias == nullptr && candidate.ip[0] == '\0') alias = &candidate;
+  }
+  if (alias == nullptr) {
+    alias = &controllerAliases[next];
+    next = (next + 1) % COMMAND_QUEUE_CONTROLLERS;
+  }
+  strlcpy(alias->ip, ip, sizeof(alias->ip));
+  strlcpy(alias->key, key, sizeof(alias->key));
+}
+
+// The IP itself for a controller no command has named yet, as
+// commandControllerKey() does for producers without controllerId
+const char* controllerKeyForIp(const char* ip) {
+  for (const ControllerAlias& alias : controllerAliases) {
+    if (strcmp(alias.ip, ip) == 0) return alias.key;
+  }
+  return ip;
+}
+
+// realtimeStart (payload in realtime_output.cpp) and realtimeStop. Both
+// complete with the stream's stats; a start's are from the stream it
+// replaced, if any.
+bool runRealtimeCommand(const String& commandId, const String& type, JsonObject& fields) {
+  JsonDocument report;
+  realtimeOutput.report(report.to<JsonObject>());
+
+  if (type == "realtimeStart") {
+    JsonDocument payload;
+    deserializeJson(payload, convertFirestorePayloadToJson(fields));
+    String error;
+    if (!realtimeOutput.start(payload.as<JsonObjectConst>(), error)) {
+      updateCommandStatus(commandId, "failed", error);
+      return false;
+    }
+  } else if (type == "realtimeStop") {
+    realtimeOutput.stop();
+    realtimeOutput.report(report.to<JsonObject>());
+  } else {
+    updateCommandStatus(commandId, "failed", "Unknown bridge command");
+    return false;
+  }
+
+  String result;
+  serializeJson(report, result);
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
+
+// Times the bridge's own kernels (see kernel_bench.h). Payload, all
+// optional: {"iterations": 200, "wledIp": "..."}; the WLED round trip
+// defaults to the command's controller.
+bool runKernelBenchCommand(const String& commandId, JsonObject& fields) {
+  updateCommandStatus(commandId, "executing");
+
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+  String wledIp = payload["wledIp"] | (fields["controllerIp"]["stringValue"] | "");
+
+  String result = kernelBenchReport(payload["iterations"] | 200, wledIp.c_str());
+  Serial.print("  Kernel benchmark: ");
+  Serial.println(result);
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
+
+String kernelBenchReport(uint32_t iterations, const char* wledIp) {
+  KernelBenchConfig config = {};
+  config.iterations = iterations;
+  config.tlsHost = "firestore.googleapis.com";
+  config.tlsPort = 443;
+  config.wledIp = wledIp;
+  config.networkTries = 5;
+
+  JsonDocument report;
+  runKernelBench(config, report.to<JsonObject>());
+  String json;
+  serializeJson(report, json);
+  return json;
+}
+
+// Serial console: "bench [iterations] [wledIp]" prints the kernel report
+void checkSerialCommand() {
+  if (!Serial.available()) return;
+  String line = Serial.readStringUntil('\n');
+  line.trim();
+  if (!line.startsWith("bench")) return;
+
+  char wledIp[16] = "";
+  unsigned long iterations = 200;
+  sscanf(line.c_str(), "bench %lu %15s", &iterations, wledIp);
+  Serial.println(kernelBenchReport(iterations, wledIp));
+}
+
+// Firmware update from a signed delta against the running image. Payload:
+// {"url": "https://.../bridge-1.3-from-1.2.ldlt"}. The result records the
+// transfer size and time; on success the bridge restarts into the new image.
+bool runOtaCommand(const String& commandId, JsonObject& fields) {
+  updateCommandStatus(commandId, "executing");
+
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+  String url = payload["url"] | "";
+  if (url.isEmpty()) {
+    updateCommandStatus(commandId, "failed", "No update URL specified");
+    return false;
+  }
+
+  Serial.print("  Delta OTA from ");
+  Serial.println(url);
+
+  static const uint8_t signingKey[32] = OTA_SIGNING_KEY;
+  DeltaOtaResult ota = runDeltaOta(url, signingKey);
+  // Counted with the rest of the cloud traffic
+  usageMeter.addBytes(USAGE_FIRESTORE, 0, ota.bytesDownloaded);
+
+  String result = "{\"downloaded\":" + String(ota.bytesDownloaded) +
+                  ",\"written\":" + String(ota.bytesWritten) +
+                  ",\"elapsedMs\":" + String(ota.elapsedMs) + "}";
+  Serial.println(result);
+
+  if (!ota.ok) {
+    Serial.print("  OTA failed: ");
+    Serial.println(ota.error);
+    updateCommandStatus(commandId, "failed", ota.error, result);
+    return false;
+  }
+
+  // Mark the command done before restarting so it is not run again
+  updateCommandStatus(commandId, "completed", "", result);
+  if (STATE_STORE) stateStore.sync(millis());
+  Serial.println("  Restarting into new firmware...");
+  delay(500);
+  ESP.restart();
+  return true;
+}
+
+// File transfer to WLED /edit. The app leaves the file in Cloud Storage
+// and one command names it; the bridge downloads it in Range requests
+// (stepFileFetch), so no file bytes pass through command documents:
+//   fileFetch {"transferId", "url": "https://...", "path": "/ledmap.json",
+//              "size", "sha256", "controllerIp"?}
+//   fileAbort {"transferId"}
+// A fetch stays "executing" while it downloads and completes once the hash
+// checks and WLED takes the upload. A new fetch with the same transferId
+// (the app's retry, also after a bridge restart) keeps the chunks already
+// downloaded.
+bool runFileCommand(const String& commandId, const String& type, JsonObject& fields,
+                    const String& controllerIp) {
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+  const char* transferId = payload["transferId"] | "";
+
+  // One transfer at a time: any file command ends the running download
+  if (fileFetch.active) finishFileFetch(false, "Replaced by a newer file command");
+
+  String error;
+  bool ok = false;
+  if (type == "fileFetch") {
+    String url = payload["url"] | "";
+    if (!url.startsWith("https://")) {
+      error = "File URL must be HTTPS";
+    } else {
+      ok = fileSpool.open(transferId, payload["path"] | "", payload["size"] | 0,
+                          FILE_FETCH_CHUNK_BYTES, payload["sha256"] | "", error);
+    }
+    if (ok) {
+      fileFetch.active = true;
+      fileFetch.commandId = commandId;
+      fileFetch.transferId = transferId;
+      fileFetch.url = url;
+      fileFetch.controllerIp = payload["controllerIp"] | controllerIp;
+      fileFetch.startedAt = millis();
+      fileFetch.retryAt = millis();
+      fileFetch.bytes = 0;
+      fileFetch.failures = 0;
+    }
+  } else if (type == "fileAbort") {
+    fileSpool.abort(transferId);
+    ok = true;
   } else {
-    Serial.println("  SUCCESS!");
-    updateCommandStatus(commandId, "completed");
+    error = "Unknown file command";
   }
+
+  JsonDocument report;
+  report["transferId"] = transferId;
+  if (fileSpool.active()) {
+    report["chunks"] = fileSpool.chunks();
+    report["received"] = fileSpool.receivedChunks();
+  }
+  String result;
+  serializeJson(report, result);
+
+  if (ok && type == "fileFetch") {
+    updateCommandStatus(commandId, "executing", "", result);
+  } else {
+    updateCommandStatus(commandId, ok ? "completed" : "failed", ok ? "" : error, result);
+  }
+  return ok;
+}
+
+// Downloads one range of the running fetch. Once every chunk is in, checks
+// the hash and uploads the file to the controller.
+void stepFileFetch() {
+  if (!fileFetch.active || (long)(millis() - fileFetch.retryAt) < 0) return;
+
+  String error;
+  int bytes = fileSpool.fetchRange(fileFetch.url.c_str(), FILE_FETCH_RANGE_BYTES, error);
+  if (bytes < 0) {
+    if (++fileFetch.failures >= FILE_FETCH_RETRIES) {
+      finishFileFetch(false, error);
+    } else {
+      fileFetch.retryAt = millis() + (FILE_FETCH_RETRY_MS << (fileFetch.failures - 1));
+    }
+    return;
+  }
+  fileFetch.failures = 0;
+  fileFetch.bytes += bytes;
+  // Counted with the rest of the cloud traffic
+  usageMeter.addBytes(USAGE_FIRESTORE, HTTP_HEADER_OVERHEAD_BYTES, bytes);
+  if (fileSpool.firstMissing() >= 0) return;
+
+  fileSpool.endFetch();
+  if (!fileSpool.verify(fileFetch.transferId.c_str(), error)) {
+    // A bad file is not resumed
+    fileSpool.discard();
+    finishFileFetch(false, error);
+    return;
+  }
+  FileUploadResult upload = fileSpool.uploadToWled(fileFetch.controllerIp.c_str());
+  usageMeter.addBytes(USAGE_WLED, upload.bytes, 0);
+  if (upload.ok) fileSpool.discard();
+  finishFileFetch(upload.ok, upload.error, &upload);
+}
+
+void finishFileFetch(bool ok, const String& error, const FileUploadResult* upload) {
+  fileSpool.endFetch();
+
+  JsonDocument report;
+  report["transferId"] = fileFetch.transferId;
+  report["downloaded"] = fileFetch.bytes;
+  report["fetchMs"] = millis() - fileFetch.startedAt;
+  if (upload != nullptr) {
+    report["httpCode"] = upload->httpCode;
+    report["bytes"] = upload->bytes;
+    report["elapsedMs"] = upload->elapsedMs;
+    report["bytesPerSec"] = upload->elapsedMs > 0
+                                ? (uint32_t)((uint64_t)upload->bytes * 1000 / upload->elapsedMs)
+                                : 0;
+    report["heapUsed"] = upload->heapUsed;
+  }
+  if (fileSpool.active()) {
+    report["chunks"] = fileSpool.chunks();
+    report["received"] = fileSpool.receivedChunks();
+  }
+  String result;
+  serializeJson(report, result);
+
+  updateCommandStatus(fileFetch.commandId, ok ? "completed" : "failed", ok ? "" : error, result);
+  fileFetch.active = false;
+  fileFetch.url = "";
+}
+
+bool prewarmActive() {
+  return prewarmUntil != 0 && (long)(millis() - prewarmUntil) < 0;
+}
+
+unsigned long currentPollInterval() {
+  if (prewarmActive()) return PREWARM_POLL_INTERVAL_MS;
+  if (pollSizer.backlog()) {
+    // More is waiting: poll again once the queues can take it
+    unsigned long wait =
+        pollSizer.backlogDelayMs(commandQueues.CAPACITY - commandQueues.stats().depth);
+    if (wait < pollIntervalMs) return wait;
+  }
+  return pollIntervalMs;
 }
 
 // ============================================================================
@@ -333,27 +1825,18 @@ void executeCommand(const String& commandId, JsonObject& fields) {
 // ============================================================================
 
 String convertFirestorePayloadToJson(JsonObject& fields) {
+  // The app writes the payload as a JSON string
+  if (fields["payload"]["stringValue"]) {
+    return fields["payload"]["stringValue"].as<String>();
+  }
+
   JsonObject payload = fields["payload"]["mapValue"]["fields"];
   if (payload.isNull()) {
     return "{}";
   }
 
   JsonDocument doc;
-
-  for (JsonPair kv : payload) {
-    const char* key = kv.key().c_str();
-    JsonObject val = kv.value().as<JsonObject>();
-
-    if (val["booleanValue"]) {
-      doc[key] = val["booleanValue"].as<bool>();
-    } else if (val["integerValue"]) {
-      doc[key] = val["integerValue"].as<int>();
-    } else if (val["doubleValue"]) {
-      doc[key] = val["doubleValue"].as<double>();
-    } else if (val["stringValue"]) {
-      doc[key] = val["stringValue"].as<String>();
-    }
-  }
+  firestoreFieldsToJson(payload, doc.to<JsonObject>());
 
   String result;
   serializeJson(doc, result);
@@ -393,6 +1876,7 @@ String makeWledRequest(const String& ip, const String& method,
   if (httpCode > 0 && (httpCode == 200 || httpCode == HTTP_CODE_OK)) {
     String response = http.getString();
     http.end();
+    usageMeter.addBytes(USAGE_WLED, url.length() + body.length(), response.length());
     return response;
   } else {
     String error = "ERROR: HTTP " + String(httpCode);
@@ -405,44 +1889,800 @@ String makeWledRequest(const String& ip, const String& method,
 // Update Command Status in Firestore
 // ============================================================================
 
-void updateCommandStatus(const String& commandId, const String& status,
-                         const String& error) {
-  HTTPClient http;
-  String url = firestoreBaseUrl() + "/commands/" + commandId +
-               "?key=" + String(FIREBASE_API_KEY) + "&updateMask.fieldPaths=status";
+void updateCommandStatus(const String& commandRef, const String& status,
+                         const String& error, const String& result) {
+  settleHedged(commandRef.c_str(), status.c_str(), error.c_str());
+  if (STATE_STORE) journalCommand(commandRef.c_str(), status.c_str());
+
+  String completedAt;
+  if (status == "completed" || status == "failed" || status == "superseded") {
+    completedAt = isoTimestamp();
+  }
+
+  // Pipelined unless the status carries a result or a long error
+  if (statusPipeline.running()) {
+    if (result.length() == 0 && error.length() < STATUS_PIPELINE_ERROR_MAX_LEN) {
+      statusPipeline.submit(commandRef.c_str(), status.c_str(), completedAt.c_str(),
+                            error.c_str());
+      return;
+    }
+    // An inline write must land after the statuses submitted before it
+    statusPipeline.drain(STATUS_PIPELINE_DRAIN_MS);
+  }
+
+  StatusWriteStats before = statusWriter.stats();
+  int httpCode = statusWriter.write(commandRef.c_str(), status.c_str(), completedAt.c_str(),
+                                    error.c_str(), result.c_str());
+  const StatusWriteStats& after = statusWriter.stats();
+
+  // Exact request and response sizes, headers included
+  usageMeter.addBytes(USAGE_FIRESTORE, after.bytesOut - before.bytesOut,
+                      after.bytesIn - before.bytesIn);
+
+  if (httpCode == 200) {
+    usageMeter.addFirestoreOps(FIRESTORE_WRITE);
+    DEBUG_PRINTF("Status updated (%u us to build)\n",
+                 after.formatMicros - before.formatMicros);
+  } else {
+    DEBUG_PRINT("Status update failed: ");
+    DEBUG_PRINTLN(httpCode);
+  }
+}
+
+// ============================================================================
+// State Store
+// ============================================================================
+
+// Replays the store and reads back the command journal and log sequence
+void loadStateStore() {
+  if (!stateFlash.begin("state") || !stateStore.begin(stateFlash, millis())) {
+    Serial.println("State store unavailable; nothing is kept across restarts");
+    return;
+  }
+
+  char key[8];
+  for (int i = 0; i < STATE_JOURNAL_SLOTS; i++) {
+    JournalEntry& entry = commandJournal[i];
+    snprintf(key, sizeof(key), "done/%02d", i);
+    int length = stateStore.get(key, &entry, sizeof(entry));
+    if (length <= (int)offsetof(JournalEntry, ref) || entry.status >= FINAL_STATUS_COUNT) {
+      memset(&entry, 0, sizeof(entry));
+      continue;
+    }
+    entry.ref[sizeof(entry.ref) - 1] = '\0';
+    if (entry.seq >= journalSeq) journalSeq = entry.seq + 1;
+  }
+  stateStore.get("logs/seq", &logShipSeq, sizeof(logShipSeq));
+
+  const StateStoreStats& stats = stateStore.stats();
+  Serial.printf("State store: %u keys, %u of %u bytes, replayed in %u us\n",
+                (unsigned)stateStore.keyCount(), (unsigned)stateStore.liveBytes(),
+                (unsigned)stateStore.capacityBytes(), stats.recoveryMicros);
+  if (stats.tornBatches > 0) {
+    Serial.printf("State store: skipped %u batch(es) cut short by a power loss\n",
+                  stats.tornBatches);
+  }
+}
+
+// Remembers a final status, so a poll after a restart that lost the
+// status write sends it again instead of running the command twice
+void journalCommand(const char* ref, const char* status) {
+  if (!stateStore.ready() || canaryRef() == ref) return;  // Every canary reuses its ref
+  uint8_t code = 0;
+  while (code < FINAL_STATUS_COUNT && strcmp(status, FINAL_STATUSES[code]) != 0) code++;
+  if (code == FINAL_STATUS_COUNT) return;
+  // Site mode reports a status, then writes it with the property's batch
+  const char* known = journaledStatus(ref);
+  if (known != nullptr && strcmp(known, status) == 0) return;
+
+  uint32_t seq = journalSeq++;
+  JournalEntry& entry = commandJournal[seq % STATE_JOURNAL_SLOTS];
+  entry.seq = seq;
+  entry.status = code;
+  strlcpy(entry.ref, ref, sizeof(entry.ref));
+
+  char key[8];
+  snprintf(key, sizeof(key), "done/%02d", (int)(seq % STATE_JOURNAL_SLOTS));
+  stateStore.put(key, &entry, offsetof(JournalEntry, ref) + strlen(entry.ref) + 1, millis());
+}
+
+// The newest journaled status for `ref`, or nullptr
+const char* journaledStatus(const char* ref) {
+  const JournalEntry* found = nullptr;
+  for (const JournalEntry& entry : commandJournal) {
+    if (entry.seq == 0 || strcmp(entry.ref, ref) != 0) continue;
+    if (found == nullptr || entry.seq > found->seq) found = &entry;
+  }
+  return found != nullptr ? FINAL_STATUSES[found->status] : nullptr;
+}
+
+// Flash cost since boot, and commit times since the last publish (group
+// commit and any compaction it waited for)
+void addStateStoreFields(JsonObject fields) {
+  const StateStoreStats& stats = stateStore.stats();
+  const LatencyStats& commits = stateStore.commitMicros();
+  fields["keys"]["integerValue"] = (uint32_t)stateStore.keyCount();
+  fields["liveBytes"]["integerValue"] = (uint32_t)stateStore.liveBytes();
+  fields["capacityBytes"]["integerValue"] = (uint32_t)stateStore.capacityBytes();
+  fields["freeSectors"]["integerValue"] = (uint32_t)stateStore.freeSectors();
+  fields["commits"]["integerValue"] = stats.commits;
+  fields["coalesced"]["integerValue"] = stats.coalesced;
+  fields["programmedBytes"]["integerValue"] = stats.programmedBytes;
+  fields["dayBytes"]["integerValue"] = stateStore.dayBytes();
+  fields["erases"]["integerValue"] = stats.erases;
+  fields["compactions"]["integerValue"] = stats.compactions;
+  fields["deferred"]["integerValue"] = stats.deferred;
+  fields["rejected"]["integerValue"] = stats.rejected;
+  fields["tornBatches"]["integerValue"] = stats.tornBatches;
+  fields["recoveryMicros"]["integerValue"] = stats.recoveryMicros;
+  fields["maxEraseCount"]["integerValue"] = stats.maxEraseCount;
+  fields["commitP50Micros"]["integerValue"] = commits.percentile(50);
+  fields["commitP99Micros"]["integerValue"] = commits.percentile(99);
+  fields["commitMaxMicros"]["integerValue"] = commits.max();
+}
+
+// ============================================================================
+// Usage Metering
+// ============================================================================
 
+// Folds the writer task's traffic into the usage meter, which only the
+// loop task touches
+void meterStatusPipeline() {
+  if (!statusPipeline.running()) return;
+
+  uint32_t up, down, writes;
+  statusPipeline.takeUsage(up, down, writes);
+  if (up > 0 || down > 0) usageMeter.addBytes(USAGE_FIRESTORE, up, down);
+  if (writes > 0) usageMeter.addFirestoreOps(FIRESTORE_WRITE, writes);
+}
+
+// Same for the hedge listener's MQTT session
+void meterHedgeListener() {
+  if (!hedgeListener.running()) return;
+
+  uint32_t up, down;
+  hedgeListener.takeUsage(up, down);
+  if (up > 0 || down > 0) usageMeter.addBytes(USAGE_MQTT, up, down);
+}
+
+String bridgeId() {
+  if (strlen(BRIDGE_ID) > 0) return String(BRIDGE_ID);
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  return mac;
+}
+
+// HTTPClient does not expose wire byte counts, so header bytes are estimated
+void meterFirestore(uint32_t up, uint32_t down) {
+  usageMeter.addBytes(USAGE_FIRESTORE, up + HTTP_HEADER_OVERHEAD_BYTES / 2,
+                      down + HTTP_HEADER_OVERHEAD_BYTES / 2);
+}
+
+void updateMeteredMode() {
+  usageMeter.setHour(millis() / 3600000UL);
+
+  bool wasMetered = usageMeter.metered();
+  bool metered = usageMeter.updateMetered((MeteredMode)METERED_MODE, METERED_DAILY_BUDGET_BYTES);
+
+  if (metered != wasMetered) {
+    Serial.println(metered ? "Metered mode ON - using frugal settings"
+                           : "Metered mode OFF");
+    pollIntervalMs = POLL_INTERVAL_MS;
+  }
+}
+
+void addUsageFields(JsonObject fields, const UsageTotals& totals) {
+  fields["firestoreBytesUp"]["integerValue"] = totals.bytesUp[USAGE_FIRESTORE];
+  fields["firestoreBytesDown"]["integerValue"] = totals.bytesDown[USAGE_FIRESTORE];
+  fields["wledBytesUp"]["integerValue"] = totals.bytesUp[USAGE_WLED];
+  fields["wledBytesDown"]["integerValue"] = totals.bytesDown[USAGE_WLED];
+  fields["reads"]["integerValue"] = totals.firestoreOps[FIRESTORE_READ];
+  fields["writes"]["integerValue"] = totals.firestoreOps[FIRESTORE_WRITE];
+  fields["deletes"]["integerValue"] = totals.firestoreOps[FIRESTORE_DELETE];
+}
+
+// Queue occupancy: totals since boot plus each controller's depth and
+// high-water mark
+void addQueueFields(JsonObject fields) {
+  CommandQueueStats stats = commandQueues.stats();
+  fields["capacity"]["integerValue"] = (uint32_t)commandQueues.CAPACITY;
+  fields["depth"]["integerValue"] = stats.depth;
+  fields["highWater"]["integerValue"] = stats.highWater;
+  fields["added"]["integerValue"] = stats.added;
+  fields["replaced"]["integerValue"] = stats.replaced;
+  fields["covered"]["integerValue"] = stats.covered;
+  fields["rejected"]["integerValue"] = stats.rejected;
+  fields["dispatched"]["integerValue"] = stats.dispatched;
+
+  // Back-to-back throughput: executed commands per second of loop time
+  if (dispatchStats.commands > 0 && dispatchStats.busyMicros > 0) {
+    fields["executeMicrosAvg"]["integerValue"] =
+        dispatchStats.busyMicros / dispatchStats.commands;
+    fields["executeMicrosMax"]["integerValue"] = dispatchStats.maxMicros;
+    fields["commandsPerSecond"]["doubleValue"] =
+        dispatchStats.commands * 1e6 / dispatchStats.busyMicros;
+  }
+
+  // Pending-command pages: how often a backlog grew the page, and what
+  // held it back
+  const PollSizerStats& polls = pollSizer.stats();
+  fields["pollPages"]["integerValue"] = polls.polls;
+  fields["pollFullPages"]["integerValue"] = polls.fullPages;
+  fields["pollMaxLimit"]["integerValue"] = polls.maxLimit;
+  fields["pollDeferred"]["integerValue"] = polls.deferred;
+  fields["pollHeapCapped"]["integerValue"] = polls.heapCapped;
+
+  JsonArray controllers =
+      fields["controllers"]["arrayValue"]["values"].to<JsonArray>();
+  for (size_t i = 0; i < commandQueues.slotCount(); i++) {
+    if (commandQueues.slotController(i)[0] == '\0') continue;
+    JsonObject slot = controllers.add<JsonObject>()["mapValue"]["fields"].to<JsonObject>();
+    slot["controller"]["stringValue"] = commandQueues.slotController(i);
+    slot["depth"]["integerValue"] = commandQueues.slotDepth(i);
+    slot["highWater"]["integerValue"] = commandQueues.slotHighWater(i);
+  }
+}
+
+// Status write cost: per-write averages since boot
+void addWriterFields(JsonObject fields, const StatusWriteStats& stats) {
+  uint32_t writes = stats.writes > 0 ? stats.writes : 1;
+  fields["writes"]["integerValue"] = stats.writes;
+  fields["failures"]["integerValue"] = stats.failures;
+  fields["connects"]["integerValue"] = stats.connects;
+  fields["bytesOutPerWrite"]["integerValue"] = stats.bytesOut / writes;
+  fields["bytesInPerWrite"]["integerValue"] = stats.bytesIn / writes;
+  fields["bytesCopiedPerWrite"]["integerValue"] = stats.bytesCopied / writes;
+  fields["formatMicrosAvg"]["integerValue"] = stats.formatMicros / writes;
+  fields["formatMicrosMax"]["integerValue"] = stats.maxFormatMicros;
+  fields["totalMicrosAvg"]["integerValue"] = stats.totalMicros / writes;
+}
+
+// Inline writes, plus the pipeline's own counters and writer when it runs
+void addStatusWriteFields(JsonObject fields) {
+  addWriterFields(fields, statusWriter.stats());
+  if (!statusPipeline.running()) return;
+
+  StatusPipelineStats stats = statusPipeline.stats();
+  JsonObject pipeline = fields["pipeline"]["mapValue"]["fields"].to<JsonObject>();
+  pipeline["depth"]["integerValue"] = STATUS_PIPELINE_DEPTH;
+  pipeline["submitted"]["integerValue"] = stats.submitted;
+  pipeline["replaced"]["integerValue"] = stats.replaced;
+  pipeline["highWater"]["integerValue"] = stats.highWater;
+  pipeline["blocked"]["integerValue"] = stats.blocked;
+  pipeline["blockedMicros"]["integerValue"] = stats.blockedMicros;
+  pipeline["retried"]["integerValue"] = stats.retried;
+  pipeline["dropped"]["integerValue"] = stats.dropped;
+  addWriterFields(pipeline, stats.writer);
+}
+
+// Writes hourly and 24-hour totals to /users/{uid}/bridges/{bridgeId},
+// along with command queue occupancy and status write cost
+void publishUsage() {
   JsonDocument doc;
-  doc["fields"]["status"]["stringValue"] = status;
+  JsonObject usage = doc["fields"]["usage"]["mapValue"]["fields"].to<JsonObject>();
+  usage["uptimeHour"]["integerValue"] = usageMeter.hour();
+  usage["metered"]["booleanValue"] = usageMeter.metered();
+  usage["updatedAt"]["timestampValue"] = isoTimestamp();
+  addUsageFields(usage["lastHour"]["mapValue"]["fields"].to<JsonObject>(),
+                 usageMeter.lastHours(1));
+  addUsageFields(usage["last24h"]["mapValue"]["fields"].to<JsonObject>(),
+                 usageMeter.lastHours(UsageMeter::HISTORY_HOURS));
+  addQueueFields(doc["fields"]["queues"]["mapValue"]["fields"].to<JsonObject>());
+  addStatusWriteFields(doc["fields"]["statusWrites"]["mapValue"]["fields"].to<JsonObject>());
+  if (canary.enabled()) {
+    addCanaryFields(doc["fields"]["canary"]["mapValue"]["fields"].to<JsonObject>());
+  }
+  if (hedgeListener.running()) {
+    addHedgeFields(doc["fields"]["hedge"]["mapValue"]["fields"].to<JsonObject>());
+  }
+  bool health = healthSeries.enabled() && healthSeries.controllerCount() > 0;
+  if (health) {
+    addHealthFields(doc["fields"]["health"]["mapValue"]["fields"].to<JsonObject>());
+  }
+  if (stateStore.ready()) {
+    addStateStoreFields(doc["fields"]["stateStore"]["mapValue"]["fields"].to<JsonObject>());
+  }
 
-  if (status == "completed" || status == "failed") {
-    time_t now = time(nullptr);
-    char timestamp[30];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
-    doc["fields"]["completedAt"]["timestampValue"] = timestamp;
-    url += "&updateMask.fieldPaths=completedAt";
+  String body;
+  serializeJson(doc, body);
+
+  HTTPClient http;
+  String url = firestoreBaseUrl() + "/bridges/" + bridgeId() +
+               "?key=" + String(FIREBASE_API_KEY) +
+               "&updateMask.fieldPaths=usage&updateMask.fieldPaths=queues"
+               "&updateMask.fieldPaths=statusWrites";
+  if (canary.enabled()) url += "&updateMask.fieldPaths=canary";
+  if (hedgeListener.running()) url += "&updateMask.fieldPaths=hedge";
+  if (health) url += "&updateMask.fieldPaths=health";
+  if (stateStore.ready()) url += "&updateMask.fieldPaths=stateStore";
+
+  http.begin(secureClient, url);
+  http.addHeader("Content-Type", "application/json");
+
+  int httpCode = http.PATCH(body);
+  meterFirestore(url.length() + body.length(), http.getSize() > 0 ? http.getSize() : 0);
+
+  if (httpCode == 200) {
+    usageMeter.addFirestoreOps(FIRESTORE_WRITE);
+    canary.clearWindow();
+    hedgedIntake.clearWindow();
+    healthSeries.clearWindow();
+    stateStore.clearCommitMicros();
+    DEBUG_PRINTLN("Usage published");
+  } else {
+    DEBUG_PRINT("Usage publish failed: ");
+    DEBUG_PRINTLN(httpCode);
   }
 
-  if (!error.isEmpty()) {
-    doc["fields"]["error"]["stringValue"] = error;
-    url += "&updateMask.fieldPaths=error";
+  http.end();
+}
+
+// ============================================================================
+// Latency Canary
+// ============================================================================
+
+String canaryRef() {
+  return String(FIREBASE_USER_UID) + "/commands/canary-" + bridgeId();
+}
+
+// Writes the canary over the previous one: a pending getInfo, as the app
+// would write it. The poll, queue and status code then treat it like any
+// other command and report its progress to the canary.
+void sendCanary() {
+  String ip = CANARY_CONTROLLER_IP;
+  if (ip.isEmpty()) ip = lastControllerIp;
+  // No controller commanded yet, or metered: the canary's writes land in
+  // the customer's own commands collection and Firestore budget. Try again
+  // next interval.
+  if (ip.isEmpty() || usageMeter.metered()) {
+    canary.begin(millis(), CANARY_INTERVAL_MS);
+    return;
   }
 
+  uint32_t sequence = canary.start(millis());
+  JsonDocument doc;
+  JsonObject fields = doc["fields"].to<JsonObject>();
+  fields["type"]["stringValue"] = "getInfo";
+  fields["status"]["stringValue"] = "pending";
+  fields["controllerIp"]["stringValue"] = ip;
+  fields["canarySeq"]["integerValue"] = sequence;
+  fields["createdAt"]["timestampValue"] = isoTimestamp();
+  if (SITE_MODE) fields["siteId"]["stringValue"] = SITE_ID;
+
   String body;
   serializeJson(doc, body);
 
+  HTTPClient http;
+  String url = firestoreBaseUrl() + "/commands/canary-" + bridgeId() +
+               "?key=" + String(FIREBASE_API_KEY);
   http.begin(secureClient, url);
   http.addHeader("Content-Type", "application/json");
 
   int httpCode = http.PATCH(body);
+  meterFirestore(url.length() + body.length(), http.getSize() > 0 ? http.getSize() : 0);
+  http.end();
 
   if (httpCode == 200) {
-    DEBUG_PRINTLN("Status updated");
+    usageMeter.addFirestoreOps(FIRESTORE_WRITE);
+    canary.sent(sequence, millis());
   } else {
-    DEBUG_PRINT("Status update failed: ");
+    DEBUG_PRINT("Canary write failed: ");
     DEBUG_PRINTLN(httpCode);
+    canary.finished(sequence, false, millis());
+  }
+}
+
+// Canaries since the last publish: round-trip percentiles, and each one's
+// legs in ms from when it was written (0 = it never got that far)
+void addCanaryFields(JsonObject fields) {
+  const LatencyStats& totals = canary.totals();
+  fields["count"]["integerValue"] = totals.count();
+  fields["failures"]["integerValue"] = totals.failures();
+  fields["p50Ms"]["integerValue"] = totals.percentile(50);
+  fields["p95Ms"]["integerValue"] = totals.percentile(95);
+  fields["maxMs"]["integerValue"] = totals.max();
+
+  JsonArray series = fields["series"]["arrayValue"]["values"].to<JsonArray>();
+  for (size_t i = 0; i < canary.count(); i++) {
+    const CanarySample& sample = canary.sample(i);
+    JsonObject entry = series.add<JsonObject>()["mapValue"]["fields"].to<JsonObject>();
+    entry["uptimeSec"]["integerValue"] = sample.startedSec;
+    entry["writeMs"]["integerValue"] = sample.sendMs;
+    entry["pickupMs"]["integerValue"] = sample.receiveMs;
+    entry["totalMs"]["integerValue"] = sample.totalMs;
+  }
+}
+
+// ============================================================================
+// Controller Health
+// ============================================================================
+
+// Reads the next due controller's /json/info into the health series. The
+// round trip is timed from the request to the last byte of the reply.
+void sampleControllerHealth() {
+  int controller = healthSeries.due(millis());
+  if (controller < 0) return;
+  String ip = healthSeries.ip(controller);
+
+  HTTPClient http;
+  String url = "http://" + ip + "/json/info";
+  http.begin(url);
+  http.setConnectTimeout(HEALTH_HTTP_TIMEOUT_MS);
+  http.setTimeout(HEALTH_HTTP_TIMEOUT_MS);
+
+  uint32_t started = micros();
+  int httpCode = http.GET();
+  if (httpCode != 200) {
+    http.end();
+    healthSeries.failed(controller, millis());
+    DEBUG_PRINTF("Health read of %s failed: %d\n", ip.c_str(), httpCode);
+    return;
+  }
+
+  // Only the fields the series keeps; the rest of /json/info is skipped
+  JsonDocument filter;
+  filter["leds"]["fps"] = true;
+  filter["leds"]["pwr"] = true;
+  filter["freeheap"] = true;
+  filter["wifi"]["rssi"] = true;
+  filter["uptime"] = true;
+
+  JsonDocument info;
+  int size = http.getSize();
+  DeserializationError error =
+      deserializeJson(info, http.getStream(), DeserializationOption::Filter(filter));
+  uint32_t rttUs = micros() - started;
+  http.end();
+  usageMeter.addBytes(USAGE_WLED, url.length(), size > 0 ? size : 0);
+
+  if (error) {
+    healthSeries.failed(controller, millis());
+    return;
+  }
+
+  HealthReading reading;
+  // WLED reports 0 fps while nothing is rendering (off or static), which
+  // says nothing about a starved CPU
+  int32_t fps = info["leds"]["fps"] | 0;
+  reading.value[HEALTH_FPS] = fps > 0 ? fps : HEALTH_MISSING;
+  reading.value[HEALTH_FREE_HEAP] = info["freeheap"] | HEALTH_MISSING;
+  reading.value[HEALTH_RSSI] = info["wifi"]["rssi"] | HEALTH_MISSING;
+  reading.value[HEALTH_POWER] = info["leds"]["pwr"] | HEALTH_MISSING;
+  reading.value[HEALTH_RTT] = rttUs;
+  reading.uptimeSec = info["uptime"] | 0;
+  healthSeries.record(controller, reading, millis());
+}
+
+// Each controller's window since the last publish: per metric min, mean,
+// max and HEALTH_ROLLUP_POINTS averaged points, and flags for what is
+// below the HEALTH_MIN_* thresholds
+void addHealthFields(JsonObject fields) {
+  static const char* const METRIC_NAMES[HEALTH_METRIC_COUNT] = {
+      "fps", "freeHeap", "rssi", "powerMa", "rttUs"};
+
+  fields["sampleSec"]["integerValue"] = HEALTH_SAMPLE_MS / 1000;
+  JsonArray controllers = fields["controllers"]["arrayValue"]["values"].to<JsonArray>();
+  for (size_t c = 0; c < healthSeries.controllerCount(); c++) {
+    JsonObject entry = controllers.add<JsonObject>()["mapValue"]["fields"].to<JsonObject>();
+    entry["ip"]["stringValue"] = healthSeries.ip(c);
+    entry["samples"]["integerValue"] = healthSeries.samples(c);
+    entry["failures"]["integerValue"] = healthSeries.failures(c);
+    entry["reboots"]["integerValue"] = healthSeries.reboots(c);
+    entry["uptimeSec"]["integerValue"] = healthSeries.uptimeSec(c);
+
+    HealthRollup rollups[HEALTH_METRIC_COUNT];
+    for (int m = 0; m < HEALTH_METRIC_COUNT; m++) {
+      rollups[m] = healthSeries.rollup(c, (HealthMetric)m);
+      if (rollups[m].samples == 0) continue;
+
+      JsonObject metric = entry[METRIC_NAMES[m]]["mapValue"]["fields"].to<JsonObject>();
+      metric["min"]["integerValue"] = rollups[m].min;
+      metric["mean"]["integerValue"] = rollups[m].mean;
+      metric["max"]["integerValue"] = rollups[m].max;
+
+      int32_t points[HEALTH_ROLLUP_POINTS];
+      size_t count = healthSeries.downsample(c, (HealthMetric)m, points, HEALTH_ROLLUP_POINTS);
+      JsonArray series = metric["points"]["arrayValue"]["values"].to<JsonArray>();
+      for (size_t i = 0; i < count; i++) {
+        if (points[i] == HEALTH_MISSING) {
+          series.add<JsonObject>()["nullValue"] = nullptr;
+        } else {
+          series.add<JsonObject>()["integerValue"] = points[i];
+        }
+      }
+    }
+
+    JsonArray flags = entry["flags"]["arrayValue"]["values"].to<JsonArray>();
+    if (healthSeries.samples(c) == 0 && healthSeries.failures(c) > 0) {
+      flags.add<JsonObject>()["stringValue"] = "unreachable";
+    }
+    if (healthSeries.reboots(c) > 0) flags.add<JsonObject>()["stringValue"] = "rebooted";
+    if (rollups[HEALTH_FPS].samples > 0 && rollups[HEALTH_FPS].mean < HEALTH_MIN_FPS) {
+      flags.add<JsonObject>()["stringValue"] = "lowFps";
+    }
+    if (rollups[HEALTH_FREE_HEAP].samples > 0 &&
+        rollups[HEALTH_FREE_HEAP].mean < HEALTH_MIN_FREE_HEAP) {
+      flags.add<JsonObject>()["stringValue"] = "lowHeap";
+    }
+    if (rollups[HEALTH_RSSI].samples > 0 && rollups[HEALTH_RSSI].mean < HEALTH_MIN_RSSI) {
+      flags.add<JsonObject>()["stringValue"] = "weakWifi";
+    }
+  }
+}
+
+// ============================================================================
+// Remote Logs
+// ============================================================================
+
+// A diagnostic line: printed as before (debug lines only with
+// DEBUG_ENABLED), and kept for shipping if the log ring admits it
+void logLine(LogLevel level, LogSite site, const char* format, ...) {
+  bool keep = REMOTE_LOGS && remoteLog.admit(level, site, millis());
+  bool print = level != LOG_DEBUG || DEBUG_ENABLED;
+  if (!keep && !print) return;
+
+  uint32_t started = micros();
+  char line[LOG_LINE_MAX + 1];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length < 0) return;
+  if (length > LOG_LINE_MAX) length = LOG_LINE_MAX;
+
+  if (keep) {
+    remoteLog.add(level, site, line, length, millis());
+    remoteLog.charge(micros() - started, millis());
+  }
+  if (print) Serial.println(line);
+}
+
+// Ships the oldest LOG_SHIP_BATCH_BYTES of the ring as one log document,
+// /bridges/{bridgeId}/logs/{seq % LOG_SHIP_SLOTS}: the lines as text,
+// LZ4-block compressed and base64'd into a bytes field. Runs when the
+// interval is up or the ring is half full; after a shipLogs command, and
+// after a shipment that left lines behind, one batch per loop pass until
+// the ring is empty.
+void shipLogs() {
+  if (remoteLog.pending() == 0) {
+    logShipRequested = false;
+    return;
+  }
+  // A half-full ring goes early, but not more than once a minute
+  unsigned long sinceLast = millis() - lastLogShip;
+  bool due = sinceLast >= LOG_SHIP_INTERVAL_MS ||
+             (remoteLog.pendingBytes() >= LOG_RING_BYTES / 2 && sinceLast >= 60000);
+  if (!due && !logShipRequested) return;
+  lastLogShip = millis();
+  logShipRequested = false;
+
+  // Static: kept off the loop task's stack
+  static char text[LOG_SHIP_BATCH_BYTES];
+  static uint8_t packed[LZ4_BOUND(LOG_SHIP_BATCH_BYTES)];
+  static uint16_t table[LZ4_TABLE_ENTRIES];
+  static unsigned char encoded[(sizeof(packed) + 2) / 3 * 4 + 1];
+
+  uint32_t started = micros();
+  size_t lines;
+  size_t rawBytes = remoteLog.peek(text, sizeof(text), lines);
+  size_t packedBytes = lz4Compress((const uint8_t*)text, rawBytes, packed, sizeof(packed), table);
+  size_t encodedBytes = 0;
+  if (lines == 0 || packedBytes == 0 ||
+      mbedtls_base64_encode(encoded, sizeof(encoded), &encodedBytes, packed, packedBytes) != 0) {
+    return;
   }
+  encoded[encodedBytes] = '\0';
+  remoteLog.charge(micros() - started, millis());
+
+  if (!remoteLog.spend(packedBytes, millis())) return;
+
+  const LogRingStats& stats = remoteLog.stats();
+  JsonDocument doc;
+  JsonObject fields = doc["fields"].to<JsonObject>();
+  fields["seq"]["integerValue"] = logShipSeq;
+  fields["codec"]["stringValue"] = "lz4-block";
+  fields["data"]["bytesValue"] = (const char*)encoded;
+  fields["rawBytes"]["integerValue"] = rawBytes;
+  fields["lines"]["integerValue"] = lines;
+  fields["level"]["integerValue"] = remoteLog.level();
+  fields["sampledOut"]["integerValue"] = stats.sampledOut;
+  fields["cpuDropped"]["integerValue"] = stats.cpuDropped;
+  fields["overwritten"]["integerValue"] = stats.overwritten;
+  fields["budgetDenied"]["integerValue"] = stats.budgetDenied;
+  fields["cpuMicros"]["integerValue"] = stats.cpuMicros;
+  fields["uptimeSec"]["integerValue"] = millis() / 1000;
+  fields["createdAt"]["timestampValue"] = isoTimestamp();
 
+  String body;
+  serializeJson(doc, body);
+
+  HTTPClient http;
+  String url = firestoreBaseUrl() + "/bridges/" + bridgeId() + "/logs/" +
+               String(logShipSeq % LOG_SHIP_SLOTS) + "?key=" + String(FIREBASE_API_KEY);
+  http.begin(secureClient, url);
+  http.addHeader("Content-Type", "application/json");
+
+  int httpCode = http.PATCH(body);
+  meterFirestore(url.length() + body.length(), http.getSize() > 0 ? http.getSize() : 0);
   http.end();
+
+  if (httpCode == 200) {
+    usageMeter.addFirestoreOps(FIRESTORE_WRITE);
+    remoteLog.release(lines, packedBytes);
+    logShipSeq++;
+    // Carries on from here after a restart instead of overwriting slot 0
+    if (STATE_STORE) stateStore.put("logs/seq", &logShipSeq, sizeof(logShipSeq), millis());
+    logShipRequested = remoteLog.pending() > 0;
+  } else {
+    // Kept in the ring for the next interval
+    DEBUG_PRINT("Log shipment failed: ");
+    DEBUG_PRINTLN(httpCode);
+  }
+}
+
+// Ships the log ring now. Payload (optional): {"level": "debug"} changes
+// the capture level ("error", "warn", "info", "debug") until a restart.
+bool runShipLogsCommand(const String& commandId, JsonObject& fields) {
+  JsonDocument payload;
+  deserializeJson(payload, convertFirestorePayloadToJson(fields));
+
+  static const char* const LEVELS[] = {"error", "warn", "info", "debug"};
+  const char* level = payload["level"] | "";
+  for (int i = 0; i <= LOG_DEBUG; i++) {
+    if (strcmp(level, LEVELS[i]) == 0) remoteLog.setLevel((LogLevel)i);
+  }
+  logShipRequested = true;
+
+  String result = "{\"pending\":" + String(remoteLog.pending()) + ",\"level\":\"" +
+                  LEVELS[remoteLog.level()] + "\"}";
+  updateCommandStatus(commandId, "completed", "", result);
+  return true;
+}
+
+// ============================================================================
+// Hedged Delivery
+// ============================================================================
+
+// Runs the command messages the hedge listener has received. A message is
+// the app's command as plain JSON with its Firestore reference
+// ("commandRef"); it is typed like the Firestore document so the poll's
+// code runs it, and its statuses go through the pipeline rather than a
+// commit, so a stalled Firestore does not hold it up. Only controller
+// commands run from here: bridge commands (updates, files, diagnostics)
+// are left to their Firestore copy.
+void takeHedgedCommands() {
+  static char message[HEDGE_MESSAGE_MAX_LEN];
+  size_t length;
+  while (hedgeListener.take(message, sizeof(message), length)) {
+    // A message that cannot be used is left to its Firestore copy
+    JsonDocument doc;
+    if (deserializeJson(doc, message, length)) continue;
+    String ref = doc["commandRef"] | "";
+    if (!isOwnCommandRef(ref, doc["siteId"] | "")) continue;
+    const char* type = doc["action"] | "setState";
+    if (isBridgeCommand(type)) continue;
+    if (!hedgedIntake.arrive(ref.c_str(), HEDGE_MQTT, millis())) continue;
+
+    JsonDocument typed;
+    PendingCommand cmd;
+    cmd.id = ref;
+    cmd.fields = typed.to<JsonObject>();
+    cmd.fields["type"]["stringValue"] = type;
+    cmd.fields["controllerId"]["stringValue"] = doc["controllerId"] | "";
+    cmd.fields["controllerIp"]["stringValue"] = doc["controllerIp"] | "";
+    String payload = "{}";
+    if (doc["payload"].is<JsonObject>()) {
+      payload = "";
+      serializeJson(doc["payload"], payload);
+    }
+    cmd.fields["payload"]["stringValue"] = payload;
+    char version[24];
+    snprintf(version, sizeof(version), "%llu", (unsigned long long)(doc["version"] | 0.0));
+    cmd.fields["version"]["integerValue"] = version;
+    const char* propertyId = doc["propertyId"] | "";
+    cmd.property = propertyId[0] != '\0' ? String(propertyId) : ref.substring(0, ref.indexOf('/'));
+    cmd.controller = commandControllerKey(cmd.fields);
+    cmd.version = commandVersion(cmd.fields);
+    cmd.writes = commandFieldWrites(cmd.fields);
+    cmd.superseded = false;
+
+    Serial.print("Hedged command via MQTT: ");
+    Serial.println(cmd.id);
+
+    if (commandQueues.contains(cmd.id.c_str())) continue;
+    if (SITE_MODE && siteProperties.track(cmd.property.c_str()) < 0) {
+      hedgedIntake.forget(cmd.id.c_str());
+      continue;
+    }
+
+    StatusBatch batch;
+    batch.pipelined = true;
+    enqueueCommand(cmd, batch);
+  }
+}
+
+// MQTT topics are shared, so a message only runs if it names a command
+// this bridge would also get from its Firestore query: one of its user's,
+// or in site mode one for its site
+bool isOwnCommandRef(const String& ref, const char* siteId) {
+  if (ref.length() >= COMMAND_REF_MAX_LEN) return false;
+  int slash = ref.indexOf('/');
+  if (slash <= 0 || !ref.substring(slash).startsWith("/commands/") ||
+      ref.indexOf('/', slash + 10) >= 0) {
+    return false;
+  }
+  if (SITE_MODE) return strcmp(siteId, SITE_ID) == 0;
+  return ref.substring(0, slash) == FIREBASE_USER_UID;
+}
+
+// A hedged command's final status also goes out on MQTT, whichever path
+// delivered it. Commands the intake does not track are left alone.
+void settleHedged(const char* ref, const char* status, const char* error) {
+  if (!HEDGED_DELIVERY) return;
+
+  HedgeOutcome outcome;
+  if (strcmp(status, "completed") == 0) {
+    outcome = HEDGE_COMPLETED;
+  } else if (strcmp(status, "failed") == 0) {
+    outcome = HEDGE_FAILED;
+  } else if (strcmp(status, "superseded") == 0) {
+    outcome = HEDGE_SUPERSEDED;
+  } else {
+    return;
+  }
+  if (hedgedIntake.outcome(ref) == outcome || !hedgedIntake.settle(ref, outcome)) return;
+  hedgeListener.ack(ref, status, error);
+}
+
+// The Firestore copy of a command the MQTT copy has already finished: the
+// app's write landed after the bridge's status and set it back to pending,
+// so the status is written again
+void answerLateCopy(const String& ref) {
+  switch (hedgedIntake.outcome(ref.c_str())) {
+    case HEDGE_COMPLETED:
+      updateCommandStatus(ref, "completed");
+      break;
+    case HEDGE_FAILED:
+      updateCommandStatus(ref, "failed", "Command failed");
+      break;
+    case HEDGE_SUPERSEDED:
+      updateCommandStatus(ref, "superseded");
+      break;
+    case HEDGE_OPEN:
+      break;
+  }
+}
+
+// Hedged delivery since the last publish: per path, the commands it
+// delivered first, how far ahead of the other copy (ms), and how many the
+// other path never delivered; then the MQTT session since boot
+void addHedgeFields(JsonObject fields) {
+  const char* names[HEDGE_PATH_COUNT] = {"firestore", "mqtt"};
+  for (int i = 0; i < HEDGE_PATH_COUNT; i++) {
+    const HedgePathStats& stats = hedgedIntake.stats((HedgePath)i);
+    JsonObject path = fields[names[i]]["mapValue"]["fields"].to<JsonObject>();
+    path["wins"]["integerValue"] = stats.wins;
+    path["alone"]["integerValue"] = stats.alone;
+    path["leadP50Ms"]["integerValue"] = stats.leadMs.percentile(50);
+    path["leadP95Ms"]["integerValue"] = stats.leadMs.percentile(95);
+    path["leadMaxMs"]["integerValue"] = stats.leadMs.max();
+  }
+  fields["duplicates"]["integerValue"] = hedgedIntake.duplicates();
+
+  HedgeListenerStats listener = hedgeListener.stats();
+  fields["mqttConnected"]["booleanValue"] = listener.connected;
+  fields["mqttConnects"]["integerValue"] = listener.connects;
+  fields["mqttReceived"]["integerValue"] = listener.received;
+  fields["mqttDropped"]["integerValue"] = listener.dropped;
+  fields["acks"]["integerValue"] = listener.acks;
+  fields["acksDropped"]["integerValue"] = listener.acksDropped;
+}
+
+String isoTimestamp() {
+  time_t now = time(nullptr);
+  char timestamp[30];
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  return String(timestamp);
 }
 
 // ============================================================================
@@ -458,16 +2698,25 @@ void blinkLed(int times, int delayMs) {
   }
 }
 
-void statusBlink() {
-  if (millis() - lastBlinkTime >= 5000) {
-    lastBlinkTime = millis();
+CoroWait HeartbeatLed::resume() {
+  CORO_BEGIN();
+  for (;;) {
+    CORO_SLEEP(5000);
 
     if (firebaseReady && WiFi.status() == WL_CONNECTED) {
-      blinkLed(1, 50);
+      blinks_ = 1;
     } else if (WiFi.status() == WL_CONNECTED) {
-      blinkLed(2, 100);
+      blinks_ = 2;
     } else {
-      blinkLed(3, 100);
+      blinks_ = 3;
+    }
+
+    for (i_ = 0; i_ < blinks_; i_++) {
+      digitalWrite(STATUS_LED_PIN, HIGH);
+      CORO_SLEEP(blinks_ == 1 ? 50 : 100);
+      digitalWrite(STATUS_LED_PIN, LOW);
+      CORO_SLEEP(blinks_ == 1 ? 50 : 100);
     }
   }
+  CORO_END();
 }
@@ -0,0 +1,175 @@
+/**
+ * Lumina ESP32 Bridge - Realtime DDP Output
+ *
+ * Payload of a realtimeStart command:
+ *
+ *   {"controllers": [{"ip": "192.168.1.50", "pixels": 600},
+ *                    {"ip": "192.168.1.51", "pixels": 450}],
+ *    "fps": 40, "durationMs": 60000, "pattern": "chase",
+ *    "color": [255, 120, 0], "broadcastPush": false}
+ *
+ * Controllers are in strip order. The frame buffer is static
+ * (REALTIME_MAX_PIXELS * 3 bytes); the task sleeps until a frame is
+ * nearly due and spins the last millisecond so frames leave on the clock.
+ */
+
+#include "realtime_output.h"
+
+#include <WiFi.h>
+#include <ddp.h>
+
+static const uint32_t OUTPUT_TASK_STACK = 4096;
+static const UBaseType_t OUTPUT_TASK_PRIORITY = 2;  // Above the status writer
+static const BaseType_t OUTPUT_TASK_CORE = 0;       // The loop task runs on core 1
+static const uint32_t STOP_WAIT_MS = 1000;
+
+static uint8_t frameBuffer[REALTIME_MAX_PIXELS * 3];
+
+RealtimeOutput::RealtimeOutput()
+    : sync_(sendPacket, this), task_(nullptr), stopRequested_(false), pattern_(REALTIME_CHASE),
+      fps_(REALTIME_DEFAULT_FPS), durationMs_(0), startedAt_(0), sendMicrosTotal_(0),
+      sendMicrosMax_(0) {
+  memset(color_, 0, sizeof(color_));
+}
+
+bool RealtimeOutput::start(JsonObjectConst payload, String& error) {
+  stop();
+
+  sync_.clearOutputs();
+  for (JsonVariantConst member : payload["controllers"].as<JsonArrayConst>()) {
+    JsonObjectConst controller = member.as<JsonObjectConst>();
+    uint32_t pixels = controller["pixels"] | 0UL;
+    if (pixels == 0 || pixels > 0xFFFF || !sync_.addOutput(controller["ip"] | "", pixels)) {
+      error = "Bad controller entry (max " + String(DDP_SYNC_MAX_OUTPUTS) + " controllers)";
+      return false;
+    }
+  }
+  if (sync_.outputCount() == 0) {
+    error = "No controllers";
+    return false;
+  }
+  if (sync_.framePixels() > REALTIME_MAX_PIXELS) {
+    error = "Too many pixels (max " + String(REALTIME_MAX_PIXELS) + ")";
+    return false;
+  }
+
+  fps_ = payload["fps"] | REALTIME_DEFAULT_FPS;
+  if (fps_ == 0 || fps_ > REALTIME_MAX_FPS) fps_ = REALTIME_DEFAULT_FPS;
+  durationMs_ = payload["durationMs"] | (uint32_t)REALTIME_MAX_DURATION_MS;
+  if (durationMs_ == 0 || durationMs_ > REALTIME_MAX_DURATION_MS) {
+    durationMs_ = REALTIME_MAX_DURATION_MS;
+  }
+
+  const char* pattern = payload["pattern"] | "chase";
+  pattern_ = strcmp(pattern, "rainbow") == 0 ? REALTIME_RAINBOW : REALTIME_CHASE;
+  JsonArrayConst color = payload["color"];
+  color_[0] = color[0] | 255;
+  color_[1] = color[1] | 255;
+  color_[2] = color[2] | 255;
+
+  bool broadcast = payload["broadcastPush"] | (bool)REALTIME_BROADCAST_PUSH;
+  sync_.setBroadcastPush(broadcast ? WiFi.broadcastIP().toString().c_str() : nullptr);
+  sync_.setDeferredPush(payload["deferPush"] | true);
+
+  sync_.resetStats();
+  sendMicrosTotal_ = 0;
+  sendMicrosMax_ = 0;
+  stopRequested_ = false;
+  startedAt_ = millis();
+
+  if (xTaskCreatePinnedToCore(taskEntry, "ddpOutput", OUTPUT_TASK_STACK, this,
+                              OUTPUT_TASK_PRIORITY, &task_, OUTPUT_TASK_CORE) != pdPASS) {
+    task_ = nullptr;
+    error = "Could not start output task";
+    return false;
+  }
+  return true;
+}
+
+void RealtimeOutput::stop() {
+  if (task_ == nullptr) return;
+  stopRequested_ = true;
+  uint32_t started = millis();
+  while (task_ != nullptr && millis() - started < STOP_WAIT_MS) {
+    delay(1);
+  }
+}
+
+void RealtimeOutput::report(JsonObject out) const {
+  const DdpSyncStats& stats = sync_.stats();
+  out["running"] = running();
+  out["controllers"] = sync_.outputCount();
+  out["pixels"] = sync_.framePixels();
+  out["fps"] = fps_;
+  out["frames"] = stats.frames;
+  out["skipped"] = stats.skipped;
+  out["packets"] = stats.packets;
+  out["sendErrors"] = stats.sendErrors;
+  out["sendUsMean"] = stats.frames > 0 ? sendMicrosTotal_ / stats.frames : 0;
+  out["sendUsMax"] = sendMicrosMax_;
+}
+
+void RealtimeOutput::taskEntry(void* arg) {
+  RealtimeOutput* output = (RealtimeOutput*)arg;
+  output->run();
+  output->task_ = nullptr;
+  vTaskDelete(nullptr);
+}
+
+bool RealtimeOutput::sendPacket(void* context, const char* ip, const uint8_t* packet,
+                                size_t length) {
+  RealtimeOutput* output = (RealtimeOutput*)context;
+  IPAddress addr;
+  if (!addr.fromString(ip)) return false;
+  return output->udp_.beginPacket(addr, DDP_PORT) &&
+         output->udp_.write(packet, length) == length && output->udp_.endPacket();
+}
+
+void RealtimeOutput::run() {
+  sync_.start(micros(), fps_);
+  for (uint32_t frame = 0; !stopRequested_ && millis() - startedAt_ < durationMs_; frame++) {
+    uint32_t wait = sync_.usUntilDue(micros());
+    if (wait > 2000) vTaskDelay(pdMS_TO_TICKS(wait / 1000 - 1));
+    while (!sync_.due(micros())) {
+    }
+
+    render(frame);
+    uint32_t sendStart = micros();
+    sync_.sendFrame(frameBuffer, sync_.framePixels() * 3, sendStart);
+    uint32_t sendMicros = micros() - sendStart;
+    sendMicrosTotal_ += sendMicros;
+    if (sendMicros > sendMicrosMax_) sendMicrosMax_ = sendMicros;
+  }
+}
+
+void RealtimeOutput::render(uint32_t frame) {
+  uint32_t pixels = sync_.framePixels();
+  memset(frameBuffer, 0, pixels * 3);
+
+  // One pass along the strip every two seconds
+  uint32_t head = (uint64_t)frame * pixels / (2 * fps_) % pixels;
+
+  if (pattern_ == REALTIME_CHASE) {
+    uint32_t length = pixels / 10 > 0 ? pixels / 10 : 1;
+    for (uint32_t i = 0; i < length; i++) {
+      memcpy(&frameBuffer[((head + i) % pixels) * 3], color_, 3);
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < pixels; i++) {
+    uint8_t hue = (uint8_t)(((i + pixels - head) % pixels) * 256 / pixels);
+    uint8_t* rgb = &frameBuffer[i * 3];
+    uint8_t rise = (hue % 85) * 3;
+    if (hue < 85) {
+      rgb[0] = 255 - rise;
+      rgb[1] = rise;
+    } else if (hue < 170) {
+      rgb[1] = 255 - rise;
+      rgb[2] = rise;
+    } else {
+      rgb[2] = 255 - rise;
+      rgb[0] = rise;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+// Lumina ESP32 Bridge - Realtime DDP Output
+//
+// Streams a generated pattern to a row of WLED controllers that together
+// make up one strip, started by a `realtimeStart` command and stopped by
+// `realtimeStop` or its duration. Frames go out through DdpFrameSync with
+// the push deferred, so every controller latches a frame at the same
+// moment and the seams between controllers do not tear.
+//
+// The stream runs on its own task so the frame clock does not wait behind
+// Firestore polls and WLED calls on the loop task.
+
+#ifndef REALTIME_OUTPUT_H
+#define REALTIME_OUTPUT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFiUdp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <ddp_sync.h>
+
+#include "config.h"
+
+enum RealtimePattern : uint8_t {
+  REALTIME_CHASE,    // A block of `color` running along the whole strip
+  REALTIME_RAINBOW,  // A rainbow scrolling along the whole strip
+};
+
+class RealtimeOutput {
+ public:
+  RealtimeOutput();
+
+  // Starts a stream described by a realtimeStart payload, replacing any
+  // running one. False with `error` set if the payload is unusable or the
+  // task could not be started.
+  bool start(JsonObjectConst payload, String& error);
+
+  // Stops the stream and waits for its task to exit
+  void stop();
+
+  bool running() const { return task_ != nullptr; }
+
+  // Stats of the current or last stream
+  void report(JsonObject out) const;
+
+ private:
+  static void taskEntry(void* arg);
+  static bool sendPacket(void* context, const char* ip, const uint8_t* packet, size_t length);
+  void run();
+  void render(uint32_t frame);
+
+  WiFiUDP udp_;
+  DdpFrameSync sync_;
+  TaskHandle_t task_;
+  volatile bool stopRequested_;
+
+  RealtimePattern pattern_;
+  uint8_t color_[3];
+  uint16_t fps_;
+  uint32_t durationMs_;
+  uint32_t startedAt_;
+
+  uint32_t sendMicrosTotal_;  // Time from a frame's first packet to its last push
+  uint32_t sendMicrosMax_;
+};
+
+#endif // REALTIME_OUTPUT_H
@@ -0,0 +1,129 @@
+/**
+ * Lumina ESP32 Bridge - Site Bridge Properties
+ *
+ * Everything here is fixed-size: SITE_MAX_PROPERTIES property entries and
+ * a shared pool of SITE_STATUS_BATCH_MAX statuses. A property that does not
+ * fit in the table simply has its commands left pending in Firestore until
+ * an entry frees up.
+ */
+
+#include "site_bridge.h"
+
+#include <string.h>
+
+SiteProperties::SiteProperties() : serveCounter_(0) {
+  memset(properties_, 0, sizeof(properties_));
+  memset(pool_, 0, sizeof(pool_));
+}
+
+int SiteProperties::find(const char* property) const {
+  for (int i = 0; i < SITE_MAX_PROPERTIES; i++) {
+    if (properties_[i].used &&
+        strncmp(properties_[i].key, property, CONTROLLER_KEY_MAX_LEN - 1) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int SiteProperties::track(const char* property) {
+  int existing = find(property);
+  if (existing >= 0) return existing;
+
+  // A free entry, else the idle one served longest ago
+  int victim = -1;
+  for (int i = 0; i < SITE_MAX_PROPERTIES; i++) {
+    const Property& p = properties_[i];
+    if (!p.used) {
+      victim = i;
+      break;
+    }
+    if (p.queued == 0 && p.pooled == 0 &&
+        (victim < 0 || p.lastServed < properties_[victim].lastServed)) {
+      victim = i;
+    }
+  }
+  if (victim < 0) return -1;
+
+  Property& p = properties_[victim];
+  memset(&p, 0, sizeof(p));
+  strncpy(p.key, property, CONTROLLER_KEY_MAX_LEN - 1);
+  p.used = true;
+  return victim;
+}
+
+void SiteProperties::queuedChanged(int property, int delta) {
+  if (property < 0) return;
+  int queued = (int)properties_[property].queued + delta;
+  properties_[property].queued = queued > 0 ? queued : 0;
+}
+
+uint16_t SiteProperties::queued(int property) const {
+  return property < 0 ? 0 : properties_[property].queued;
+}
+
+uint32_t SiteProperties::lastServed(int property) const {
+  return property < 0 ? 0 : properties_[property].lastServed;
+}
+
+void SiteProperties::markServed(int property) {
+  if (property >= 0) properties_[property].lastServed = ++serveCounter_;
+}
+
+bool SiteProperties::addStatus(int property, const char* ref, const char* status,
+                               const char* error, uint32_t nowMs) {
+  if (property < 0) return false;
+
+  for (int i = 0; i < SITE_STATUS_BATCH_MAX; i++) {
+    SiteStatus& entry = pool_[i];
+    if (entry.used) continue;
+
+    strncpy(entry.ref, ref, sizeof(entry.ref) - 1);
+    entry.ref[sizeof(entry.ref) - 1] = '\0';
+    strncpy(entry.status, status, sizeof(entry.status) - 1);
+    entry.status[sizeof(entry.status) - 1] = '\0';
+    strncpy(entry.error, error != nullptr ? error : "", sizeof(entry.error) - 1);
+    entry.error[sizeof(entry.error) - 1] = '\0';
+    entry.property = property;
+    entry.addedAt = nowMs;
+    entry.used = true;
+    properties_[property].pooled++;
+    return true;
+  }
+  return false;
+}
+
+int SiteProperties::takeDue(uint32_t nowMs, SiteStatus* out, int maxCount) {
+  // A nearly full pool flushes whatever is oldest
+  int usedCount = 0;
+  int oldest = -1;
+  for (int i = 0; i < SITE_STATUS_BATCH_MAX; i++) {
+    if (!pool_[i].used) continue;
+    usedCount++;
+    if (oldest < 0 || (int32_t)(pool_[i].addedAt - pool_[oldest].addedAt) < 0) oldest = i;
+  }
+  if (usedCount == 0) return 0;
+
+  int property = -1;
+  if (usedCount >= SITE_STATUS_BATCH_MAX - 1 ||
+      nowMs - pool_[oldest].addedAt >= SITE_STATUS_FLUSH_MS) {
+    property = pool_[oldest].property;
+  } else {
+    for (int i = 0; i < SITE_STATUS_BATCH_MAX; i++) {
+      if (pool_[i].used && properties_[pool_[i].property].queued == 0) {
+        property = pool_[i].property;
+        break;
+      }
+    }
+  }
+  if (property < 0) return 0;
+
+  int count = 0;
+  for (int i = 0; i < SITE_STATUS_BATCH_MAX && count < maxCount; i++) {
+    if (!pool_[i].used || pool_[i].property != property) continue;
+    out[count++] = pool_[i];
+    pool_[i].used = false;
+    properties_[property].pooled--;
+  }
+  return count;
+}
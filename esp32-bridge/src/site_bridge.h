@@ -0,0 +1,73 @@
+// Lumina ESP32 Bridge - Site Bridge Properties
+//
+// In site bridge mode (SITE_ID set) one bridge serves every property at a
+// site that shares a network, such as an apartment complex or HOA common
+// areas. Commands from all of the site's properties arrive through a single
+// collection-group query, so this table keeps the properties from crowding
+// each other out:
+//
+// - Fair dispatch: the next command comes from the property served longest
+//   ago, however many controllers each property has.
+// - Status batching: final statuses wait in a small shared pool and are
+//   written with one commit per property, once that property has nothing
+//   left queued or its oldest status has waited SITE_STATUS_FLUSH_MS.
+
+#ifndef SITE_BRIDGE_H
+#define SITE_BRIDGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+// A finished command's status, waiting to be written
+struct SiteStatus {
+  char ref[COMMAND_REF_MAX_LEN];
+  char status[12];
+  char error[SITE_STATUS_ERROR_MAX_LEN];
+  int8_t property;
+  uint32_t addedAt;
+  bool used;
+};
+
+class SiteProperties {
+ public:
+  SiteProperties();
+
+  // Index of the property's entry, creating one if there is room (a free
+  // entry, or one with nothing queued or pending). -1 if the table is full.
+  int track(const char* property);
+  int find(const char* property) const;
+
+  // Queued command count per property, kept in step with the queues
+  void queuedChanged(int property, int delta);
+  uint16_t queued(int property) const;
+
+  // Order in which properties were last served; 0 = never
+  uint32_t lastServed(int property) const;
+  void markServed(int property);
+
+  // Adds a final status to the pool. False if the pool is full, in which
+  // case the caller writes the status directly.
+  bool addStatus(int property, const char* ref, const char* status, const char* error,
+                 uint32_t nowMs);
+
+  // Moves every pooled status of the first property that is due into
+  // `out` and returns how many there were (0 if nothing is due).
+  int takeDue(uint32_t nowMs, SiteStatus* out, int maxCount);
+
+ private:
+  struct Property {
+    char key[CONTROLLER_KEY_MAX_LEN];
+    uint32_t lastServed;
+    uint16_t queued;
+    uint16_t pooled;
+    bool used;
+  };
+
+  Property properties_[SITE_MAX_PROPERTIES];
+  SiteStatus pool_[SITE_STATUS_BATCH_MAX];
+  uint32_t serveCounter_;
+};
+
+#endif // SITE_BRIDGE_H
@@ -0,0 +1,197 @@
+/**
+ * Lumina ESP32 Bridge - Asynchronous Command Status Writes
+ *
+ * The writer task sleeps on a task notification. submit() and the task
+ * share the ring under one mutex, which is never held across network I/O:
+ * the task copies the oldest job out, releases the lock, then writes.
+ */
+
+#include "status_pipeline.h"
+
+static const uint32_t WRITER_TASK_STACK = 8192;
+static const UBaseType_t WRITER_TASK_PRIORITY = 1;
+static const BaseType_t WRITER_TASK_CORE = 0;  // The loop task runs on core 1
+
+// Connection failures, rate limiting and server errors may pass; anything
+// else (a deleted command, a rejected request) will not
+static bool retryable(int code) {
+  return code <= 0 || code == 429 || code >= 500;
+}
+
+// ============================================================================
+// Job Ring
+// ============================================================================
+
+void StatusJobRing::fill(StatusJob& job, const char* ref, const char* status,
+                         const char* completedAt, const char* error) {
+  strlcpy(job.ref, ref, sizeof(job.ref));
+  strlcpy(job.status, status, sizeof(job.status));
+  strlcpy(job.completedAt, completedAt != nullptr ? completedAt : "", sizeof(job.completedAt));
+  strlcpy(job.error, error != nullptr ? error : "", sizeof(job.error));
+}
+
+StatusJobRing::PushResult StatusJobRing::push(const char* ref, const char* status,
+                                              const char* completedAt, const char* error) {
+  for (size_t n = 0; n < count_; n++) {
+    StatusJob& job = jobs_[(head_ + n) % CAPACITY];
+    if (strcmp(job.ref, ref) == 0) {
+      fill(job, ref, status, completedAt, error);
+      return JOB_REPLACED;
+    }
+  }
+
+  if (count_ == CAPACITY) return JOB_FULL;
+  fill(jobs_[(head_ + count_) % CAPACITY], ref, status, completedAt, error);
+  count_++;
+  return JOB_ADDED;
+}
+
+bool StatusJobRing::waiting(const char* ref) const {
+  for (size_t n = 0; n < count_; n++) {
+    if (strcmp(jobs_[(head_ + n) % CAPACITY].ref, ref) == 0) return true;
+  }
+  return false;
+}
+
+bool StatusJobRing::pop(StatusJob& out) {
+  if (count_ == 0) return false;
+  out = jobs_[head_];
+  head_ = (head_ + 1) % CAPACITY;
+  count_--;
+  return true;
+}
+
+// ============================================================================
+// Pipeline
+// ============================================================================
+
+StatusPipeline::StatusPipeline(StatusWriter& writer)
+    : writer_(writer), lock_(nullptr), task_(nullptr), busy_(false),
+      usageOut_(0), usageIn_(0), usageWrites_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool StatusPipeline::begin() {
+  if (task_ != nullptr) return true;
+
+  lock_ = xSemaphoreCreateMutex();
+  if (lock_ == nullptr) return false;
+
+  if (xTaskCreatePinnedToCore(taskEntry, "statusWriter", WRITER_TASK_STACK, this,
+                              WRITER_TASK_PRIORITY, &task_, WRITER_TASK_CORE) != pdPASS) {
+    task_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void StatusPipeline::submit(const char* ref, const char* status, const char* completedAt,
+                            const char* error) {
+  uint32_t started = 0;
+
+  for (;;) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    StatusJobRing::PushResult result = ring_.push(ref, status, completedAt, error);
+    if (result != StatusJobRing::JOB_FULL) {
+      stats_.submitted++;
+      if (result == StatusJobRing::JOB_REPLACED) stats_.replaced++;
+      if (inPipeline() > stats_.highWater) stats_.highWater = inPipeline();
+      if (started != 0) stats_.blockedMicros += micros() - started;
+      xSemaphoreGive(lock_);
+      break;
+    }
+    if (started == 0) {
+      started = micros();
+      stats_.blocked++;
+    }
+    xSemaphoreGive(lock_);
+    delay(1);
+  }
+
+  xTaskNotifyGive(task_);
+}
+
+bool StatusPipeline::drain(uint32_t timeoutMs) {
+  uint32_t started = millis();
+  for (;;) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool empty = inPipeline() == 0;
+    xSemaphoreGive(lock_);
+
+    if (empty) return true;
+    if (millis() - started >= timeoutMs) return false;
+    delay(1);
+  }
+}
+
+StatusPipelineStats StatusPipeline::stats() {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  StatusPipelineStats copy = stats_;
+  xSemaphoreGive(lock_);
+  return copy;
+}
+
+void StatusPipeline::takeUsage(uint32_t& bytesOut, uint32_t& bytesIn, uint32_t& writes) {
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  bytesOut = usageOut_;
+  bytesIn = usageIn_;
+  writes = usageWrites_;
+  usageOut_ = usageIn_ = usageWrites_ = 0;
+  xSemaphoreGive(lock_);
+}
+
+void StatusPipeline::taskEntry(void* arg) {
+  ((StatusPipeline*)arg)->run();
+}
+
+void StatusPipeline::run() {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for (;;) {
+      xSemaphoreTake(lock_, portMAX_DELAY);
+      bool have = ring_.pop(current_);
+      busy_ = have;
+      xSemaphoreGive(lock_);
+      if (!have) break;
+
+      int code = writeCurrent();
+      for (uint32_t retry = 0; retry < STATUS_PIPELINE_RETRIES && retryable(code); retry++) {
+        delay(STATUS_PIPELINE_RETRY_MS << retry);
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        bool newer = ring_.waiting(current_.ref);
+        if (!newer) stats_.retried++;
+        xSemaphoreGive(lock_);
+        if (newer) break;
+        code = writeCurrent();
+      }
+
+      xSemaphoreTake(lock_, portMAX_DELAY);
+      if (code != 200 && !ring_.waiting(current_.ref)) stats_.dropped++;
+      busy_ = false;
+      xSemaphoreGive(lock_);
+
+      if (code != 200) {
+        DEBUG_PRINT("Pipelined status update failed: ");
+        DEBUG_PRINTLN(code);
+      }
+    }
+  }
+}
+
+int StatusPipeline::writeCurrent() {
+  // Only this task uses the writer, so its stats need no lock until they
+  // are copied out
+  StatusWriteStats before = writer_.stats();
+  int code = writer_.write(current_.ref, current_.status, current_.completedAt,
+                           current_.error, nullptr);
+  const StatusWriteStats& after = writer_.stats();
+
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  usageOut_ += after.bytesOut - before.bytesOut;
+  usageIn_ += after.bytesIn - before.bytesIn;
+  if (code == 200) usageWrites_++;
+  stats_.writer = after;
+  xSemaphoreGive(lock_);
+  return code;
+}
@@ -0,0 +1,131 @@
+// Lumina ESP32 Bridge - Asynchronous Command Status Writes
+//
+// Takes command status PATCHes off the execution path. Statuses go into a
+// small ring and a writer task sends them on its own TLS connection, so the
+// next command's WLED call runs while the previous command's status is
+// still on its way to Firestore.
+//
+// Ordering: the ring is FIFO with a single writer, so one command's
+// statuses reach Firestore in the order they were submitted. A final status
+// replaces the same command's status that is still waiting (normally
+// "executing") in its place, so the writer keeps up with one PATCH per
+// command under load without ever writing an older status last.
+//
+// Synchronous writers, single PATCHes and batch commits alike, call drain()
+// first so their statuses also land after everything submitted before it.
+//
+// A write that fails for a reason that may pass (no connection, 429, 5xx)
+// is retried up to STATUS_PIPELINE_RETRIES times with a doubling delay,
+// before anything behind it is written. A retry is skipped once a newer
+// status for the same command is waiting, since that one will be written.
+
+#ifndef STATUS_PIPELINE_H
+#define STATUS_PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "config.h"
+#include "status_writer.h"
+
+// Longest a synchronous writer waits for the pipeline to empty
+#define STATUS_PIPELINE_DRAIN_MS 30000
+
+// A status waiting for the writer
+struct StatusJob {
+  char ref[COMMAND_REF_MAX_LEN];
+  char status[12];
+  char completedAt[24];
+  char error[STATUS_PIPELINE_ERROR_MAX_LEN];
+};
+
+// Fixed ring of waiting statuses; the pipeline holds its lock around every
+// call
+class StatusJobRing {
+ public:
+  static const size_t CAPACITY = STATUS_PIPELINE_DEPTH > 0 ? STATUS_PIPELINE_DEPTH : 1;
+
+  StatusJobRing() : head_(0), count_(0) {}
+
+  enum PushResult { JOB_ADDED, JOB_REPLACED, JOB_FULL };
+
+  // A status for a command that already has one waiting takes that entry's
+  // place instead of adding a second write
+  PushResult push(const char* ref, const char* status, const char* completedAt,
+                  const char* error);
+
+  // Removes the oldest job into `out`; false if the ring is empty
+  bool pop(StatusJob& out);
+
+  // True if a status for the command is waiting
+  bool waiting(const char* ref) const;
+
+  size_t size() const { return count_; }
+
+ private:
+  static void fill(StatusJob& job, const char* ref, const char* status,
+                   const char* completedAt, const char* error);
+
+  StatusJob jobs_[CAPACITY];
+  size_t head_;
+  size_t count_;
+};
+
+struct StatusPipelineStats {
+  uint32_t submitted;      // Statuses handed to the pipeline
+  uint32_t replaced;       // Waiting statuses overwritten by a later one
+  uint32_t blocked;        // Submits that waited for room
+  uint32_t blockedMicros;  // Time the command loop spent waiting for room
+  uint32_t highWater;      // Most statuses waiting or in flight at once
+  uint32_t retried;        // Writes sent again after a failure
+  uint32_t dropped;        // Writes given up after the last retry
+  StatusWriteStats writer; // The writer task's own connection
+};
+
+class StatusPipeline {
+ public:
+  explicit StatusPipeline(StatusWriter& writer);
+
+  // Creates the lock and starts the writer task. False if either could not
+  // be created; submit() then is not usable.
+  bool begin();
+  bool running() const { return task_ != nullptr; }
+
+  // Queues a status write, waiting while the ring is full. `error` must fit
+  // in STATUS_PIPELINE_ERROR_MAX_LEN (the caller writes longer ones
+  // synchronously).
+  void submit(const char* ref, const char* status, const char* completedAt,
+              const char* error);
+
+  // Waits until every submitted status has been written or `timeoutMs`
+  // passes. True if the pipeline is empty.
+  bool drain(uint32_t timeoutMs);
+
+  StatusPipelineStats stats();
+
+  // Bytes and successful writes since the last call, for the usage meter
+  // (which is only touched from the main loop)
+  void takeUsage(uint32_t& bytesOut, uint32_t& bytesIn, uint32_t& writes);
+
+ private:
+  static void taskEntry(void* arg);
+  void run();
+  int writeCurrent();
+  size_t inPipeline() const { return ring_.size() + (busy_ ? 1 : 0); }
+
+  StatusWriter& writer_;
+  StatusJobRing ring_;
+  StatusJob current_;
+  SemaphoreHandle_t lock_;
+  TaskHandle_t task_;
+  volatile bool busy_;
+
+  StatusPipelineStats stats_;
+  uint32_t usageOut_;
+  uint32_t usageIn_;
+  uint32_t usageWrites_;
+};
+
+#endif // STATUS_PIPELINE_H
@@ -0,0 +1,391 @@
+/**
+ * Lumina ESP32 Bridge - Streaming Command Status Writer
+ *
+ * Request layout (optional parts in brackets):
+ *
+ *   PATCH {pathPrefix}{commandRef}?key=...&mask.fieldPaths=status
+ *         &updateMask.fieldPaths=status[&...=completedAt][&...=error]
+ *         [&...=result] HTTP/1.1
+ *   Host: firestore.googleapis.com
+ *   Content-Type: application/json
+ *   Content-Length: N
+ *
+ *   {"fields":{"status":{"stringValue":"completed"}
+ *    [,"completedAt":{"timestampValue":"..."}][,"error":{"stringValue":"..."}]
+ *    [,"result":{"stringValue":"..."}]}}
+ *
+ * `mask.fieldPaths=status` makes Firestore return only the status field
+ * instead of echoing the whole command document back.
+ *
+ * A batch of status changes goes out as one commit:
+ *
+ *   POST /v1/projects/{id}/databases/(default)/documents:commit?key=... HTTP/1.1
+ *
+ *   {"writes":[{"update":{"name":"projects/{id}/.../users/{commandRef}",
+ *    "fields":{"status":{"stringValue":"queued"}[,"completedAt":...][,"error":...]}},
+ *    "updateMask":{"fieldPaths":["status"[,"completedAt"][,"error"]]},
+ *    "currentDocument":{"exists":true}},...]}
+ */
+
+#include "status_writer.h"
+
+static const uint16_t HTTPS_PORT = 443;
+static const uint32_t RESPONSE_TIMEOUT_MS = 10000;
+
+// Constant request fragments; sizeof - 1 gives their length at compile time
+#define FRAGMENT(name, text) static const char name[] = text
+FRAGMENT(REQUEST_START, "PATCH ");
+FRAGMENT(COMMIT_START, "POST ");
+FRAGMENT(COMMIT_PATH, ":commit?key=");
+FRAGMENT(USERS_PATH, "/users/");
+FRAGMENT(MASK_COMPLETED_AT, "&updateMask.fieldPaths=completedAt");
+FRAGMENT(MASK_ERROR, "&updateMask.fieldPaths=error");
+FRAGMENT(MASK_RESULT, "&updateMask.fieldPaths=result");
+FRAGMENT(HTTP_VERSION, " HTTP/1.1\r\nHost: ");
+FRAGMENT(HEADERS, "\r\nContent-Type: application/json\r\nContent-Length: ");
+FRAGMENT(HEADERS_END, "\r\n\r\n");
+FRAGMENT(BODY_STATUS, "{\"fields\":{\"status\":{\"stringValue\":\"");
+FRAGMENT(BODY_COMPLETED_AT, "\"},\"completedAt\":{\"timestampValue\":\"");
+FRAGMENT(BODY_ERROR, "\"},\"error\":{\"stringValue\":\"");
+FRAGMENT(BODY_RESULT, "\"},\"result\":{\"stringValue\":\"");
+FRAGMENT(BODY_END, "\"}}}");
+FRAGMENT(WRITES_START, "{\"writes\":[");
+FRAGMENT(WRITE_NAME, "{\"update\":{\"name\":\"");
+FRAGMENT(WRITE_STATUS, "\",\"fields\":{\"status\":{\"stringValue\":\"");
+FRAGMENT(WRITE_MASK, "\"}}},\"updateMask\":{\"fieldPaths\":[\"status\"");
+FRAGMENT(WRITE_MASK_COMPLETED_AT, ",\"completedAt\"");
+FRAGMENT(WRITE_MASK_ERROR, ",\"error\"");
+FRAGMENT(WRITE_END, "]},\"currentDocument\":{\"exists\":true}}");
+FRAGMENT(WRITES_SEPARATOR, ",");
+FRAGMENT(WRITES_END, "]}");
+#undef FRAGMENT
+
+#define LEN(fragment) (sizeof(fragment) - 1)
+
+static bool present(const char* text) {
+  return text != nullptr && text[0] != '\0';
+}
+
+size_t jsonEscapedLength(const char* text) {
+  size_t length = 0;
+  for (const char* p = text; *p; p++) {
+    unsigned char c = *p;
+    if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') {
+      length += 2;
+    } else if (c < 0x20) {
+      length += 6;  // \u00XX
+    } else {
+      length += 1;
+    }
+  }
+  return length;
+}
+
+StatusWriter::StatusWriter(Client& client)
+    : client_(client), host_(""), apiKey_(""), buffered_(0), ioError_(false), flushMicros_(0) {
+  pathPrefix_[0] = '\0';
+  query_[0] = '\0';
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+void StatusWriter::begin(const char* host, const char* projectId, const char* apiKey) {
+  host_ = host;
+  apiKey_ = apiKey;
+  snprintf(pathPrefix_, sizeof(pathPrefix_),
+           "/v1/projects/%s/databases/(default)/documents/users/", projectId);
+  snprintf(query_, sizeof(query_),
+           "?key=%s&mask.fieldPaths=status&updateMask.fieldPaths=status", apiKey);
+}
+
+int StatusWriter::write(const char* commandRef, const char* status, const char* completedAt,
+                        const char* error, const char* result) {
+  uint32_t started = micros();
+  if (!startRequest()) return -1;
+
+  bool hasCompletedAt = present(completedAt);
+  bool hasError = present(error);
+  bool hasResult = present(result);
+
+  size_t contentLength = LEN(BODY_STATUS) + strlen(status) + LEN(BODY_END);
+  if (hasCompletedAt) contentLength += LEN(BODY_COMPLETED_AT) + strlen(completedAt);
+  if (hasError) contentLength += LEN(BODY_ERROR) + jsonEscapedLength(error);
+  if (hasResult) contentLength += LEN(BODY_RESULT) + jsonEscapedLength(result);
+
+  // Request line and headers
+  put(REQUEST_START, LEN(REQUEST_START));
+  put(pathPrefix_);
+  put(commandRef);
+  put(query_);
+  if (hasCompletedAt) put(MASK_COMPLETED_AT, LEN(MASK_COMPLETED_AT));
+  if (hasError) put(MASK_ERROR, LEN(MASK_ERROR));
+  if (hasResult) put(MASK_RESULT, LEN(MASK_RESULT));
+  putHeaders(contentLength);
+
+  // Body
+  put(BODY_STATUS, LEN(BODY_STATUS));
+  put(status);
+  if (hasCompletedAt) {
+    put(BODY_COMPLETED_AT, LEN(BODY_COMPLETED_AT));
+    put(completedAt);
+  }
+  if (hasError) {
+    put(BODY_ERROR, LEN(BODY_ERROR));
+    putEscaped(error);
+  }
+  if (hasResult) {
+    put(BODY_RESULT, LEN(BODY_RESULT));
+    putEscaped(result);
+  }
+  put(BODY_END, LEN(BODY_END));
+  return finishRequest(started);
+}
+
+int StatusWriter::commit(const StatusCommitWrite* writes, size_t count,
+                         const char* completedAt) {
+  uint32_t started = micros();
+  if (!startRequest()) return -1;
+
+  // Document names are the path prefix without its leading "/v1/"
+  const char* namePrefix = pathPrefix_ + 4;
+  size_t namePrefixLength = strlen(namePrefix);
+
+  size_t contentLength = LEN(WRITES_START) + LEN(WRITES_END);
+  for (size_t i = 0; i < count; i++) {
+    const StatusCommitWrite& w = writes[i];
+    if (i > 0) contentLength += LEN(WRITES_SEPARATOR);
+    contentLength += LEN(WRITE_NAME) + namePrefixLength + strlen(w.ref) + LEN(WRITE_STATUS) +
+                     strlen(w.status) + LEN(WRITE_MASK) + LEN(WRITE_END);
+    if (strcmp(w.status, "queued") != 0) {
+      contentLength += LEN(BODY_COMPLETED_AT) + strlen(completedAt) + LEN(WRITE_MASK_COMPLETED_AT);
+    }
+    if (present(w.error)) {
+      contentLength += LEN(BODY_ERROR) + jsonEscapedLength(w.error) + LEN(WRITE_MASK_ERROR);
+    }
+  }
+
+  // Request line and headers: the prefix up to "/users/" names the database
+  put(COMMIT_START, LEN(COMMIT_START));
+  put(pathPrefix_, strlen(pathPrefix_) - LEN(USERS_PATH));
+  put(COMMIT_PATH, LEN(COMMIT_PATH));
+  put(apiKey_);
+  putHeaders(contentLength);
+
+  // Body
+  put(WRITES_START, LEN(WRITES_START));
+  for (size_t i = 0; i < count; i++) {
+    const StatusCommitWrite& w = writes[i];
+    bool hasCompletedAt = strcmp(w.status, "queued") != 0;
+    bool hasError = present(w.error);
+
+    if (i > 0) put(WRITES_SEPARATOR, LEN(WRITES_SEPARATOR));
+    put(WRITE_NAME, LEN(WRITE_NAME));
+    put(namePrefix, namePrefixLength);
+    put(w.ref);
+    put(WRITE_STATUS, LEN(WRITE_STATUS));
+    put(w.status);
+    if (hasCompletedAt) {
+      put(BODY_COMPLETED_AT, LEN(BODY_COMPLETED_AT));
+      put(completedAt);
+    }
+    if (hasError) {
+      put(BODY_ERROR, LEN(BODY_ERROR));
+      putEscaped(w.error);
+    }
+    put(WRITE_MASK, LEN(WRITE_MASK));
+    if (hasCompletedAt) put(WRITE_MASK_COMPLETED_AT, LEN(WRITE_MASK_COMPLETED_AT));
+    if (hasError) put(WRITE_MASK_ERROR, LEN(WRITE_MASK_ERROR));
+    put(WRITE_END, LEN(WRITE_END));
+  }
+  put(WRITES_END, LEN(WRITES_END));
+  return finishRequest(started);
+}
+
+bool StatusWriter::startRequest() {
+  buffered_ = 0;
+  ioError_ = false;
+  flushMicros_ = 0;
+
+  // Drop anything an earlier request on this connection left unread
+  while (client_.available() > 0) client_.read();
+
+  if (!client_.connected()) {
+    if (!client_.connect(host_, HTTPS_PORT)) {
+      stats_.failures++;
+      return false;
+    }
+    stats_.connects++;
+  }
+  return true;
+}
+
+void StatusWriter::putHeaders(size_t contentLength) {
+  char lengthText[12];
+  utoa(contentLength, lengthText, 10);
+
+  put(HTTP_VERSION, LEN(HTTP_VERSION));
+  put(host_);
+  put(HEADERS, LEN(HEADERS));
+  put(lengthText);
+  put(HEADERS_END, LEN(HEADERS_END));
+}
+
+int StatusWriter::finishRequest(uint32_t started) {
+  flush();
+
+  uint32_t formatMicros = micros() - started - flushMicros_;
+  stats_.formatMicros += formatMicros;
+  if (formatMicros > stats_.maxFormatMicros) stats_.maxFormatMicros = formatMicros;
+  stats_.writes++;
+
+  int code = ioError_ ? -2 : readResponse();
+  if (code != 200) {
+    stats_.failures++;
+    // Leave no half-read response behind for the next request
+    client_.stop();
+  }
+
+  stats_.totalMicros += micros() - started;
+  return code;
+}
+
+void StatusWriter::put(const char* data, size_t length) {
+  while (length > 0) {
+    size_t n = STATUS_WRITER_BUFFER_SIZE - buffered_;
+    if (n > length) n = length;
+    memcpy(buffer_ + buffered_, data, n);
+    buffered_ += n;
+    stats_.bytesCopied += n;
+    data += n;
+    length -= n;
+    if (buffered_ == STATUS_WRITER_BUFFER_SIZE) flush();
+  }
+}
+
+void StatusWriter::putEscaped(const char* text) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  const char* run = text;
+
+  for (const char* p = text;; p++) {
+    unsigned char c = *p;
+    bool plain = c >= 0x20 && c != '"' && c != '\\';
+    if (plain) continue;
+
+    // Copy the unescaped run in one go, then the escape
+    put(run, p - run);
+    if (c == '\0') break;
+
+    char escape[6] = {'\\', 0, 0, 0, 0, 0};
+    size_t length = 2;
+    switch (c) {
+      case '"': escape[1] = '"'; break;
+      case '\\': escape[1] = '\\'; break;
+      case '\n': escape[1] = 'n'; break;
+      case '\r': escape[1] = 'r'; break;
+      case '\t': escape[1] = 't'; break;
+      default:
+        escape[1] = 'u';
+        escape[2] = '0';
+        escape[3] = '0';
+        escape[4] = HEX_DIGITS[c >> 4];
+        escape[5] = HEX_DIGITS[c & 0x0F];
+        length = 6;
+    }
+    put(escape, length);
+    run = p + 1;
+  }
+}
+
+bool StatusWriter::flush() {
+  if (buffered_ == 0 || ioError_) {
+    buffered_ = 0;
+    return !ioError_;
+  }
+
+  uint32_t started = micros();
+  size_t written = client_.write(buffer_, buffered_);
+  flushMicros_ += micros() - started;
+
+  stats_.bytesOut += written;
+  if (written != buffered_) ioError_ = true;
+  buffered_ = 0;
+  return !ioError_;
+}
+
+// Reads the status line, headers and body (Content-Length or chunked).
+// Returns the HTTP status code, or -3 on timeout or a malformed response.
+int StatusWriter::readResponse() {
+  char line[96];
+  if (!readLine(line, sizeof(line)) || strncmp(line, "HTTP/1.", 7) != 0) return -3;
+  int code = atoi(line + 9);
+
+  long contentLength = -1;
+  bool chunked = false;
+  bool closeAfter = false;
+  for (;;) {
+    if (!readLine(line, sizeof(line))) return -3;
+    if (line[0] == '\0') break;
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      contentLength = atol(line + 15);
+    } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked")) {
+      chunked = true;
+    } else if (strncasecmp(line, "Connection:", 11) == 0 && strstr(line, "close")) {
+      closeAfter = true;
+    }
+  }
+
+  uint32_t deadline = millis() + RESPONSE_TIMEOUT_MS;
+  auto discard = [&](long count) -> bool {
+    while (count > 0) {
+      if (client_.available() > 0) {
+        client_.read();
+        stats_.bytesIn++;
+        count--;
+      } else if (!client_.connected() || (long)(millis() - deadline) > 0) {
+        return false;
+      } else {
+        delay(1);
+      }
+    }
+    return true;
+  };
+
+  if (chunked) {
+    for (;;) {
+      if (!readLine(line, sizeof(line))) return -3;
+      long size = strtol(line, nullptr, 16);
+      if (size == 0) {
+        readLine(line, sizeof(line));  // Blank line after the last chunk
+        break;
+      }
+      if (!discard(size + 2)) return -3;
+    }
+  } else if (contentLength > 0) {
+    if (!discard(contentLength)) return -3;
+  }
+
+  if (closeAfter) client_.stop();
+  return code;
+}
+
+// Reads one CRLF-terminated line without the line ending; long lines are
+// truncated (only the first few characters of any header matter here)
+bool StatusWriter::readLine(char* line, size_t size) {
+  uint32_t deadline = millis() + RESPONSE_TIMEOUT_MS;
+  size_t length = 0;
+
+  for (;;) {
+    if (client_.available() <= 0) {
+      if (!client_.connected() || (long)(millis() - deadline) > 0) return false;
+      delay(1);
+      continue;
+    }
+
+    char c = client_.read();
+    stats_.bytesIn++;
+    if (c == '\n') break;
+    if (c != '\r' && length + 1 < size) line[length++] = c;
+  }
+
+  line[length] = '\0';
+  return true;
+}
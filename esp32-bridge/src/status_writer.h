@@ -0,0 +1,93 @@
+// Lumina ESP32 Bridge - Streaming Command Status Writer
+//
+// Writes command status PATCHes, and batches of them as one commit, to
+// Firestore straight into the TLS socket. The request line, query string
+// and JSON body are stitched together from constant fragments and the
+// commands' own strings, with the Content-Length worked out up front, so a
+// status write builds no JsonDocument, no String body and no concatenated
+// URL. Every byte of the request is copied once, into a small staging
+// buffer that is flushed to the socket when full.
+//
+// The connection is shared with HTTPClient (both talk to the same host), so
+// the writer reads each response to the end to leave the socket reusable.
+
+#ifndef STATUS_WRITER_H
+#define STATUS_WRITER_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define STATUS_WRITER_BUFFER_SIZE 512
+#define STATUS_WRITER_PATH_MAX_LEN 192
+#define STATUS_WRITER_QUERY_MAX_LEN 128
+
+// One status change of a commit; `error` may be null or empty
+struct StatusCommitWrite {
+  const char* ref;
+  const char* status;
+  const char* error;
+};
+
+// Per-request measurements, accumulated since boot
+struct StatusWriteStats {
+  uint32_t writes;         // Requests sent
+  uint32_t failures;       // Non-200 responses, connect or I/O errors
+  uint32_t connects;       // Times the writer had to open the connection
+  uint32_t bytesOut;       // Request bytes, headers included
+  uint32_t bytesIn;        // Response bytes, headers included
+  uint32_t bytesCopied;    // Bytes copied while building requests
+  uint32_t formatMicros;   // CPU time building requests (socket time excluded)
+  uint32_t maxFormatMicros;
+  uint32_t totalMicros;    // Wall time including TLS and the server
+};
+
+class StatusWriter {
+ public:
+  explicit StatusWriter(Client& client);
+
+  // Precomputes the document path prefix and the fixed part of the query
+  void begin(const char* host, const char* projectId, const char* apiKey);
+
+  // PATCHes status (and completedAt, error, result when not null or empty)
+  // on /users/{commandRef}, where commandRef is "{uid}/commands/{commandId}".
+  // Returns the HTTP status code, or a negative value on connection or I/O
+  // errors.
+  int write(const char* commandRef, const char* status, const char* completedAt,
+            const char* error, const char* result);
+
+  // POSTs several status changes as one documents:commit. Every status but
+  // "queued" also sets completedAt; each write requires the document to
+  // exist. Returns as write() does.
+  int commit(const StatusCommitWrite* writes, size_t count, const char* completedAt);
+
+  const StatusWriteStats& stats() const { return stats_; }
+
+ private:
+  bool startRequest();
+  void putHeaders(size_t contentLength);
+  int finishRequest(uint32_t started);
+  void put(const char* data, size_t length);
+  void put(const char* text) { put(text, strlen(text)); }
+  void putEscaped(const char* text);
+  bool flush();
+  int readResponse();
+  bool readLine(char* line, size_t size);
+
+  Client& client_;
+  const char* host_;
+  const char* apiKey_;
+  char pathPrefix_[STATUS_WRITER_PATH_MAX_LEN];
+  char query_[STATUS_WRITER_QUERY_MAX_LEN];
+
+  uint8_t buffer_[STATUS_WRITER_BUFFER_SIZE];
+  size_t buffered_;
+  bool ioError_;
+  uint32_t flushMicros_;
+
+  StatusWriteStats stats_;
+};
+
+// Length of `text` once escaped as a JSON string body (without quotes)
+size_t jsonEscapedLength(const char* text);
+
+#endif // STATUS_WRITER_H
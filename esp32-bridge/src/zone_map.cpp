@@ -0,0 +1,136 @@
+/**
+ * Lumina ESP32 Bridge - Zone Map
+ *
+ * The map is fixed-size (ZONE_MAX zones of ZONE_MAX_CONTROLLERS
+ * controllers, about 3 KB). A new map is parsed into a static scratch copy
+ * first, so one that does not fit is rejected whole rather than half
+ * applied.
+ */
+
+#include "zone_map.h"
+
+ZoneMap::ZoneMap() : zoneCount_(0), version_(0) {
+  memset(zones_, 0, sizeof(zones_));
+}
+
+bool ZoneMap::load(const char* json, String& error) {
+  JsonDocument doc;
+  if (deserializeJson(doc, json)) {
+    error = "Zone map is not valid JSON";
+    return false;
+  }
+  JsonObjectConst zones = doc["zones"];
+  if (zones.isNull()) {
+    error = "Zone map has no zones";
+    return false;
+  }
+
+  static Zone parsed[ZONE_MAX];
+  memset(parsed, 0, sizeof(parsed));
+  int count = 0;
+
+  for (JsonPairConst kv : zones) {
+    if (count >= ZONE_MAX) {
+      error = "Too many zones (max " + String(ZONE_MAX) + ")";
+      return false;
+    }
+    Zone& zone = parsed[count++];
+    if (strlen(kv.key().c_str()) >= sizeof(zone.id)) {
+      error = "Zone ID too long";
+      return false;
+    }
+    strlcpy(zone.id, kv.key().c_str(), sizeof(zone.id));
+
+    for (JsonVariantConst member : kv.value().as<JsonArrayConst>()) {
+      JsonObjectConst entry = member.as<JsonObjectConst>();
+      const char* ip = entry["ip"] | "";
+      if (ip[0] == '\0' || strlen(ip) >= sizeof(zone.targets[0].ip)) {
+        error = "Bad controller IP in zone " + String(zone.id);
+        return false;
+      }
+
+      uint32_t segments = 0;
+      for (JsonVariantConst id : entry["seg"].as<JsonArrayConst>()) {
+        int segment = id | -1;
+        if (segment < 0 || segment > 31) {
+          error = "Bad segment ID in zone " + String(zone.id);
+          return false;
+        }
+        segments |= 1UL << segment;
+      }
+
+      // Merge with an earlier entry for the same controller; the whole
+      // controller covers any set of its segments
+      ZoneTarget* target = nullptr;
+      for (uint8_t i = 0; i < zone.count; i++) {
+        if (strcmp(zone.targets[i].ip, ip) == 0) target = &zone.targets[i];
+      }
+      if (target != nullptr) {
+        target->segments = (target->segments == 0 || segments == 0)
+                               ? 0
+                               : target->segments | segments;
+        continue;
+      }
+
+      if (zone.count >= ZONE_MAX_CONTROLLERS) {
+        error = "Too many controllers in zone " + String(zone.id);
+        return false;
+      }
+      target = &zone.targets[zone.count++];
+      strlcpy(target->ip, ip, sizeof(target->ip));
+      target->segments = segments;
+    }
+  }
+
+  memcpy(zones_, parsed, sizeof(zones_));
+  zoneCount_ = count;
+  version_ = doc["version"] | 0UL;
+  return true;
+}
+
+const ZoneTarget* ZoneMap::targets(const char* zoneId, int& count) const {
+  for (int i = 0; i < zoneCount_; i++) {
+    if (strcmp(zones_[i].id, zoneId) == 0) {
+      count = zones_[i].count;
+      return zones_[i].targets;
+    }
+  }
+  count = 0;
+  return nullptr;
+}
+
+void ZoneMap::buildRequest(JsonObjectConst state, const ZoneTarget& target, String& body) {
+  body = "";
+  if (target.segments == 0) {
+    serializeJson(state, body);
+    return;
+  }
+
+  JsonVariantConst seg = state["seg"];
+  JsonObjectConst fields = seg.is<JsonArrayConst>() ? seg[0].as<JsonObjectConst>()
+                                                    : seg.as<JsonObjectConst>();
+
+  JsonDocument request;
+  for (JsonPairConst kv : state) {
+    const char* key = kv.key().c_str();
+    if (strcmp(key, "seg") == 0 || strcmp(key, "on") == 0 || strcmp(key, "bri") == 0) {
+      continue;
+    }
+    request[key] = kv.value();
+  }
+
+  JsonArray segments = request["seg"].to<JsonArray>();
+  for (int id = 0; id < 32; id++) {
+    if (!(target.segments & (1UL << id))) continue;
+
+    JsonObject segment = segments.add<JsonObject>();
+    for (JsonPairConst kv : fields) {
+      if (strcmp(kv.key().c_str(), "id") != 0) segment[kv.key()] = kv.value();
+    }
+    if (!state["on"].isNull()) segment["on"] = state["on"];
+    if (!state["bri"].isNull()) segment["bri"] = state["bri"];
+    segment["id"] = id;
+  }
+
+  serializeJson(request, body);
+}
@@ -0,0 +1,65 @@
+// Lumina ESP32 Bridge - Zone Map
+//
+// A zone groups controllers, or some segments of them, under one ID. The
+// app sends the whole map in a `syncZones` command; after that a zone
+// command is one small message whatever the zone's size, and the bridge
+// expands it here into one WLED request per controller. Entries for the
+// same controller are merged, so a controller is never sent two requests
+// for one zone command.
+//
+// Map JSON, as sent by the app and kept on flash:
+//
+//   {"version": 17,
+//    "zones": {"patio": [{"ip": "192.168.1.50", "seg": [0, 2]},
+//                        {"ip": "192.168.1.51"}]}}
+//
+// An entry without "seg" covers the whole controller.
+
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+
+// One controller of a zone; segments is a bitmask of WLED segment IDs
+// (0-31), 0 for the whole controller
+struct ZoneTarget {
+  char ip[16];
+  uint32_t segments;
+};
+
+class ZoneMap {
+ public:
+  ZoneMap();
+
+  // Replaces the map. On error the previous map is kept.
+  bool load(const char* json, String& error);
+
+  // Version the app gave the map; 0 until one is loaded
+  uint32_t version() const { return version_; }
+  int zoneCount() const { return zoneCount_; }
+
+  // The zone's controllers, or nullptr if the zone is unknown
+  const ZoneTarget* targets(const char* zoneId, int& count) const;
+
+  // The WLED state body for one controller of a zone. Segment fields (the
+  // "seg" object, or the first entry of a "seg" array) are applied to each
+  // of the target's segments, and so are "on" and "bri", so a zone that
+  // covers part of a controller leaves its other segments alone.
+  static void buildRequest(JsonObjectConst state, const ZoneTarget& target, String& body);
+
+ private:
+  struct Zone {
+    char id[ZONE_ID_MAX_LEN];
+    uint8_t count;
+    ZoneTarget targets[ZONE_MAX_CONTROLLERS];
+  };
+
+  Zone zones_[ZONE_MAX];
+  int zoneCount_;
+  uint32_t version_;
+};
+
+#endif // ZONE_MAP_H
@@ -0,0 +1,28 @@
+/**
+ * Lumina Bridge Common - Kernel Benchmarks on the Host
+ *
+ * Prints the same report a bridge returns for its benchmark command. The
+ * TLS handshake is skipped; the WLED round trip runs if an IP is given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include <ArduinoJson.h>
+#include <kernel_bench.h>
+
+int main(int argc, char** argv) {
+  KernelBenchConfig config = {};
+  config.wledIp = argc > 1 ? argv[1] : "";
+  config.iterations = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000;
+  config.tlsHost = "";
+  config.networkTries = 10;
+
+  JsonDocument report;
+  runKernelBench(config, report.to<JsonObject>());
+  serializeJsonPretty(report, std::cout);
+  std::cout << std::endl;
+  return 0;
+}
@@ -0,0 +1,286 @@
+// Lumina Bridge Common - Per-Controller Command Queues
+//
+// One fixed-capacity ring queue per controller, so a burst of commands for
+// one controller neither blocks the others nor grows memory. All storage is
+// inside the object (declare it as a global and the linker reports its
+// size); nothing is allocated at run time.
+//
+// A state write ("overwritable" command) removes the queued state writes
+// for the same controller whose every field it sets absolutely
+// (field_groups.h): only the latest state matters, so a slider drag queues
+// one command rather than fifty. It then queues ahead of any queued write
+// with a newer version, or is dropped if those already set all its fields.
+// Ordered commands (reads, config writes, bridge operations) and opaque
+// state writes (actions such as "psave", per-LED writes) always queue
+// behind what is already there, and nothing moves across them.
+//
+// The command type is supplied by the bridge. It must have:
+//   char controller[];  // controller key (ID or IP)
+//   uint64_t version;   // 0 = unversioned (arrival order decides)
+//   FieldWrites writes; // fields the command touches and overwrites
+//   bool overwritable;  // true for state writes
+// and, for contains(), a `char id[]`. A transport without command IDs
+// passes CommandWithoutId as the Ids parameter instead.
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "field_groups.h"
+
+enum QueuePushResult : uint8_t {
+  QUEUE_ADDED = 0,  // Queued for the controller
+  QUEUE_REPLACED,   // Queued, and removed one or more state writes it covers
+  QUEUE_COVERED,    // A newer queued state write already covers it
+  QUEUE_FULL,       // Controller queue full, or no free controller slot
+};
+
+struct CommandQueueStats {
+  uint32_t added;       // Commands accepted as new entries
+  uint32_t replaced;    // Queued commands removed by newer state writes
+  uint32_t covered;     // Incoming commands dropped as already covered
+  uint32_t rejected;    // Incoming commands refused because a queue was full
+  uint32_t dispatched;  // Commands handed out by popNext()
+  uint16_t depth;       // Commands queued now, all controllers
+  uint16_t highWater;   // Largest total depth seen
+  uint8_t controllers;  // Controllers with at least one queued command
+};
+
+// How contains() finds a command's ID
+struct CommandIdField {
+  template <typename Command>
+  static const char* idOf(const Command& cmd) { return cmd.id; }
+};
+
+struct CommandWithoutId {
+  template <typename Command>
+  static const char* idOf(const Command&) { return nullptr; }
+};
+
+template <typename Command, size_t Controllers, size_t Depth, typename Ids = CommandIdField>
+class CommandQueues {
+ public:
+  // Total queued commands the object can ever hold
+  static const size_t CAPACITY = Controllers * Depth;
+
+  // Called with each queued command that a push removed
+  typedef void (*ReplacedFn)(const Command& replaced, void* context);
+
+  CommandQueues() { clear(); }
+
+  void clear() {
+    memset(slots_, 0, sizeof(slots_));
+    memset(&stats_, 0, sizeof(stats_));
+    next_ = 0;
+  }
+
+  QueuePushResult push(const Command& cmd, ReplacedFn onReplaced = nullptr,
+                       void* context = nullptr) {
+    Slot* slot = slotFor(cmd.controller);
+    if (slot == nullptr) {
+      stats_.rejected++;
+      return QUEUE_FULL;
+    }
+
+    // State writes may only be reordered or removed within the run after
+    // the last ordered or opaque command; anything earlier must still run
+    // before that command.
+    size_t start = slot->count;
+    while (start > 0 && reorderable(entry(slot, start - 1))) start--;
+
+    size_t at = slot->count;
+    bool replaced = false;
+    if (reorderable(cmd)) {
+      FieldSet newerWrites;
+      newerWrites.clear();
+      for (size_t i = start; i < slot->count; i++) {
+        const Command& queued = entry(slot, i);
+        if (newer(queued, cmd)) newerWrites.add(queued.writes.overwritten);
+      }
+      if (cmd.writes.coveredBy(newerWrites)) {
+        stats_.covered++;
+        return QUEUE_COVERED;
+      }
+
+      size_t i = start;
+      while (i < slot->count) {
+        const Command& queued = entry(slot, i);
+        if (newer(queued, cmd) || !queued.writes.coveredBy(cmd.writes.overwritten)) {
+          i++;
+          continue;
+        }
+        if (onReplaced != nullptr) onReplaced(queued, context);
+        stats_.replaced++;
+        removeAt(slot, i);
+        replaced = true;
+      }
+
+      // Run before newer writes so they keep the fields both set
+      at = slot->count;
+      for (i = start; i < slot->count; i++) {
+        if (newer(entry(slot, i), cmd)) {
+          at = i;
+          break;
+        }
+      }
+    }
+
+    if (slot->count >= Depth) {
+      stats_.rejected++;
+      return QUEUE_FULL;
+    }
+
+    if (slot->count == 0) {
+      strncpy(slot->controller, cmd.controller, sizeof(slot->controller) - 1);
+      slot->controller[sizeof(slot->controller) - 1] = '\0';
+    }
+    insertAt(slot, at, cmd);
+    if (slot->count > slot->highWater) slot->highWater = slot->count;
+
+    stats_.depth++;
+    if (stats_.depth > stats_.highWater) stats_.highWater = stats_.depth;
+    if (replaced) return QUEUE_REPLACED;
+    stats_.added++;
+    return QUEUE_ADDED;
+  }
+
+  // Copies out the head of the next non-empty controller queue, taking
+  // controllers in turn so one busy controller cannot starve the rest.
+  bool popNext(Command& out) {
+    for (size_t n = 0; n < Controllers; n++) {
+      size_t i = (next_ + n) % Controllers;
+      if (slots_[i].count > 0) return popSlot(i, out);
+    }
+    return false;
+  }
+
+  // Head of one controller's queue, or nullptr if it is empty. With
+  // popSlot() this lets a caller apply its own dispatch policy.
+  const Command* peekSlot(size_t i) const {
+    const Slot* slot = &slots_[i];
+    return slot->count > 0 ? &slot->items[slot->head] : nullptr;
+  }
+
+  bool popSlot(size_t i, Command& out) {
+    Slot* slot = &slots_[i];
+    if (slot->count == 0) return false;
+
+    out = slot->items[slot->head];
+    slot->head = (slot->head + 1) % Depth;
+    slot->count--;
+    stats_.depth--;
+    stats_.dispatched++;
+    next_ = (i + 1) % Controllers;
+    return true;
+  }
+
+  // True if a command with this ID is queued
+  bool contains(const char* id) const {
+    if (id == nullptr || id[0] == '\0') return false;
+    for (size_t s = 0; s < Controllers; s++) {
+      const Slot* slot = &slots_[s];
+      for (size_t i = 0; i < slot->count; i++) {
+        const char* queued = Ids::idOf(slot->items[(slot->head + i) % Depth]);
+        if (queued != nullptr && strcmp(queued, id) == 0) return true;
+      }
+    }
+    return false;
+  }
+
+  bool empty() const { return stats_.depth == 0; }
+
+  // Commands the controller's queue can still take; a controller without
+  // one gets a full queue's worth if a slot is free. A caller queueing
+  // several commands at once checks first instead of undoing a partial push.
+  size_t room(const char* controller) const {
+    bool idle = false;
+    for (size_t i = 0; i < Controllers; i++) {
+      const Slot* slot = &slots_[i];
+      bool inUse = slot->count > 0 || slot->controller[0] != '\0';
+      if (inUse && strncmp(slot->controller, controller, sizeof(slot->controller) - 1) == 0) {
+        return Depth - slot->count;
+      }
+      if (slot->count == 0) idle = true;
+    }
+    return idle ? Depth : 0;
+  }
+
+  CommandQueueStats stats() const {
+    CommandQueueStats s = stats_;
+    s.controllers = 0;
+    for (size_t i = 0; i < Controllers; i++) {
+      if (slots_[i].count > 0) s.controllers++;
+    }
+    return s;
+  }
+
+  // Per-controller occupancy. Slot keys stay set after a queue drains so
+  // the high-water mark can still be reported.
+  size_t slotCount() const { return Controllers; }
+  const char* slotController(size_t i) const { return slots_[i].controller; }
+  size_t slotDepth(size_t i) const { return slots_[i].count; }
+  size_t slotHighWater(size_t i) const { return slots_[i].highWater; }
+
+ private:
+  struct Slot {
+    char controller[sizeof(Command::controller)];
+    Command items[Depth];
+    size_t head;
+    size_t count;
+    size_t highWater;
+  };
+
+  // Queued `a` wins over incoming `b` if it is strictly newer. Unversioned
+  // commands are ordered by arrival, so the incoming one wins.
+  static bool newer(const Command& a, const Command& b) {
+    return a.version != 0 && b.version != 0 && a.version > b.version;
+  }
+
+  static bool reorderable(const Command& cmd) { return cmd.overwritable && !cmd.writes.opaque; }
+
+  Command& entry(Slot* slot, size_t i) { return slot->items[(slot->head + i) % Depth]; }
+
+  void insertAt(Slot* slot, size_t i, const Command& cmd) {
+    for (size_t j = slot->count; j > i; j--) entry(slot, j) = entry(slot, j - 1);
+    entry(slot, i) = cmd;
+    slot->count++;
+  }
+
+  void removeAt(Slot* slot, size_t i) {
+    for (; i + 1 < slot->count; i++) entry(slot, i) = entry(slot, i + 1);
+    slot->count--;
+    stats_.depth--;
+  }
+
+  // The controller's slot, else an empty one (preferring slots never used,
+  // so drained controllers keep their high-water marks as long as possible)
+  Slot* slotFor(const char* controller) {
+    Slot* idle = nullptr;
+    for (size_t i = 0; i < Controllers; i++) {
+      Slot* slot = &slots_[i];
+      bool inUse = slot->count > 0 || slot->controller[0] != '\0';
+      if (inUse && strncmp(slot->controller, controller, sizeof(slot->controller) - 1) == 0) {
+        return slot;
+      }
+      if (slot->count == 0 &&
+          (idle == nullptr || (idle->controller[0] != '\0' && slot->controller[0] == '\0'))) {
+        idle = slot;
+      }
+    }
+    if (idle != nullptr) {
+      idle->head = 0;
+      idle->highWater = 0;
+      idle->controller[0] = '\0';
+    }
+    return idle;
+  }
+
+  Slot slots_[Controllers];
+  CommandQueueStats stats_;
+  size_t next_;
+};
+
+#endif // COMMAND_QUEUE_H
@@ -0,0 +1,183 @@
+/**
+ * Lumina Bridge Common - Cooperative Coroutines
+ *
+ * The run list is intrusive (each Coroutine carries its next pointer), so
+ * spawning and finishing never allocate.
+ */
+
+#include "coop.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+#else
+#include <sys/select.h>
+#endif
+
+uint32_t coopNow() {
+#ifdef ARDUINO
+  return millis();
+#else
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void coopSleep(uint32_t ms) {
+#ifdef ARDUINO
+  delay(ms);
+#else
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+#endif
+}
+
+static bool due(uint32_t deadline, uint32_t now) {
+  return (int32_t)(now - deadline) >= 0;
+}
+
+// ============================================================================
+// Coroutine
+// ============================================================================
+
+Coroutine::Coroutine()
+    : line_(0), wait_(CORO_RUNNABLE), timedOut_(false), fd_(-1), wakeAt_(0),
+      next_(nullptr), scheduled_(false) {}
+
+void Coroutine::restart() {
+  line_ = 0;
+  wait_ = CORO_RUNNABLE;
+  timedOut_ = false;
+  fd_ = -1;
+}
+
+// ============================================================================
+// Scheduler
+// ============================================================================
+
+CoopScheduler::CoopScheduler() : head_(nullptr), count_(0), stats_{0, 0, 0} {}
+
+void CoopScheduler::spawn(Coroutine& coroutine) {
+  if (coroutine.scheduled_) return;
+  if (coroutine.done()) coroutine.restart();
+
+  coroutine.scheduled_ = true;
+  coroutine.next_ = head_;
+  head_ = &coroutine;
+  count_++;
+}
+
+bool CoopScheduler::ready(Coroutine& c, uint32_t now, const void* readSet,
+                          const void* writeSet) {
+  switch (c.wait_) {
+    case CORO_RUNNABLE:
+      return true;
+    case CORO_SLEEPING:
+      return due(c.wakeAt_, now);
+    case CORO_READABLE:
+    case CORO_WRITABLE: {
+      const fd_set* set = (const fd_set*)(c.wait_ == CORO_READABLE ? readSet : writeSet);
+      if (c.fd_ >= 0 && FD_ISSET(c.fd_, set)) {
+        c.timedOut_ = false;
+        return true;
+      }
+      if (due(c.wakeAt_, now)) {
+        c.timedOut_ = true;
+        return true;
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+size_t CoopScheduler::runOnce(uint32_t maxWaitMs) {
+  stats_.passes++;
+  uint32_t now = coopNow();
+
+  // Find out whether anything can run now, and otherwise how long to wait
+  fd_set readSet, writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  int maxFd = -1;
+  bool runnable = false;
+  uint32_t waitMs = maxWaitMs;
+
+  for (Coroutine* c = head_; c != nullptr; c = c->next_) {
+    switch (c->wait_) {
+      case CORO_RUNNABLE:
+        runnable = true;
+        break;
+      case CORO_READABLE:
+      case CORO_WRITABLE:
+        // Socket waits also have a deadline
+        if (c->fd_ >= 0) {
+          FD_SET(c->fd_, c->wait_ == CORO_READABLE ? &readSet : &writeSet);
+          if (c->fd_ > maxFd) maxFd = c->fd_;
+        }
+        // Fall through
+      case CORO_SLEEPING:
+        if (due(c->wakeAt_, now)) {
+          runnable = true;
+        } else if (c->wakeAt_ - now < waitMs) {
+          waitMs = c->wakeAt_ - now;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  if (runnable) waitMs = 0;
+
+  if (maxFd >= 0) {
+    struct timeval timeout;
+    timeout.tv_sec = waitMs / 1000;
+    timeout.tv_usec = (waitMs % 1000) * 1000;
+    stats_.selects++;
+    if (select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout) < 0) {
+      // The sets are undefined after an error; fall back to deadlines
+      FD_ZERO(&readSet);
+      FD_ZERO(&writeSet);
+    }
+  } else if (waitMs > 0 && head_ != nullptr) {
+    coopSleep(waitMs);
+  }
+
+  now = coopNow();
+  Coroutine** link = &head_;
+  while (*link != nullptr) {
+    Coroutine* c = *link;
+    if (ready(*c, now, &readSet, &writeSet)) {
+      stats_.resumes++;
+      c->wait_ = c->resume();
+      // A coroutine spawned meanwhile went in at the head, ahead of `c`
+      while (*link != c) link = &(*link)->next_;
+    }
+
+    if (c->done()) {
+      *link = c->next_;
+      c->next_ = nullptr;
+      c->scheduled_ = false;
+      count_--;
+    } else {
+      link = &c->next_;
+    }
+  }
+  return count_;
+}
+
+bool CoopScheduler::runAll(uint32_t timeoutMs) {
+  uint32_t started = coopNow();
+  while (count_ > 0) {
+    uint32_t elapsed = coopNow() - started;
+    if (elapsed >= timeoutMs) return false;
+    runOnce(timeoutMs - elapsed);
+  }
+  return true;
+}
@@ -0,0 +1,173 @@
+// Lumina Bridge Common - Cooperative Coroutines
+//
+// Stackless coroutines that share the calling task's stack. A waiting
+// operation costs only its own object (its members plus a resume point)
+// rather than a FreeRTOS task with its own stack, so many sockets, timers
+// and LED patterns can be in flight from one loop().
+//
+// The Arduino ESP32 toolchain (GCC 8) has no C++20 coroutines, so bodies
+// are protothread-style state machines built from the CORO_* macros:
+//
+//   class Blinker : public Coroutine {
+//     CoroWait resume() override {
+//       CORO_BEGIN();
+//       for (;;) {
+//         digitalWrite(pin_, HIGH);
+//         CORO_SLEEP(50);
+//         digitalWrite(pin_, LOW);
+//         CORO_SLEEP(950);
+//       }
+//       CORO_END();
+//     }
+//   };
+//
+// Rules that come with the technique:
+// - Local variables do not survive a CORO_* wait; keep state in members.
+// - At most one CORO_* macro per source line (the line number is the
+//   resume point), and none inside a nested switch.
+//
+// CoopScheduler resumes coroutines whose wait is over. Socket waits go to
+// one select() across all of them, so with nothing to do the task sleeps
+// in select() instead of spinning.
+
+#ifndef COOP_H
+#define COOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What a coroutine is waiting for when it returns to the scheduler
+enum CoroWait : uint8_t {
+  CORO_RUNNABLE,  // Yielded; resume on the next pass
+  CORO_SLEEPING,  // Resume once wakeAt_ has passed
+  CORO_READABLE,  // Resume when fd_ is readable, or at wakeAt_
+  CORO_WRITABLE,  // Resume when fd_ is writable (connect done), or at wakeAt_
+  CORO_DONE,
+};
+
+// Milliseconds since boot (millis() on the device)
+uint32_t coopNow();
+
+class Coroutine {
+ public:
+  Coroutine();
+  virtual ~Coroutine() {}
+
+  bool done() const { return wait_ == CORO_DONE; }
+
+  // Rewinds to the start so the object can be spawned again
+  void restart();
+
+ protected:
+  // The body; runs until its next CORO_* wait
+  virtual CoroWait resume() = 0;
+
+  // True if the last socket wait ended at its deadline rather than on I/O
+  bool timedOut() const { return timedOut_; }
+
+  uint16_t line_;     // Resume point, managed by the CORO_* macros
+  CoroWait wait_;
+  bool timedOut_;
+  int fd_;
+  uint32_t wakeAt_;
+
+ private:
+  friend class CoopScheduler;
+  Coroutine* next_;
+  bool scheduled_;
+};
+
+#define CORO_BEGIN() \
+  switch (line_) {   \
+    case 0:
+
+#define CORO_END() \
+  }                \
+  line_ = 0;       \
+  return CORO_DONE
+
+// Finishes early, from anywhere in the body
+#define CORO_EXIT()   \
+  do {                \
+    line_ = 0;        \
+    return CORO_DONE; \
+  } while (0)
+
+// Resume on the next scheduler pass
+#define CORO_YIELD()       \
+  do {                     \
+    line_ = __LINE__;      \
+    return CORO_RUNNABLE;  \
+    case __LINE__:;        \
+  } while (0)
+
+#define CORO_SLEEP(ms)                \
+  do {                                \
+    wakeAt_ = coopNow() + (ms);       \
+    line_ = __LINE__;                 \
+    return CORO_SLEEPING;             \
+    case __LINE__:;                   \
+  } while (0)
+
+// Polls `cond` once per scheduler pass
+#define CORO_WAIT_UNTIL(cond)             \
+  do {                                    \
+    line_ = __LINE__;                     \
+    case __LINE__:                        \
+      if (!(cond)) return CORO_RUNNABLE;  \
+  } while (0)
+
+// Waits for a non-blocking socket; check timedOut() afterwards
+#define CORO_WAIT_READABLE(fd, timeoutMs) \
+  do {                                    \
+    fd_ = (fd);                           \
+    wakeAt_ = coopNow() + (timeoutMs);    \
+    line_ = __LINE__;                     \
+    return CORO_READABLE;                 \
+    case __LINE__:;                       \
+  } while (0)
+
+#define CORO_WAIT_WRITABLE(fd, timeoutMs) \
+  do {                                    \
+    fd_ = (fd);                           \
+    wakeAt_ = coopNow() + (timeoutMs);    \
+    line_ = __LINE__;                     \
+    return CORO_WRITABLE;                 \
+    case __LINE__:;                       \
+  } while (0)
+
+struct CoopStats {
+  uint32_t resumes;   // Coroutine bodies entered
+  uint32_t passes;    // runOnce() calls
+  uint32_t selects;   // select() calls made for socket waits
+};
+
+class CoopScheduler {
+ public:
+  CoopScheduler();
+
+  // Adds a coroutine (not owned) to the run list; it is removed once done.
+  // Spawning one that is already scheduled does nothing.
+  void spawn(Coroutine& coroutine);
+
+  // Resumes every coroutine whose wait is over. When none is runnable it
+  // waits up to `maxWaitMs` in select() for socket activity or the next
+  // deadline, whichever comes first. Returns the coroutines still alive.
+  size_t runOnce(uint32_t maxWaitMs = 0);
+
+  // Runs until every coroutine is done or `timeoutMs` passes. True if all
+  // finished.
+  bool runAll(uint32_t timeoutMs);
+
+  size_t alive() const { return count_; }
+  const CoopStats& stats() const { return stats_; }
+
+ private:
+  bool ready(Coroutine& c, uint32_t now, const void* readSet, const void* writeSet);
+
+  Coroutine* head_;
+  size_t count_;
+  CoopStats stats_;
+};
+
+#endif // COOP_H
@@ -0,0 +1,154 @@
+/**
+ * Lumina Bridge Common - Coroutine vs Task Benchmark
+ *
+ * Memory is the drop in free heap while the operations are parked, so it
+ * includes allocator overhead. Switch cost is wall time over many round
+ * trips: two coroutines yielding to each other through the scheduler, and
+ * two tasks handing a notification back and forth.
+ */
+
+#include "coop_bench.h"
+
+#include <new>
+
+#include "coop.h"
+#include "coop_tcp.h"
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#endif
+
+uint64_t benchMicros() {
+#ifdef ESP_PLATFORM
+  return esp_timer_get_time();
+#else
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Yields `rounds` times, one resume per pass
+class BenchYielder : public Coroutine {
+ public:
+  explicit BenchYielder(uint32_t rounds) : rounds_(rounds), count_(0) {}
+
+ protected:
+  CoroWait resume() override {
+    CORO_BEGIN();
+    for (count_ = 0; count_ < rounds_; count_++) {
+      CORO_YIELD();
+    }
+    CORO_END();
+  }
+
+ private:
+  uint32_t rounds_;
+  uint32_t count_;
+};
+
+static uint32_t coroutineSwitchNs(uint32_t rounds) {
+  BenchYielder a(rounds), b(rounds);
+  CoopScheduler scheduler;
+  scheduler.spawn(a);
+  scheduler.spawn(b);
+
+  uint64_t started = benchMicros();
+  while (scheduler.runOnce(0) > 0) {
+  }
+  uint64_t elapsed = benchMicros() - started;
+
+  uint32_t resumes = scheduler.stats().resumes;
+  return resumes > 0 ? (uint32_t)(elapsed * 1000 / resumes) : 0;
+}
+
+#ifdef ESP_PLATFORM
+
+static uint32_t freeHeap() {
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+static void parkedTask(void*) {
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  vTaskDelete(nullptr);
+}
+
+struct PingPong {
+  TaskHandle_t peer;
+  TaskHandle_t caller;
+  uint32_t rounds;
+};
+
+static void pongTask(void* arg) {
+  PingPong* p = (PingPong*)arg;
+  for (uint32_t i = 0; i < p->rounds; i++) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xTaskNotifyGive(p->caller);
+  }
+  vTaskDelete(nullptr);
+}
+
+static uint32_t taskSwitchNs(uint32_t rounds) {
+  PingPong p = {nullptr, xTaskGetCurrentTaskHandle(), rounds};
+  // Same core and priority as the caller, so every hand-off is a switch
+  if (xTaskCreatePinnedToCore(pongTask, "benchPong", 2048, &p, uxTaskPriorityGet(nullptr),
+                              &p.peer, xPortGetCoreID()) != pdPASS) {
+    return 0;
+  }
+
+  uint64_t started = benchMicros();
+  for (uint32_t i = 0; i < rounds; i++) {
+    xTaskNotifyGive(p.peer);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+  uint64_t elapsed = benchMicros() - started;
+  vTaskDelay(1);  // Let the pong task delete itself
+
+  return (uint32_t)(elapsed * 1000 / (2 * (uint64_t)rounds));
+}
+
+#endif
+
+CoopBenchResult runCoopBenchmark(uint16_t operations, uint32_t taskStack, uint32_t rounds) {
+  CoopBenchResult result = {};
+  result.operations = operations;
+  result.taskStack = taskStack;
+  if (operations == 0 || rounds == 0) return result;
+
+#ifdef ESP_PLATFORM
+  uint32_t before = freeHeap();
+  CoopHttpGet* gets = new (std::nothrow) CoopHttpGet[operations];
+  if (gets != nullptr) {
+    result.coroutineBytes = (before - freeHeap()) / operations;
+    delete[] gets;
+  }
+
+  TaskHandle_t* handles = new (std::nothrow) TaskHandle_t[operations];
+  if (handles != nullptr) {
+    before = freeHeap();
+    for (uint16_t i = 0; i < operations; i++) {
+      if (xTaskCreate(parkedTask, "benchPark", taskStack, nullptr, 1, &handles[i]) != pdPASS) {
+        break;
+      }
+      result.tasks++;
+    }
+    if (result.tasks > 0) result.taskBytes = (before - freeHeap()) / result.tasks;
+
+    for (uint16_t i = 0; i < result.tasks; i++) xTaskNotifyGive(handles[i]);
+    vTaskDelay(2);  // Idle task frees the deleted tasks' memory
+    delete[] handles;
+  }
+
+  result.taskSwitchNs = taskSwitchNs(rounds);
+#else
+  result.coroutineBytes = sizeof(CoopHttpGet);
+#endif
+
+  result.coroutineSwitchNs = coroutineSwitchNs(rounds);
+  return result;
+}
@@ -0,0 +1,31 @@
+// Lumina Bridge Common - Coroutine vs Task Benchmark
+//
+// Measures what one concurrent operation costs as a coroutine (a parked
+// CoopHttpGet) and as a FreeRTOS task blocked the way a task-per-connection
+// design would park it, plus the cost of one switch in each model. Run on
+// the device; off the device only the coroutine half is measured.
+
+#ifndef COOP_BENCH_H
+#define COOP_BENCH_H
+
+#include <stdint.h>
+
+struct CoopBenchResult {
+  uint16_t operations;        // Coroutines parked for the memory figure
+  uint16_t tasks;             // Tasks created (fewer than asked if heap ran out)
+  uint32_t taskStack;         // Stack given to each task, bytes
+  uint32_t coroutineBytes;    // Heap per parked coroutine
+  uint32_t taskBytes;         // Heap per parked task (stack and TCB); 0 off the device
+  uint32_t coroutineSwitchNs; // One resume and return through the scheduler
+  uint32_t taskSwitchNs;      // One notify-and-block hand-off between two tasks
+};
+
+// Microsecond clock for the benchmarks (esp_timer on the device)
+uint64_t benchMicros();
+
+// Parks `operations` coroutines and up to `operations` tasks with
+// `taskStack` bytes of stack each, then times `rounds` switches in each
+// model. Everything is freed before returning.
+CoopBenchResult runCoopBenchmark(uint16_t operations, uint32_t taskStack, uint32_t rounds);
+
+#endif // COOP_BENCH_H
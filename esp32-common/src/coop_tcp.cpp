@@ -0,0 +1,161 @@
+/**
+ * Lumina Bridge Common - Non-blocking TCP for Coroutines
+ */
+
+#include "coop_tcp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+// ============================================================================
+// Socket
+// ============================================================================
+
+bool CoopTcp::startConnect(const char* ip, uint16_t port) {
+  close();
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) return false;
+
+  fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd_ < 0) return false;
+
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+  if (connect(fd_, (struct sockaddr*)&addr, sizeof(addr)) == 0) return true;
+  if (errno == EINPROGRESS) return true;
+
+  close();
+  return false;
+}
+
+bool CoopTcp::connectResult() {
+  if (fd_ < 0) return false;
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) != 0) return false;
+  return error == 0;
+}
+
+int CoopTcp::send(const void* data, size_t length) {
+  if (fd_ < 0) return -2;
+  int n = ::send(fd_, data, length, 0);
+  if (n >= 0) return n;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -2;
+}
+
+int CoopTcp::recv(void* buffer, size_t size) {
+  if (fd_ < 0) return -2;
+  int n = ::recv(fd_, buffer, size, 0);
+  if (n > 0) return n;
+  if (n == 0) return -1;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -2;
+}
+
+void CoopTcp::close() {
+  if (fd_ < 0) return;
+  ::close(fd_);
+  fd_ = -1;
+}
+
+// ============================================================================
+// HTTP GET
+// ============================================================================
+
+CoopHttpGet::CoopHttpGet()
+    : requestLen_(0), sent_(0), received_(0), io_(0), status_(0),
+      startedAt_(0), deadline_(0), elapsedMs_(0) {
+  ip_[0] = '\0';
+  request_[0] = '\0';
+  head_[0] = '\0';
+}
+
+void CoopHttpGet::begin(const char* ip, const char* path, uint32_t timeoutMs) {
+  restart();
+  strncpy(ip_, ip, sizeof(ip_) - 1);
+  ip_[sizeof(ip_) - 1] = '\0';
+  int length = snprintf(request_, sizeof(request_),
+                        "GET %.*s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n",
+                        (int)PATH_MAX_LEN, path, ip_);
+  requestLen_ = length < (int)sizeof(request_) ? length : sizeof(request_) - 1;
+  sent_ = 0;
+  received_ = 0;
+  head_[0] = '\0';
+  status_ = 0;
+  elapsedMs_ = 0;
+  deadline_ = timeoutMs;  // Made absolute when the body starts
+}
+
+uint32_t CoopHttpGet::remainingMs() const {
+  int32_t left = (int32_t)(deadline_ - coopNow());
+  return left > 0 ? left : 0;
+}
+
+CoroWait CoopHttpGet::finish(int status) {
+  status_ = status;
+  elapsedMs_ = coopNow() - startedAt_;
+  tcp_.close();
+  CORO_EXIT();
+}
+
+CoroWait CoopHttpGet::resume() {
+  CORO_BEGIN();
+  startedAt_ = coopNow();
+  deadline_ += startedAt_;
+
+  if (!tcp_.startConnect(ip_, 80)) return finish(-1);
+  CORO_WAIT_WRITABLE(tcp_.fd(), remainingMs());
+  if (timedOut()) return finish(-3);
+  if (!tcp_.connectResult()) return finish(-1);
+
+  while (sent_ < requestLen_) {
+    io_ = tcp_.send(request_ + sent_, requestLen_ - sent_);
+    if (io_ < 0) return finish(-2);
+    sent_ += io_;
+    if (sent_ < requestLen_) {
+      CORO_WAIT_WRITABLE(tcp_.fd(), remainingMs());
+      if (timedOut()) return finish(-3);
+    }
+  }
+
+  // Keep the first bytes for the status line, count and drop the rest
+  for (;;) {
+    CORO_WAIT_READABLE(tcp_.fd(), remainingMs());
+    if (timedOut()) return finish(-3);
+
+    io_ = tcp_.recv(buffer_, sizeof(buffer_));
+    if (io_ == -1) break;
+    if (io_ < 0) return finish(-2);
+
+    size_t kept = strlen(head_);
+    if (kept < sizeof(head_) - 1) {
+      size_t n = sizeof(head_) - 1 - kept;
+      if (n > (size_t)io_) n = io_;
+      memcpy(head_ + kept, buffer_, n);
+      head_[kept + n] = '\0';
+    }
+    received_ += io_;
+  }
+
+  if (strncmp(head_, "HTTP/1.", 7) != 0 || strlen(head_) < 12) return finish(-2);
+  return finish(atoi(head_ + 9));
+  CORO_END();
+}
@@ -0,0 +1,75 @@
+// Lumina Bridge Common - Non-blocking TCP for Coroutines
+//
+// A plain (non-TLS) lwIP socket in non-blocking mode, and an HTTP GET built
+// on it that runs as a coroutine. Meant for LAN calls to WLED: any number
+// of them can be in flight from one task, each costing its object (a few
+// hundred bytes) instead of a task stack.
+
+#ifndef COOP_TCP_H
+#define COOP_TCP_H
+
+#include "coop.h"
+
+class CoopTcp {
+ public:
+  CoopTcp() : fd_(-1) {}
+  ~CoopTcp() { close(); }
+
+  // Starts connecting to a dotted IPv4 address. False if the socket could
+  // not be created or the connect failed at once; otherwise wait for the
+  // socket to become writable and check connectResult().
+  bool startConnect(const char* ip, uint16_t port);
+  bool connectResult();
+
+  // Bytes sent or received; 0 if the call would block. recv() returns -1
+  // once the peer has closed, and both return -2 on errors.
+  int send(const void* data, size_t length);
+  int recv(void* buffer, size_t size);
+
+  void close();
+  int fd() const { return fd_; }
+
+ private:
+  int fd_;
+};
+
+// GET http://{ip}{path} with "Connection: close". Reads the status line
+// and discards the body until the controller closes the connection.
+class CoopHttpGet : public Coroutine {
+ public:
+  static const size_t PATH_MAX_LEN = 48;
+
+  CoopHttpGet();
+
+  // Sets up the request; spawn the coroutine afterwards
+  void begin(const char* ip, const char* path, uint32_t timeoutMs);
+
+  // HTTP status code once done; -1 connect failed, -2 I/O error, -3 timeout
+  int status() const { return status_; }
+  uint32_t elapsedMs() const { return elapsedMs_; }
+  uint32_t bytesOut() const { return sent_; }
+  uint32_t bytesIn() const { return received_; }
+
+ protected:
+  CoroWait resume() override;
+
+ private:
+  CoroWait finish(int status);
+  uint32_t remainingMs() const;
+
+  CoopTcp tcp_;
+  char ip_[16];
+  char request_[32 + PATH_MAX_LEN + 16];  // Request line and Host header
+  uint16_t requestLen_;
+  uint16_t sent_;
+  uint32_t received_;
+  char head_[13];                         // "HTTP/1.1 200"
+  uint8_t buffer_[64];
+  int io_;
+  int status_;
+  uint32_t startedAt_;
+  uint32_t deadline_;
+  uint32_t elapsedMs_;
+};
+
+#endif // COOP_TCP_H
@@ -0,0 +1,33 @@
+/**
+ * Lumina Bridge Common - DDP Packets
+ *
+ * Header: flags (version 1, push), sequence (1-15, 0 = unused), data type
+ * (0x0B, RGB 8 bits per channel), destination (1 = default output), data
+ * offset (32-bit big-endian) and data length (16-bit big-endian).
+ */
+
+#include "ddp.h"
+
+#include <string.h>
+
+size_t ddpEncode(uint8_t* out, size_t capacity, const uint8_t* data, uint16_t length,
+                 uint32_t offset, uint8_t sequence, bool push) {
+  if (length > DDP_MAX_DATA_LEN || capacity < (size_t)DDP_HEADER_LEN + length) return 0;
+
+  out[0] = 0x40 | (push ? 0x01 : 0x00);
+  out[1] = sequence & 0x0F;
+  out[2] = 0x0B;
+  out[3] = 0x01;
+  out[4] = offset >> 24;
+  out[5] = offset >> 16;
+  out[6] = offset >> 8;
+  out[7] = offset;
+  out[8] = length >> 8;
+  out[9] = length;
+  if (data != nullptr) {
+    memcpy(out + DDP_HEADER_LEN, data, length);
+  } else {
+    memset(out + DDP_HEADER_LEN, 0, length);
+  }
+  return DDP_HEADER_LEN + length;
+}
@@ -0,0 +1,25 @@
+// Lumina Bridge Common - DDP Packets
+//
+// Distributed Display Protocol, as WLED receives it on UDP port 4048: a
+// 10-byte header and up to 1440 bytes (480 RGB pixels) of pixel data per
+// packet. A frame longer than that is sent as several packets at
+// increasing offsets, with the push flag on the last one only (or on a
+// separate header-only packet, see ddp_sync.h).
+
+#ifndef DDP_H
+#define DDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DDP_PORT 4048
+#define DDP_HEADER_LEN 10
+#define DDP_MAX_DATA_LEN 1440
+
+// Writes one packet carrying `length` bytes of RGB data at byte `offset`
+// of the frame. Returns the packet length, or 0 if it does not fit in
+// `capacity` or `length` exceeds DDP_MAX_DATA_LEN.
+size_t ddpEncode(uint8_t* out, size_t capacity, const uint8_t* data, uint16_t length,
+                 uint32_t offset, uint8_t sequence, bool push);
+
+#endif // DDP_H
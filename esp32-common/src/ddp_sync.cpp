@@ -0,0 +1,121 @@
+/**
+ * Lumina Bridge Common - Frame-Synchronous DDP Output
+ *
+ * Per frame, with deferred push and two controllers of 600 pixels:
+ *
+ *   A  data  offset 0     1440 bytes
+ *   A  data  offset 1440   360 bytes
+ *   B  data  offset 0     1440 bytes
+ *   B  data  offset 1440   360 bytes
+ *   A  push  (header only)
+ *   B  push
+ *
+ * Offsets are within each controller's own strip. All packets of a frame
+ * carry the same sequence number (1-15), so a receiver can tell a push
+ * from a stale frame.
+ */
+
+#include "ddp_sync.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ddp.h"
+
+DdpFrameSync::DdpFrameSync(DdpSendFn send, void* context)
+    : send_(send), context_(context), outputCount_(0), framePixels_(0), deferred_(true),
+      periodUs_(25000), nextFrameUs_(0), sequence_(0) {
+  memset(outputs_, 0, sizeof(outputs_));
+  broadcastIp_[0] = '\0';
+  resetStats();
+}
+
+bool DdpFrameSync::addOutput(const char* ip, uint16_t pixels) {
+  if (outputCount_ >= DDP_SYNC_MAX_OUTPUTS || ip == nullptr || ip[0] == '\0' ||
+      strlen(ip) >= sizeof(outputs_[0].ip) || pixels == 0) {
+    return false;
+  }
+  Output& output = outputs_[outputCount_++];
+  snprintf(output.ip, sizeof(output.ip), "%s", ip);
+  output.pixels = pixels;
+  framePixels_ += pixels;
+  return true;
+}
+
+void DdpFrameSync::clearOutputs() {
+  outputCount_ = 0;
+  framePixels_ = 0;
+}
+
+void DdpFrameSync::setBroadcastPush(const char* ip) {
+  if (ip == nullptr || strlen(ip) >= sizeof(broadcastIp_)) {
+    broadcastIp_[0] = '\0';
+  } else {
+    snprintf(broadcastIp_, sizeof(broadcastIp_), "%s", ip);
+  }
+}
+
+void DdpFrameSync::start(uint32_t nowUs, uint16_t fps) {
+  periodUs_ = 1000000UL / (fps > 0 ? fps : 1);
+  nextFrameUs_ = nowUs;
+}
+
+bool DdpFrameSync::due(uint32_t nowUs) const {
+  return (int32_t)(nowUs - nextFrameUs_) >= 0;
+}
+
+uint32_t DdpFrameSync::usUntilDue(uint32_t nowUs) const {
+  return due(nowUs) ? 0 : nextFrameUs_ - nowUs;
+}
+
+bool DdpFrameSync::sendFrame(const uint8_t* rgb, size_t length, uint32_t nowUs) {
+  static uint8_t packet[DDP_HEADER_LEN + DDP_MAX_DATA_LEN];
+  if (length < framePixels_ * 3) return false;
+  bool ok = true;
+  sequence_ = sequence_ % 15 + 1;
+
+  const uint8_t* slice = rgb;
+  for (uint8_t i = 0; i < outputCount_; i++) {
+    uint32_t bytes = (uint32_t)outputs_[i].pixels * 3;
+    for (uint32_t offset = 0; offset < bytes; offset += DDP_MAX_DATA_LEN) {
+      uint16_t chunk = bytes - offset < DDP_MAX_DATA_LEN ? bytes - offset : DDP_MAX_DATA_LEN;
+      bool last = offset + chunk == bytes;
+      size_t n = ddpEncode(packet, sizeof(packet), slice + offset, chunk, offset, sequence_,
+                           last && !deferred_);
+      ok = send(outputs_[i].ip, packet, n) && ok;
+    }
+    slice += bytes;
+  }
+
+  // Latch every controller together once all data is out
+  if (deferred_) {
+    size_t n = ddpEncode(packet, sizeof(packet), nullptr, 0, 0, sequence_, true);
+    if (broadcastIp_[0] != '\0') {
+      ok = send(broadcastIp_, packet, n) && ok;
+    } else {
+      for (uint8_t i = 0; i < outputCount_; i++) {
+        ok = send(outputs_[i].ip, packet, n) && ok;
+      }
+    }
+  }
+
+  stats_.frames++;
+  nextFrameUs_ += periodUs_;
+  if ((int32_t)(nowUs - nextFrameUs_) >= 0) {
+    uint32_t missed = (nowUs - nextFrameUs_) / periodUs_ + 1;
+    stats_.skipped += missed;
+    nextFrameUs_ += missed * periodUs_;
+  }
+  return ok;
+}
+
+void DdpFrameSync::resetStats() {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool DdpFrameSync::send(const char* ip, const uint8_t* packet, size_t length) {
+  stats_.packets++;
+  if (send_(context_, ip, packet, length)) return true;
+  stats_.sendErrors++;
+  return false;
+}
@@ -0,0 +1,94 @@
+// Lumina Bridge Common - Frame-Synchronous DDP Output
+//
+// Streams frames to a row of WLED controllers that together make up one
+// strip (a roofline split across controllers) so every controller shows a
+// frame at the same moment:
+//
+// - Each controller gets its slice of the frame with the DDP PUSH flag
+//   clear. WLED buffers that data without showing it.
+// - Once every slice is out, a push-only packet to each controller, or one
+//   broadcast, latches the frame everywhere.
+//
+// A plain DDP sender sets PUSH on each controller's last packet instead, so
+// a controller shows its slice as soon as that packet arrives, and the seam
+// to the next controller tears by however long the remaining slices take
+// to send.
+//
+// One frame clock paces all controllers. Packets go out through a
+// callback, so the same code drives WiFiUDP on the bridge and plain sockets
+// in the host simulation (tools/ddp_farm_sim.cpp).
+
+#ifndef DDP_SYNC_H
+#define DDP_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DDP_SYNC_MAX_OUTPUTS 8
+
+// Sends one datagram to `ip` on DDP_PORT; true if the stack accepted it
+typedef bool (*DdpSendFn)(void* context, const char* ip, const uint8_t* packet,
+                          size_t length);
+
+struct DdpSyncStats {
+  uint32_t frames;      // Frames sent
+  uint32_t skipped;     // Frame slots missed because sendFrame() was late
+  uint32_t packets;     // Datagrams sent, pushes included
+  uint32_t sendErrors;  // Datagrams the send callback refused
+};
+
+class DdpFrameSync {
+ public:
+  DdpFrameSync(DdpSendFn send, void* context);
+
+  // Controllers in strip order; each shows the next `pixels` RGB pixels of
+  // the frame. False if the list is full or the IP does not fit.
+  bool addOutput(const char* ip, uint16_t pixels);
+  void clearOutputs();
+  uint8_t outputCount() const { return outputCount_; }
+  uint32_t framePixels() const { return framePixels_; }
+
+  // Latch with one push to a broadcast address (e.g. "192.168.1.255")
+  // instead of one per controller; nullptr or "" goes back to unicast
+  void setBroadcastPush(const char* ip);
+
+  // false: PUSH on each controller's last data packet, like a plain DDP
+  // sender (for comparison)
+  void setDeferredPush(bool deferred) { deferred_ = deferred; }
+
+  // Frame clock: the first frame is due at `nowUs`, then one every
+  // 1000000 / fps microseconds
+  void start(uint32_t nowUs, uint16_t fps);
+  bool due(uint32_t nowUs) const;
+  uint32_t usUntilDue(uint32_t nowUs) const;
+
+  // Sends one frame of framePixels() * 3 bytes and advances the clock,
+  // skipping any slots already missed. False if a datagram was refused.
+  bool sendFrame(const uint8_t* rgb, size_t length, uint32_t nowUs);
+
+  const DdpSyncStats& stats() const { return stats_; }
+  void resetStats();
+
+ private:
+  struct Output {
+    char ip[16];
+    uint16_t pixels;
+  };
+
+  bool send(const char* ip, const uint8_t* packet, size_t length);
+
+  DdpSendFn send_;
+  void* context_;
+  Output outputs_[DDP_SYNC_MAX_OUTPUTS];
+  uint8_t outputCount_;
+  uint32_t framePixels_;
+  char broadcastIp_[16];
+  bool deferred_;
+
+  uint32_t periodUs_;
+  uint32_t nextFrameUs_;
+  uint8_t sequence_;
+  DdpSyncStats stats_;
+};
+
+#endif // DDP_SYNC_H
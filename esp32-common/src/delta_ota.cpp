@@ -0,0 +1,298 @@
+/**
+ * Lumina Bridge Common - Delta OTA Updates
+ *
+ * Pipeline: HTTPS stream -> tinfl (ESP32 ROM) -> DeltaPatcher -> 4 KB write
+ * buffer -> esp_ota_write, hashing the new image on the way through.
+ *
+ * The header signature is checked before anything is written. The TLS
+ * certificate is not checked (the bridge has no CA store), so the
+ * signature is what makes a delta trusted, and the image is only made
+ * bootable once its hash matches the signed one.
+ */
+
+#ifdef ESP_PLATFORM
+
+#include "delta_ota.h"
+
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <sodium.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32C3
+#include "esp32c3/rom/miniz.h"
+#else
+#include "esp32/rom/miniz.h"
+#endif
+
+#include "delta_patch.h"
+
+static const size_t OTA_WRITE_BUFFER = 4096;
+static const size_t OTA_READ_BUFFER = 1024;
+static const uint32_t OTA_STALL_TIMEOUT_MS = 15000;
+
+namespace {
+
+struct OtaContext {
+  const esp_partition_t* source;
+  esp_ota_handle_t handle;
+  mbedtls_sha256_context sha;
+  uint8_t* buffer;
+  size_t buffered;
+};
+
+bool readSource(void* context, uint32_t offset, uint8_t* buffer, size_t length) {
+  OtaContext* ctx = (OtaContext*)context;
+  return esp_partition_read(ctx->source, offset, buffer, length) == ESP_OK;
+}
+
+bool flushTarget(OtaContext* ctx) {
+  if (ctx->buffered == 0) return true;
+  bool ok = esp_ota_write(ctx->handle, ctx->buffer, ctx->buffered) == ESP_OK;
+  ctx->buffered = 0;
+  return ok;
+}
+
+bool writeTarget(void* context, const uint8_t* data, size_t length) {
+  OtaContext* ctx = (OtaContext*)context;
+  mbedtls_sha256_update(&ctx->sha, data, length);
+
+  while (length > 0) {
+    size_t n = OTA_WRITE_BUFFER - ctx->buffered;
+    if (n > length) n = length;
+    memcpy(ctx->buffer + ctx->buffered, data, n);
+    ctx->buffered += n;
+    data += n;
+    length -= n;
+    if (ctx->buffered == OTA_WRITE_BUFFER && !flushTarget(ctx)) return false;
+  }
+  return true;
+}
+
+// SHA-256 of the first `length` bytes of the running image
+bool sourceMatches(const esp_partition_t* source, uint32_t length, const uint8_t* expected,
+                   uint8_t* scratch) {
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+
+  for (uint32_t offset = 0; offset < length; offset += OTA_WRITE_BUFFER) {
+    size_t n = length - offset < OTA_WRITE_BUFFER ? length - offset : OTA_WRITE_BUFFER;
+    if (esp_partition_read(source, offset, scratch, n) != ESP_OK) {
+      mbedtls_sha256_free(&sha);
+      return false;
+    }
+    mbedtls_sha256_update(&sha, scratch, n);
+  }
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  return memcmp(digest, expected, 32) == 0;
+}
+
+// Reads up to `length` bytes, waiting while the connection stalls
+int readStream(WiFiClient* stream, uint8_t* buffer, size_t length) {
+  unsigned long start = millis();
+  while (stream->connected() || stream->available()) {
+    int available = stream->available();
+    if (available > 0) {
+      return stream->read(buffer, (size_t)available < length ? available : length);
+    }
+    if (millis() - start > OTA_STALL_TIMEOUT_MS) break;
+    delay(2);
+  }
+  return -1;
+}
+
+bool keyConfigured(const uint8_t* publicKey) {
+  for (int i = 0; i < 32; i++) {
+    if (publicKey[i] != 0) return true;
+  }
+  return false;
+}
+
+DeltaOtaResult fail(DeltaOtaResult& result, const char* error) {
+  result.ok = false;
+  result.error = error;
+  return result;
+}
+
+}  // namespace
+
+DeltaOtaResult runDeltaOta(const String& url, const uint8_t* publicKey) {
+  DeltaOtaResult result = {false, "", 0, 0, 0};
+  unsigned long started = millis();
+
+  if (publicKey == nullptr || !keyConfigured(publicKey)) {
+    return fail(result, "No update signing key in this firmware");
+  }
+  if (!url.startsWith("https://")) {
+    return fail(result, "Update URL must be https://");
+  }
+  if (sodium_init() < 0) {
+    return fail(result, "Signature check unavailable");
+  }
+
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+  if (running == nullptr || target == nullptr) {
+    return fail(result, "No OTA partition (check the partition table)");
+  }
+
+  WiFiClientSecure secure;
+  secure.setInsecure();
+  HTTPClient http;
+  http.begin(secure, url);
+
+  int httpCode = http.GET();
+  if (httpCode != 200) {
+    http.end();
+    return fail(result, "Download failed");
+  }
+  WiFiClient* stream = http.getStreamPtr();
+
+  // Header and its signature
+  uint8_t headerBytes[DELTA_HEADER_SIZE + DELTA_SIGNATURE_SIZE];
+  size_t have = 0;
+  while (have < sizeof(headerBytes)) {
+    int n = readStream(stream, headerBytes + have, sizeof(headerBytes) - have);
+    if (n <= 0) break;
+    have += n;
+  }
+  result.bytesDownloaded = have;
+
+  DeltaHeader header;
+  if (have < sizeof(headerBytes) || !parseDeltaHeader(headerBytes, have, header)) {
+    http.end();
+    return fail(result, "Not a delta file");
+  }
+  if (crypto_sign_ed25519_verify_detached(headerBytes + DELTA_HEADER_SIZE, headerBytes,
+                                          DELTA_HEADER_SIZE, publicKey) != 0) {
+    http.end();
+    return fail(result, "Delta signature not valid");
+  }
+  if (header.sourceSize > running->size || header.targetSize > target->size) {
+    http.end();
+    return fail(result, "Image does not fit the partition");
+  }
+
+  OtaContext ctx;
+  ctx.source = running;
+  ctx.buffered = 0;
+  ctx.buffer = (uint8_t*)malloc(OTA_WRITE_BUFFER);
+  uint8_t* input = (uint8_t*)malloc(OTA_READ_BUFFER);
+  tinfl_decompressor* inflator = nullptr;
+  uint8_t* dictionary = nullptr;
+  if (header.flags & DELTA_FLAG_ZLIB) {
+    inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    dictionary = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  }
+
+  auto cleanup = [&]() {
+    free(ctx.buffer);
+    free(input);
+    free(inflator);
+    free(dictionary);
+    http.end();
+  };
+
+  if (ctx.buffer == nullptr || input == nullptr ||
+      ((header.flags & DELTA_FLAG_ZLIB) && (inflator == nullptr || dictionary == nullptr))) {
+    cleanup();
+    return fail(result, "Out of memory");
+  }
+
+  if (header.sourceSize > 0 &&
+      !sourceMatches(running, header.sourceSize, header.sourceSha256, ctx.buffer)) {
+    cleanup();
+    return fail(result, "Delta was not built from the running firmware");
+  }
+
+  if (esp_ota_begin(target, header.targetSize, &ctx.handle) != ESP_OK) {
+    cleanup();
+    return fail(result, "esp_ota_begin failed");
+  }
+
+  mbedtls_sha256_init(&ctx.sha);
+  mbedtls_sha256_starts(&ctx.sha, 0);
+
+  DeltaPatcher patcher(header, readSource, writeTarget, &ctx);
+  DeltaPatcher::Status status = DeltaPatcher::PATCH_OK;
+  size_t dictOffset = 0;
+  bool inflateError = false;
+  bool streamDone = false;
+
+  if (inflator != nullptr) tinfl_init(inflator);
+
+  while (status == DeltaPatcher::PATCH_OK && !streamDone && !inflateError) {
+    int n = readStream(stream, input, OTA_READ_BUFFER);
+    if (n <= 0) break;
+    result.bytesDownloaded += n;
+
+    if (inflator == nullptr) {
+      status = patcher.feed(input, n);
+      continue;
+    }
+
+    const uint8_t* in = input;
+    size_t inAvailable = n;
+    for (;;) {
+      size_t inBytes = inAvailable;
+      size_t outBytes = TINFL_LZ_DICT_SIZE - dictOffset;
+      tinfl_status inflated = tinfl_decompress(
+          inflator, in, &inBytes, dictionary, dictionary + dictOffset, &outBytes,
+          TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+      in += inBytes;
+      inAvailable -= inBytes;
+
+      if (outBytes > 0) {
+        status = patcher.feed(dictionary + dictOffset, outBytes);
+        dictOffset = (dictOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        if (status != DeltaPatcher::PATCH_OK) break;
+      }
+
+      if (inflated == TINFL_STATUS_DONE) {
+        streamDone = true;
+        break;
+      }
+      if (inflated < 0) {
+        inflateError = true;
+        break;
+      }
+      if (inflated == TINFL_STATUS_NEEDS_MORE_INPUT && inAvailable == 0) break;
+    }
+  }
+
+  bool written = status == DeltaPatcher::PATCH_DONE && flushTarget(&ctx);
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&ctx.sha, digest);
+  mbedtls_sha256_free(&ctx.sha);
+  result.bytesWritten = patcher.bytesWritten();
+  cleanup();
+
+  if (!written) {
+    esp_ota_abort(ctx.handle);
+    if (inflateError) return fail(result, "Corrupt delta stream");
+    if (status == DeltaPatcher::PATCH_OK) return fail(result, "Download interrupted");
+    return fail(result, DeltaPatcher::statusName(status));
+  }
+  // The hash the signature vouches for; only then may the image boot
+  if (memcmp(digest, header.targetSha256, 32) != 0) {
+    esp_ota_abort(ctx.handle);
+    return fail(result, "New image hash mismatch");
+  }
+  if (esp_ota_end(ctx.handle) != ESP_OK || esp_ota_set_boot_partition(target) != ESP_OK) {
+    return fail(result, "Could not activate new image");
+  }
+
+  result.ok = true;
+  result.elapsedMs = millis() - started;
+  return result;
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,33 @@
+// Lumina Bridge Common - Delta OTA Updates
+//
+// Updates the bridge firmware from a compressed binary delta against the
+// running image instead of a full image. The delta is streamed over HTTPS
+// through the ROM inflater and the delta patcher straight into the inactive
+// OTA partition, so RAM use is bounded (about 48 KB, freed afterwards) no
+// matter how large the image is. Deltas are built and signed with
+// esp32-common/tools/make_delta.py; the bridge takes only deltas signed
+// with the Ed25519 key whose public half is compiled into it, fetched over
+// HTTPS.
+
+#ifndef DELTA_OTA_H
+#define DELTA_OTA_H
+
+#include <Arduino.h>
+
+struct DeltaOtaResult {
+  bool ok;
+  String error;
+  uint32_t bytesDownloaded;  // Delta bytes transferred, header included
+  uint32_t bytesWritten;     // New image size
+  uint32_t elapsedMs;        // Download, patch and verify
+};
+
+// Downloads the delta at `url` (https:// only), checks its header is
+// signed by `publicKey` (32 bytes, Ed25519) and that it was built against
+// the running image, patches the new image into the next OTA partition,
+// verifies its SHA-256 against the signed header and makes it the boot
+// partition. The caller reports the result and restarts; nothing changes
+// if any step fails. An all-zero key refuses every update.
+DeltaOtaResult runDeltaOta(const String& url, const uint8_t* publicKey);
+
+#endif // DELTA_OTA_H
@@ -0,0 +1,167 @@
+/**
+ * Lumina Bridge Common - Streaming Delta Patcher
+ *
+ * A small state machine over the op stream. RAM use is the object itself
+ * (about 350 bytes); COPY and ADD read the source in CHUNK_SIZE pieces.
+ */
+
+#include "delta_patch.h"
+
+#include <string.h>
+
+static const uint8_t OP_END = 0x00;
+static const uint8_t OP_COPY = 0x01;
+static const uint8_t OP_ADD = 0x02;
+static const uint8_t OP_INSERT = 0x03;
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool parseDeltaHeader(const uint8_t* data, size_t length, DeltaHeader& header) {
+  if (length < DELTA_HEADER_SIZE) return false;
+  if (memcmp(data, "LDLT", 4) != 0) return false;
+
+  header.version = data[4];
+  header.flags = data[5];
+  if (header.version != DELTA_FORMAT_VERSION) return false;
+
+  header.sourceSize = readU32(data + 8);
+  header.targetSize = readU32(data + 12);
+  memcpy(header.sourceSha256, data + 16, 32);
+  memcpy(header.targetSha256, data + 48, 32);
+  return true;
+}
+
+DeltaPatcher::DeltaPatcher(const DeltaHeader& header, ReadSourceFn readSource,
+                           WriteTargetFn writeTarget, void* context)
+    : header_(header),
+      readSource_(readSource),
+      writeTarget_(writeTarget),
+      context_(context),
+      phase_(READ_OP),
+      status_(PATCH_OK),
+      op_(0),
+      argsNeeded_(0),
+      argsHave_(0),
+      srcOffset_(0),
+      remaining_(0),
+      written_(0) {}
+
+const char* DeltaPatcher::statusName(Status status) {
+  switch (status) {
+    case PATCH_OK: return "ok";
+    case PATCH_DONE: return "done";
+    case PATCH_BAD_OP: return "bad op";
+    case PATCH_OUT_OF_RANGE: return "out of range";
+    case PATCH_IO_ERROR: return "io error";
+  }
+  return "unknown";
+}
+
+DeltaPatcher::Status DeltaPatcher::feed(const uint8_t* data, size_t length) {
+  size_t pos = 0;
+
+  while (status_ == PATCH_OK && pos < length) {
+    switch (phase_) {
+      case READ_OP:
+        op_ = data[pos++];
+        argsHave_ = 0;
+        if (op_ == OP_END) {
+          status_ = written_ == header_.targetSize ? PATCH_DONE : PATCH_OUT_OF_RANGE;
+        } else if (op_ == OP_COPY || op_ == OP_ADD) {
+          argsNeeded_ = 8;
+          phase_ = READ_ARGS;
+        } else if (op_ == OP_INSERT) {
+          argsNeeded_ = 4;
+          phase_ = READ_ARGS;
+        } else {
+          status_ = PATCH_BAD_OP;
+        }
+        break;
+
+      case READ_ARGS:
+        while (argsHave_ < argsNeeded_ && pos < length) {
+          args_[argsHave_++] = data[pos++];
+        }
+        if (argsHave_ == argsNeeded_) {
+          status_ = startOp();
+        }
+        break;
+
+      case STREAM_INSERT: {
+        size_t n = length - pos;
+        if (n > remaining_) n = remaining_;
+        status_ = emit(data + pos, n);
+        pos += n;
+        remaining_ -= n;
+        if (remaining_ == 0) phase_ = READ_OP;
+        break;
+      }
+
+      case STREAM_ADD: {
+        size_t n = length - pos;
+        if (n > remaining_) n = remaining_;
+        if (n > CHUNK_SIZE) n = CHUNK_SIZE;
+        if (!readSource_(context_, srcOffset_, chunk_, n)) {
+          status_ = PATCH_IO_ERROR;
+          break;
+        }
+        for (size_t i = 0; i < n; i++) {
+          chunk_[i] = (uint8_t)(chunk_[i] + data[pos + i]);
+        }
+        status_ = emit(chunk_, n);
+        pos += n;
+        srcOffset_ += n;
+        remaining_ -= n;
+        if (remaining_ == 0) phase_ = READ_OP;
+        break;
+      }
+    }
+  }
+
+  return status_;
+}
+
+DeltaPatcher::Status DeltaPatcher::startOp() {
+  if (op_ == OP_INSERT) {
+    remaining_ = readU32(args_);
+    if (remaining_ > header_.targetSize - written_) return PATCH_OUT_OF_RANGE;
+    phase_ = remaining_ > 0 ? STREAM_INSERT : READ_OP;
+    return PATCH_OK;
+  }
+
+  srcOffset_ = readU32(args_);
+  remaining_ = readU32(args_ + 4);
+  if (srcOffset_ > header_.sourceSize || remaining_ > header_.sourceSize - srcOffset_ ||
+      remaining_ > header_.targetSize - written_) {
+    return PATCH_OUT_OF_RANGE;
+  }
+
+  if (op_ == OP_COPY) {
+    phase_ = READ_OP;
+    return copyFromSource(srcOffset_, remaining_);
+  }
+
+  phase_ = remaining_ > 0 ? STREAM_ADD : READ_OP;
+  return PATCH_OK;
+}
+
+DeltaPatcher::Status DeltaPatcher::copyFromSource(uint32_t offset, uint32_t length) {
+  while (length > 0) {
+    size_t n = length > CHUNK_SIZE ? CHUNK_SIZE : length;
+    if (!readSource_(context_, offset, chunk_, n)) return PATCH_IO_ERROR;
+    Status status = emit(chunk_, n);
+    if (status != PATCH_OK) return status;
+    offset += n;
+    length -= n;
+  }
+  return PATCH_OK;
+}
+
+DeltaPatcher::Status DeltaPatcher::emit(const uint8_t* data, size_t length) {
+  if (length == 0) return PATCH_OK;
+  if (!writeTarget_(context_, data, length)) return PATCH_IO_ERROR;
+  written_ += length;
+  return PATCH_OK;
+}
@@ -0,0 +1,106 @@
+// Lumina Bridge Common - Streaming Delta Patcher
+//
+// Applies a firmware delta to produce a new image, one buffer at a time,
+// with a fixed amount of RAM regardless of image size. The caller supplies
+// the decompressed op stream in arbitrary pieces; the patcher reads the
+// running image through `readSource` and emits the new image in order
+// through `writeTarget`.
+//
+// Delta file layout (little-endian), produced by tools/make_delta.py:
+//
+//   Header (DELTA_HEADER_SIZE bytes, never compressed)
+//     "LDLT"              magic
+//     u8  version         DELTA_FORMAT_VERSION
+//     u8  flags           DELTA_FLAG_ZLIB if the op stream is zlib-compressed
+//     u16 reserved
+//     u32 sourceSize      bytes of the running image the delta was made from
+//     u32 targetSize      bytes of the new image
+//     u8  sourceSha256[32]
+//     u8  targetSha256[32]
+//
+//   Signature (DELTA_SIGNATURE_SIZE bytes)
+//     Ed25519 signature of the header bytes. The header carries the target
+//     image's hash, so the signature vouches for the image it produces.
+//
+//   Op stream
+//     0x01 COPY    u32 srcOffset, u32 length
+//     0x02 ADD     u32 srcOffset, u32 length, length bytes added to source
+//     0x03 INSERT  u32 length, length literal bytes
+//     0x00 END
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DELTA_HEADER_SIZE 80
+#define DELTA_SIGNATURE_SIZE 64
+#define DELTA_FORMAT_VERSION 2
+#define DELTA_FLAG_ZLIB 0x01
+
+struct DeltaHeader {
+  uint8_t version;
+  uint8_t flags;
+  uint32_t sourceSize;
+  uint32_t targetSize;
+  uint8_t sourceSha256[32];
+  uint8_t targetSha256[32];
+};
+
+// Parses the fixed header. Returns false on a bad magic or version.
+bool parseDeltaHeader(const uint8_t* data, size_t length, DeltaHeader& header);
+
+class DeltaPatcher {
+ public:
+  // Read `length` bytes of the running image at `offset` into `buffer`
+  typedef bool (*ReadSourceFn)(void* context, uint32_t offset, uint8_t* buffer, size_t length);
+  // Append `length` bytes to the new image
+  typedef bool (*WriteTargetFn)(void* context, const uint8_t* data, size_t length);
+
+  enum Status {
+    PATCH_OK = 0,       // Needs more input
+    PATCH_DONE,         // END op reached
+    PATCH_BAD_OP,       // Unknown op code
+    PATCH_OUT_OF_RANGE, // Source or target bounds exceeded
+    PATCH_IO_ERROR,     // readSource or writeTarget failed
+  };
+
+  DeltaPatcher(const DeltaHeader& header, ReadSourceFn readSource,
+               WriteTargetFn writeTarget, void* context);
+
+  // Feed the next piece of the (decompressed) op stream
+  Status feed(const uint8_t* data, size_t length);
+
+  Status status() const { return status_; }
+  uint32_t bytesWritten() const { return written_; }
+
+  static const char* statusName(Status status);
+
+ private:
+  enum Phase { READ_OP, READ_ARGS, STREAM_ADD, STREAM_INSERT };
+
+  Status startOp();
+  Status copyFromSource(uint32_t offset, uint32_t length);
+  Status emit(const uint8_t* data, size_t length);
+
+  static const size_t CHUNK_SIZE = 256;
+
+  DeltaHeader header_;
+  ReadSourceFn readSource_;
+  WriteTargetFn writeTarget_;
+  void* context_;
+
+  Phase phase_;
+  Status status_;
+  uint8_t op_;
+  uint8_t args_[8];
+  uint8_t argsNeeded_;
+  uint8_t argsHave_;
+  uint32_t srcOffset_;
+  uint32_t remaining_;
+  uint32_t written_;
+  uint8_t chunk_[CHUNK_SIZE];
+};
+
+#endif // DELTA_PATCH_H
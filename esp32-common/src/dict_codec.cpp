@@ -0,0 +1,63 @@
+/**
+ * Lumina Bridge Common - Dictionary Payload Codec
+ *
+ * The length in the header is checked against what the block decodes to,
+ * so a truncated frame is refused rather than handed on as partial JSON.
+ */
+
+#include "dict_codec.h"
+
+const uint8_t* dictData(uint8_t version, size_t& length) {
+  switch (version) {
+    case 1:
+      length = WLED_DICT_V1_LEN;
+      return WLED_DICT_V1;
+    default:
+      length = 0;
+      return nullptr;
+  }
+}
+
+size_t dictDecode(const uint8_t* frame, size_t length, uint8_t* out, size_t size) {
+  if (!dictFramed(frame, length)) return 0;
+  size_t dictLength;
+  const uint8_t* dict = dictData(dictFrameVersion(frame), dictLength);
+  if (dict == nullptr) return 0;
+
+  size_t expected = frame[2] | (frame[3] << 8);
+  if (expected == 0 || expected > size) return 0;
+  size_t decoded = lz4DecompressDict(dict, dictLength, frame + DICT_FRAME_HEADER,
+                                     length - DICT_FRAME_HEADER, out, expected);
+  return decoded == expected ? decoded : 0;
+}
+
+bool DictCodec::select(uint8_t version) {
+  if (version == 0) {
+    version_ = 0;
+    return true;
+  }
+  size_t length;
+  const uint8_t* data = dictData(version, length);
+  if (data == nullptr) return false;
+  if (version != version_) lz4LoadDict(dict_, data, length);
+  version_ = version;
+  return true;
+}
+
+size_t DictCodec::encode(const uint8_t* in, size_t length, uint8_t* out, size_t size) {
+  if (version_ == 0 || length <= DICT_FRAME_HEADER || length > 0xFFFF ||
+      size <= DICT_FRAME_HEADER) {
+    return 0;
+  }
+  // A block that would make the frame no smaller than the input fails to fit
+  size_t room = size - DICT_FRAME_HEADER;
+  if (room > length - 1 - DICT_FRAME_HEADER) room = length - 1 - DICT_FRAME_HEADER;
+
+  size_t packed = lz4CompressDict(dict_, in, length, out + DICT_FRAME_HEADER, room, table_);
+  if (packed == 0) return 0;
+  out[0] = DICT_FRAME_MAGIC;
+  out[1] = version_;
+  out[2] = (uint8_t)length;
+  out[3] = (uint8_t)(length >> 8);
+  return DICT_FRAME_HEADER + packed;
+}
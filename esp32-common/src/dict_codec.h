@@ -0,0 +1,71 @@
+// Lumina Bridge Common - Dictionary Payload Codec
+//
+// Commands and status updates are a few hundred bytes of JSON, too short
+// for LZ4 to find much repetition in on its own, but nearly all of them
+// repeat the same keys and values ("seg":[{"id":0,"col":[[ ...). This codec
+// compresses them against a dictionary trained on WLED payloads
+// (tools/make_dict.py), shipped in the firmware and versioned: the backend
+// keeps every released version, and each message names the one it used.
+//
+// A frame is DICT_FRAME_MAGIC, the dictionary version, the JSON length
+// (LE16), then one LZ4 block compressed against that dictionary. 0xF5 is
+// never the first byte of JSON text or a MessagePack map, so a frame is
+// told apart from plain payloads by its first byte alone.
+//
+// Encoding needs a DictCodec (4 KB: the primed table and a working one);
+// decoding needs only the dictionary bytes.
+
+#ifndef DICT_CODEC_H
+#define DICT_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lz4_block.h"
+
+#define DICT_FRAME_MAGIC 0xF5
+#define DICT_FRAME_HEADER 4
+#define DICT_NEWEST_VERSION 1  // Versions 1 to this are all in the firmware
+
+// Largest frame for `length` bytes of JSON
+#define DICT_FRAME_BOUND(length) (DICT_FRAME_HEADER + LZ4_BOUND(length))
+
+// Generated by tools/make_dict.py; never edited once released
+extern const uint8_t WLED_DICT_V1[];
+extern const size_t WLED_DICT_V1_LEN;
+
+// The dictionary of `version`, or nullptr if this firmware does not have it
+const uint8_t* dictData(uint8_t version, size_t& length);
+
+inline bool dictFramed(const uint8_t* payload, size_t length) {
+  return length >= DICT_FRAME_HEADER && payload[0] == DICT_FRAME_MAGIC;
+}
+
+// The version a frame names; check dictData() before decoding
+inline uint8_t dictFrameVersion(const uint8_t* frame) { return frame[1]; }
+
+// Decodes a frame into `out`; returns the JSON length, or 0 if the frame is
+// malformed, names an unknown version or does not fit in `size`
+size_t dictDecode(const uint8_t* frame, size_t length, uint8_t* out, size_t size);
+
+class DictCodec {
+ public:
+  DictCodec() : version_(0) {}
+
+  // Encode with `version` from now on (0: stop encoding); false, and no
+  // change, if this firmware does not have it
+  bool select(uint8_t version);
+  uint8_t version() const { return version_; }
+
+  // Frames `in`; returns the frame length, or 0 if no version is selected,
+  // the frame would not fit in `size`, or it would be no smaller than `in`
+  // (send the plain payload then)
+  size_t encode(const uint8_t* in, size_t length, uint8_t* out, size_t size);
+
+ private:
+  uint8_t version_;
+  Lz4Dict dict_;
+  uint16_t table_[LZ4_TABLE_ENTRIES];
+};
+
+#endif // DICT_CODEC_H
@@ -0,0 +1,203 @@
+/**
+ * Lumina Bridge Common - WLED Field Coverage
+ *
+ * "col" sets only the colour slots it lists: [[255,0,0]] changes the
+ * primary colour and leaves the other two, so each slot is its own field.
+ * An empty entry ([]) skips its slot, as in WLED.
+ *
+ * Presets and playlists replace power, brightness and the segments, as
+ * the app saves them (full state). That lets a newer preset cover older
+ * segment writes; a preset is itself covered only by a newer preset.
+ */
+
+#include "field_groups.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void FieldSet::clear() { memset(this, 0, sizeof(*this)); }
+
+bool FieldSet::empty() const {
+  if (state != 0) return false;
+  for (int i = 0; i < FIELD_MAX_SEGMENTS; i++) {
+    if (segments[i] != 0) return false;
+  }
+  return true;
+}
+
+void FieldSet::add(const FieldSet& other) {
+  state |= other.state;
+  for (int i = 0; i < FIELD_MAX_SEGMENTS; i++) segments[i] |= other.segments[i];
+}
+
+bool FieldSet::contains(const FieldSet& other) const {
+  if ((other.state & ~state) != 0) return false;
+  for (int i = 0; i < FIELD_MAX_SEGMENTS; i++) {
+    if ((other.segments[i] & ~segments[i]) != 0) return false;
+  }
+  return true;
+}
+
+void FieldWrites::clear() {
+  touched.clear();
+  overwritten.clear();
+  opaque = false;
+}
+
+FieldWrites fieldWritesOpaque() {
+  FieldWrites writes;
+  writes.clear();
+  writes.opaque = true;
+  return writes;
+}
+
+struct FieldKey {
+  const char* key;
+  uint16_t field;
+};
+
+static const FieldKey NIGHTLIGHT_KEYS[] = {
+    {"on", FIELD_NL_ON}, {"dur", FIELD_NL_DURATION}, {"mode", FIELD_NL_MODE},
+    {"tbri", FIELD_NL_TARGET}};
+
+static const FieldKey SYNC_KEYS[] = {{"send", FIELD_SYNC_SEND}, {"recv", FIELD_SYNC_RECEIVE}};
+
+static const FieldKey SEGMENT_KEYS[] = {
+    {"on", SEG_FIELD_POWER},     {"bri", SEG_FIELD_BRIGHTNESS}, {"cct", SEG_FIELD_CCT},
+    {"fx", SEG_FIELD_EFFECT},    {"sx", SEG_FIELD_SPEED},       {"ix", SEG_FIELD_INTENSITY},
+    {"pal", SEG_FIELD_PALETTE},  {"c1", SEG_FIELD_CUSTOM1},     {"c2", SEG_FIELD_CUSTOM2},
+    {"c3", SEG_FIELD_CUSTOM3},   {"sel", SEG_FIELD_SELECTED},   {"frz", SEG_FIELD_FROZEN},
+    {"rev", SEG_FIELD_REVERSED}};
+
+template <size_t N>
+static uint16_t lookup(const FieldKey (&keys)[N], const char* key) {
+  for (size_t i = 0; i < N; i++) {
+    if (strcmp(keys[i].key, key) == 0) return keys[i].field;
+  }
+  return 0;
+}
+
+// A toggle ("t"), random pick ("r") or relative step ("~10", "~-5",
+// "4~8~") in place of a value
+static bool isRelative(JsonVariantConst value) {
+  if (!value.is<const char*>()) return false;
+  const char* text = value.as<const char*>();
+  return strcmp(text, "t") == 0 || strcmp(text, "r") == 0 || strchr(text, '~') != nullptr;
+}
+
+static void addState(FieldWrites& writes, uint16_t field, JsonVariantConst value) {
+  writes.touched.state |= field;
+  if (!isRelative(value)) writes.overwritten.state |= field;
+}
+
+// Keys of "nl" or "udpn"
+template <size_t N>
+static void addStateObject(FieldWrites& writes, const FieldKey (&keys)[N],
+                           JsonVariantConst value) {
+  if (!value.is<JsonObjectConst>()) {
+    writes.opaque = true;
+    return;
+  }
+  for (JsonPairConst kv : value.as<JsonObjectConst>()) {
+    uint16_t field = lookup(keys, kv.key().c_str());
+    if (field == 0) {
+      writes.opaque = true;
+    } else {
+      addState(writes, field, kv.value());
+    }
+  }
+}
+
+static void addSegment(FieldWrites& writes, JsonObjectConst segment, int id) {
+  if (id < 0 || id >= FIELD_MAX_SEGMENTS) {
+    writes.opaque = true;
+    return;
+  }
+  uint16_t& touched = writes.touched.segments[id];
+  uint16_t& overwritten = writes.overwritten.segments[id];
+
+  for (JsonPairConst kv : segment) {
+    const char* key = kv.key().c_str();
+    JsonVariantConst value = kv.value();
+    if (strcmp(key, "id") == 0) continue;
+
+    if (strcmp(key, "col") == 0) {
+      if (!value.is<JsonArrayConst>()) {
+        writes.opaque = true;
+        continue;
+      }
+      JsonArrayConst colors = value.as<JsonArrayConst>();
+      for (size_t slot = 0; slot < colors.size(); slot++) {
+        JsonVariantConst color = colors[slot];
+        if (color.is<JsonArrayConst>() && color.as<JsonArrayConst>().size() == 0) continue;
+        if (slot >= 3) {
+          writes.opaque = true;
+          break;
+        }
+        touched |= SEG_FIELD_COLOR1 << slot;
+        overwritten |= SEG_FIELD_COLOR1 << slot;
+      }
+      continue;
+    }
+
+    uint16_t field = lookup(SEGMENT_KEYS, key);
+    if (field == 0) {
+      writes.opaque = true;
+      continue;
+    }
+    touched |= field;
+    if (!isRelative(value)) overwritten |= field;
+  }
+}
+
+FieldWrites fieldWritesForState(JsonObjectConst state) {
+  FieldWrites writes;
+  writes.clear();
+
+  for (JsonPairConst kv : state) {
+    const char* key = kv.key().c_str();
+    JsonVariantConst value = kv.value();
+
+    if (strcmp(key, "on") == 0) {
+      addState(writes, FIELD_POWER, value);
+    } else if (strcmp(key, "bri") == 0) {
+      addState(writes, FIELD_BRIGHTNESS, value);
+    } else if (strcmp(key, "mainseg") == 0) {
+      addState(writes, FIELD_MAIN_SEGMENT, value);
+    } else if (strcmp(key, "nl") == 0) {
+      addStateObject(writes, NIGHTLIGHT_KEYS, value);
+    } else if (strcmp(key, "udpn") == 0) {
+      addStateObject(writes, SYNC_KEYS, value);
+    } else if (strcmp(key, "ps") == 0 || strcmp(key, "pl") == 0) {
+      FieldSet preset;
+      preset.clear();
+      preset.state = FIELD_PRESET | FIELD_POWER | FIELD_BRIGHTNESS;
+      for (int i = 0; i < FIELD_MAX_SEGMENTS; i++) preset.segments[i] = SEG_FIELD_ALL;
+      writes.touched.add(preset);
+      if (!isRelative(value)) writes.overwritten.add(preset);
+    } else if (strcmp(key, "seg") == 0) {
+      if (value.is<JsonArrayConst>()) {
+        // Entries without an "id" are segments by position, as in WLED
+        int position = 0;
+        for (JsonVariantConst entry : value.as<JsonArrayConst>()) {
+          if (!entry.is<JsonObjectConst>()) {
+            writes.opaque = true;
+          } else {
+            JsonObjectConst segment = entry.as<JsonObjectConst>();
+            addSegment(writes, segment, segment["id"] | position);
+          }
+          position++;
+        }
+      } else if (value.is<JsonObjectConst>() && value["id"].is<int>()) {
+        addSegment(writes, value.as<JsonObjectConst>(), value["id"].as<int>());
+      } else {
+        writes.opaque = true;
+      }
+    } else if (strcmp(key, "transition") != 0 && strcmp(key, "tt") != 0 &&
+               strcmp(key, "v") != 0) {
+      // Transition timing and the response flag change nothing
+      writes.opaque = true;
+    }
+  }
+  return writes;
+}
@@ -0,0 +1,99 @@
+// Lumina Bridge Common - WLED Field Coverage
+//
+// Which parts of WLED state a command writes. Both bridges use this to
+// decide when a newer command makes an older one redundant: a command is
+// superseded only when every field it touches was set by a newer one.
+//
+// Segment fields are tracked per segment id and property, the way WLED
+// merges them: {"seg":[{"id":1,"fx":9}]} leaves segment 0's colours
+// alone. Only absolute values overwrite. A toggle or relative step
+// ("on": "t", "bri": "~10", "fx": "r") touches its field but covers
+// nothing, so it never makes another command redundant, and two steps
+// never merge into one.
+//
+// Anything not tracked here makes the command opaque: unknown keys,
+// actions such as "psave" or "rb", per-LED writes, segments from
+// FIELD_MAX_SEGMENTS up, and a "seg" object without an "id" (WLED applies
+// it to whichever segments are selected). An opaque command is never
+// superseded. Its tracked absolute fields still cover older commands.
+
+#ifndef FIELD_GROUPS_H
+#define FIELD_GROUPS_H
+
+#include <stdint.h>
+
+#include <ArduinoJson.h>
+
+// Segment ids tracked; writes to higher ones are opaque
+#define FIELD_MAX_SEGMENTS 8
+
+// Top-level fields
+enum StateField : uint16_t {
+  FIELD_POWER        = 1 << 0,  // "on"
+  FIELD_BRIGHTNESS   = 1 << 1,  // "bri"
+  FIELD_PRESET       = 1 << 2,  // "ps", "pl"
+  FIELD_NL_ON        = 1 << 3,  // "nl": {"on"}
+  FIELD_NL_DURATION  = 1 << 4,  // "nl": {"dur"}
+  FIELD_NL_MODE      = 1 << 5,  // "nl": {"mode"}
+  FIELD_NL_TARGET    = 1 << 6,  // "nl": {"tbri"}
+  FIELD_SYNC_SEND    = 1 << 7,  // "udpn": {"send"}
+  FIELD_SYNC_RECEIVE = 1 << 8,  // "udpn": {"recv"}
+  FIELD_MAIN_SEGMENT = 1 << 9,  // "mainseg"
+};
+
+// Fields of one segment
+enum SegmentField : uint16_t {
+  SEG_FIELD_POWER      = 1 << 0,   // "on"
+  SEG_FIELD_BRIGHTNESS = 1 << 1,   // "bri"
+  SEG_FIELD_COLOR1     = 1 << 2,   // "col"[0]
+  SEG_FIELD_COLOR2     = 1 << 3,   // "col"[1]
+  SEG_FIELD_COLOR3     = 1 << 4,   // "col"[2]
+  SEG_FIELD_CCT        = 1 << 5,   // "cct"
+  SEG_FIELD_EFFECT     = 1 << 6,   // "fx"
+  SEG_FIELD_SPEED      = 1 << 7,   // "sx"
+  SEG_FIELD_INTENSITY  = 1 << 8,   // "ix"
+  SEG_FIELD_PALETTE    = 1 << 9,   // "pal"
+  SEG_FIELD_CUSTOM1    = 1 << 10,  // "c1"
+  SEG_FIELD_CUSTOM2    = 1 << 11,  // "c2"
+  SEG_FIELD_CUSTOM3    = 1 << 12,  // "c3"
+  SEG_FIELD_SELECTED   = 1 << 13,  // "sel"
+  SEG_FIELD_FROZEN     = 1 << 14,  // "frz"
+  SEG_FIELD_REVERSED   = 1 << 15,  // "rev"
+};
+
+#define SEG_FIELD_ALL 0xFFFF
+
+struct FieldSet {
+  uint16_t state;                         // StateField bits
+  uint16_t segments[FIELD_MAX_SEGMENTS];  // SegmentField bits, by segment id
+
+  void clear();
+  bool empty() const;
+  void add(const FieldSet& other);
+  bool contains(const FieldSet& other) const;  // Every field of `other`
+};
+
+struct FieldWrites {
+  FieldSet touched;      // Every tracked field the command changes
+  FieldSet overwritten;  // Those it sets to an absolute value
+  bool opaque;           // Also changes something not tracked here
+
+  void clear();
+
+  // False for opaque commands and those that change nothing (reads)
+  bool supersedable() const { return !opaque && !touched.empty(); }
+
+  // True if a newer command that overwrote `newer` leaves nothing of this
+  // one to apply
+  bool coveredBy(const FieldSet& newer) const { return supersedable() && newer.contains(touched); }
+};
+
+// The fields a /json/state body writes. A preset or playlist counts as
+// writing power, brightness and every segment field.
+FieldWrites fieldWritesForState(JsonObjectConst state);
+
+// Anything else (a /json/cfg write, a bridge command the queue must keep):
+// opaque, never superseded
+FieldWrites fieldWritesOpaque();
+
+#endif // FIELD_GROUPS_H
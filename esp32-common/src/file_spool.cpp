@@ -0,0 +1,440 @@
+/**
+ * Lumina Bridge Common - Resumable File Transfer to WLED
+ *
+ * Flash layout: /spool/transfer.meta holds the Meta struct (about 370
+ * bytes), /spool/transfer.bin the file itself. Chunks are written at their
+ * own offset, so a chunk that arrives early leaves a gap that a later chunk
+ * fills.
+ *
+ * A fetch asks for the first run of missing chunks ("Range: bytes=a-b").
+ * A server that ignores Range answers 200 with the whole file; the bytes
+ * before the run are read and dropped, and the connection is closed since
+ * the rest of the body is left unread.
+ *
+ * The upload request is built around the file with a precomputed
+ * Content-Length:
+ *
+ *   --{boundary}
+ *   Content-Disposition: form-data; name="data"; filename="{name}"
+ *   Content-Type: application/octet-stream
+ *
+ *   {file bytes, streamed from flash}
+ *   --{boundary}
+ *   Content-Disposition: form-data; name="path"
+ *
+ *   {path}
+ *   --{boundary}--
+ */
+
+#ifdef ESP_PLATFORM
+
+#include "file_spool.h"
+
+#include <HTTPClient.h>
+#include <LittleFS.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/sha256.h>
+
+static const char* SPOOL_DIR = "/spool";
+static const char* META_FILE = "/spool/transfer.meta";
+static const char* DATA_FILE = "/spool/transfer.bin";
+static const char* BOUNDARY = "----LuminaBridgeSpool";
+static const size_t UPLOAD_BUFFER = 1024;
+static const uint32_t UPLOAD_TIMEOUT_MS = 15000;
+static const uint32_t FETCH_TIMEOUT_MS = 10000;
+
+// One decoded or fetched chunk
+static uint8_t chunkBuffer[SPOOL_CHUNK_MAX];
+
+// Kept between fetchRange() calls, so consecutive ranges reuse the TLS session
+static WiFiClientSecure fetchSecure;
+static HTTPClient fetchHttp;
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseSha256(const char* hex, uint8_t* out) {
+  if (hex == nullptr || strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    int high = hexValue(hex[i * 2]);
+    int low = hexValue(hex[i * 2 + 1]);
+    if (high < 0 || low < 0) return false;
+    out[i] = (high << 4) | low;
+  }
+  return true;
+}
+
+FileSpool::FileSpool() : mounted_(false) {
+  memset(&meta_, 0, sizeof(meta_));
+}
+
+bool FileSpool::begin() {
+  if (!mounted_) {
+    mounted_ = LittleFS.begin(true);  // Formats an empty partition
+    if (!mounted_) return false;
+    if (!LittleFS.exists(SPOOL_DIR)) LittleFS.mkdir(SPOOL_DIR);
+  }
+
+  File file = LittleFS.open(META_FILE, "r");
+  if (file) {
+    if (file.read((uint8_t*)&meta_, sizeof(meta_)) != sizeof(meta_) ||
+        meta_.magic != META_MAGIC) {
+      memset(&meta_, 0, sizeof(meta_));
+    }
+    file.close();
+  }
+  return true;
+}
+
+bool FileSpool::open(const char* transferId, const char* path, uint32_t size,
+                     uint16_t chunkSize, const char* sha256Hex, String& error) {
+  if (!mounted_ && !begin()) {
+    error = "Spool storage unavailable";
+    return false;
+  }
+
+  uint8_t sha256[32];
+  if (strlen(transferId) == 0 || strlen(transferId) >= SPOOL_ID_MAX_LEN) {
+    error = "Invalid transfer ID";
+    return false;
+  }
+  if (path[0] != '/' || strlen(path) >= SPOOL_PATH_MAX_LEN) {
+    error = "Invalid WLED path";
+    return false;
+  }
+  if (!parseSha256(sha256Hex, sha256)) {
+    error = "Invalid SHA-256";
+    return false;
+  }
+  if (chunkSize == 0 || chunkSize > SPOOL_CHUNK_MAX || size == 0 ||
+      (size + chunkSize - 1) / chunkSize > SPOOL_MAX_CHUNKS) {
+    error = "File too large or bad chunk size";
+    return false;
+  }
+
+  // Same transfer: keep what already arrived
+  if (active() && strcmp(meta_.transferId, transferId) == 0 && meta_.size == size &&
+      meta_.chunkSize == chunkSize && memcmp(meta_.sha256, sha256, 32) == 0) {
+    return true;
+  }
+
+  discard();
+  if (size > LittleFS.totalBytes() - LittleFS.usedBytes()) {
+    error = "Not enough spool space";
+    return false;
+  }
+
+  meta_.magic = META_MAGIC;
+  strlcpy(meta_.transferId, transferId, sizeof(meta_.transferId));
+  strlcpy(meta_.path, path, sizeof(meta_.path));
+  meta_.size = size;
+  meta_.chunkSize = chunkSize;
+  meta_.chunks = (size + chunkSize - 1) / chunkSize;
+  memcpy(meta_.sha256, sha256, 32);
+
+  File data = LittleFS.open(DATA_FILE, "w");
+  if (!data) {
+    memset(&meta_, 0, sizeof(meta_));
+    error = "Could not create spool file";
+    return false;
+  }
+  data.close();
+
+  if (!saveMeta()) {
+    error = "Could not save transfer state";
+    return false;
+  }
+  return true;
+}
+
+bool FileSpool::writeChunk(const char* transferId, uint16_t index, const char* base64,
+                           String& error) {
+  if (!matches(transferId, error)) return false;
+  if (index >= meta_.chunks) {
+    error = "Chunk index out of range";
+    return false;
+  }
+  if (hasChunk(index)) return true;
+
+  size_t length = 0;
+  if (mbedtls_base64_decode(chunkBuffer, sizeof(chunkBuffer), &length,
+                            (const unsigned char*)base64, strlen(base64)) != 0) {
+    error = "Bad chunk encoding";
+    return false;
+  }
+  return storeChunk(index, chunkBuffer, length, error);
+}
+
+int FileSpool::fetchRange(const char* url, uint32_t maxBytes, String& error) {
+  if (!active()) {
+    error = "Nothing spooled";
+    return -1;
+  }
+  int first = firstMissing();
+  if (first < 0) return 0;
+
+  // The run of missing chunks from `first`, at least one chunk long
+  uint16_t last = first;
+  while (last + 1 < meta_.chunks && !hasChunk(last + 1) &&
+         (uint32_t)(last + 2 - first) * meta_.chunkSize <= maxBytes) {
+    last++;
+  }
+  uint32_t from = (uint32_t)first * meta_.chunkSize;
+  uint32_t end = (uint32_t)(last + 1) * meta_.chunkSize;
+  if (end > meta_.size) end = meta_.size;
+
+  fetchSecure.setInsecure();  // The SHA-256 check covers the content
+  fetchHttp.setReuse(true);
+  fetchHttp.setTimeout(FETCH_TIMEOUT_MS);
+  if (!fetchHttp.begin(fetchSecure, url)) {
+    error = "Bad file URL";
+    return -1;
+  }
+  fetchHttp.addHeader("Range", String("bytes=") + from + "-" + (end - 1));
+  int httpCode = fetchHttp.GET();
+  if (httpCode != HTTP_CODE_PARTIAL_CONTENT && httpCode != HTTP_CODE_OK) {
+    fetchHttp.end();
+    error = "File fetch failed: HTTP " + String(httpCode);
+    return -1;
+  }
+
+  WiFiClient* stream = fetchHttp.getStreamPtr();
+  bool ok = true;
+  uint32_t skip = httpCode == HTTP_CODE_OK ? from : 0;
+  while (ok && skip > 0) {
+    size_t want = skip < sizeof(chunkBuffer) ? skip : sizeof(chunkBuffer);
+    size_t n = stream->readBytes(chunkBuffer, want);
+    if (n == 0) ok = false;
+    skip -= n;
+  }
+
+  int stored = 0;
+  for (uint16_t index = first; ok && index <= last; index++) {
+    uint32_t offset = (uint32_t)index * meta_.chunkSize;
+    size_t length = meta_.size - offset < meta_.chunkSize ? meta_.size - offset : meta_.chunkSize;
+    if (stream->readBytes(chunkBuffer, length) != length) {
+      ok = false;
+    } else if (!storeChunk(index, chunkBuffer, length, error)) {
+      fetchHttp.end();
+      fetchSecure.stop();
+      return -1;
+    } else {
+      stored += length;
+    }
+  }
+
+  fetchHttp.end();
+  if (!ok || (httpCode == HTTP_CODE_OK && end < meta_.size)) fetchSecure.stop();
+  if (!ok) {
+    error = "File fetch interrupted";
+    return -1;
+  }
+  return stored;
+}
+
+void FileSpool::endFetch() {
+  fetchHttp.end();
+  fetchSecure.stop();
+}
+
+bool FileSpool::verify(const char* transferId, String& error) {
+  if (!matches(transferId, error)) return false;
+  if (firstMissing() >= 0) {
+    error = "Missing chunks";
+    return false;
+  }
+
+  File data = LittleFS.open(DATA_FILE, "r");
+  if (!data || data.size() != meta_.size) {
+    if (data) data.close();
+    error = "Spooled file incomplete";
+    return false;
+  }
+
+  uint8_t buffer[UPLOAD_BUFFER];
+  uint8_t digest[32];
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  for (;;) {
+    int n = data.read(buffer, sizeof(buffer));
+    if (n <= 0) break;
+    mbedtls_sha256_update(&sha, buffer, n);
+  }
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  data.close();
+
+  if (memcmp(digest, meta_.sha256, 32) != 0) {
+    error = "SHA-256 mismatch";
+    return false;
+  }
+  return true;
+}
+
+FileUploadResult FileSpool::uploadToWled(const char* ip) {
+  FileUploadResult result = {false, "", 0, 0, 0, 0};
+  uint32_t started = millis();
+  uint32_t heapAtStart = ESP.getFreeHeap();
+  uint32_t heapLow = heapAtStart;
+
+  File data = LittleFS.open(DATA_FILE, "r");
+  if (!active() || !data) {
+    result.error = "Nothing spooled";
+    return result;
+  }
+
+  const char* name = strrchr(meta_.path, '/') + 1;
+  String head = String("--") + BOUNDARY +
+                "\r\nContent-Disposition: form-data; name=\"data\"; filename=\"" + name +
+                "\"\r\nContent-Type: application/octet-stream\r\n\r\n";
+  String tail = String("\r\n--") + BOUNDARY +
+                "\r\nContent-Disposition: form-data; name=\"path\"\r\n\r\n" + meta_.path +
+                "\r\n--" + BOUNDARY + "--\r\n";
+  uint32_t contentLength = head.length() + meta_.size + tail.length();
+
+  WiFiClient client;
+  client.setTimeout(UPLOAD_TIMEOUT_MS / 1000);
+  if (!client.connect(ip, 80)) {
+    data.close();
+    result.httpCode = -1;
+    result.error = "Could not connect to WLED";
+    return result;
+  }
+
+  client.print(String("POST /edit HTTP/1.1\r\nHost: ") + ip +
+               "\r\nContent-Type: multipart/form-data; boundary=" + BOUNDARY +
+               "\r\nContent-Length: " + contentLength + "\r\nConnection: close\r\n\r\n");
+  client.print(head);
+
+  uint8_t buffer[UPLOAD_BUFFER];
+  bool ioError = false;
+  for (;;) {
+    int n = data.read(buffer, sizeof(buffer));
+    if (n <= 0) break;
+    if (client.write(buffer, n) != (size_t)n) {
+      ioError = true;
+      break;
+    }
+    result.bytes += n;
+    uint32_t heap = ESP.getFreeHeap();
+    if (heap < heapLow) heapLow = heap;
+  }
+  data.close();
+
+  if (ioError || result.bytes != meta_.size) {
+    client.stop();
+    result.httpCode = -2;
+    result.error = "Upload interrupted";
+  } else {
+    client.print(tail);
+
+    // Status line only; WLED closes the connection after the response
+    uint32_t deadline = millis() + UPLOAD_TIMEOUT_MS;
+    while (!client.available() && client.connected() && (long)(millis() - deadline) < 0) {
+      delay(5);
+    }
+    String status = client.readStringUntil('\n');
+    client.stop();
+
+    result.httpCode = status.startsWith("HTTP/1.") ? status.substring(9, 12).toInt() : -3;
+    result.ok = result.httpCode >= 200 && result.httpCode < 300;
+    if (!result.ok) result.error = "WLED rejected the upload";
+  }
+
+  result.elapsedMs = millis() - started;
+  result.heapUsed = heapAtStart - heapLow;
+  return result;
+}
+
+void FileSpool::discard() {
+  if (mounted_) {
+    LittleFS.remove(DATA_FILE);
+    LittleFS.remove(META_FILE);
+  }
+  memset(&meta_, 0, sizeof(meta_));
+}
+
+void FileSpool::abort(const char* transferId) {
+  if (active() && strcmp(meta_.transferId, transferId) == 0) discard();
+}
+
+uint16_t FileSpool::receivedChunks() const {
+  uint16_t count = 0;
+  for (uint16_t i = 0; i < meta_.chunks; i++) {
+    if (hasChunk(i)) count++;
+  }
+  return count;
+}
+
+int FileSpool::firstMissing() const {
+  for (uint16_t i = 0; i < meta_.chunks; i++) {
+    if (!hasChunk(i)) return i;
+  }
+  return -1;
+}
+
+String FileSpool::receivedHex() const {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  String hex;
+  size_t bytes = (meta_.chunks + 7) / 8;
+  hex.reserve(bytes * 2);
+  for (size_t i = 0; i < bytes; i++) {
+    hex += HEX_DIGITS[meta_.received[i] >> 4];
+    hex += HEX_DIGITS[meta_.received[i] & 0x0F];
+  }
+  return hex;
+}
+
+bool FileSpool::matches(const char* transferId, String& error) const {
+  if (!active() || strcmp(meta_.transferId, transferId) != 0) {
+    error = "Unknown transfer";
+    return false;
+  }
+  return true;
+}
+
+bool FileSpool::hasChunk(uint16_t index) const {
+  return meta_.received[index / 8] & (1 << (index % 8));
+}
+
+bool FileSpool::storeChunk(uint16_t index, const uint8_t* data, size_t length, String& error) {
+  uint32_t offset = (uint32_t)index * meta_.chunkSize;
+  uint32_t expected = meta_.size - offset < meta_.chunkSize ? meta_.size - offset
+                                                            : meta_.chunkSize;
+  if (length != expected) {
+    error = "Chunk length mismatch";
+    return false;
+  }
+
+  File file = LittleFS.open(DATA_FILE, "r+");
+  if (!file || !file.seek(offset) || file.write(data, length) != length) {
+    if (file) file.close();
+    error = "Spool write failed";
+    return false;
+  }
+  file.close();
+
+  meta_.received[index / 8] |= 1 << (index % 8);
+  if (!saveMeta()) {
+    error = "Could not save transfer state";
+    return false;
+  }
+  return true;
+}
+
+bool FileSpool::saveMeta() {
+  File file = LittleFS.open(META_FILE, "w");
+  if (!file) return false;
+  bool ok = file.write((const uint8_t*)&meta_, sizeof(meta_)) == sizeof(meta_);
+  file.close();
+  return ok;
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,103 @@
+// Lumina Bridge Common - Resumable File Transfer to WLED
+//
+// Receives a file (ledmap.json, presets.json, palettes) in numbered chunks,
+// either sent to it or fetched from a URL in HTTP Range requests, spools it
+// to LittleFS, checks its SHA-256 and then streams it to WLED's
+// /edit endpoint as multipart/form-data, 1 KB at a time. Chunks may arrive
+// in any order and more than once; the transfer state (which chunks have
+// arrived) is kept on flash, so a transfer survives a bridge restart and
+// the sender only resends what is missing.
+//
+// One transfer is spooled at a time. Starting a different transfer drops
+// the previous one.
+
+#ifndef FILE_SPOOL_H
+#define FILE_SPOOL_H
+
+#include <Arduino.h>
+
+// Largest file: SPOOL_MAX_CHUNKS x the sender's chunk size
+#define SPOOL_MAX_CHUNKS 256
+#define SPOOL_CHUNK_MAX 4096
+#define SPOOL_ID_MAX_LEN 24
+#define SPOOL_PATH_MAX_LEN 32
+
+struct FileUploadResult {
+  bool ok;
+  String error;
+  int httpCode;         // WLED's response, or negative on connection errors
+  uint32_t bytes;       // File bytes sent
+  uint32_t elapsedMs;   // Connect to response
+  uint32_t heapUsed;    // Free heap at the start minus the lowest seen while sending
+};
+
+class FileSpool {
+ public:
+  FileSpool();
+
+  // Mounts LittleFS and loads any transfer left from before a restart
+  bool begin();
+
+  // Starts a transfer, or resumes it if one with the same ID, size and hash
+  // is already spooled. `path` is the file's path on WLED ("/ledmap.json"),
+  // `sha256Hex` the hash of the whole file.
+  bool open(const char* transferId, const char* path, uint32_t size, uint16_t chunkSize,
+            const char* sha256Hex, String& error);
+
+  // Stores chunk `index` (base64). Chunks already received are accepted
+  // without writing again.
+  bool writeChunk(const char* transferId, uint16_t index, const char* base64, String& error);
+
+  // Fetches the next missing chunks of the open transfer from `url` (HTTPS)
+  // in one Range request of at most `maxBytes`, keeping the connection for
+  // the next call. Returns the bytes stored, or -1 with `error` set; chunks
+  // stored before an error stay stored.
+  int fetchRange(const char* url, uint32_t maxBytes, String& error);
+
+  // Closes the fetch connection
+  void endFetch();
+
+  // Checks every chunk arrived and the spooled file's SHA-256
+  bool verify(const char* transferId, String& error);
+
+  // Streams the verified file to http://{ip}/edit
+  FileUploadResult uploadToWled(const char* ip);
+
+  // Deletes the spooled file and its state
+  void discard();
+
+  // discard() if `transferId` is the spooled transfer
+  void abort(const char* transferId);
+
+  bool active() const { return meta_.magic == META_MAGIC; }
+  uint16_t chunks() const { return meta_.chunks; }
+  uint16_t receivedChunks() const;
+  int firstMissing() const;  // -1 when complete
+
+  // Received-chunk bitmap as hex (bit i = chunk i), for the sender to resume
+  String receivedHex() const;
+
+ private:
+  static const uint32_t META_MAGIC = 0x4C535031;  // "LSP1"
+
+  struct Meta {
+    uint32_t magic;
+    char transferId[SPOOL_ID_MAX_LEN];
+    char path[SPOOL_PATH_MAX_LEN];
+    uint32_t size;
+    uint16_t chunkSize;
+    uint16_t chunks;
+    uint8_t sha256[32];
+    uint8_t received[SPOOL_MAX_CHUNKS / 8];
+  };
+
+  bool matches(const char* transferId, String& error) const;
+  bool hasChunk(uint16_t index) const;
+  bool storeChunk(uint16_t index, const uint8_t* data, size_t length, String& error);
+  bool saveMeta();
+
+  Meta meta_;
+  bool mounted_;
+};
+
+#endif // FILE_SPOOL_H
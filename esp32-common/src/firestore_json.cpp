@@ -0,0 +1,67 @@
+/**
+ * Lumina Bridge Common - Firestore REST JSON
+ */
+
+#include "firestore_json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void firestoreValueToJson(JsonVariantConst value, JsonVariant out) {
+  JsonObjectConst typed = value.as<JsonObjectConst>();
+  for (JsonPairConst kv : typed) {
+    const char* type = kv.key().c_str();
+    JsonVariantConst v = kv.value();
+
+    if (strcmp(type, "stringValue") == 0 || strcmp(type, "timestampValue") == 0 ||
+        strcmp(type, "referenceValue") == 0) {
+      out.set(v.as<const char*>());
+    } else if (strcmp(type, "integerValue") == 0) {
+      // int64 as a decimal string
+      out.set((long long)strtoll(v.as<const char*>() ? v.as<const char*>() : "0", nullptr, 10));
+    } else if (strcmp(type, "doubleValue") == 0) {
+      out.set(v.as<double>());
+    } else if (strcmp(type, "booleanValue") == 0) {
+      out.set(v.as<bool>());
+    } else if (strcmp(type, "mapValue") == 0) {
+      firestoreFieldsToJson(v["fields"].as<JsonObjectConst>(), out.to<JsonObject>());
+    } else if (strcmp(type, "arrayValue") == 0) {
+      JsonArray array = out.to<JsonArray>();
+      for (JsonVariantConst item : v["values"].as<JsonArrayConst>()) {
+        firestoreValueToJson(item, array.add<JsonVariant>());
+      }
+    } else {
+      out.clear();  // nullValue and anything unknown
+    }
+    return;  // One type key per value
+  }
+}
+
+void firestoreFieldsToJson(JsonObjectConst fields, JsonObject out) {
+  for (JsonPairConst kv : fields) {
+    firestoreValueToJson(kv.value(), out[kv.key()].to<JsonVariant>());
+  }
+}
+
+void addFirestoreStatusWrite(JsonArray writes, const char* documentsPath, const char* ref,
+                             const char* status, const char* error, const char* timestamp) {
+  char name[192];
+  snprintf(name, sizeof(name), "%s%s", documentsPath, ref);
+
+  JsonObject write = writes.add<JsonObject>();
+  JsonObject update = write["update"].to<JsonObject>();
+  JsonArray mask = write["updateMask"]["fieldPaths"].to<JsonArray>();
+  update["name"] = name;
+  update["fields"]["status"]["stringValue"] = status;
+  mask.add("status");
+  if (strcmp(status, "queued") != 0) {
+    update["fields"]["completedAt"]["timestampValue"] = timestamp;
+    mask.add("completedAt");
+  }
+  if (error != nullptr && error[0] != '\0') {
+    update["fields"]["error"]["stringValue"] = error;
+    mask.add("error");
+  }
+  write["currentDocument"]["exists"] = true;
+}
@@ -0,0 +1,28 @@
+// Lumina Bridge Common - Firestore REST JSON
+//
+// Firestore's REST API wraps every value in a type object
+// ({"integerValue": "5"}, {"mapValue": {"fields": {...}}}). These convert
+// command payloads to the plain JSON WLED takes, and build the status
+// updates the bridge commits. Portable, so the kernel benchmarks time the
+// same code on the device and on a host.
+
+#ifndef FIRESTORE_JSON_H
+#define FIRESTORE_JSON_H
+
+#include <ArduinoJson.h>
+
+// Plain JSON for one Firestore value. int64 values arrive as strings and
+// come out as numbers; timestamps and references as their strings.
+void firestoreValueToJson(JsonVariantConst value, JsonVariant out);
+
+// Plain JSON object for a map's "fields"
+void firestoreFieldsToJson(JsonObjectConst fields, JsonObject out);
+
+// Appends a status update for one command to a documents:commit "writes"
+// array. `documentsPath` is "projects/{id}/databases/(default)/documents/users/"
+// and `ref` the command's path below it. Every status but "queued" also
+// sets completedAt to `timestamp`; `error` may be null.
+void addFirestoreStatusWrite(JsonArray writes, const char* documentsPath, const char* ref,
+                             const char* status, const char* error, const char* timestamp);
+
+#endif // FIRESTORE_JSON_H
@@ -0,0 +1,166 @@
+/**
+ * Lumina Bridge Common - Controller Health Series
+ *
+ * Values are rounded to the nearest step and clamped to int16, with the
+ * lowest int16 reserved for a missing reading. At most one controller is
+ * due per sampleMs / HEALTH_MAX_CONTROLLERS, so a full table is read one
+ * controller at a time across the interval.
+ */
+
+#include "health_series.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Units of each metric per stored step
+static const int32_t STEPS[HEALTH_METRIC_COUNT] = {1, 16, 1, 10, 100};
+
+static int16_t toStored(int32_t value, HealthMetric metric) {
+  if (value == HEALTH_MISSING) return INT16_MIN;
+  int32_t step = STEPS[metric];
+  int32_t rounded = value >= 0 ? (value + step / 2) / step : (value - step / 2) / step;
+  if (rounded > INT16_MAX) return INT16_MAX;
+  if (rounded <= INT16_MIN) return INT16_MIN + 1;
+  return (int16_t)rounded;
+}
+
+HealthSeries::HealthSeries(uint32_t sampleMs)
+    : sampleMs_(sampleMs), count_(0), lastSampleAt_(0), sampled_(false) {
+  memset(controllers_, 0, sizeof(controllers_));
+}
+
+int HealthSeries::controller(const char* ip, bool create) {
+  for (size_t i = 0; i < count_; i++) {
+    if (strcmp(controllers_[i].ip, ip) == 0) return (int)i;
+  }
+  if (!create || count_ >= HEALTH_MAX_CONTROLLERS || ip[0] == '\0' ||
+      strlen(ip) >= HEALTH_IP_LEN) {
+    return -1;
+  }
+  Controller& c = controllers_[count_];
+  memset(&c, 0, sizeof(c));
+  snprintf(c.ip, sizeof(c.ip), "%s", ip);
+  c.due = true;
+  return (int)count_++;
+}
+
+const char* HealthSeries::ip(int controller) const {
+  return valid(controller) ? controllers_[controller].ip : "";
+}
+
+int HealthSeries::due(uint32_t nowMs) {
+  if (!enabled() || count_ == 0) return -1;
+  if (sampled_ && nowMs - lastSampleAt_ < sampleMs_ / HEALTH_MAX_CONTROLLERS) return -1;
+
+  for (size_t i = 0; i < count_; i++) {
+    Controller& c = controllers_[i];
+    if (c.due || (int32_t)(nowMs - c.nextAt) >= 0) return (int)i;
+  }
+  return -1;
+}
+
+void HealthSeries::record(int controller, const HealthReading& reading, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  scheduled(c, nowMs);
+
+  int16_t* slot = c.series[c.head];
+  for (int m = 0; m < HEALTH_METRIC_COUNT; m++) {
+    slot[m] = toStored(reading.value[m], (HealthMetric)m);
+  }
+  c.head = (c.head + 1) % HEALTH_SERIES_LEN;
+  if (c.count < HEALTH_SERIES_LEN) c.count++;
+
+  if (reading.uptimeSec > 0) {
+    if (reading.uptimeSec < c.lastUptime) c.reboots++;
+    c.lastUptime = reading.uptimeSec;
+  }
+}
+
+void HealthSeries::failed(int controller, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  scheduled(c, nowMs);
+  c.failures++;
+}
+
+void HealthSeries::scheduled(Controller& c, uint32_t nowMs) {
+  c.due = false;
+  c.nextAt = nowMs + sampleMs_;
+  lastSampleAt_ = nowMs;
+  sampled_ = true;
+}
+
+size_t HealthSeries::samples(int controller) const {
+  return valid(controller) ? controllers_[controller].count : 0;
+}
+
+uint32_t HealthSeries::failures(int controller) const {
+  return valid(controller) ? controllers_[controller].failures : 0;
+}
+
+uint32_t HealthSeries::reboots(int controller) const {
+  return valid(controller) ? controllers_[controller].reboots : 0;
+}
+
+uint32_t HealthSeries::uptimeSec(int controller) const {
+  return valid(controller) ? controllers_[controller].lastUptime : 0;
+}
+
+int32_t HealthSeries::stored(const Controller& c, size_t index, HealthMetric metric) const {
+  size_t slot = (c.head + HEALTH_SERIES_LEN - c.count + index) % HEALTH_SERIES_LEN;
+  int16_t value = c.series[slot][metric];
+  return value == INT16_MIN ? HEALTH_MISSING : (int32_t)value * STEPS[metric];
+}
+
+HealthRollup HealthSeries::rollup(int controller, HealthMetric metric) const {
+  HealthRollup out = {0, HEALTH_MISSING, HEALTH_MISSING, HEALTH_MISSING};
+  if (!valid(controller)) return out;
+  const Controller& c = controllers_[controller];
+
+  int64_t sum = 0;
+  for (size_t i = 0; i < c.count; i++) {
+    int32_t value = stored(c, i, metric);
+    if (value == HEALTH_MISSING) continue;
+    if (out.samples == 0 || value < out.min) out.min = value;
+    if (out.samples == 0 || value > out.max) out.max = value;
+    sum += value;
+    out.samples++;
+  }
+  if (out.samples > 0) out.mean = (int32_t)(sum / out.samples);
+  return out;
+}
+
+size_t HealthSeries::downsample(int controller, HealthMetric metric, int32_t* out,
+                                size_t points) const {
+  if (!valid(controller)) return 0;
+  const Controller& c = controllers_[controller];
+  size_t runs = points < c.count ? points : c.count;
+
+  for (size_t r = 0; r < runs; r++) {
+    size_t from = r * c.count / runs;
+    size_t to = (r + 1) * c.count / runs;
+    int64_t sum = 0;
+    size_t n = 0;
+    for (size_t i = from; i < to; i++) {
+      int32_t value = stored(c, i, metric);
+      if (value == HEALTH_MISSING) continue;
+      sum += value;
+      n++;
+    }
+    out[r] = n > 0 ? (int32_t)(sum / (int64_t)n) : HEALTH_MISSING;
+  }
+  return runs;
+}
+
+void HealthSeries::clearWindow() {
+  for (size_t i = 0; i < count_; i++) {
+    controllers_[i].count = 0;
+    controllers_[i].failures = 0;
+    controllers_[i].reboots = 0;
+  }
+}
+
+size_t HealthSeries::controllerBytes() {
+  return sizeof(Controller);
+}
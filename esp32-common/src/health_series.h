@@ -0,0 +1,119 @@
+// Lumina Bridge Common - Controller Health Series
+//
+// The bridge is the only always-on device on the customer's LAN, so it
+// keeps an eye on the controllers: every `sampleMs` it reads each one's
+// /json/info and records frame rate, free heap, WiFi signal, uptime and
+// estimated LED current, along with the round trip it measured itself.
+// Between two publishes the samples are summarised into rollups (min,
+// mean and max, plus a few averaged points), so a controller starved for
+// CPU, rebooting or on weak WiFi shows up before it makes remote control
+// slow.
+//
+// Samples are stored fixed-point, one int16 per metric in the step sizes
+// below, so an hour of one-minute samples for a controller is under 1 KB.
+// Uptime is not stored: a reading lower than the last one counts as a
+// reboot.
+
+#ifndef HEALTH_SERIES_H
+#define HEALTH_SERIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEALTH_MAX_CONTROLLERS 8
+#define HEALTH_IP_LEN 16
+#define HEALTH_SERIES_LEN 60   // Samples kept per controller between publishes
+#define HEALTH_ROLLUP_POINTS 6 // Averaged points per metric in a rollup
+
+// A metric the controller did not report
+#define HEALTH_MISSING INT32_MIN
+
+enum HealthMetric : uint8_t {
+  HEALTH_FPS = 0,    // leds.fps, frames per second
+  HEALTH_FREE_HEAP,  // freeheap, bytes (stored in 16-byte steps)
+  HEALTH_RSSI,       // wifi.rssi, dBm
+  HEALTH_POWER,      // leds.pwr, mA (stored in 10 mA steps)
+  HEALTH_RTT,        // Bridge-measured request time, microseconds (stored in 100 us steps)
+  HEALTH_METRIC_COUNT
+};
+
+// One reading, in each metric's own unit; HEALTH_MISSING where absent
+struct HealthReading {
+  int32_t value[HEALTH_METRIC_COUNT];
+  uint32_t uptimeSec;  // 0 if not reported
+};
+
+struct HealthRollup {
+  uint16_t samples;  // Readings that had this metric
+  int32_t min;       // HEALTH_MISSING when samples is 0
+  int32_t mean;
+  int32_t max;
+};
+
+class HealthSeries {
+ public:
+  // sampleMs 0 disables collection
+  explicit HealthSeries(uint32_t sampleMs);
+
+  bool enabled() const { return sampleMs_ > 0; }
+
+  // Index of the controller at `ip`, adding it if `create`; -1 if unknown
+  // or the table is full. A new controller is sampled on the next due().
+  int controller(const char* ip, bool create);
+  const char* ip(int controller) const;
+  size_t controllerCount() const { return count_; }
+
+  // The controller to sample now, if one is due, or -1. Controllers are
+  // spread over the interval rather than read back to back.
+  int due(uint32_t nowMs);
+
+  // A sample was taken (record) or the read failed (failed). Either way the
+  // controller's next sample is `sampleMs` away.
+  void record(int controller, const HealthReading& reading, uint32_t nowMs);
+  void failed(int controller, uint32_t nowMs);
+
+  // Since clearWindow()
+  size_t samples(int controller) const;
+  uint32_t failures(int controller) const;
+  uint32_t reboots(int controller) const;
+  uint32_t uptimeSec(int controller) const;  // Last reported
+
+  HealthRollup rollup(int controller, HealthMetric metric) const;
+
+  // Means of up to `points` equal runs of the window's samples, oldest
+  // first; HEALTH_MISSING for a run with no readings. Returns how many.
+  size_t downsample(int controller, HealthMetric metric, int32_t* out, size_t points) const;
+
+  // After the rollups have been published
+  void clearWindow();
+
+  // Bytes of series memory each controller takes
+  static size_t controllerBytes();
+
+ private:
+  struct Controller {
+    char ip[HEALTH_IP_LEN];
+    bool due;        // New; sampled on the next due()
+    uint32_t nextAt;
+    uint32_t lastUptime;
+    uint32_t failures;
+    uint32_t reboots;
+    uint16_t head;   // Next slot to write
+    uint16_t count;
+    int16_t series[HEALTH_SERIES_LEN][HEALTH_METRIC_COUNT];
+  };
+
+  void scheduled(Controller& c, uint32_t nowMs);
+  int32_t stored(const Controller& c, size_t index, HealthMetric metric) const;
+  bool valid(int controller) const {
+    return controller >= 0 && controller < (int)count_;
+  }
+
+  uint32_t sampleMs_;
+  size_t count_;
+  uint32_t lastSampleAt_;
+  bool sampled_;
+  Controller controllers_[HEALTH_MAX_CONTROLLERS];
+};
+
+#endif // HEALTH_SERIES_H
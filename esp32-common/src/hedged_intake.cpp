@@ -0,0 +1,95 @@
+/**
+ * Lumina Bridge Common - Hedged Intake
+ *
+ * The ledger is a ring: a new command takes the oldest entry. A command
+ * seen on one path only is counted as "alone" when its entry is reused, so
+ * that count trails the wins by up to HEDGE_LEDGER_LEN commands.
+ */
+
+#include "hedged_intake.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// FNV-1a; never 0, which marks a free entry
+static uint32_t hashId(const char* id) {
+  uint32_t hash = 2166136261UL;
+  for (const char* c = id; *c != '\0'; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619UL;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+HedgedIntake::HedgedIntake() : next_(0), duplicates_(0) {
+  memset(entries_, 0, sizeof(entries_));
+  clearWindow();
+}
+
+bool HedgedIntake::arrive(const char* id, HedgePath path, uint32_t nowMs) {
+  if (strlen(id) >= HEDGE_ID_LEN) return true;
+
+  uint32_t hash = hashId(id);
+  Entry* entry = find(id, hash);
+  if (entry != nullptr) {
+    uint8_t bit = 1 << path;
+    if (!(entry->seen & bit)) {
+      // The other copy, now behind the one that ran
+      entry->seen |= bit;
+      duplicates_++;
+      stats_[entry->first].leadMs.add(nowMs - entry->arrivedAt);
+    }
+    return false;
+  }
+
+  Entry& slot = entries_[next_];
+  next_ = (next_ + 1) % HEDGE_LEDGER_LEN;
+  evict(slot);
+  slot.hash = hash;
+  slot.arrivedAt = nowMs;
+  slot.first = path;
+  slot.seen = 1 << path;
+  snprintf(slot.id, sizeof(slot.id), "%s", id);
+  stats_[path].wins++;
+  return true;
+}
+
+void HedgedIntake::forget(const char* id) {
+  Entry* entry = find(id, hashId(id));
+  if (entry == nullptr) return;
+  HedgePathStats& stats = stats_[entry->first];
+  if (stats.wins > 0) stats.wins--;
+  memset(entry, 0, sizeof(*entry));
+}
+
+bool HedgedIntake::settle(const char* id, HedgeOutcome outcome) {
+  Entry* entry = find(id, hashId(id));
+  if (entry == nullptr) return false;
+  entry->outcome = outcome;
+  return true;
+}
+
+HedgeOutcome HedgedIntake::outcome(const char* id) {
+  Entry* entry = find(id, hashId(id));
+  return entry != nullptr ? (HedgeOutcome)entry->outcome : HEDGE_OPEN;
+}
+
+void HedgedIntake::clearWindow() {
+  duplicates_ = 0;
+  for (HedgePathStats& stats : stats_) {
+    stats.wins = 0;
+    stats.alone = 0;
+    stats.leadMs.clear();
+  }
+}
+
+HedgedIntake::Entry* HedgedIntake::find(const char* id, uint32_t hash) {
+  for (Entry& entry : entries_) {
+    if (entry.hash == hash && strcmp(entry.id, id) == 0) return &entry;
+  }
+  return nullptr;
+}
+
+void HedgedIntake::evict(Entry& entry) {
+  if (entry.hash != 0 && entry.seen == (1 << entry.first)) stats_[entry.first].alone++;
+  memset(&entry, 0, sizeof(entry));
+}
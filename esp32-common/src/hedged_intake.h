@@ -0,0 +1,97 @@
+// Lumina Bridge Common - Hedged Intake
+//
+// With hedged delivery the producer sends every command over two
+// transports at once (a Firestore write and an MQTT publish) and the bridge
+// takes commands from both. A stall on one link then costs nothing as long
+// as the other is moving. arrive() is called for every copy the bridge
+// sees: the first copy of a command runs, later ones are dropped.
+//
+// The intake also keeps the attribution: which path delivered each command
+// first, how far ahead it was when the other copy came too, and how often
+// the other copy never came. That shows in the field whether hedging pays
+// for its second transport.
+//
+// The last HEDGE_LEDGER_LEN command IDs are remembered. A copy arriving
+// after its command has been forgotten runs again, so the ledger should
+// cover more commands than can arrive during the longest stall worth
+// hedging.
+
+#ifndef HEDGED_INTAKE_H
+#define HEDGED_INTAKE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latency_stats.h"
+
+#define HEDGE_LEDGER_LEN 32
+#define HEDGE_ID_LEN 72
+
+enum HedgePath : uint8_t {
+  HEDGE_FIRESTORE = 0,
+  HEDGE_MQTT = 1,
+};
+
+#define HEDGE_PATH_COUNT 2
+
+// Final status of a command, kept so a copy that arrives after it finished
+// can be answered with it
+enum HedgeOutcome : uint8_t {
+  HEDGE_OPEN = 0,  // Still running, or not tracked
+  HEDGE_COMPLETED,
+  HEDGE_FAILED,
+  HEDGE_SUPERSEDED,
+};
+
+// Attribution for one path since clearWindow()
+struct HedgePathStats {
+  uint32_t wins;        // Commands whose first copy came this way
+  uint32_t alone;       // Of those, forgotten before the other copy came
+  LatencyStats leadMs;  // Wins where the other copy came too: how far ahead
+};
+
+class HedgedIntake {
+ public:
+  HedgedIntake();
+
+  // True for the first copy of `id`: run it. False for a copy of a command
+  // already taken, from either path. IDs of HEDGE_ID_LEN or more are never
+  // deduplicated.
+  bool arrive(const char* id, HedgePath path, uint32_t nowMs);
+
+  // The command was not taken after all (its queue was full) and should
+  // run when a copy arrives again
+  void forget(const char* id);
+
+  // Records a command's final status; false if `id` is not tracked
+  bool settle(const char* id, HedgeOutcome outcome);
+  HedgeOutcome outcome(const char* id);
+
+  // Second copies dropped since clearWindow()
+  uint32_t duplicates() const { return duplicates_; }
+
+  const HedgePathStats& stats(HedgePath path) const { return stats_[path]; }
+
+  // After the window has been published
+  void clearWindow();
+
+ private:
+  struct Entry {
+    uint32_t hash;  // 0 = free
+    uint32_t arrivedAt;
+    uint8_t first;  // HedgePath of the first copy
+    uint8_t seen;   // Bit per path
+    uint8_t outcome;
+    char id[HEDGE_ID_LEN];
+  };
+
+  Entry* find(const char* id, uint32_t hash);
+  void evict(Entry& entry);
+
+  Entry entries_[HEDGE_LEDGER_LEN];
+  size_t next_;  // Oldest entry, overwritten next
+  uint32_t duplicates_;
+  HedgePathStats stats_[HEDGE_PATH_COUNT];
+};
+
+#endif // HEDGED_INTAKE_H
@@ -0,0 +1,328 @@
+/**
+ * Lumina Bridge Common - Kernel Benchmarks
+ *
+ * Inputs are fixed and realistic: a poll response carrying one applyJson
+ * command, and a 150-LED single-segment WLED state before and after a
+ * brightness, effect and colour change. Each CPU kernel runs `iterations`
+ * times after one warm-up run; its result feeds a checksum so the
+ * compiler cannot drop the work.
+ *
+ * The state kernels run twice, on the DOM and on the packed form
+ * (wled_packed.h), and the report says how many bytes each holds. The
+ * payload kernels encode the after state and a state command each way the
+ * MQTT bridge can send them, and the report gives their sizes.
+ */
+
+#include "kernel_bench.h"
+
+#include "coop.h"
+#include "coop_bench.h"
+#include "coop_tcp.h"
+#include "ddp.h"
+#include "dict_codec.h"
+#include "firestore_json.h"
+#include "latency_stats.h"
+#include "lz4_block.h"
+#include "wled_packed.h"
+#include "wled_state.h"
+
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#endif
+
+static const char COMMAND_RESPONSE[] = R"json(
+[{"document":{"name":"projects/lumina/databases/(default)/documents/users/u1/commands/c1",
+"fields":{"type":{"stringValue":"applyJson"},"status":{"stringValue":"pending"},
+"controllerId":{"stringValue":"ctrl-1"},
+"controllerIp":{"stringValue":"192.168.1.50"},
+"version":{"integerValue":"1735689600123"},
+"payload":{"mapValue":{"fields":{"on":{"booleanValue":true},
+"bri":{"integerValue":"180"},"transition":{"integerValue":"7"},
+"seg":{"arrayValue":{"values":[{"mapValue":{"fields":{"id":{"integerValue":"0"},
+"fx":{"integerValue":"9"},"sx":{"integerValue":"128"},"ix":{"integerValue":"200"},
+"col":{"arrayValue":{"values":[{"arrayValue":{"values":[{"integerValue":"255"},
+{"integerValue":"120"},{"integerValue":"0"}]}}]}}}}}]}}}}},
+"createdAt":{"timestampValue":"2025-01-01T00:00:00Z"}},
+"createTime":"2025-01-01T00:00:00.000000Z",
+"updateTime":"2025-01-01T00:00:00.000000Z"},
+"readTime":"2025-01-01T00:00:00.100000Z"}]
+)json";
+
+static const char STATE_BEFORE[] = R"json(
+{"on":true,"bri":128,"transition":7,"ps":-1,"pl":-1,"nl":{"on":false,"dur":60,
+"mode":1,"tbri":0,"rem":-1},"udpn":{"send":false,"recv":true},"lor":0,"mainseg":0,
+"seg":[{"id":0,"start":0,"stop":150,"len":150,"grp":1,"spc":0,"of":0,"on":true,
+"frz":false,"bri":255,"cct":127,"col":[[255,160,0],[0,0,0],[0,0,0]],"fx":0,"sx":128,
+"ix":128,"pal":0,"sel":true,"rev":false,"mi":false}]}
+)json";
+
+static const char STATE_AFTER[] = R"json(
+{"on":true,"bri":180,"transition":7,"ps":-1,"pl":-1,"nl":{"on":false,"dur":60,
+"mode":1,"tbri":0,"rem":-1},"udpn":{"send":false,"recv":true},"lor":0,"mainseg":0,
+"seg":[{"id":0,"start":0,"stop":150,"len":150,"grp":1,"spc":0,"of":0,"on":true,
+"frz":false,"bri":255,"cct":127,"col":[[255,120,0],[0,0,0],[0,0,0]],"fx":9,"sx":128,
+"ix":128,"pal":0,"sel":true,"rev":false,"mi":false}]}
+)json";
+
+static const char STATE_COMMAND[] = R"json(
+{"action":"setState","payload":{"on":true,"bri":180,"seg":[{"id":0,"col":[[255,120,0]],
+"fx":9,"sx":128,"ix":200,"pal":0}]},"version":1735689600123}
+)json";
+
+static const char DOCUMENTS_PATH[] = "projects/lumina/databases/(default)/documents/users/";
+static const uint16_t DDP_PIXELS = 480;
+
+static volatile uint32_t checksum;
+
+// Runs `kernel` once to warm up, then `iterations` times, and records the
+// mean time per run
+template <typename Kernel>
+static void timeKernel(JsonObject kernels, const char* name, uint32_t iterations,
+                       Kernel kernel) {
+  checksum += kernel();
+  uint64_t started = benchMicros();
+  for (uint32_t i = 0; i < iterations; i++) {
+    checksum += kernel();
+  }
+  uint64_t elapsed = benchMicros() - started;
+
+  JsonObject out = kernels[name].to<JsonObject>();
+  out["n"] = iterations;
+  out["ns"] = (uint32_t)(elapsed * 1000 / iterations);
+}
+
+// Counts the bytes a JsonDocument holds, for comparing with the packed state
+class CountingAllocator : public ArduinoJson::Allocator {
+ public:
+  size_t bytes = 0;
+
+  void* allocate(size_t size) override {
+    size_t* block = (size_t*)malloc(sizeof(size_t) + size);
+    if (block == nullptr) return nullptr;
+    *block = size;
+    bytes += size;
+    return block + 1;
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr == nullptr) return;
+    size_t* block = (size_t*)ptr - 1;
+    bytes -= *block;
+    free(block);
+  }
+
+  void* reallocate(void* ptr, size_t size) override {
+    size_t* block = ptr != nullptr ? (size_t*)ptr - 1 : nullptr;
+    size_t old = block != nullptr ? *block : 0;
+    block = (size_t*)realloc(block, sizeof(size_t) + size);
+    if (block == nullptr) return nullptr;
+    *block = size;
+    bytes = bytes - old + size;
+    return block + 1;
+  }
+};
+
+static void addLatency(JsonObject out, const char* unit, const LatencyStats& stats) {
+  out["n"] = stats.count() + stats.failures();
+  JsonArray times = out[unit].to<JsonArray>();
+  times.add(stats.percentile(50));
+  times.add(stats.max());
+  out["fail"] = stats.failures();
+}
+
+static void benchTls(const KernelBenchConfig& config, JsonObject kernels) {
+#ifdef ESP_PLATFORM
+  LatencyStats stats;
+  for (uint8_t i = 0; i < config.networkTries; i++) {
+    WiFiClientSecure client;
+    client.setInsecure();  // Handshake cost only; certificate checks vary by bridge
+    uint64_t started = benchMicros();
+    if (client.connect(config.tlsHost, config.tlsPort)) {
+      stats.add((benchMicros() - started) / 1000);
+    } else {
+      stats.addFailure();
+    }
+    client.stop();
+  }
+  addLatency(kernels["tlsHandshake"].to<JsonObject>(), "ms", stats);
+#else
+  // The host build has no TLS stack of its own
+  kernels["tlsHandshake"]["skipped"] = true;
+#endif
+}
+
+static void benchWled(const KernelBenchConfig& config, JsonObject kernels) {
+  LatencyStats stats;
+  CoopHttpGet get;
+  CoopScheduler scheduler;
+  for (uint8_t i = 0; i < config.networkTries; i++) {
+    get.begin(config.wledIp, "/json/info", 2000);
+    scheduler.spawn(get);
+    uint64_t started = benchMicros();
+    scheduler.runAll(3000);
+    if (get.status() == 200) {
+      stats.add(benchMicros() - started);
+    } else {
+      stats.addFailure();
+    }
+  }
+  addLatency(kernels["wledRoundTrip"].to<JsonObject>(), "us", stats);
+}
+
+void runKernelBench(const KernelBenchConfig& config, JsonObject report) {
+  uint32_t iterations = config.iterations > 0 ? config.iterations : 1;
+
+  JsonObject board = report["board"].to<JsonObject>();
+#ifdef ESP_PLATFORM
+  board["chip"] = ESP.getChipModel();
+  board["mhz"] = ESP.getCpuFreqMHz();
+  board["freeHeap"] = ESP.getFreeHeap();
+#else
+  board["chip"] = "host";
+#endif
+
+  JsonObject kernels = report["kernels"].to<JsonObject>();
+
+  timeKernel(kernels, "commandParse", iterations, []() -> uint32_t {
+    JsonDocument doc;
+    deserializeJson(doc, COMMAND_RESPONSE);
+    return (uint32_t)doc.size();
+  });
+
+  JsonDocument command;
+  deserializeJson(command, COMMAND_RESPONSE);
+  JsonObjectConst payload = command[0]["document"]["fields"]["payload"]["mapValue"]["fields"];
+  timeKernel(kernels, "firestoreConvert", iterations, [&payload]() -> uint32_t {
+    JsonDocument doc;
+    firestoreFieldsToJson(payload, doc.to<JsonObject>());
+    char body[256];
+    return (uint32_t)serializeJson(doc, body, sizeof(body));
+  });
+
+  JsonDocument before, after, delta;
+  deserializeJson(before, STATE_BEFORE);
+  deserializeJson(after, STATE_AFTER);
+  timeKernel(kernels, "stateDiff", iterations, [&]() -> uint32_t {
+    JsonDocument diff;
+    return (uint32_t)wledStateDiff(before.as<JsonObjectConst>(), after.as<JsonObjectConst>(),
+                                   diff.to<JsonObject>());
+  });
+
+  wledStateDiff(before.as<JsonObjectConst>(), after.as<JsonObjectConst>(),
+                delta.to<JsonObject>());
+  timeKernel(kernels, "stateMerge", iterations, [&]() -> uint32_t {
+    JsonDocument state;
+    state.set(before);
+    wledStateMerge(state.as<JsonObject>(), delta.as<JsonObjectConst>());
+    return (uint32_t)state.size();
+  });
+
+  timeKernel(kernels, "stateParse", iterations, []() -> uint32_t {
+    JsonDocument state;
+    deserializeJson(state, STATE_AFTER);
+    return (uint32_t)state.size();
+  });
+  timeKernel(kernels, "stateSerialize", iterations, [&after]() -> uint32_t {
+    char body[768];
+    return (uint32_t)serializeJson(after, body, sizeof(body));
+  });
+
+  timeKernel(kernels, "packedParse", iterations, []() -> uint32_t {
+    WledState state;
+    wledPackedClear(state);
+    wledPackedParse(STATE_AFTER, sizeof(STATE_AFTER) - 1, state);
+    return state.bri;
+  });
+
+  static WledState packedBefore, packedAfter;
+  wledPackedClear(packedBefore);
+  wledPackedClear(packedAfter);
+  wledPackedParse(STATE_BEFORE, sizeof(STATE_BEFORE) - 1, packedBefore);
+  wledPackedParse(STATE_AFTER, sizeof(STATE_AFTER) - 1, packedAfter);
+  timeKernel(kernels, "packedSerialize", iterations, []() -> uint32_t {
+    char body[768];
+    return (uint32_t)wledPackedEmit(packedAfter, body, sizeof(body));
+  });
+  timeKernel(kernels, "packedDiff", iterations, []() -> uint32_t {
+    return wledPackedCompare(packedBefore, packedAfter);
+  });
+  timeKernel(kernels, "packedHash", iterations, []() -> uint32_t {
+    return wledPackedHash(packedAfter);
+  });
+
+  CountingAllocator allocator;
+  JsonDocument dom(&allocator);
+  deserializeJson(dom, STATE_BEFORE);
+  JsonObject stateBytes = report["stateBytes"].to<JsonObject>();
+  stateBytes["dom"] = allocator.bytes;
+  stateBytes["packed"] = sizeof(WledState);
+
+  timeKernel(kernels, "statusSerialize", iterations, []() -> uint32_t {
+    static const char* const statuses[] = {"completed", "completed", "superseded", "failed"};
+    JsonDocument doc;
+    JsonArray writes = doc["writes"].to<JsonArray>();
+    char ref[48];
+    for (int i = 0; i < 4; i++) {
+      snprintf(ref, sizeof(ref), "u1/commands/c%d", i);
+      addFirestoreStatusWrite(writes, DOCUMENTS_PATH, ref, statuses[i],
+                              i == 3 ? "ERROR: HTTP 503" : nullptr, "2025-01-01T00:00:00Z");
+    }
+    char body[1536];
+    return (uint32_t)serializeJson(doc, body, sizeof(body));
+  });
+
+  // Static: 4 KB of codec tables, kept off the loop task's stack
+  static DictCodec codec;
+  static uint8_t frame[1024];
+  static uint8_t decoded[1024];
+  static uint16_t lz4Table[LZ4_TABLE_ENTRIES];
+  codec.select(DICT_NEWEST_VERSION);
+  JsonObject payloadBytes = report["payloadBytes"].to<JsonObject>();
+  const char* const payloadNames[] = {"state", "command"};
+  const char* const payloads[] = {STATE_AFTER, STATE_COMMAND};
+  for (int i = 0; i < 2; i++) {
+    JsonDocument doc;
+    deserializeJson(doc, payloads[i]);
+    char json[768];
+    size_t jsonLength = serializeJson(doc, json, sizeof(json));
+    JsonArray sizes = payloadBytes[payloadNames[i]].to<JsonArray>();
+    sizes.add(jsonLength);
+    sizes.add(measureMsgPack(doc));
+    sizes.add(lz4Compress((const uint8_t*)json, jsonLength, frame, sizeof(frame), lz4Table));
+    sizes.add(codec.encode((const uint8_t*)json, jsonLength, frame, sizeof(frame)));
+  }
+
+  char stateJson[768];
+  size_t stateLength = serializeJson(after, stateJson, sizeof(stateJson));
+  timeKernel(kernels, "msgpackSerialize", iterations, [&after]() -> uint32_t {
+    uint8_t packed[512];
+    return (uint32_t)serializeMsgPack(after, packed, sizeof(packed));
+  });
+  static uint8_t packedState[512];
+  size_t packedLength = serializeMsgPack(after, packedState, sizeof(packedState));
+  timeKernel(kernels, "msgpackParse", iterations, [packedLength]() -> uint32_t {
+    JsonDocument state;
+    deserializeMsgPack(state, packedState, packedLength);
+    return (uint32_t)state.size();
+  });
+  timeKernel(kernels, "dictEncode", iterations, [&stateJson, stateLength]() -> uint32_t {
+    return (uint32_t)codec.encode((const uint8_t*)stateJson, stateLength, frame, sizeof(frame));
+  });
+  size_t frameLength = codec.encode((const uint8_t*)stateJson, stateLength, frame, sizeof(frame));
+  timeKernel(kernels, "dictDecode", iterations, [frameLength]() -> uint32_t {
+    return (uint32_t)dictDecode(frame, frameLength, decoded, sizeof(decoded));
+  });
+
+  static uint8_t pixels[DDP_PIXELS * 3];
+  static uint8_t packet[DDP_HEADER_LEN + DDP_PIXELS * 3];
+  for (size_t i = 0; i < sizeof(pixels); i++) pixels[i] = i * 7;
+  timeKernel(kernels, "ddpEncode", iterations, []() -> uint32_t {
+    return (uint32_t)ddpEncode(packet, sizeof(packet), pixels, sizeof(pixels), 0, 1, true);
+  });
+
+  if (config.tlsHost != nullptr && config.tlsHost[0] != '\0') benchTls(config, kernels);
+  if (config.wledIp != nullptr && config.wledIp[0] != '\0') benchWled(config, kernels);
+}
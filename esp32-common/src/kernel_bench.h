@@ -0,0 +1,53 @@
+// Lumina Bridge Common - Kernel Benchmarks
+//
+// Times the bridges' hot paths one at a time on fixed inputs, so boards
+// (ESP32, ESP32-S3, ESP32-C3) can be compared with each other and with the
+// native host build (esp32-common/bench):
+//
+//   commandParse     parse a Firestore runQuery response with one command
+//   firestoreConvert Firestore typed payload to WLED JSON
+//   stateDiff        top-level delta between two WLED states
+//   stateMerge       apply that delta back to the old state
+//   stateParse       WLED state JSON into a JsonDocument
+//   stateSerialize   that document back to JSON
+//   packedParse      the same JSON into a WledState (wled_packed.h)
+//   packedSerialize  a WledState to JSON
+//   packedDiff       field-wise change mask between two WledStates
+//   packedHash       hash of a WledState
+//   statusSerialize  build and serialize a four-status documents:commit
+//   msgpackSerialize the after state as MessagePack
+//   msgpackParse     that MessagePack into a JsonDocument
+//   dictEncode       the after state's JSON compressed against the newest
+//                    payload dictionary (dict_codec.h)
+//   dictDecode       that frame back to JSON
+//   ddpEncode        one 480-pixel DDP packet
+//   tlsHandshake     TLS connect to a configured host (device only)
+//   wledRoundTrip    GET /json/info from a controller
+//
+// CPU kernels report nanoseconds per operation; the network ones report
+// median and worst time over a few tries.
+
+#ifndef KERNEL_BENCH_H
+#define KERNEL_BENCH_H
+
+#include <ArduinoJson.h>
+
+struct KernelBenchConfig {
+  uint32_t iterations;   // Per CPU kernel
+  const char* tlsHost;   // "" skips the TLS handshake
+  uint16_t tlsPort;
+  const char* wledIp;    // "" skips the WLED round trip
+  uint8_t networkTries;  // Per network kernel
+};
+
+// Runs every kernel and fills `report`:
+//   {"board": {"chip", "mhz", "freeHeap"},
+//    "kernels": {"commandParse": {"n", "ns"}, ...,
+//                "tlsHandshake": {"n", "ms": [median, max], "fail"},
+//                "wledRoundTrip": {"n", "us": [median, max], "fail"}},
+//    "stateBytes": {"dom", "packed"},
+//    "payloadBytes": {"state": [json, msgpack, lz4, dict],
+//                     "command": [json, msgpack, lz4, dict]}}
+void runKernelBench(const KernelBenchConfig& config, JsonObject report);
+
+#endif // KERNEL_BENCH_H
@@ -0,0 +1,443 @@
+/**
+ * Lumina Bridge Common - LAN MQTT Broker
+ *
+ * Each poll() reads what every socket has, then handles the complete
+ * packets in the client's buffer. A packet is sent with one send() from
+ * the shared buffer; a client whose socket cannot take a whole packet is
+ * dropped rather than buffered for, since a controller that far behind is
+ * better off reconnecting.
+ */
+
+#include "lan_broker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include "mqtt_packet.h"
+
+static void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+LanBroker::LanBroker() : listenFd_(-1), handler_(nullptr), context_(nullptr) {
+  username_[0] = '\0';
+  password_[0] = '\0';
+  memset(clients_, 0, sizeof(clients_));
+  for (Client& c : clients_) c.fd = -1;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+LanBroker::~LanBroker() {
+  end();
+}
+
+bool LanBroker::begin(uint16_t port, const char* username, const char* password) {
+  end();
+  snprintf(username_, sizeof(username_), "%s", username != nullptr ? username : "");
+  snprintf(password_, sizeof(password_), "%s", password != nullptr ? password : "");
+
+  listenFd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listenFd_ < 0) return false;
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(listenFd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listenFd_, LAN_BROKER_MAX_CLIENTS) != 0) {
+    end();
+    return false;
+  }
+  setNonBlocking(listenFd_);
+  return true;
+}
+
+void LanBroker::end() {
+  for (Client& c : clients_) {
+    if (c.fd >= 0) drop(c, false);
+  }
+  if (listenFd_ >= 0) {
+    close(listenFd_);
+    listenFd_ = -1;
+  }
+}
+
+void LanBroker::setHandler(LanBrokerHandler handler, void* context) {
+  handler_ = handler;
+  context_ = context;
+}
+
+// ============================================================================
+// Polling
+// ============================================================================
+
+void LanBroker::poll(uint32_t nowMs) {
+  if (listenFd_ < 0) return;
+  deliverWills();
+  accept(nowMs);
+
+  for (Client& c : clients_) {
+    if (c.fd < 0) continue;
+    read(c, nowMs);
+    if (c.fd < 0) continue;
+
+    // Keepalive: the spec allows one and a half periods of silence
+    bool late = c.connected
+                    ? c.keepAliveSec > 0 && nowMs - c.lastHeardAt > c.keepAliveSec * 1500UL
+                    : nowMs - c.acceptedAt > LAN_BROKER_CONNECT_TIMEOUT_SEC * 1000UL;
+    if (late) {
+      stats_.timeouts++;
+      drop(c, true);
+    }
+  }
+  deliverWills();
+}
+
+void LanBroker::accept(uint32_t nowMs) {
+  for (;;) {
+    struct sockaddr_in addr;
+    socklen_t addrLength = sizeof(addr);
+    int fd = ::accept(listenFd_, (struct sockaddr*)&addr, &addrLength);
+    if (fd < 0) return;
+
+    Client* slot = nullptr;
+    for (Client& c : clients_) {
+      if (c.fd < 0 && !c.willDue) {
+        slot = &c;
+        break;
+      }
+    }
+    if (slot == nullptr) {
+      close(fd);
+      stats_.refused++;
+      continue;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setNonBlocking(fd);
+
+    memset(slot, 0, offsetof(Client, rx));
+    slot->fd = fd;
+    slot->acceptedAt = nowMs;
+    slot->lastHeardAt = nowMs;
+    inet_ntop(AF_INET, &addr.sin_addr, slot->ip, sizeof(slot->ip));
+    stats_.accepted++;
+  }
+}
+
+void LanBroker::read(Client& c, uint32_t nowMs) {
+  for (;;) {
+    int n = recv(c.fd, c.rx + c.rxLength, sizeof(c.rx) - c.rxLength, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      drop(c, true);
+      return;
+    }
+    if (n < 0) break;
+    c.rxLength += n;
+    c.lastHeardAt = nowMs;
+    stats_.bytesIn += n;
+
+    // Handle every complete packet, then keep what is left of the next
+    size_t offset = 0;
+    for (;;) {
+      size_t headerLength = 0;
+      int32_t length = mqttPacketLength(c.rx + offset, c.rxLength - offset, headerLength);
+      if (length < 0 || (length == 0 && c.rxLength - offset == sizeof(c.rx)) ||
+          length > (int32_t)sizeof(c.rx)) {
+        drop(c, true);  // Malformed, or larger than a client may send
+        return;
+      }
+      if (length == 0 || (size_t)length > c.rxLength - offset) break;
+      if (!handle(c, c.rx + offset, headerLength, length, nowMs)) {
+        if (c.fd >= 0) drop(c, true);
+        return;
+      }
+      if (c.fd < 0) return;
+      offset += length;
+    }
+    memmove(c.rx, c.rx + offset, c.rxLength - offset);
+    c.rxLength -= offset;
+  }
+}
+
+// ============================================================================
+// Packets
+// ============================================================================
+
+// False to drop the client
+bool LanBroker::handle(Client& c, const uint8_t* packet, size_t headerLength, size_t length,
+                       uint32_t nowMs) {
+  uint8_t type = packet[0] >> 4;
+  const uint8_t* body = packet + headerLength;
+  size_t bodyLength = length - headerLength;
+
+  if (!c.connected) return type == MQTT_CONNECT && handleConnect(c, body, bodyLength, nowMs);
+
+  switch (type) {
+    case MQTT_PUBLISH: {
+      MqttPublish message;
+      if (!mqttParsePublish(packet[0], body, bodyLength, message)) return false;
+      stats_.publishesIn++;
+      if (message.qos == 1) {
+        uint8_t ack[4];
+        if (!send(c, ack, mqttBuildAck(ack, sizeof(ack), MQTT_PUBACK, message.packetId))) {
+          return true;
+        }
+      }
+      char topic[LAN_BROKER_FILTER_LEN + 16];
+      if (!message.topic.copyTo(topic, sizeof(topic))) return true;  // Ignored
+      if (handler_ != nullptr) {
+        handler_(index(c), topic, message.payload, message.payloadLength, context_);
+      }
+      route(topic, message.payload, message.payloadLength);
+      return true;
+    }
+    case MQTT_SUBSCRIBE:
+      subscribe(c, body, bodyLength);
+      return true;
+    case MQTT_UNSUBSCRIBE:
+      unsubscribe(c, body, bodyLength);
+      return true;
+    case MQTT_PINGREQ: {
+      uint8_t pong[2];
+      send(c, pong, mqttBuildEmpty(pong, sizeof(pong), MQTT_PINGRESP));
+      return true;
+    }
+    case MQTT_PUBACK:
+      return true;
+    case MQTT_DISCONNECT:
+      drop(c, false);
+      return true;
+    default:
+      return false;  // A second CONNECT, or a packet a client never sends
+  }
+}
+
+bool LanBroker::handleConnect(Client& c, const uint8_t* body, size_t length, uint32_t nowMs) {
+  MqttConnect connect;
+  if (!mqttParseConnect(body, length, connect)) return false;
+
+  MqttConnectCode code = MQTT_ACCEPTED;
+  if (connect.protocolLevel != 4) {
+    code = MQTT_REFUSED_PROTOCOL;
+  } else if (!connect.clientId.copyTo(c.id, sizeof(c.id))) {
+    code = MQTT_REFUSED_IDENTIFIER;
+  } else if (username_[0] != '\0' &&
+             (!connect.username.equals(username_) || !connect.password.equals(password_))) {
+    code = MQTT_REFUSED_CREDENTIALS;
+  }
+
+  uint8_t ack[4];
+  size_t ackLength = mqttBuildConnack(ack, sizeof(ack), code);
+  if (code != MQTT_ACCEPTED) {
+    send(c, ack, ackLength);
+    stats_.refused++;
+    return false;
+  }
+
+  // A client reconnecting under the same ID replaces its old connection
+  for (Client& other : clients_) {
+    if (&other != &c && other.connected && c.id[0] != '\0' && strcmp(other.id, c.id) == 0) {
+      drop(other, false);
+    }
+  }
+
+  if (connect.hasWill) {
+    // A will too long to keep is dropped; the client still connects
+    if (!connect.willTopic.copyTo(c.willTopic, sizeof(c.willTopic)) ||
+        !connect.willMessage.copyTo(c.willMessage, sizeof(c.willMessage))) {
+      c.willTopic[0] = '\0';
+    }
+  }
+  c.keepAliveSec = connect.keepAliveSec;
+  c.connected = true;
+  c.connectedAt = nowMs;
+  stats_.connects++;
+  return send(c, ack, ackLength);
+}
+
+void LanBroker::subscribe(Client& c, const uint8_t* body, size_t length) {
+  uint16_t packetId;
+  if (!mqttParsePacketId(body, length, packetId)) return;
+
+  size_t offset = 0;
+  size_t count = 0;
+  MqttString filter;
+  while (mqttNextFilter(body, length, true, offset, filter, nullptr)) {
+    count++;
+    char text[LAN_BROKER_FILTER_LEN];
+    if (!filter.copyTo(text, sizeof(text))) continue;
+
+    int free = -1;
+    bool have = false;
+    for (int i = 0; i < LAN_BROKER_MAX_FILTERS; i++) {
+      if (strcmp(c.filters[i], text) == 0) have = true;
+      if (c.filters[i][0] == '\0' && free < 0) free = i;
+    }
+    if (!have && free >= 0) memcpy(c.filters[free], text, sizeof(text));
+
+    // WLED subscribes to "{deviceTopic}/api" before its group topic
+    size_t textLength = strlen(text);
+    if (c.topic[0] == '\0' && textLength > 4 && strcmp(text + textLength - 4, "/api") == 0) {
+      memcpy(c.topic, text, textLength - 4);
+      c.topic[textLength - 4] = '\0';
+    }
+  }
+  // Every filter is granted QoS 0, even one there was no room for: the
+  // client would drop the connection over a refusal and try again
+  uint8_t ack[2 + 4 + 2 + LAN_BROKER_MAX_FILTERS * 2];
+  size_t ackLength = mqttBuildSuback(ack, sizeof(ack), packetId, count);
+  if (ackLength > 0) send(c, ack, ackLength);
+}
+
+void LanBroker::unsubscribe(Client& c, const uint8_t* body, size_t length) {
+  uint16_t packetId;
+  if (!mqttParsePacketId(body, length, packetId)) return;
+
+  size_t offset = 0;
+  MqttString filter;
+  while (mqttNextFilter(body, length, false, offset, filter, nullptr)) {
+    for (int i = 0; i < LAN_BROKER_MAX_FILTERS; i++) {
+      if (filter.equals(c.filters[i])) c.filters[i][0] = '\0';
+    }
+  }
+  uint8_t ack[4];
+  send(c, ack, mqttBuildAck(ack, sizeof(ack), MQTT_UNSUBACK, packetId));
+}
+
+// ============================================================================
+// Delivery
+// ============================================================================
+
+size_t LanBroker::publish(const char* topic, const uint8_t* payload, size_t length) {
+  return route(topic, payload, length);
+}
+
+// Builds the packet once and sends it to every matching subscriber
+size_t LanBroker::route(const char* topic, const uint8_t* payload, size_t length) {
+  size_t topicLength = strlen(topic);
+  size_t packetLength = 0;
+  size_t sent = 0;
+  for (Client& c : clients_) {
+    if (!c.connected) continue;
+    bool match = false;
+    for (int i = 0; i < LAN_BROKER_MAX_FILTERS && !match; i++) {
+      match = c.filters[i][0] != '\0' && mqttTopicMatches(c.filters[i], topic, topicLength);
+    }
+    if (!match) continue;
+
+    if (packetLength == 0) {
+      packetLength = mqttBuildPublish(tx_, sizeof(tx_), topic, payload, length, false);
+      if (packetLength == 0) return 0;
+    }
+    if (send(c, tx_, packetLength)) {
+      stats_.publishesOut++;
+      sent++;
+    }
+  }
+  return sent;
+}
+
+void LanBroker::deliverWills() {
+  for (Client& c : clients_) {
+    if (!c.willDue) continue;
+    c.willDue = false;
+    size_t willLength = strlen(c.willMessage);
+    if (handler_ != nullptr) {
+      handler_(index(c), c.willTopic, (const uint8_t*)c.willMessage, willLength, context_);
+    }
+    route(c.willTopic, (const uint8_t*)c.willMessage, willLength);
+  }
+}
+
+bool LanBroker::send(Client& c, const uint8_t* data, size_t length) {
+  if (length == 0 || c.fd < 0) return false;
+  int n = ::send(c.fd, data, length, 0);
+  if (n != (int)length) {
+    drop(c, true);
+    return false;
+  }
+  stats_.bytesOut += n;
+  return true;
+}
+
+void LanBroker::drop(Client& c, bool publishWill) {
+  if (c.fd < 0) return;
+  close(c.fd);
+  c.fd = -1;
+  c.rxLength = 0;
+
+  bool wasConnected = c.connected;
+  c.connected = false;
+  if (!wasConnected) return;
+  stats_.disconnects++;
+
+  // Sent from poll(): a drop can happen while a packet is being routed
+  c.willDue = publishWill && c.willTopic[0] != '\0';
+}
+
+// ============================================================================
+// Clients
+// ============================================================================
+
+bool LanBroker::connected(int client) const {
+  return valid(client);
+}
+
+int LanBroker::findByIp(const char* ip) const {
+  for (int i = 0; i < LAN_BROKER_MAX_CLIENTS; i++) {
+    if (valid(i) && strcmp(clients_[i].ip, ip) == 0) return i;
+  }
+  return -1;
+}
+
+int LanBroker::findByTopic(const char* deviceTopic) const {
+  for (int i = 0; i < LAN_BROKER_MAX_CLIENTS; i++) {
+    if (valid(i) && strcmp(clients_[i].topic, deviceTopic) == 0) return i;
+  }
+  return -1;
+}
+
+const char* LanBroker::clientId(int client) const {
+  return valid(client) ? clients_[client].id : "";
+}
+
+const char* LanBroker::deviceTopic(int client) const {
+  return valid(client) ? clients_[client].topic : "";
+}
+
+const char* LanBroker::ip(int client) const {
+  return valid(client) ? clients_[client].ip : "";
+}
+
+uint32_t LanBroker::connectedAt(int client) const {
+  return valid(client) ? clients_[client].connectedAt : 0;
+}
+
+size_t LanBroker::clientCount() const {
+  size_t count = 0;
+  for (int i = 0; i < LAN_BROKER_MAX_CLIENTS; i++) {
+    if (valid(i)) count++;
+  }
+  return count;
+}
+
+size_t LanBroker::clientBytes() {
+  return sizeof(Client);
+}
@@ -0,0 +1,141 @@
+// Lumina Bridge Common - LAN MQTT Broker
+//
+// A small MQTT 3.1.1 broker for the controllers on the bridge's LAN. WLED
+// has a plain-MQTT client: pointed at the bridge, each controller keeps
+// one connection open, takes JSON commands published to "{topic}/api" and
+// publishes its own changes ("{topic}/g", "/c", "/v", "/status"). The
+// bridge then writes to a controller without a TCP handshake per command,
+// and hears about changes made at the controller as they happen instead
+// of polling for them.
+//
+// What WLED needs and no more:
+// - QoS 0 delivery; a QoS 1 publish from a client is acknowledged and
+//   delivered at QoS 0. QoS 2 and retained messages are not supported.
+// - Up to LAN_BROKER_MAX_CLIENTS clients with LAN_BROKER_MAX_FILTERS
+//   subscriptions each (WLED uses six). A client's device topic is taken
+//   from its first "{topic}/api" subscription.
+// - Wills are delivered when a client drops without DISCONNECT or misses
+//   its keepalive, so "{topic}/status" reads "offline" as WLED intends.
+//
+// Memory is fixed: a client slot holds its receive buffer (packets from
+// controllers are small), and one shared buffer builds outgoing packets.
+// Sockets are non-blocking and poll() never waits, so it runs from the
+// bridge's loop(). Times are the caller's clock; tools/lan_broker_sim.cpp
+// runs the same code on a host.
+
+#ifndef LAN_BROKER_H
+#define LAN_BROKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAN_BROKER_MAX_CLIENTS 8
+#define LAN_BROKER_MAX_FILTERS 6
+#define LAN_BROKER_FILTER_LEN 40   // WLED topics are up to 32 characters, plus "/api"
+#define LAN_BROKER_ID_LEN 24
+#define LAN_BROKER_WILL_LEN 16
+#define LAN_BROKER_RX_LEN 1024     // Largest packet a client may send
+#define LAN_BROKER_TX_LEN 2176     // Largest packet the broker sends (a 2 KB command)
+
+// Seconds a new connection has to send CONNECT
+#define LAN_BROKER_CONNECT_TIMEOUT_SEC 5
+
+struct LanBrokerStats {
+  uint32_t accepted;     // TCP connections accepted
+  uint32_t refused;      // Turned away: no free slot, bad CONNECT or credentials
+  uint32_t connects;     // CONNECTs accepted
+  uint32_t disconnects;  // Clients gone, cleanly or not
+  uint32_t timeouts;     // Of those, missed CONNECT or keepalive
+  uint32_t publishesIn;  // PUBLISH packets from clients
+  uint32_t publishesOut; // PUBLISH packets sent to clients
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+};
+
+// A message a client published; `client` is its slot
+typedef void (*LanBrokerHandler)(int client, const char* topic, const uint8_t* payload,
+                                 size_t length, void* context);
+
+class LanBroker {
+ public:
+  LanBroker();
+  ~LanBroker();
+
+  // Listens on `port`. Empty credentials accept any client.
+  bool begin(uint16_t port, const char* username, const char* password);
+  void end();
+
+  // Called for every message a client publishes, before it is passed on
+  // to subscribed clients, and for wills
+  void setHandler(LanBrokerHandler handler, void* context);
+
+  // Accepts connections, reads what clients sent and answers it, and drops
+  // clients that went quiet. Never blocks.
+  void poll(uint32_t nowMs);
+
+  // Sends a QoS 0 message to every client subscribed to `topic`; returns
+  // how many got it
+  size_t publish(const char* topic, const uint8_t* payload, size_t length);
+
+  // Client slots, 0 to LAN_BROKER_MAX_CLIENTS - 1. Lookups return -1 if no
+  // connected client matches.
+  bool connected(int client) const;
+  int findByIp(const char* ip) const;
+  int findByTopic(const char* deviceTopic) const;
+  const char* clientId(int client) const;
+  const char* deviceTopic(int client) const;  // "" until it subscribes to /api
+  const char* ip(int client) const;
+  uint32_t connectedAt(int client) const;
+  size_t clientCount() const;
+
+  // Bytes of broker memory each client slot takes
+  static size_t clientBytes();
+
+  const LanBrokerStats& stats() const { return stats_; }
+
+ private:
+  struct Client {
+    int fd;
+    bool connected;       // CONNECT accepted
+    uint16_t keepAliveSec;
+    uint32_t acceptedAt;
+    uint32_t lastHeardAt;
+    uint32_t connectedAt;
+    char ip[16];
+    char id[LAN_BROKER_ID_LEN];
+    char topic[LAN_BROKER_FILTER_LEN];
+    char filters[LAN_BROKER_MAX_FILTERS][LAN_BROKER_FILTER_LEN];
+    char willTopic[LAN_BROKER_FILTER_LEN];
+    char willMessage[LAN_BROKER_WILL_LEN];
+    bool willDue;         // Dropped; the will goes out on the next poll()
+    uint16_t rxLength;
+    uint8_t rx[LAN_BROKER_RX_LEN];
+  };
+
+  void accept(uint32_t nowMs);
+  void read(Client& c, uint32_t nowMs);
+  bool handle(Client& c, const uint8_t* packet, size_t headerLength, size_t length,
+              uint32_t nowMs);
+  bool handleConnect(Client& c, const uint8_t* body, size_t length, uint32_t nowMs);
+  void subscribe(Client& c, const uint8_t* body, size_t length);
+  void unsubscribe(Client& c, const uint8_t* body, size_t length);
+  size_t route(const char* topic, const uint8_t* payload, size_t length);
+  void deliverWills();
+  bool send(Client& c, const uint8_t* data, size_t length);
+  void drop(Client& c, bool publishWill);
+  int index(const Client& c) const { return (int)(&c - clients_); }
+  bool valid(int client) const {
+    return client >= 0 && client < LAN_BROKER_MAX_CLIENTS && clients_[client].connected;
+  }
+
+  int listenFd_;
+  char username_[32];
+  char password_[32];
+  LanBrokerHandler handler_;
+  void* context_;
+  Client clients_[LAN_BROKER_MAX_CLIENTS];
+  uint8_t tx_[LAN_BROKER_TX_LEN];
+  LanBrokerStats stats_;
+};
+
+#endif // LAN_BROKER_H
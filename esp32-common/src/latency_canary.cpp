@@ -0,0 +1,86 @@
+/**
+ * Lumina Bridge Common - Latency Canary
+ *
+ * Times are kept relative to start(), so millis() wrapping during a
+ * canary does not matter. The next canary is scheduled from when the last
+ * one started, not when it finished, so a slow path does not stretch the
+ * interval.
+ */
+
+#include "latency_canary.h"
+
+#include <string.h>
+
+LatencyCanary::LatencyCanary(uint32_t intervalMs, uint32_t timeoutMs)
+    : intervalMs_(intervalMs), timeoutMs_(timeoutMs), nextAt_(0), startedAt_(0),
+      sequence_(0), inFlight_(false), head_(0), count_(0) {
+  memset(&current_, 0, sizeof(current_));
+  memset(series_, 0, sizeof(series_));
+}
+
+void LatencyCanary::begin(uint32_t nowMs, uint32_t offsetMs) {
+  nextAt_ = nowMs + offsetMs;
+}
+
+bool LatencyCanary::due(uint32_t nowMs) {
+  if (!enabled()) return false;
+  if (inFlight_) {
+    if (nowMs - startedAt_ < timeoutMs_) return false;
+    record(false);
+  }
+  return (int32_t)(nowMs - nextAt_) >= 0;
+}
+
+uint32_t LatencyCanary::start(uint32_t nowMs) {
+  if (inFlight_) record(false);
+  sequence_++;
+  inFlight_ = true;
+  startedAt_ = nowMs;
+  nextAt_ = nowMs + intervalMs_;
+  memset(&current_, 0, sizeof(current_));
+  current_.startedSec = nowMs / 1000;
+  return sequence_;
+}
+
+void LatencyCanary::sent(uint32_t sequence, uint32_t nowMs) {
+  if (inFlight_ && sequence == sequence_) current_.sendMs = nowMs - startedAt_;
+}
+
+void LatencyCanary::received(uint32_t sequence, uint32_t nowMs) {
+  if (inFlight_ && sequence == sequence_ && current_.receiveMs == 0) {
+    current_.receiveMs = nowMs - startedAt_;
+  }
+}
+
+void LatencyCanary::finished(uint32_t sequence, bool ok, uint32_t nowMs) {
+  if (!inFlight_ || sequence != sequence_) return;
+  if (ok && current_.receiveMs == 0) return;  // An older canary's command
+  if (ok) current_.totalMs = nowMs - startedAt_;
+  record(ok);
+}
+
+size_t LatencyCanary::count() const {
+  return count_;
+}
+
+const CanarySample& LatencyCanary::sample(size_t index) const {
+  return series_[(head_ + CANARY_SERIES_LEN - count_ + index) % CANARY_SERIES_LEN];
+}
+
+void LatencyCanary::clearWindow() {
+  head_ = 0;
+  count_ = 0;
+  totals_.clear();
+}
+
+void LatencyCanary::record(bool ok) {
+  inFlight_ = false;
+  series_[head_] = current_;
+  head_ = (head_ + 1) % CANARY_SERIES_LEN;
+  if (count_ < CANARY_SERIES_LEN) count_++;
+  if (ok) {
+    totals_.add(current_.totalMs);
+  } else {
+    totals_.addFailure();
+  }
+}
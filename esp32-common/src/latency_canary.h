@@ -0,0 +1,84 @@
+// Lumina Bridge Common - Latency Canary
+//
+// Every `intervalMs` a bridge sends itself a harmless read (a getInfo
+// command) the way a customer's command travels: up to the cloud, back
+// down to the bridge, through the command queue to WLED. The canary times
+// each leg and keeps the series, so slow remote control shows up in the
+// data before a customer calls about it.
+//
+//   start()     the bridge is about to send a canary; returns its sequence
+//   sent()      the cloud accepted it (Firestore write, MQTT publish)
+//   received()  it came back to the bridge (poll result, MQTT message)
+//   finished()  WLED answered, or the command failed
+//
+// One canary is in flight at a time. One that has not finished after
+// `timeoutMs` counts as a failure, and a late arrival of it is ignored;
+// so is a success reported before received().
+
+#ifndef LATENCY_CANARY_H
+#define LATENCY_CANARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latency_stats.h"
+
+// Samples kept between two publishes; older ones are overwritten
+#define CANARY_SERIES_LEN 24
+
+struct CanarySample {
+  uint32_t startedSec;  // Bridge uptime when the canary was sent
+  uint32_t sendMs;      // Until the cloud accepted it
+  uint32_t receiveMs;   // Until the bridge had it back; 0 if it never came
+  uint32_t totalMs;     // Until it finished; 0 if it failed or timed out
+};
+
+class LatencyCanary {
+ public:
+  // intervalMs 0 disables the canary
+  LatencyCanary(uint32_t intervalMs, uint32_t timeoutMs);
+
+  // The first canary goes `offsetMs` from now (spread it over an interval,
+  // so a fleet's canaries do not hit the cloud together)
+  void begin(uint32_t nowMs, uint32_t offsetMs);
+
+  bool enabled() const { return intervalMs_ > 0; }
+
+  // Time to send the next canary. Times out one in flight for too long.
+  bool due(uint32_t nowMs);
+
+  uint32_t start(uint32_t nowMs);
+  void sent(uint32_t sequence, uint32_t nowMs);
+  void received(uint32_t sequence, uint32_t nowMs);
+  void finished(uint32_t sequence, bool ok, uint32_t nowMs);
+
+  bool inFlight() const { return inFlight_; }
+  uint32_t sequence() const { return sequence_; }
+
+  // Samples since clearWindow(), oldest first; failures included
+  size_t count() const;
+  const CanarySample& sample(size_t index) const;
+
+  // Round-trip times (totalMs) and failures since clearWindow()
+  const LatencyStats& totals() const { return totals_; }
+
+  // After the window has been published
+  void clearWindow();
+
+ private:
+  void record(bool ok);
+
+  uint32_t intervalMs_;
+  uint32_t timeoutMs_;
+  uint32_t nextAt_;
+  uint32_t startedAt_;
+  uint32_t sequence_;
+  bool inFlight_;
+  CanarySample current_;
+  CanarySample series_[CANARY_SERIES_LEN];
+  size_t head_;   // Next slot to write
+  size_t count_;
+  LatencyStats totals_;
+};
+
+#endif // LATENCY_CANARY_H
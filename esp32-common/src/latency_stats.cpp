@@ -0,0 +1,51 @@
+/**
+ * Lumina Bridge Common - Latency Statistics
+ */
+
+#include "latency_stats.h"
+
+LatencyStats::LatencyStats() {
+  clear();
+}
+
+void LatencyStats::clear() {
+  count_ = 0;
+  failures_ = 0;
+}
+
+void LatencyStats::add(uint32_t sample) {
+  if (count_ >= MAX_SAMPLES) return;
+
+  // Keep the samples sorted; insertion is cheap at this size
+  int i = count_++;
+  while (i > 0 && samples_[i - 1] > sample) {
+    samples_[i] = samples_[i - 1];
+    i--;
+  }
+  samples_[i] = sample;
+}
+
+uint8_t LatencyStats::lossPercent() const {
+  int attempts = count_ + failures_;
+  if (attempts == 0) return 0;
+  return (uint8_t)((failures_ * 100 + attempts / 2) / attempts);
+}
+
+uint32_t LatencyStats::percentile(uint8_t p) const {
+  if (count_ == 0) return 0;
+  if (p >= 100) return samples_[count_ - 1];
+
+  int rank = (p * count_ + 99) / 100;
+  if (rank < 1) rank = 1;
+  return samples_[rank - 1];
+}
+
+uint32_t LatencyStats::mean() const {
+  if (count_ == 0) return 0;
+
+  uint64_t sum = 0;
+  for (int i = 0; i < count_; i++) {
+    sum += samples_[i];
+  }
+  return (uint32_t)(sum / count_);
+}
@@ -0,0 +1,44 @@
+// Lumina Bridge Common - Latency Statistics
+//
+// Collects a bounded number of latency samples and reports percentiles.
+// Samples are in whatever unit the caller records (ms or us). Used by the
+// installer diagnostics and anything else that needs a small latency
+// distribution without heap allocation.
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+class LatencyStats {
+ public:
+  static const int MAX_SAMPLES = 64;
+
+  LatencyStats();
+
+  void clear();
+
+  // Record a successful sample; samples past MAX_SAMPLES are dropped
+  void add(uint32_t sample);
+
+  // Record an attempt that produced no sample (timeout, error)
+  void addFailure() { failures_++; }
+
+  int count() const { return count_; }
+  int failures() const { return failures_; }
+
+  // Percentage of attempts that failed, 0-100
+  uint8_t lossPercent() const;
+
+  // Nearest-rank percentile (0-100) of the successful samples; 0 if none
+  uint32_t percentile(uint8_t p) const;
+  uint32_t max() const { return percentile(100); }
+  uint32_t mean() const;
+
+ private:
+  uint32_t samples_[MAX_SAMPLES];
+  int count_;
+  int failures_;
+};
+
+#endif // LATENCY_STATS_H
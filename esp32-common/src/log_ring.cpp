@@ -0,0 +1,193 @@
+/**
+ * Lumina Bridge Common - Remote Log Ring
+ *
+ * Records are a fixed header and the line's text, laid end to end in a
+ * byte ring and split across the end where they have to be. Nothing is
+ * allocated; peek() renders straight from the ring into the caller's
+ * buffer.
+ */
+
+#include "log_ring.h"
+
+#include <stdio.h>
+#include <string.h>
+
+LogRing::LogRing(const char* const* siteNames, uint8_t siteCount, LogLevel level,
+                 uint8_t burst, uint32_t refillMs, uint16_t sampleEvery, uint32_t cpuBudgetUs,
+                 uint32_t dailyBytes)
+    : siteNames_(siteNames),
+      siteCount_(siteCount > LOG_MAX_SITES ? LOG_MAX_SITES : siteCount),
+      level_(level),
+      burst_(burst),
+      refillMs_(refillMs),
+      sampleEvery_(sampleEvery),
+      cpuBudgetUs_(cpuBudgetUs),
+      dailyBytes_(dailyBytes),
+      cpuSecond_(0),
+      cpuSpent_(0),
+      dayStartedAt_(0),
+      dayBytes_(0),
+      dayStarted_(false),
+      head_(0),
+      used_(0),
+      count_(0) {
+  memset(sites_, 0, sizeof(sites_));
+  for (uint8_t i = 0; i < siteCount_; i++) sites_[i].tokens = burst_;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+char LogRing::levelCode(LogLevel level) {
+  static const char CODES[] = {'E', 'W', 'I', 'D'};
+  return level <= LOG_DEBUG ? CODES[level] : '?';
+}
+
+bool LogRing::admit(LogLevel level, uint8_t site, uint32_t nowMs) {
+  if (level > level_ || site >= siteCount_) {
+    stats_.filtered++;
+    return false;
+  }
+  if (level == LOG_ERROR) return true;
+
+  if (nowMs / 1000 != cpuSecond_) {
+    cpuSecond_ = nowMs / 1000;
+    cpuSpent_ = 0;
+  }
+  if (cpuBudgetUs_ > 0 && cpuSpent_ >= cpuBudgetUs_) {
+    stats_.cpuDropped++;
+    return false;
+  }
+
+  Site& s = sites_[site];
+  if (refillMs_ > 0) {
+    uint32_t refills = (nowMs - s.refilledAt) / refillMs_;
+    if (refills > 0) {
+      uint32_t tokens = s.tokens + refills;
+      s.tokens = tokens > burst_ ? burst_ : (uint16_t)tokens;
+      s.refilledAt = s.tokens == burst_ ? nowMs : s.refilledAt + refills * refillMs_;
+    }
+  }
+  if (s.tokens > 0) {
+    s.tokens--;
+    return true;
+  }
+
+  s.overRate++;
+  if (sampleEvery_ > 0 && s.overRate % sampleEvery_ == 0) return true;
+  if (s.skipped < UINT16_MAX) s.skipped++;
+  stats_.sampledOut++;
+  return false;
+}
+
+void LogRing::add(LogLevel level, uint8_t site, const char* text, size_t length,
+                  uint32_t nowMs) {
+  if (site >= siteCount_) return;
+  if (length > LOG_LINE_MAX) length = LOG_LINE_MAX;
+
+  Header header;
+  header.atMs = nowMs;
+  header.level = level;
+  header.site = site;
+  header.skipped = sites_[site].skipped;
+  header.length = (uint16_t)length;
+  sites_[site].skipped = 0;
+
+  size_t size = sizeof(Header) + length;
+  while (used_ + size > LOG_RING_BYTES) {
+    dropOldest();
+    stats_.overwritten++;
+  }
+  size_t tail = (head_ + used_) % LOG_RING_BYTES;
+  write(tail, &header, sizeof(header));
+  write((tail + sizeof(Header)) % LOG_RING_BYTES, text, length);
+  used_ += size;
+  count_++;
+  stats_.kept++;
+}
+
+void LogRing::charge(uint32_t micros, uint32_t nowMs) {
+  if (nowMs / 1000 != cpuSecond_) {
+    cpuSecond_ = nowMs / 1000;
+    cpuSpent_ = 0;
+  }
+  cpuSpent_ += micros;
+  stats_.cpuMicros += micros;
+}
+
+size_t LogRing::peek(char* out, size_t size, size_t& lines) const {
+  size_t written = 0;
+  size_t offset = head_;
+  lines = 0;
+
+  for (size_t i = 0; i < count_; i++) {
+    Header header;
+    read(offset, &header, sizeof(header));
+
+    char prefix[48];
+    int prefixLength;
+    if (header.skipped > 0) {
+      prefixLength = snprintf(prefix, sizeof(prefix), "%lu %c %s [+%u] ",
+                              (unsigned long)header.atMs, levelCode((LogLevel)header.level),
+                              siteNames_[header.site], header.skipped);
+    } else {
+      prefixLength = snprintf(prefix, sizeof(prefix), "%lu %c %s ",
+                              (unsigned long)header.atMs, levelCode((LogLevel)header.level),
+                              siteNames_[header.site]);
+    }
+    if (prefixLength < 0 || prefixLength >= (int)sizeof(prefix)) prefixLength = 0;
+
+    size_t lineLength = prefixLength + header.length + 1;
+    if (written + lineLength > size) break;
+    memcpy(out + written, prefix, prefixLength);
+    read((offset + sizeof(Header)) % LOG_RING_BYTES, out + written + prefixLength,
+         header.length);
+    out[written + lineLength - 1] = '\n';
+    written += lineLength;
+    lines++;
+    offset = (offset + sizeof(Header) + header.length) % LOG_RING_BYTES;
+  }
+  return written;
+}
+
+void LogRing::release(size_t lines, uint32_t bytes) {
+  for (size_t i = 0; i < lines && count_ > 0; i++) dropOldest();
+  stats_.shipments++;
+  stats_.shippedLines += lines;
+  stats_.shippedBytes += bytes;
+}
+
+bool LogRing::spend(uint32_t bytes, uint32_t nowMs) {
+  if (!dayStarted_ || nowMs - dayStartedAt_ >= 86400000UL) {
+    dayStarted_ = true;
+    dayStartedAt_ = nowMs;
+    dayBytes_ = 0;
+  }
+  if (dailyBytes_ > 0 && dayBytes_ + bytes > dailyBytes_) {
+    stats_.budgetDenied++;
+    return false;
+  }
+  dayBytes_ += bytes;
+  return true;
+}
+
+void LogRing::read(size_t offset, void* out, size_t length) const {
+  size_t first = LOG_RING_BYTES - offset;
+  if (first > length) first = length;
+  memcpy(out, ring_ + offset, first);
+  memcpy((uint8_t*)out + first, ring_, length - first);
+}
+
+void LogRing::write(size_t offset, const void* data, size_t length) {
+  size_t first = LOG_RING_BYTES - offset;
+  if (first > length) first = length;
+  memcpy(ring_ + offset, data, first);
+  memcpy(ring_, (const uint8_t*)data + first, length - first);
+}
+
+void LogRing::dropOldest() {
+  Header header;
+  read(head_, &header, sizeof(header));
+  size_t size = sizeof(Header) + header.length;
+  head_ = (head_ + size) % LOG_RING_BYTES;
+  used_ -= size;
+  count_--;
+}
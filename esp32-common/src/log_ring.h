@@ -0,0 +1,131 @@
+// Lumina Bridge Common - Remote Log Ring
+//
+// Keeps the bridge's diagnostic lines in RAM until they are shipped, so a
+// field problem can be read without a laptop on the serial port. Lines are
+// leveled and tagged with a site (the bridge's own small enum: poll,
+// execute, ...). Three limits keep logging from costing command latency:
+//
+// - Rate: each site has a token bucket of `burst` lines refilled one per
+//   `refillMs`. With the bucket empty only one line in `sampleEvery` is
+//   kept, and it carries the count skipped before it. Errors are exempt.
+// - CPU: the bridge charges the microseconds it spends formatting and
+//   storing lines (and compressing them); past `cpuBudgetUs` in a second,
+//   lines other than errors are dropped until the next second.
+// - Bytes: spend() admits a shipment only while the bytes shipped in the
+//   current 24-hour window stay within `dailyBytes`.
+//
+// The ring overwrites its oldest lines when full. peek() renders the
+// oldest lines as text ("uptimeMs L site [+skipped] text\n") and release()
+// frees them once the shipment has gone, so a failed upload loses nothing.
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_RING_BYTES 8192
+#define LOG_MAX_SITES 12
+#define LOG_LINE_MAX 160  // Longest stored line; longer ones are cut
+
+enum LogLevel : uint8_t {
+  LOG_ERROR = 0,
+  LOG_WARN,
+  LOG_INFO,
+  LOG_DEBUG,
+};
+
+struct LogRingStats {
+  uint32_t kept;          // Lines stored
+  uint32_t filtered;      // Below the capture level
+  uint32_t sampledOut;    // Over a site's rate, not sampled
+  uint32_t cpuDropped;    // Over the CPU budget
+  uint32_t overwritten;   // Stored, then overwritten before shipping
+  uint32_t shipments;
+  uint32_t shippedLines;
+  uint32_t shippedBytes;  // As sent (compressed)
+  uint32_t budgetDenied;  // Shipments held back by the daily byte budget
+  uint32_t cpuMicros;     // Charged in total
+};
+
+class LogRing {
+ public:
+  // `siteNames` has LOG_MAX_SITES or fewer entries and outlives the ring
+  LogRing(const char* const* siteNames, uint8_t siteCount, LogLevel level, uint8_t burst,
+          uint32_t refillMs, uint16_t sampleEvery, uint32_t cpuBudgetUs, uint32_t dailyBytes);
+
+  void setLevel(LogLevel level) { level_ = level; }
+  LogLevel level() const { return level_; }
+
+  // Whether a line should be formatted and added; counts those that are not
+  bool admit(LogLevel level, uint8_t site, uint32_t nowMs);
+
+  // Stores an admitted line
+  void add(LogLevel level, uint8_t site, const char* text, size_t length, uint32_t nowMs);
+
+  // CPU time the bridge spent on logging
+  void charge(uint32_t micros, uint32_t nowMs);
+
+  // Lines waiting to ship, and their stored size
+  size_t pending() const { return count_; }
+  size_t pendingBytes() const { return used_; }
+
+  // Renders the oldest lines into `out` (not NUL-terminated), as many as
+  // fit; `lines` gets their count. Returns the bytes written.
+  size_t peek(char* out, size_t size, size_t& lines) const;
+
+  // Frees the oldest `lines` once they have shipped as `bytes`
+  void release(size_t lines, uint32_t bytes);
+
+  // Whether `bytes` more may ship under the daily budget; counts a denial
+  bool spend(uint32_t bytes, uint32_t nowMs);
+
+  const LogRingStats& stats() const { return stats_; }
+
+  // Level names as peek() writes them: 'E', 'W', 'I', 'D'
+  static char levelCode(LogLevel level);
+
+ private:
+  struct Header {
+    uint32_t atMs;
+    uint8_t level;
+    uint8_t site;
+    uint16_t skipped;  // Lines of this site sampled out before this one
+    uint16_t length;
+  };
+
+  struct Site {
+    uint16_t tokens;
+    uint16_t overRate;  // Lines past the bucket, for 1-in-sampleEvery
+    uint16_t skipped;   // Sampled out since the last kept line
+    uint32_t refilledAt;
+  };
+
+  void read(size_t offset, void* out, size_t length) const;
+  void write(size_t offset, const void* data, size_t length);
+  void dropOldest();
+
+  const char* const* siteNames_;
+  uint8_t siteCount_;
+  LogLevel level_;
+  uint8_t burst_;
+  uint32_t refillMs_;
+  uint16_t sampleEvery_;
+  uint32_t cpuBudgetUs_;
+  uint32_t dailyBytes_;
+
+  Site sites_[LOG_MAX_SITES];
+  uint32_t cpuSecond_;     // nowMs / 1000 the charges below belong to
+  uint32_t cpuSpent_;
+  uint32_t dayStartedAt_;
+  uint32_t dayBytes_;
+  bool dayStarted_;
+
+  uint8_t ring_[LOG_RING_BYTES];
+  size_t head_;   // Oldest record
+  size_t used_;
+  size_t count_;
+  LogRingStats stats_;
+};
+
+#endif // LOG_RING_H
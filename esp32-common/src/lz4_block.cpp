@@ -0,0 +1,200 @@
+/**
+ * Lumina Bridge Common - LZ4 Block Compression
+ *
+ * Format rules the compressor keeps so stock decoders accept its output:
+ * the last 5 bytes are always literals, and no match starts within the
+ * last 12 bytes. Table entries are positions; a stale or colliding entry
+ * is caught by comparing the four bytes it points at. With a dictionary,
+ * positions count from the dictionary's first byte, which is why the
+ * dictionary and input together stay within 64 KB.
+ */
+
+#include "lz4_block.h"
+
+#include <string.h>
+
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MATCH_FIND_LIMIT 12
+
+static uint32_t read32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, 4);
+  return value;
+}
+
+static uint32_t hashOf(uint32_t sequence) {
+  // Knuth's multiplicative hash, top bits for a 1024-entry table
+  return (sequence * 2654435761u) >> 22;
+}
+
+// Writes the 255-run tail of a length whose nibble was 15
+static uint8_t* writeLength(uint8_t* op, size_t length) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+// One sequence: literals [anchor, anchor + literals), then a match of
+// `matchLength` at `offset` (matchLength 0 for the closing literals)
+static uint8_t* writeSequence(uint8_t* op, uint8_t* end, const uint8_t* anchor,
+                              size_t literals, uint16_t offset, size_t matchLength) {
+  size_t needed = 1 + literals + literals / 255 + 1;
+  if (matchLength > 0) needed += 2 + matchLength / 255 + 1;
+  if ((size_t)(end - op) < needed) return nullptr;
+
+  uint8_t* token = op++;
+  *token = (uint8_t)((literals >= 15 ? 15 : literals) << 4);
+  if (literals >= 15) op = writeLength(op, literals - 15);
+  memcpy(op, anchor, literals);
+  op += literals;
+  if (matchLength == 0) return op;
+
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  size_t code = matchLength - MIN_MATCH;
+  *token |= (uint8_t)(code >= 15 ? 15 : code);
+  if (code >= 15) op = writeLength(op, code - 15);
+  return op;
+}
+
+// Positions run through the dictionary and on into the input, so a match
+// may start in the dictionary and end in the input, as the stock decoder
+// allows. Without a dictionary these reduce to plain reads of `in`.
+struct Window {
+  const uint8_t* dict;
+  size_t dictLength;
+  const uint8_t* in;
+
+  uint8_t at(size_t position) const {
+    return position < dictLength ? dict[position] : in[position - dictLength];
+  }
+  uint32_t read(size_t position) const {
+    if (position >= dictLength) return read32(in + position - dictLength);
+    if (position + 4 <= dictLength) return read32(dict + position);
+    uint8_t bytes[4] = {at(position), at(position + 1), at(position + 2), at(position + 3)};
+    return read32(bytes);
+  }
+};
+
+static size_t compress(const Window& window, size_t length, uint8_t* out, size_t size,
+                       uint16_t* table) {
+  const uint8_t* in = window.in;
+  size_t base = window.dictLength;  // Window position of in[0]
+  uint8_t* op = out;
+  uint8_t* end = out + size;
+  size_t anchor = 0;
+
+  if (length > MATCH_FIND_LIMIT) {
+    size_t matchLimit = length - LAST_LITERALS;
+    size_t ip = 0;
+    while (ip + MATCH_FIND_LIMIT < length) {
+      uint32_t sequence = read32(in + ip);
+      uint32_t h = hashOf(sequence);
+      size_t ref = table[h];
+      table[h] = (uint16_t)(base + ip);
+
+      if (ref >= base + ip || window.read(ref) != sequence) {
+        ip++;
+        continue;
+      }
+
+      size_t matchLength = MIN_MATCH;
+      while (ip + matchLength < matchLimit &&
+             window.at(ref + matchLength) == in[ip + matchLength]) {
+        matchLength++;
+      }
+      op = writeSequence(op, end, in + anchor, ip - anchor, (uint16_t)(base + ip - ref),
+                         matchLength);
+      if (op == nullptr) return 0;
+      ip += matchLength;
+      anchor = ip;
+    }
+  }
+
+  op = writeSequence(op, end, in + anchor, length - anchor, 0, 0);
+  return op == nullptr ? 0 : (size_t)(op - out);
+}
+
+size_t lz4Compress(const uint8_t* in, size_t length, uint8_t* out, size_t size,
+                   uint16_t* table) {
+  if (length > LZ4_MAX_INPUT) return 0;
+  memset(table, 0, LZ4_TABLE_ENTRIES * sizeof(uint16_t));
+  return compress(Window{nullptr, 0, in}, length, out, size, table);
+}
+
+void lz4LoadDict(Lz4Dict& dict, const uint8_t* data, size_t length) {
+  if (length > LZ4_MAX_DICT) {
+    // Only the end is reachable from the input; keep that
+    data += length - LZ4_MAX_DICT;
+    length = LZ4_MAX_DICT;
+  }
+  dict.data = data;
+  dict.length = length;
+  memset(dict.table, 0, sizeof(dict.table));
+  // Front to back, so a hash shared by two places keeps the later one
+  for (size_t i = 0; i + MIN_MATCH <= length; i++) {
+    dict.table[hashOf(read32(data + i))] = (uint16_t)i;
+  }
+}
+
+size_t lz4CompressDict(const Lz4Dict& dict, const uint8_t* in, size_t length, uint8_t* out,
+                       size_t size, uint16_t* table) {
+  if (length > LZ4_MAX_INPUT - dict.length) return 0;
+  memcpy(table, dict.table, sizeof(dict.table));
+  return compress(Window{dict.data, dict.length, in}, length, out, size, table);
+}
+
+// Adds the 255-run tail of a length; false if it runs past the input
+static bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+  uint8_t byte;
+  do {
+    if (ip >= end) return false;
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+size_t lz4Decompress(const uint8_t* in, size_t length, uint8_t* out, size_t size) {
+  return lz4DecompressDict(nullptr, 0, in, length, out, size);
+}
+
+size_t lz4DecompressDict(const uint8_t* dict, size_t dictLength, const uint8_t* in,
+                         size_t length, uint8_t* out, size_t size) {
+  const uint8_t* ip = in;
+  const uint8_t* end = in + length;
+  size_t op = 0;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(ip, end, literals)) return 0;
+    if ((size_t)(end - ip) < literals || size - op < literals) return 0;
+    memcpy(out + op, ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == end) return op;  // Closing literals
+
+    if (end - ip < 2) return 0;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t matchLength = token & 0x0F;
+    if (matchLength == 15 && !readLength(ip, end, matchLength)) return 0;
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > op + dictLength || size - op < matchLength) return 0;
+
+    // The part of a match that reaches back before the output is in the
+    // dictionary's tail
+    size_t i = 0;
+    for (; i < matchLength && offset > op; i++, op++) {
+      out[op] = dict[dictLength - (offset - op)];
+    }
+    // Byte by byte: a match may overlap what it is copying
+    for (; i < matchLength; i++, op++) out[op] = out[op - offset];
+  }
+  return 0;  // Empty input, or no closing literals
+}
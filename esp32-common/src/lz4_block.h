@@ -0,0 +1,60 @@
+// Lumina Bridge Common - LZ4 Block Compression
+//
+// Compresses a buffer into the LZ4 block format, so whatever receives it
+// decodes with a stock LZ4 library (lz4.block.decompress, LZ4_decompress_
+// safe). The compressor is the greedy single-probe kind: one hash lookup
+// per position, no backward extension. On log text that is most of what
+// LZ4 achieves at a fraction of the table, and it runs in well under a
+// millisecond per few KB on an ESP32.
+//
+// The hash table is the caller's (LZ4_TABLE_ENTRIES uint16_t), so nothing
+// lands on the loop task's stack. Inputs are limited to 64 KB.
+//
+// Short messages (a command, a state update) have too little repetition of
+// their own to compress; they compress against a dictionary instead, text
+// both ends know that matches may refer back into. lz4LoadDict() primes a
+// table from the dictionary once, so each message costs a 2 KB copy rather
+// than hashing the dictionary again. The output is what LZ4_compress_
+// continue() would give after LZ4_loadDict(): decode it with LZ4_
+// decompress_safe_usingDict() and the same dictionary.
+
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ4_TABLE_ENTRIES 1024  // 2 KB of table
+#define LZ4_MAX_INPUT 65535
+#define LZ4_MAX_DICT 32768      // Longer dictionaries keep their last 32 KB
+
+// Worst-case compressed size of `length` bytes
+#define LZ4_BOUND(length) ((length) + (length) / 255 + 16)
+
+// Compresses `in` into `out`; returns the compressed size, or 0 if `out`
+// is too small or the input is over LZ4_MAX_INPUT
+size_t lz4Compress(const uint8_t* in, size_t length, uint8_t* out, size_t size,
+                   uint16_t* table);
+
+struct Lz4Dict {
+  const uint8_t* data;  // Not copied; must outlive the Lz4Dict
+  size_t length;
+  uint16_t table[LZ4_TABLE_ENTRIES];
+};
+
+void lz4LoadDict(Lz4Dict& dict, const uint8_t* data, size_t length);
+
+// As lz4Compress(), against a loaded dictionary; the dictionary and input
+// together are limited to LZ4_MAX_INPUT
+size_t lz4CompressDict(const Lz4Dict& dict, const uint8_t* in, size_t length, uint8_t* out,
+                       size_t size, uint16_t* table);
+
+// Decompresses a block; returns the decompressed size, or 0 if the block is
+// malformed or does not fit in `size`
+size_t lz4Decompress(const uint8_t* in, size_t length, uint8_t* out, size_t size);
+
+// As lz4Decompress(), for a block compressed against `dict`
+size_t lz4DecompressDict(const uint8_t* dict, size_t dictLength, const uint8_t* in,
+                         size_t length, uint8_t* out, size_t size);
+
+#endif // LZ4_BLOCK_H
@@ -0,0 +1,260 @@
+/**
+ * Lumina Bridge Common - MQTT 3.1.1 Packets
+ *
+ * Readers bounds-check every field against the packet's own length, since
+ * the broker parses whatever a LAN client sends.
+ */
+
+#include "mqtt_packet.h"
+
+#include <string.h>
+
+// ============================================================================
+// Strings
+// ============================================================================
+
+bool MqttString::equals(const char* text) const {
+  return strlen(text) == length && memcmp(text, data, length) == 0;
+}
+
+bool MqttString::copyTo(char* out, size_t size) const {
+  if (size == 0) return false;
+  if (length >= size) {
+    out[0] = '\0';
+    return false;
+  }
+  memcpy(out, data, length);
+  out[length] = '\0';
+  return true;
+}
+
+static bool readU16(const uint8_t* body, size_t length, size_t& offset, uint16_t& value) {
+  if (offset + 2 > length) return false;
+  value = (uint16_t)((body[offset] << 8) | body[offset + 1]);
+  offset += 2;
+  return true;
+}
+
+static bool readString(const uint8_t* body, size_t length, size_t& offset, MqttString& out) {
+  uint16_t size;
+  if (!readU16(body, length, offset, size) || offset + size > length) return false;
+  out.data = (const char*)body + offset;
+  out.length = size;
+  offset += size;
+  return true;
+}
+
+static size_t writeU16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)(value >> 8);
+  out[1] = (uint8_t)value;
+  return 2;
+}
+
+static size_t writeString(uint8_t* out, const char* text, size_t length) {
+  writeU16(out, (uint16_t)length);
+  memcpy(out + 2, text, length);
+  return 2 + length;
+}
+
+// ============================================================================
+// Fixed Header
+// ============================================================================
+
+int32_t mqttPacketLength(const uint8_t* data, size_t length, size_t& headerLength) {
+  uint32_t remaining = 0;
+  for (size_t i = 1; i <= 4; i++) {
+    if (i >= length) return 0;
+    remaining |= (uint32_t)(data[i] & 0x7F) << (7 * (i - 1));
+    if ((data[i] & 0x80) == 0) {
+      headerLength = i + 1;
+      return (int32_t)(headerLength + remaining);
+    }
+  }
+  return -1;
+}
+
+// First byte plus the remaining length, 2 to 5 bytes
+static size_t writeHeader(uint8_t* out, uint8_t first, size_t remaining) {
+  size_t n = 0;
+  out[n++] = first;
+  do {
+    uint8_t digit = remaining & 0x7F;
+    remaining >>= 7;
+    out[n++] = remaining > 0 ? (digit | 0x80) : digit;
+  } while (remaining > 0);
+  return n;
+}
+
+static size_t headerSize(size_t remaining) {
+  if (remaining < 128) return 2;
+  if (remaining < 16384) return 3;
+  if (remaining < 2097152) return 4;
+  return 5;
+}
+
+// ============================================================================
+// Parsers
+// ============================================================================
+
+bool mqttParseConnect(const uint8_t* body, size_t length, MqttConnect& out) {
+  memset(&out, 0, sizeof(out));
+  size_t offset = 0;
+  MqttString protocol;
+  if (!readString(body, length, offset, protocol) || !protocol.equals("MQTT")) return false;
+  if (offset + 1 > length) return false;
+  out.protocolLevel = body[offset++];
+  if (offset + 1 > length) return false;
+  uint8_t flags = body[offset++];
+  if (!readU16(body, length, offset, out.keepAliveSec)) return false;
+  if (flags & 0x01) return false;  // Reserved bit
+
+  out.cleanSession = flags & 0x02;
+  out.hasWill = flags & 0x04;
+  out.willRetain = flags & 0x20;
+  if (!readString(body, length, offset, out.clientId)) return false;
+  if (out.hasWill && (!readString(body, length, offset, out.willTopic) ||
+                      !readString(body, length, offset, out.willMessage))) {
+    return false;
+  }
+  if ((flags & 0x80) && !readString(body, length, offset, out.username)) return false;
+  if ((flags & 0x40) && !readString(body, length, offset, out.password)) return false;
+  return true;
+}
+
+bool mqttParsePublish(uint8_t first, const uint8_t* body, size_t length, MqttPublish& out) {
+  memset(&out, 0, sizeof(out));
+  out.qos = (first >> 1) & 0x03;
+  out.retain = first & 0x01;
+  if (out.qos > 1) return false;  // QoS 2 is not supported
+
+  size_t offset = 0;
+  if (!readString(body, length, offset, out.topic) || out.topic.length == 0) return false;
+  if (out.qos > 0 && !readU16(body, length, offset, out.packetId)) return false;
+  out.payload = body + offset;
+  out.payloadLength = length - offset;
+  return true;
+}
+
+bool mqttParsePacketId(const uint8_t* body, size_t length, uint16_t& packetId) {
+  size_t offset = 0;
+  return readU16(body, length, offset, packetId);
+}
+
+bool mqttNextFilter(const uint8_t* body, size_t length, bool withQos, size_t& offset,
+                    MqttString& filter, uint8_t* qos) {
+  if (offset == 0) offset = 2;  // Past the packet ID
+  if (offset >= length) return false;
+  if (!readString(body, length, offset, filter)) return false;
+  if (withQos) {
+    if (offset + 1 > length) return false;
+    if (qos != nullptr) *qos = body[offset] & 0x03;
+    offset++;
+  }
+  return true;
+}
+
+// ============================================================================
+// Builders
+// ============================================================================
+
+size_t mqttBuildConnect(uint8_t* out, size_t size, const char* clientId, const char* username,
+                        const char* password, uint16_t keepAliveSec) {
+  size_t idLength = strlen(clientId);
+  size_t userLength = username != nullptr ? strlen(username) : 0;
+  size_t passLength = password != nullptr ? strlen(password) : 0;
+  size_t remaining = 10 + 2 + idLength;
+  if (userLength > 0) remaining += 2 + userLength;
+  if (passLength > 0) remaining += 2 + passLength;
+  if (headerSize(remaining) + remaining > size) return 0;
+
+  uint8_t flags = 0x02;  // Clean session
+  if (userLength > 0) flags |= 0x80;
+  if (passLength > 0) flags |= 0x40;
+
+  size_t n = writeHeader(out, MQTT_CONNECT << 4, remaining);
+  n += writeString(out + n, "MQTT", 4);
+  out[n++] = 4;
+  out[n++] = flags;
+  n += writeU16(out + n, keepAliveSec);
+  n += writeString(out + n, clientId, idLength);
+  if (userLength > 0) n += writeString(out + n, username, userLength);
+  if (passLength > 0) n += writeString(out + n, password, passLength);
+  return n;
+}
+
+size_t mqttBuildConnack(uint8_t* out, size_t size, MqttConnectCode code) {
+  if (size < 4) return 0;
+  size_t n = writeHeader(out, MQTT_CONNACK << 4, 2);
+  out[n++] = 0;  // No session present
+  out[n++] = code;
+  return n;
+}
+
+size_t mqttBuildPublish(uint8_t* out, size_t size, const char* topic, const uint8_t* payload,
+                        size_t length, bool retain) {
+  size_t topicLength = strlen(topic);
+  size_t remaining = 2 + topicLength + length;
+  if (topicLength > 0xFFFF || headerSize(remaining) + remaining > size) return 0;
+
+  size_t n = writeHeader(out, (MQTT_PUBLISH << 4) | (retain ? 0x01 : 0), remaining);
+  n += writeString(out + n, topic, topicLength);
+  memcpy(out + n, payload, length);
+  return n + length;
+}
+
+size_t mqttBuildSubscribe(uint8_t* out, size_t size, uint16_t packetId, const char* filter) {
+  size_t filterLength = strlen(filter);
+  size_t remaining = 2 + 2 + filterLength + 1;
+  if (headerSize(remaining) + remaining > size) return 0;
+
+  size_t n = writeHeader(out, (MQTT_SUBSCRIBE << 4) | 0x02, remaining);
+  n += writeU16(out + n, packetId);
+  n += writeString(out + n, filter, filterLength);
+  out[n++] = 0;  // QoS 0
+  return n;
+}
+
+size_t mqttBuildSuback(uint8_t* out, size_t size, uint16_t packetId, size_t count) {
+  size_t remaining = 2 + count;
+  if (headerSize(remaining) + remaining > size) return 0;
+
+  size_t n = writeHeader(out, MQTT_SUBACK << 4, remaining);
+  n += writeU16(out + n, packetId);
+  memset(out + n, 0, count);
+  return n + count;
+}
+
+size_t mqttBuildAck(uint8_t* out, size_t size, MqttPacketType type, uint16_t packetId) {
+  if (size < 4) return 0;
+  size_t n = writeHeader(out, type << 4, 2);
+  return n + writeU16(out + n, packetId);
+}
+
+size_t mqttBuildEmpty(uint8_t* out, size_t size, MqttPacketType type) {
+  if (size < 2) return 0;
+  return writeHeader(out, type << 4, 0);
+}
+
+// ============================================================================
+// Topic Filters
+// ============================================================================
+
+bool mqttTopicMatches(const char* filter, const char* topic, size_t topicLength) {
+  size_t t = 0;
+  const char* f = filter;
+  while (*f != '\0') {
+    if (*f == '#') return true;  // Matches the rest, including the parent level
+    if (*f == '+') {
+      while (t < topicLength && topic[t] != '/') t++;
+      f++;
+    } else {
+      if (t >= topicLength || topic[t] != *f) {
+        // "a/#" also matches "a"
+        return t == topicLength && f[0] == '/' && f[1] == '#' && f[2] == '\0';
+      }
+      t++;
+      f++;
+    }
+  }
+  return t == topicLength;
+}
@@ -0,0 +1,106 @@
+// Lumina Bridge Common - MQTT 3.1.1 Packets
+//
+// Encoding and decoding of the MQTT 3.1.1 packets a small LAN broker and
+// its clients exchange: CONNECT/CONNACK, PUBLISH (QoS 0 and 1), PUBACK,
+// SUBSCRIBE/SUBACK, UNSUBSCRIBE/UNSUBACK, PINGREQ/PINGRESP and DISCONNECT.
+// Parsers work on a complete packet in the caller's buffer and return
+// views into it, so nothing is copied or allocated. No sockets, so the
+// host tools use the same code for their simulated controllers.
+
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum MqttPacketType : uint8_t {
+  MQTT_CONNECT = 1,
+  MQTT_CONNACK = 2,
+  MQTT_PUBLISH = 3,
+  MQTT_PUBACK = 4,
+  MQTT_SUBSCRIBE = 8,
+  MQTT_SUBACK = 9,
+  MQTT_UNSUBSCRIBE = 10,
+  MQTT_UNSUBACK = 11,
+  MQTT_PINGREQ = 12,
+  MQTT_PINGRESP = 13,
+  MQTT_DISCONNECT = 14,
+};
+
+// CONNACK return codes
+enum MqttConnectCode : uint8_t {
+  MQTT_ACCEPTED = 0,
+  MQTT_REFUSED_PROTOCOL = 1,
+  MQTT_REFUSED_IDENTIFIER = 2,
+  MQTT_REFUSED_UNAVAILABLE = 3,
+  MQTT_REFUSED_CREDENTIALS = 4,
+};
+
+// A length-prefixed string inside a packet; not NUL-terminated
+struct MqttString {
+  const char* data;
+  uint16_t length;
+
+  // Compares with a NUL-terminated string
+  bool equals(const char* text) const;
+  // Copies into `out` with a NUL; false (and `out` empty) if it does not fit
+  bool copyTo(char* out, size_t size) const;
+};
+
+struct MqttConnect {
+  uint8_t protocolLevel;  // 4 for 3.1.1
+  uint16_t keepAliveSec;
+  bool cleanSession;
+  bool hasWill;
+  bool willRetain;
+  MqttString clientId;
+  MqttString willTopic;
+  MqttString willMessage;
+  MqttString username;  // length 0 if absent
+  MqttString password;
+};
+
+struct MqttPublish {
+  MqttString topic;
+  const uint8_t* payload;
+  size_t payloadLength;
+  uint8_t qos;
+  bool retain;
+  uint16_t packetId;  // QoS 1 only
+};
+
+// Size of the packet at the start of `data`: 0 while more bytes are
+// needed, -1 if the remaining length is malformed. Sets `headerLength` to
+// the fixed header's size once it is known.
+int32_t mqttPacketLength(const uint8_t* data, size_t length, size_t& headerLength);
+
+// Parsers take the first byte of the fixed header and the packet's
+// variable part (header stripped). False if the packet is malformed.
+bool mqttParseConnect(const uint8_t* body, size_t length, MqttConnect& out);
+bool mqttParsePublish(uint8_t first, const uint8_t* body, size_t length, MqttPublish& out);
+
+// Packet ID of a SUBSCRIBE or UNSUBSCRIBE, then each topic filter in turn:
+// start with `offset` 0; `qos` may be null (UNSUBSCRIBE has none)
+bool mqttParsePacketId(const uint8_t* body, size_t length, uint16_t& packetId);
+bool mqttNextFilter(const uint8_t* body, size_t length, bool withQos, size_t& offset,
+                    MqttString& filter, uint8_t* qos);
+
+// Builders write a whole packet into `out` and return its size, or 0 if it
+// does not fit in `size`
+size_t mqttBuildConnect(uint8_t* out, size_t size, const char* clientId, const char* username,
+                        const char* password, uint16_t keepAliveSec);
+size_t mqttBuildConnack(uint8_t* out, size_t size, MqttConnectCode code);
+size_t mqttBuildPublish(uint8_t* out, size_t size, const char* topic, const uint8_t* payload,
+                        size_t length, bool retain);
+size_t mqttBuildSubscribe(uint8_t* out, size_t size, uint16_t packetId, const char* filter);
+// SUBACK granting QoS 0 to `count` filters
+size_t mqttBuildSuback(uint8_t* out, size_t size, uint16_t packetId, size_t count);
+// PUBACK and UNSUBACK
+size_t mqttBuildAck(uint8_t* out, size_t size, MqttPacketType type, uint16_t packetId);
+// PINGREQ, PINGRESP and DISCONNECT
+size_t mqttBuildEmpty(uint8_t* out, size_t size, MqttPacketType type);
+
+// Whether `topic` matches a subscription filter with "+" and "#" wildcards
+bool mqttTopicMatches(const char* filter, const char* topic, size_t topicLength);
+
+#endif // MQTT_PACKET_H
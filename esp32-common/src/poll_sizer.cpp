@@ -0,0 +1,62 @@
+/**
+ * Lumina Bridge Common - Adaptive Poll Sizing
+ *
+ * Execution time is an exponentially weighted average (1/8 per sample),
+ * so one slow controller does not stall polling, but a run of them does.
+ */
+
+#include "poll_sizer.h"
+
+#include <string.h>
+
+PollSizer::PollSizer(uint16_t baseLimit, uint16_t maxLimit, uint32_t bytesPerCommand)
+    : baseLimit_(baseLimit > 0 ? baseLimit : 1),
+      maxLimit_(maxLimit > baseLimit ? maxLimit : baseLimit),
+      bytesPerCommand_(bytesPerCommand > 0 ? bytesPerCommand : 1),
+      lastLimit_(baseLimit_), lastDeferred_(0), backlog_(false), executeMicros_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint16_t PollSizer::limit(uint32_t heapBytes, size_t room) {
+  uint32_t wanted = baseLimit_;
+  if (backlog_) {
+    wanted = (uint32_t)lastLimit_ * 2;
+    if (wanted > maxLimit_) wanted = maxLimit_;
+    if (wanted > room) wanted = room > baseLimit_ ? room : baseLimit_;
+  }
+
+  uint32_t affordable = heapBytes / bytesPerCommand_;
+  if (affordable < 1) affordable = 1;
+  if (wanted > affordable) {
+    wanted = affordable;
+    stats_.heapCapped++;
+  }
+  return (uint16_t)wanted;
+}
+
+void PollSizer::polled(uint16_t limit, uint16_t returned, uint16_t deferred) {
+  lastLimit_ = limit;
+  lastDeferred_ = deferred;
+  backlog_ = returned >= limit || deferred > 0;
+
+  stats_.polls++;
+  stats_.commands += returned;
+  stats_.deferred += deferred;
+  if (backlog_) stats_.fullPages++;
+  if (limit > stats_.maxLimit) stats_.maxLimit = limit;
+}
+
+void PollSizer::executed(uint32_t micros) {
+  if (executeMicros_ == 0) {
+    executeMicros_ = micros > 0 ? micros : 1;
+  } else {
+    executeMicros_ = executeMicros_ - executeMicros_ / 8 + micros / 8;
+  }
+}
+
+uint32_t PollSizer::backlogDelayMs(size_t room) const {
+  // Commands to execute before a poll is worth its round trip
+  uint32_t shortfall = room < baseLimit_ ? baseLimit_ - room : 0;
+  if (lastDeferred_ > shortfall) shortfall = lastDeferred_;
+  return (uint32_t)(((uint64_t)executeMicros_ * shortfall + 999) / 1000);
+}
@@ -0,0 +1,76 @@
+// Lumina Bridge Common - Adaptive Poll Sizing
+//
+// Chooses how many pending commands the next Firestore query asks for and
+// how soon it runs. With a fixed page of 5 every 2 s, a backlog of 60
+// commands after an outage takes 12 polls and 24 s to fetch. Here:
+//
+// - A full page means more is waiting. The next poll runs straight away
+//   and asks for twice as many, up to maxLimit.
+// - A short page means the backlog is fetched. The page drops back to
+//   baseLimit and the normal interval applies.
+// - The page never needs more heap than the caller says one poll may use,
+//   at bytesPerCommand per command (response text and document).
+// - A page never asks for more than the queues have room for (or a base
+//   page when they are full). A command whose controller's queue is full
+//   stays pending, so fetching it again only adds billed reads. After a
+//   poll that left commands pending, the next one waits until execution,
+//   at the measured time per command, could have made room for them.
+//
+// Times are the caller's clock, so tools/backlog_sim.cpp runs the same code
+// on a host.
+
+#ifndef POLL_SIZER_H
+#define POLL_SIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct PollSizerStats {
+  uint32_t polls;      // Successful queries
+  uint32_t fullPages;  // Of those, returned as many as asked for
+  uint32_t commands;   // Commands returned
+  uint32_t deferred;   // Of those, left pending for want of queue room
+  uint16_t maxLimit;   // Largest page asked for
+  uint16_t heapCapped; // Pages cut short by the heap
+};
+
+class PollSizer {
+ public:
+  PollSizer(uint16_t baseLimit, uint16_t maxLimit, uint32_t bytesPerCommand);
+
+  // Page size for the next query, given the heap one poll may use and the
+  // commands the queues can still take
+  uint16_t limit(uint32_t heapBytes, size_t room);
+
+  // After a successful query that asked for `limit` and got `returned`, of
+  // which `deferred` stayed pending because their queue was full
+  void polled(uint16_t limit, uint16_t returned, uint16_t deferred);
+
+  // After each command the bridge executed, with the time it took
+  void executed(uint32_t micros);
+
+  // The last page came back full
+  bool backlog() const { return backlog_; }
+
+  // Wait before the next poll during a backlog: none while the queues have
+  // room and the last page fit, else the time to execute what was deferred
+  // (a base page if the queues are full)
+  uint32_t backlogDelayMs(size_t room) const;
+
+  // Smoothed execution time per command; 0 before the first
+  uint32_t executeMicros() const { return executeMicros_; }
+
+  const PollSizerStats& stats() const { return stats_; }
+
+ private:
+  uint16_t baseLimit_;
+  uint16_t maxLimit_;
+  uint32_t bytesPerCommand_;
+  uint16_t lastLimit_;
+  uint16_t lastDeferred_;
+  bool backlog_;
+  uint32_t executeMicros_;
+  PollSizerStats stats_;
+};
+
+#endif // POLL_SIZER_H
@@ -0,0 +1,135 @@
+/**
+ * Lumina Bridge Common - Reconciler and WLED JSON
+ *
+ * A command is flattened into a static scratch list first, so one that
+ * does not fit the desired table is refused before anything changes.
+ */
+
+#include "reconcile_wled.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wled_state.h"
+
+struct Leaf {
+  char path[RECONCILE_PATH_LEN];
+  char value[RECONCILE_VALUE_LEN];
+};
+
+struct LeafList {
+  Leaf leaves[RECONCILE_MAX_ENTRIES];
+  size_t count;
+  bool overflow;
+};
+
+static bool collectLeaf(void* context, const char* path, const char* value) {
+  LeafList* list = (LeafList*)context;
+  if (list->count >= RECONCILE_MAX_ENTRIES || strlen(path) >= RECONCILE_PATH_LEN) {
+    list->overflow = true;
+    return false;
+  }
+  Leaf& leaf = list->leaves[list->count++];
+  snprintf(leaf.path, sizeof(leaf.path), "%s", path);
+  snprintf(leaf.value, sizeof(leaf.value), "%s", value);
+  return true;
+}
+
+struct ActualContext {
+  Reconciler* reconciler;
+  int controller;
+};
+
+static bool reportActual(void* context, const char* path, const char* value) {
+  ActualContext* actual = (ActualContext*)context;
+  // "ps" and "pl" follow the playlist; they are never desired state
+  if (!wledStateIsAction(path, JsonVariantConst())) {
+    actual->reconciler->actualValue(actual->controller, path, value);
+  }
+  return true;
+}
+
+// The apply in flight starts a preset or playlist
+static bool sendingPreset(const Reconciler& reconciler, int controller) {
+  for (size_t i = 0; i < reconciler.entryCount(controller); i++) {
+    const ReconcileEntry& entry = reconciler.entry(controller, i);
+    if (entry.sending && (strcmp(entry.path, "ps") == 0 || strcmp(entry.path, "pl") == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool reconcileCommand(Reconciler& reconciler, int controller, JsonObjectConst command,
+                      uint32_t nowMs) {
+  static LeafList list;
+  list.count = 0;
+  list.overflow = false;
+  if (!wledStateFlatten(command, collectLeaf, &list, RECONCILE_VALUE_LEN) || list.overflow) {
+    return false;
+  }
+
+  // Entries the table does not have yet must fit
+  size_t added = 0;
+  for (size_t i = 0; i < list.count; i++) {
+    bool known = false;
+    for (size_t j = 0; j < reconciler.entryCount(controller); j++) {
+      const ReconcileEntry& entry = reconciler.entry(controller, j);
+      if (!entry.oneShot && strcmp(entry.path, list.leaves[i].path) == 0) known = true;
+    }
+    if (!known) added++;
+  }
+  bool replaces = !command["ps"].isNull() || !command["pl"].isNull();
+  if (!replaces && reconciler.entryCount(controller) + added > RECONCILE_MAX_ENTRIES) {
+    return false;
+  }
+  if (replaces && list.count > RECONCILE_MAX_ENTRIES) return false;
+
+  if (replaces) reconciler.clearDesired(controller);
+  for (size_t i = 0; i < list.count; i++) {
+    const Leaf& leaf = list.leaves[i];
+    JsonDocument value;
+    deserializeJson(value, leaf.value);
+    bool action = wledStateIsAction(leaf.path, value.as<JsonVariantConst>());
+    reconciler.setDesired(controller, leaf.path, leaf.value, action, nowMs);
+  }
+  return true;
+}
+
+void reconcileRequestBody(const Reconciler& reconciler, int controller, JsonDocument& body) {
+  body.clear();
+  JsonObject request = body.to<JsonObject>();
+  for (size_t i = 0; i < reconciler.entryCount(controller); i++) {
+    const ReconcileEntry& entry = reconciler.entry(controller, i);
+    if (entry.sending) wledStateSetPath(request, entry.path, entry.value);
+  }
+  request["v"] = true;
+}
+
+void reconcileResponse(Reconciler& reconciler, int controller, ReconcileAction action, bool ok,
+                       const char* response, uint32_t nowMs) {
+  JsonDocument doc;
+  if (ok && deserializeJson(doc, response)) ok = false;
+
+  if (action == RECONCILE_APPLY) {
+    // WLED loads a preset after answering, so what it becomes is read by
+    // an audit straight after
+    bool preset = ok && sendingPreset(reconciler, controller);
+    if (ok) {
+      ActualContext actual = {&reconciler, controller};
+      wledStateFlatten(doc.as<JsonObjectConst>(), reportActual, &actual, RECONCILE_VALUE_LEN);
+    }
+    reconciler.finishApply(controller, ok, nowMs);
+    if (preset) reconciler.adoptNextAudit(controller, nowMs);
+    return;
+  }
+
+  JsonObjectConst state = doc["state"];
+  if (ok && state.isNull()) ok = false;
+  if (ok) {
+    reconciler.auditUptime(controller, doc["info"]["uptime"] | 0UL);
+    ActualContext actual = {&reconciler, controller};
+    wledStateFlatten(state, reportActual, &actual, RECONCILE_VALUE_LEN);
+  }
+  reconciler.finishAudit(controller, ok, nowMs);
+}
@@ -0,0 +1,36 @@
+// Lumina Bridge Common - Reconciler and WLED JSON
+//
+// Connects Reconciler to WLED's JSON API: turns a state command into
+// desired entries, builds the POST body for an apply, and feeds WLED's
+// answers back. The bridge does the HTTP:
+//
+//   int c;
+//   ReconcileAction action = reconciler.next(millis(), c);
+//   if (action == RECONCILE_APPLY)  POST reconcileRequestBody() to /json/state
+//   if (action == RECONCILE_AUDIT)  GET /json/si
+//   reconcileResponse(reconciler, c, action, ok, response, millis());
+
+#ifndef RECONCILE_WLED_H
+#define RECONCILE_WLED_H
+
+#include <ArduinoJson.h>
+
+#include "reconciler.h"
+
+// Merges a /json/state command into the controller's desired state. A
+// preset or playlist ("ps", "pl") is sent once and replaces it with what
+// the controller reports afterwards. False, with nothing changed, if the
+// command does not fit; send it directly instead.
+bool reconcileCommand(Reconciler& reconciler, int controller, JsonObjectConst command,
+                      uint32_t nowMs);
+
+// The body for an apply: the entries being sent, plus "v": true so WLED
+// answers with its full state
+void reconcileRequestBody(const Reconciler& reconciler, int controller, JsonDocument& body);
+
+// Hands WLED's answer (or the failure) to the reconciler. `response` is the
+// state for an apply and {"state", "info"} for an audit.
+void reconcileResponse(Reconciler& reconciler, int controller, ReconcileAction action, bool ok,
+                       const char* response, uint32_t nowMs);
+
+#endif // RECONCILE_WLED_H
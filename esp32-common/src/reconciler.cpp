@@ -0,0 +1,304 @@
+/**
+ * Lumina Bridge Common - Desired-State Reconciliation
+ *
+ * Per controller, in order of preference, next() asks for:
+ *
+ *   1. nothing while a request is in flight or a failure is backing off
+ *   2. an audit if the controller is new or its last request failed
+ *   3. an apply once there are unsynced entries and settleMs has passed
+ *      since the first change not yet sent
+ *   4. an audit once the controller has been idle for auditMs
+ *
+ * An audit confirms entries and takes over local changes; it only starts
+ * a new apply for entries that were never confirmed, or after a reboot.
+ *
+ * Controllers are served round robin, so one that keeps failing does not
+ * hold up the others.
+ */
+
+#include "reconciler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+Reconciler::Reconciler(uint32_t settleMs, uint32_t auditMs, uint32_t retryBaseMs,
+                       uint32_t retryCapMs)
+    : count_(0), cursor_(0), settleMs_(settleMs), auditMs_(auditMs) {
+  memset(&stats_, 0, sizeof(stats_));
+  for (int i = 0; i < RECONCILE_MAX_CONTROLLERS; i++) {
+    Controller& c = controllers_[i];
+    memset(c.ip, 0, sizeof(c.ip));
+    memset(c.entries, 0, sizeof(c.entries));
+    c.count = 0;
+    c.backoff = ReconnectBackoff(retryBaseMs, retryCapMs, 0);
+    c.batchStart = c.dirtySince = c.lastAuditAt = c.uptimeSec = 0;
+    c.dirty = c.batching = c.inFlight = c.rebooted = c.adopting = false;
+    c.needsAudit = true;
+  }
+}
+
+int Reconciler::controller(const char* ip, bool create) {
+  for (int i = 0; i < count_; i++) {
+    if (strcmp(controllers_[i].ip, ip) == 0) return i;
+  }
+  if (!create || count_ >= RECONCILE_MAX_CONTROLLERS || strlen(ip) >= RECONCILE_IP_LEN) {
+    return -1;
+  }
+  Controller& c = controllers_[count_];
+  snprintf(c.ip, sizeof(c.ip), "%s", ip);
+  c.backoff.begin(ip, count_ + 1);
+  return count_++;
+}
+
+const char* Reconciler::ip(int controller) const {
+  return valid(controller) ? controllers_[controller].ip : "";
+}
+
+bool Reconciler::setDesired(int controller, const char* path, const char* value, bool oneShot,
+                            uint32_t nowMs) {
+  if (!valid(controller) || strlen(path) >= RECONCILE_PATH_LEN ||
+      strlen(value) >= RECONCILE_VALUE_LEN) {
+    return false;
+  }
+  Controller& c = controllers_[controller];
+
+  ReconcileEntry* entry = nullptr;
+  for (uint8_t i = 0; i < c.count && !oneShot; i++) {
+    if (!c.entries[i].oneShot && strcmp(c.entries[i].path, path) == 0) {
+      entry = &c.entries[i];
+    }
+  }
+  if (entry != nullptr && strcmp(entry->value, value) == 0) {
+    return true;  // Already desired; nothing to converge
+  }
+  if (entry == nullptr) {
+    if (c.count >= RECONCILE_MAX_ENTRIES) return false;
+    entry = &c.entries[c.count++];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    entry->oneShot = oneShot;
+  }
+  snprintf(entry->value, sizeof(entry->value), "%s", value);
+  entry->synced = false;
+  entry->sending = false;  // A request in flight carries the old value
+
+  stats_.changes++;
+  if (!c.batching) {
+    c.batching = true;
+    c.batchStart = nowMs;
+  }
+  if (!c.dirty) {
+    c.dirty = true;
+    c.dirtySince = nowMs;
+  }
+  return true;
+}
+
+void Reconciler::clearDesired(int controller) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+
+  // One-shots still go out
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < c.count; i++) {
+    if (c.entries[i].oneShot) c.entries[kept++] = c.entries[i];
+  }
+  c.count = kept;
+}
+
+ReconcileAction Reconciler::next(uint32_t nowMs, int& controller) {
+  for (uint8_t n = 0; n < count_; n++) {
+    int index = (cursor_ + n) % count_;
+    Controller& c = controllers_[index];
+    if (c.inFlight || !c.backoff.due(nowMs)) continue;
+
+    bool pending = !converged(index);
+    bool settled = !c.batching || nowMs - c.batchStart >= settleMs_;
+    ReconcileAction action = RECONCILE_NONE;
+
+    if (c.needsAudit && (pending || nowMs - c.lastAuditAt >= auditMs_)) {
+      action = RECONCILE_AUDIT;
+    } else if (pending && settled) {
+      action = RECONCILE_APPLY;
+    } else if (!pending && nowMs - c.lastAuditAt >= auditMs_) {
+      action = RECONCILE_AUDIT;
+    }
+    if (action == RECONCILE_NONE) continue;
+
+    for (uint8_t i = 0; i < c.count; i++) {
+      c.entries[i].seen = false;
+      c.entries[i].sending = action == RECONCILE_APPLY && !c.entries[i].synced;
+    }
+    c.inFlight = true;
+    if (action == RECONCILE_APPLY) c.batching = false;
+    cursor_ = (index + 1) % count_;
+    controller = index;
+    if (action == RECONCILE_APPLY) {
+      stats_.applies++;
+    } else {
+      stats_.audits++;
+    }
+    return action;
+  }
+  return RECONCILE_NONE;
+}
+
+size_t Reconciler::entryCount(int controller) const {
+  return valid(controller) ? controllers_[controller].count : 0;
+}
+
+const ReconcileEntry& Reconciler::entry(int controller, size_t index) const {
+  return controllers_[controller].entries[index];
+}
+
+void Reconciler::auditUptime(int controller, uint32_t uptimeSec) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  c.rebooted = c.uptimeSec != 0 && uptimeSec < c.uptimeSec;
+  c.uptimeSec = uptimeSec > 0 ? uptimeSec : 1;
+  if (c.rebooted) stats_.reboots++;
+}
+
+void Reconciler::actualValue(int controller, const char* path, const char* value) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  bool known = false;
+  for (uint8_t i = 0; i < c.count; i++) {
+    ReconcileEntry& entry = c.entries[i];
+    if (entry.oneShot || strcmp(entry.path, path) != 0) continue;
+    entry.seen = true;
+    known = true;
+
+    bool differs = strcmp(entry.value, value) != 0;
+    if (entry.sending || (entry.synced && differs && !c.rebooted)) {
+      // What WLED made of it, or what someone at the controller chose
+      if (!entry.sending) stats_.drifts++;
+      if (strlen(value) < sizeof(entry.value)) {
+        snprintf(entry.value, sizeof(entry.value), "%s", value);
+      }
+    } else if (!entry.synced && !differs) {
+      entry.synced = true;
+    }
+  }
+
+  if (!known && c.adopting && !c.rebooted && c.count < RECONCILE_MAX_ENTRIES &&
+      strlen(path) < RECONCILE_PATH_LEN && strlen(value) < RECONCILE_VALUE_LEN) {
+    ReconcileEntry& entry = c.entries[c.count++];
+    memset(&entry, 0, sizeof(entry));
+    snprintf(entry.path, sizeof(entry.path), "%s", path);
+    snprintf(entry.value, sizeof(entry.value), "%s", value);
+    entry.synced = true;
+    entry.seen = true;
+  }
+}
+
+void Reconciler::finishApply(int controller, bool ok, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  c.inFlight = false;
+
+  if (!ok) {
+    for (uint8_t i = 0; i < c.count; i++) c.entries[i].sending = false;
+    stats_.failures++;
+    c.backoff.failed(nowMs);
+    c.needsAudit = true;
+    return;
+  }
+
+  c.backoff.succeeded();
+  for (uint8_t i = 0; i < c.count; i++) {
+    ReconcileEntry& entry = c.entries[i];
+    if (entry.sending) entry.synced = true;
+    entry.sending = false;
+  }
+  removeOneShots(c);
+  if (converged(controller)) markConverged(c, nowMs);
+}
+
+void Reconciler::finishAudit(int controller, bool ok, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  Controller& c = controllers_[controller];
+  c.inFlight = false;
+  bool rebooted = c.rebooted;
+  c.rebooted = false;
+
+  if (!ok) {
+    stats_.failures++;
+    c.backoff.failed(nowMs);
+    c.needsAudit = true;
+    return;
+  }
+
+  c.backoff.succeeded();
+  c.needsAudit = false;
+  c.lastAuditAt = nowMs;
+  c.adopting = false;
+
+  bool wasConverged = !c.dirty;
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < c.count; i++) {
+    ReconcileEntry& entry = c.entries[i];
+    if (!entry.oneShot && entry.synced) {
+      // The controller started over from its boot preset: send everything
+      // again. A confirmed entry gone from its state (a segment removed
+      // there) is forgotten like any other local change.
+      if (rebooted) {
+        entry.synced = false;
+      } else if (!entry.seen) {
+        stats_.drifts++;
+        continue;
+      }
+    }
+    c.entries[kept++] = entry;
+  }
+  c.count = kept;
+
+  if (converged(controller)) {
+    if (c.dirty) markConverged(c, nowMs);
+  } else if (wasConverged) {
+    // Drift or reboot; counts as a new change to converge, sent at once
+    c.dirty = true;
+    c.dirtySince = nowMs;
+    c.batching = false;
+  }
+}
+
+void Reconciler::adoptNextAudit(int controller, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  controllers_[controller].adopting = true;
+  auditSoon(controller, nowMs);
+}
+
+void Reconciler::auditSoon(int controller, uint32_t nowMs) {
+  if (!valid(controller)) return;
+  controllers_[controller].lastAuditAt = nowMs - auditMs_;
+}
+
+bool Reconciler::converged(int controller) const {
+  if (!valid(controller)) return true;
+  const Controller& c = controllers_[controller];
+  for (uint8_t i = 0; i < c.count; i++) {
+    if (!c.entries[i].synced) return false;
+  }
+  return true;
+}
+
+uint32_t Reconciler::failures(int controller) const {
+  return valid(controller) ? controllers_[controller].backoff.failures() : 0;
+}
+
+void Reconciler::markConverged(Controller& c, uint32_t nowMs) {
+  uint32_t took = nowMs - c.dirtySince;
+  c.dirty = false;
+  stats_.converged++;
+  stats_.convergeMsTotal += took;
+  if (took > stats_.convergeMsMax) stats_.convergeMsMax = took;
+}
+
+void Reconciler::removeOneShots(Controller& c) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < c.count; i++) {
+    if (!(c.entries[i].oneShot && c.entries[i].synced)) c.entries[kept++] = c.entries[i];
+  }
+  c.count = kept;
+}
@@ -0,0 +1,158 @@
+// Lumina Bridge Common - Desired-State Reconciliation
+//
+// Commands no longer go to WLED one by one. Each one updates its
+// controller's desired state, and the reconciler works out which requests
+// bring the controller there:
+//
+// - Only entries the controller does not already have are sent. Entries
+//   are WLED state leaves by path ("bri", "nl.dur", "seg.0.fx") with their
+//   JSON value as text; wled_state.h converts to and from WLED JSON.
+// - Changes go out in batches: everything that arrives within `settleMs`
+//   of the first unsent change, or while a request is in flight, shares
+//   one request (a slider drag sends a few steps, not every one).
+// - Failed requests back off (decorrelated jitter, ReconnectBackoff) and
+//   the next attempt after a failure starts with an audit.
+// - Every `auditMs` an idle controller is audited (GET /json/si). A lower
+//   `uptime` than last time means it rebooted, and every entry is resent.
+//   A value changed locally (WLED app, button, timer, nightlight fade) is
+//   taken into the desired state: someone at the controller wanted it.
+//   Only entries not yet confirmed (a newer command, a failed or timed out
+//   apply) are sent again.
+//
+// Some requests are actions rather than state ("psave", "on":"t"). Those
+// are queued as one-shot entries, sent once with the next request and not
+// audited. A preset or playlist ("ps", "pl") is one too, since WLED moves
+// on from it by itself; it clears the desired state, and the audit right
+// after it takes what the controller reports as the new desired state.
+//
+// No JSON library and no clock of its own, so the same code runs in the
+// host simulation (tools/reconcile_sim.cpp).
+
+#ifndef RECONCILER_H
+#define RECONCILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "reconnect_backoff.h"
+
+#define RECONCILE_MAX_CONTROLLERS 8
+#define RECONCILE_MAX_ENTRIES 24
+#define RECONCILE_IP_LEN 16
+#define RECONCILE_PATH_LEN 24
+#define RECONCILE_VALUE_LEN 64
+
+// What next() asks the caller to do
+enum ReconcileAction : uint8_t {
+  RECONCILE_NONE,
+  RECONCILE_APPLY,  // POST the sending() entries to /json/state
+  RECONCILE_AUDIT,  // GET /json/si and report every desired path's value
+};
+
+struct ReconcileEntry {
+  char path[RECONCILE_PATH_LEN];
+  char value[RECONCILE_VALUE_LEN];
+  bool oneShot;  // Sent once, then dropped
+  bool synced;   // The controller is known to have this value
+  bool sending;  // Part of the request in flight
+  bool seen;     // Reported by the response being processed
+};
+
+struct ReconcileStats {
+  uint32_t changes;      // Desired entries changed by commands
+  uint32_t converged;    // Times a controller reached its desired state
+  uint32_t applies;      // POST requests
+  uint32_t audits;       // GET requests
+  uint32_t failures;     // Requests that failed
+  uint32_t reboots;      // Reboots detected from uptime
+  uint32_t drifts;       // Audited values found changed locally and taken over
+  uint32_t convergeMsTotal;
+  uint32_t convergeMsMax;
+};
+
+class Reconciler {
+ public:
+  Reconciler(uint32_t settleMs, uint32_t auditMs, uint32_t retryBaseMs, uint32_t retryCapMs);
+
+  // Index of the controller at `ip`, adding it if `create`; -1 if unknown
+  // or every slot is taken
+  int controller(const char* ip, bool create);
+  const char* ip(int controller) const;
+
+  // Sets one desired entry. False if the path or value is too long or the
+  // table is full; the caller then sends the command the old way.
+  bool setDesired(int controller, const char* path, const char* value, bool oneShot,
+                  uint32_t nowMs);
+
+  // Forgets every desired entry (a preset or playlist replaces the state)
+  void clearDesired(int controller);
+
+  // The next request to make, if one is due; fills `controller`
+  ReconcileAction next(uint32_t nowMs, int& controller);
+
+  // Entries of the current apply request
+  size_t entryCount(int controller) const;
+  const ReconcileEntry& entry(int controller, size_t index) const;
+
+  // An audit's info.uptime, reported before its values
+  void auditUptime(int controller, uint32_t uptimeSec);
+
+  // The controller's value for a path, from the apply response or the
+  // audit, in the same text form as setDesired(). A differing value is
+  // adopted (WLED clamps and rounds what was sent; anything else was
+  // changed locally) unless the controller rebooted or the entry is not
+  // confirmed yet. Unknown paths are ignored until the audit that
+  // adoptNextAudit() asked for, which adds them while there is room.
+  void actualValue(int controller, const char* path, const char* value);
+
+  // The request next() asked for finished
+  void finishApply(int controller, bool ok, uint32_t nowMs);
+  void finishAudit(int controller, bool ok, uint32_t nowMs);
+
+  // The controller replaced its state by itself (a preset or playlist was
+  // applied): audit it at once and take all it reports as desired
+  void adoptNextAudit(int controller, uint32_t nowMs);
+
+  // The controller announced a change of its own (an MQTT push): audit it
+  // on the next idle next() instead of waiting out `auditMs`
+  void auditSoon(int controller, uint32_t nowMs);
+
+  // Every desired entry synced and no one-shot waiting
+  bool converged(int controller) const;
+
+  // Consecutive failed requests
+  uint32_t failures(int controller) const;
+
+  const ReconcileStats& stats() const { return stats_; }
+
+ private:
+  struct Controller {
+    char ip[RECONCILE_IP_LEN];
+    ReconcileEntry entries[RECONCILE_MAX_ENTRIES];
+    uint8_t count;
+    ReconnectBackoff backoff;
+    uint32_t batchStart;  // First change not yet sent
+    uint32_t dirtySince;
+    uint32_t lastAuditAt;
+    uint32_t uptimeSec;
+    bool dirty;        // Waiting to converge since dirtySince
+    bool batching;     // Changes waiting for settleMs from batchStart
+    bool needsAudit;   // Audit before the next apply (new or failed controller)
+    bool inFlight;
+    bool rebooted;     // The audit being processed found a lower uptime
+    bool adopting;     // The next audit adds every reported path
+  };
+
+  bool valid(int controller) const { return controller >= 0 && controller < count_; }
+  void markConverged(Controller& c, uint32_t nowMs);
+  void removeOneShots(Controller& c);
+
+  Controller controllers_[RECONCILE_MAX_CONTROLLERS];
+  uint8_t count_;
+  uint8_t cursor_;  // Round robin start for next()
+  uint32_t settleMs_;
+  uint32_t auditMs_;
+  ReconcileStats stats_;
+};
+
+#endif // RECONCILER_H
@@ -0,0 +1,94 @@
+/**
+ * Lumina Bridge Common - Reconnect Backoff
+ *
+ * Decorrelated jitter as in "Exponential Backoff and Jitter" (AWS
+ * Architecture Blog): sleep = min(cap, random(base, sleep * 3)). Compared
+ * with full jitter it keeps waits growing while never synchronising
+ * clients that started together.
+ */
+
+#include "reconnect_backoff.h"
+
+// FNV-1a
+static uint32_t hashId(const char* id) {
+  uint32_t hash = 2166136261u;
+  for (; *id != '\0'; id++) {
+    hash ^= (uint8_t)*id;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+ReconnectBackoff::ReconnectBackoff(uint32_t baseMs, uint32_t capMs, uint32_t spreadMs)
+    : baseMs_(baseMs), capMs_(capMs), spreadMs_(spreadMs), hintSpreadMs_(0),
+      hintMinMs_(0), hintCapMs_(0), deviceHash_(0), rng_(1), failures_(0), delayMs_(0),
+      nextAt_(0), waiting_(false) {}
+
+void ReconnectBackoff::begin(const char* deviceId, uint32_t seed) {
+  deviceHash_ = hashId(deviceId);
+  rng_ = (seed ^ deviceHash_) | 1;
+}
+
+void ReconnectBackoff::failed(uint32_t nowMs) {
+  if (failures_ == 0) {
+    // Same offset every outage for this device, different across the fleet
+    uint32_t spread = hintSpreadMs_ > 0 ? hintSpreadMs_ : spreadMs_;
+    delayMs_ = spread > 0 ? deviceHash_ % spread : 0;
+  } else {
+    uint32_t previous = delayMs_ > base() ? delayMs_ : base();
+    uint64_t high = (uint64_t)previous * 3;
+    delayMs_ = random(base(), high < cap() ? (uint32_t)high : cap());
+  }
+  failures_++;
+  nextAt_ = nowMs + delayMs_;
+  waiting_ = true;
+}
+
+void ReconnectBackoff::succeeded() {
+  failures_ = 0;
+  delayMs_ = 0;
+  waiting_ = false;
+}
+
+bool ReconnectBackoff::due(uint32_t nowMs) const {
+  return !waiting_ || (int32_t)(nowMs - nextAt_) >= 0;
+}
+
+uint32_t ReconnectBackoff::msUntilDue(uint32_t nowMs) const {
+  return due(nowMs) ? 0 : nextAt_ - nowMs;
+}
+
+void ReconnectBackoff::retryAfter(uint32_t nowMs, uint32_t delayMs) {
+  if (delayMs > cap()) delayMs = cap();
+  if (!waiting_ || (int32_t)(nowMs + delayMs - nextAt_) > 0) {
+    nextAt_ = nowMs + delayMs;
+    waiting_ = true;
+  }
+  // Later waits grow from the server's figure
+  if (delayMs > delayMs_) delayMs_ = delayMs;
+  if (failures_ == 0) failures_ = 1;
+}
+
+void ReconnectBackoff::setFleetHint(uint32_t spreadMs, uint32_t minMs, uint32_t capMs) {
+  hintSpreadMs_ = spreadMs;
+  hintMinMs_ = minMs;
+  hintCapMs_ = capMs;
+}
+
+uint32_t ReconnectBackoff::base() const {
+  return hintMinMs_ > baseMs_ ? hintMinMs_ : baseMs_;
+}
+
+uint32_t ReconnectBackoff::cap() const {
+  uint32_t limit = hintCapMs_ > 0 ? hintCapMs_ : capMs_;
+  return limit > base() ? limit : base();
+}
+
+// xorshift32; uniform enough for spreading retries
+uint32_t ReconnectBackoff::random(uint32_t low, uint32_t high) {
+  rng_ ^= rng_ << 13;
+  rng_ ^= rng_ >> 17;
+  rng_ ^= rng_ << 5;
+  if (high <= low) return low;
+  return low + rng_ % (high - low + 1);
+}
@@ -0,0 +1,75 @@
+// Lumina Bridge Common - Reconnect Backoff
+//
+// Decides when a bridge next tries to reach the cloud after a failure, so a
+// fleet that loses the broker or Firestore together does not come back in
+// lockstep:
+//
+// - The first retry after an outage starts is spread over `spreadMs` by a
+//   hash of the device ID, so bridges that dropped at the same moment do
+//   not all reconnect at the same moment.
+// - Later retries use decorrelated jitter: each wait is random between
+//   `baseMs` and three times the previous wait, capped at `capMs`.
+// - The server can ask for more: a Retry-After on one failed request, or a
+//   fleet-wide hint (retained MQTT message) that widens the spread and
+//   raises the floor and cap for later outages.
+//
+// Times are milliseconds from the caller's clock (millis() on the bridge),
+// so the same code runs in the host simulation (tools/reconnect_sim.cpp).
+
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+#include <stdint.h>
+
+class ReconnectBackoff {
+ public:
+  ReconnectBackoff(uint32_t baseMs, uint32_t capMs, uint32_t spreadMs);
+
+  // For arrays; assign a configured instance before use
+  ReconnectBackoff() : ReconnectBackoff(0, 0, 0) {}
+
+  // Device ID for the first-retry spread, and a seed for the jitter
+  // (esp_random() on the bridge)
+  void begin(const char* deviceId, uint32_t seed);
+
+  // An attempt failed, or a working connection was lost, at `nowMs`
+  void failed(uint32_t nowMs);
+
+  // Connected; the next failure starts a new outage
+  void succeeded();
+
+  // True when the caller may try again (always, unless a failure is
+  // waiting out its delay)
+  bool due(uint32_t nowMs) const;
+
+  // The server asked for at least `delayMs` before the next attempt
+  void retryAfter(uint32_t nowMs, uint32_t delayMs);
+
+  // Fleet-wide hint; 0 leaves a setting at its built-in value
+  void setFleetHint(uint32_t spreadMs, uint32_t minMs, uint32_t capMs);
+
+  uint32_t failures() const { return failures_; }
+  uint32_t lastDelayMs() const { return delayMs_; }
+  uint32_t msUntilDue(uint32_t nowMs) const;
+
+ private:
+  uint32_t random(uint32_t low, uint32_t high);
+  uint32_t base() const;
+  uint32_t cap() const;
+
+  uint32_t baseMs_;
+  uint32_t capMs_;
+  uint32_t spreadMs_;
+  uint32_t hintSpreadMs_;
+  uint32_t hintMinMs_;
+  uint32_t hintCapMs_;
+
+  uint32_t deviceHash_;
+  uint32_t rng_;
+  uint32_t failures_;
+  uint32_t delayMs_;
+  uint32_t nextAt_;
+  bool waiting_;
+};
+
+#endif // RECONNECT_BACKOFF_H
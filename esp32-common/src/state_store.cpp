@@ -0,0 +1,646 @@
+/**
+ * Lumina Bridge Common - Log-Structured State Store
+ *
+ * Sector: a 16-byte header (magic, sequence number, erase count, CRC-32 of
+ * the first 12 bytes), then batches up to the end. Batch: length (LE16),
+ * its complement, CRC-32 of the entries, then the entries, padded to 4
+ * bytes with 0xFF. Entry: key length (1 byte), value length (LE16, 0xFFFF
+ * for a removal), key, value.
+ *
+ * An erased batch header, with the rest of the sector erased too, ends a
+ * sector's log. Anything else that fails its checks is the damage of a
+ * cut-short program: recovery skips it, resuming at the next valid batch
+ * header if a later batch was appended after it, and otherwise appends
+ * after the last programmed byte. A page program does not set its bytes in
+ * order, so that byte may lie past the torn batch's own length. Sealing the
+ * sector instead would cost one sector per brownout, and a supply that
+ * browns out on every boot would soon leave none free.
+ *
+ * Compaction always takes the oldest sector. A removal only has to hide
+ * values in older sectors, so by the time its own sector is the oldest it
+ * can be dropped. Before erasing, the sector's magic is programmed to zero,
+ * so an erase cut short never leaves a header that looks valid. Commits
+ * never open the last free sector; compaction may, for its copies, and
+ * frees the oldest right after. A power cut in between leaves none free,
+ * so the next commit finishes that compaction first.
+ */
+
+#include "state_store.h"
+
+#include "coop_bench.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_partition.h>
+#endif
+
+static const uint32_t SECTOR_MAGIC = 0x3153534C;  // "LSS1"
+static const size_t SECTOR_HEADER = 16;
+static const size_t BATCH_HEADER = 8;
+static const size_t ENTRY_HEADER = 3;
+static const uint16_t TOMBSTONE = 0xFFFF;
+static const uint32_t DAY_MS = 24UL * 60 * 60 * 1000;
+
+enum BatchStatus { BATCH_VALID, BATCH_ERASED, BATCH_BAD };
+
+static uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+  static const uint32_t NIBBLES[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc = NIBBLES[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+    crc = NIBBLES[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+static size_t padded(size_t length) { return (length + 3) & ~(size_t)3; }
+
+static void put16(uint8_t* p, uint16_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint16_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ============================================================================
+// Recovery
+// ============================================================================
+
+StateStore::StateStore(uint32_t commitMs, uint32_t dailyBytes)
+    : commitMs_(commitMs),
+      dailyBytes_(dailyBytes),
+      flash_(nullptr),
+      sectorSize_(0),
+      sectorCount_(0),
+      nextSeq_(1),
+      keyCount_(0),
+      staged_(0),
+      stagedAt_(0),
+      dayStartedAt_(0),
+      dayBytes_(0) {
+  memset(sectors_, 0, sizeof(sectors_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool StateStore::begin(StateFlash& flash, uint32_t nowMs) {
+  uint64_t started = benchMicros();
+  flash_ = nullptr;
+  keyCount_ = 0;
+  size_t count = flash.sectorCount();
+  if (count < STATE_MIN_SECTORS || flash.sectorSize() > 0xFFFF ||
+      flash.sectorSize() < SECTOR_HEADER + BATCH_HEADER + STATE_BATCH_BYTES) {
+    return false;
+  }
+  sectorSize_ = flash.sectorSize();
+  sectorCount_ = count > STATE_MAX_SECTORS ? STATE_MAX_SECTORS : (uint8_t)count;
+  flash_ = &flash;
+
+  // Headers first, then the logs in sequence order
+  nextSeq_ = 1;
+  uint32_t knownErases = 0;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    Sector& sector = sectors_[i];
+    memset(&sector, 0, sizeof(sector));
+    uint8_t header[SECTOR_HEADER];
+    if (!flash.read(i * sectorSize_, header, sizeof(header))) {
+      flash_ = nullptr;
+      return false;
+    }
+    if (get32(header) != SECTOR_MAGIC || get32(header + 12) != crc32(header, 12)) continue;
+    sector.inLog = true;
+    sector.seq = get32(header + 4);
+    sector.eraseCount = get32(header + 8);
+    sector.used = SECTOR_HEADER;
+    if (sector.seq >= nextSeq_) nextSeq_ = sector.seq + 1;
+    if (sector.eraseCount > knownErases) knownErases = sector.eraseCount;
+  }
+  // A sector with no header lost its count; assume it is as worn as any
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (!sectors_[i].inLog) sectors_[i].eraseCount = knownErases;
+  }
+
+  uint32_t replayedSeq = 0;
+  for (;;) {
+    int next = -1;
+    for (uint8_t i = 0; i < sectorCount_; i++) {
+      const Sector& sector = sectors_[i];
+      if (!sector.inLog || sector.seq <= replayedSeq) continue;
+      if (next < 0 || sector.seq < sectors_[next].seq) next = i;
+    }
+    if (next < 0) break;
+    replayedSeq = sectors_[next].seq;
+    if (!replay(next)) {
+      flash_ = nullptr;
+      return false;
+    }
+  }
+
+  // Only the newest sector takes appends
+  int last = newest();
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (sectors_[i].inLog && i != last) sectors_[i].sealed = true;
+  }
+
+  refreshEraseStats();
+  stats_.recoveryMicros = (uint32_t)(benchMicros() - started);
+  dayStartedAt_ = nowMs;
+  dayBytes_ = 0;
+  return true;
+}
+
+bool StateStore::replay(uint8_t index) {
+  Sector& sector = sectors_[index];
+  size_t offset = SECTOR_HEADER;
+
+  while (offset + BATCH_HEADER <= sectorSize_) {
+    uint16_t length;
+    int status = readBatch(index, offset, length);
+    if (status < 0) return false;
+    if (status == BATCH_VALID) {
+      apply(index, offset + BATCH_HEADER, buffer_, length);
+      offset += BATCH_HEADER + padded(length);
+      continue;
+    }
+    if (status == BATCH_ERASED && restErased(index, offset)) break;  // End of the log
+
+    // Cut short by a power loss: later batches were appended after the
+    // damage, so look for one; if there is none, appends go past it
+    stats_.tornBatches++;
+    size_t next = offset + 4;
+    for (; next + BATCH_HEADER <= sectorSize_; next += 4) {
+      status = readBatch(index, next, length);
+      if (status < 0) return false;
+      if (status == BATCH_VALID) break;
+    }
+    if (next + BATCH_HEADER <= sectorSize_) {
+      offset = next;
+      continue;
+    }
+    int last = lastProgrammed(index, offset);
+    if (last < 0) return false;
+    offset = padded(last + 1);
+    break;
+  }
+  sector.used = offset;
+  sector.sealed = offset + BATCH_HEADER >= sectorSize_;
+  return true;
+}
+
+// BATCH_VALID (read into buffer_), BATCH_ERASED, BATCH_BAD, or -1 if the
+// flash could not be read
+int StateStore::readBatch(uint8_t index, size_t offset, uint16_t& length) {
+  uint8_t header[BATCH_HEADER];
+  if (!flash_->read(index * sectorSize_ + offset, header, sizeof(header))) return -1;
+  length = get16(header);
+  if (length == 0xFFFF && get16(header + 2) == 0xFFFF && get32(header + 4) == 0xFFFFFFFF) {
+    return BATCH_ERASED;
+  }
+  if ((uint16_t)~length != get16(header + 2) || length == 0 || length > STATE_BATCH_BYTES ||
+      offset + BATCH_HEADER + padded(length) > sectorSize_) {
+    return BATCH_BAD;
+  }
+  if (!flash_->read(index * sectorSize_ + offset + BATCH_HEADER, buffer_, length)) return -1;
+  return crc32(buffer_, length) == get32(header + 4) ? BATCH_VALID : BATCH_BAD;
+}
+
+// Whether the sector is erased from `offset` on. A page program cut short
+// can set bytes past a batch header it never wrote.
+bool StateStore::restErased(uint8_t index, size_t offset) {
+  return lastProgrammed(index, offset) < (int)offset;
+}
+
+// The last byte at or after `offset` that is not 0xFF; offset - 1 if none,
+// -1 if the flash could not be read
+int StateStore::lastProgrammed(uint8_t index, size_t offset) {
+  int last = (int)offset - 1;
+  for (size_t at = offset; at < sectorSize_; at += STATE_BATCH_BYTES) {
+    size_t chunk = sectorSize_ - at;
+    if (chunk > STATE_BATCH_BYTES) chunk = STATE_BATCH_BYTES;
+    if (!flash_->read(index * sectorSize_ + at, buffer_, chunk)) return -1;
+    for (size_t i = 0; i < chunk; i++) {
+      if (buffer_[i] != 0xFF) last = (int)(at + i);
+    }
+  }
+  return last;
+}
+
+// Updates the index for entries stored at `base` within `sector`
+void StateStore::apply(uint8_t sector, size_t base, const uint8_t* entries, size_t length) {
+  size_t at = 0;
+  while (at + ENTRY_HEADER <= length) {
+    uint8_t keyLength = entries[at];
+    uint16_t valueLength = get16(entries + at + 1);
+    size_t valueBytes = valueLength == TOMBSTONE ? 0 : valueLength;
+    if (keyLength == 0 || keyLength > STATE_KEY_MAX ||
+        at + ENTRY_HEADER + keyLength + valueBytes > length) {
+      return;  // The CRC matched, so only a bug gets here
+    }
+    char key[STATE_KEY_MAX + 1];
+    memcpy(key, entries + at + ENTRY_HEADER, keyLength);
+    key[keyLength] = '\0';
+
+    int found = findKey(key);
+    if (valueLength == TOMBSTONE) {
+      if (found >= 0) keys_[found] = keys_[--keyCount_];
+    } else {
+      if (found < 0 && keyCount_ < STATE_MAX_KEYS) {
+        found = keyCount_++;
+        memcpy(keys_[found].name, key, keyLength + 1);
+      }
+      if (found >= 0) {
+        keys_[found].sector = sector;
+        keys_[found].offset = (uint16_t)(base + at + ENTRY_HEADER + keyLength);
+        keys_[found].length = valueLength;
+      }
+    }
+    at += ENTRY_HEADER + keyLength + valueBytes;
+  }
+}
+
+// ============================================================================
+// Reads and Writes
+// ============================================================================
+
+int StateStore::findKey(const char* key) const {
+  for (size_t i = 0; i < keyCount_; i++) {
+    if (strcmp(keys_[i].name, key) == 0) return (int)i;
+  }
+  return -1;
+}
+
+// Offset and size of the staged entry for `key`; its value length, or -1
+int StateStore::findStaged(const char* key, size_t& at, size_t& size) const {
+  size_t keyLength = strlen(key);
+  for (size_t i = 0; i + ENTRY_HEADER <= staged_;) {
+    uint8_t entryKey = staging_[i];
+    uint16_t valueLength = get16(staging_ + i + 1);
+    size_t entrySize = ENTRY_HEADER + entryKey + (valueLength == TOMBSTONE ? 0 : valueLength);
+    if (entryKey == keyLength && memcmp(staging_ + i + ENTRY_HEADER, key, keyLength) == 0) {
+      at = i;
+      size = entrySize;
+      return valueLength;
+    }
+    i += entrySize;
+  }
+  size = 0;
+  return -1;
+}
+
+int StateStore::get(const char* key, void* out, size_t size) {
+  if (!ready()) return -1;
+  size_t at, entrySize;
+  int staged = findStaged(key, at, entrySize);
+  if (entrySize > 0) {
+    if (staged == TOMBSTONE) return -1;
+    memcpy(out, staging_ + at + ENTRY_HEADER + strlen(key), (size_t)staged < size ? staged : size);
+    return staged;
+  }
+
+  int found = findKey(key);
+  if (found < 0) return -1;
+  const Key& entry = keys_[found];
+  size_t length = entry.length < size ? entry.length : size;
+  if (length > 0 && !flash_->read(entry.sector * sectorSize_ + entry.offset, out, length)) {
+    return -1;
+  }
+  return entry.length;
+}
+
+bool StateStore::put(const char* key, const void* value, size_t length, uint32_t nowMs) {
+  return stage(key, value, length, false, nowMs);
+}
+
+bool StateStore::remove(const char* key, uint32_t nowMs) {
+  return stage(key, nullptr, 0, true, nowMs);
+}
+
+bool StateStore::stage(const char* key, const void* value, size_t length, bool tombstone,
+                       uint32_t nowMs) {
+  size_t keyLength = strlen(key);
+  if (!ready() || keyLength == 0 || keyLength > STATE_KEY_MAX || length > STATE_VALUE_MAX) {
+    stats_.rejected++;
+    return false;
+  }
+
+  size_t at, oldSize;
+  findStaged(key, at, oldSize);
+  if (tombstone && oldSize == 0 && findKey(key) < 0) return true;  // Nothing to remove
+
+  size_t entrySize = ENTRY_HEADER + keyLength + (tombstone ? 0 : length);
+  if (staged_ - oldSize + entrySize > STATE_BATCH_BYTES) {
+    // Group commit by size: the batch so far goes now
+    if (!commitStaged(nowMs)) {
+      stats_.rejected++;
+      return false;
+    }
+    oldSize = 0;
+  }
+
+  if (!tombstone) {
+    // Keys not committed yet, this one and others staged, must fit the
+    // index; live bytes must leave compaction room
+    size_t newKeys = findKey(key) < 0 ? 1 : 0;
+    for (size_t i = 0; i + ENTRY_HEADER <= staged_;) {
+      uint16_t valueLength = get16(staging_ + i + 1);
+      char name[STATE_KEY_MAX + 1];
+      memcpy(name, staging_ + i + ENTRY_HEADER, staging_[i]);
+      name[staging_[i]] = '\0';
+      if (valueLength != TOMBSTONE && strcmp(name, key) != 0 && findKey(name) < 0) newKeys++;
+      i += ENTRY_HEADER + staging_[i] + (valueLength == TOMBSTONE ? 0 : valueLength);
+    }
+    if (keyCount_ + newKeys > STATE_MAX_KEYS ||
+        liveBytes() + staged_ - oldSize + entrySize > capacityBytes()) {
+      stats_.rejected++;
+      return false;
+    }
+  }
+
+  if (oldSize > 0) {
+    memmove(staging_ + at, staging_ + at + oldSize, staged_ - at - oldSize);
+    staged_ -= oldSize;
+    stats_.coalesced++;
+  }
+  if (staged_ == 0) stagedAt_ = nowMs;
+  uint8_t* entry = staging_ + staged_;
+  entry[0] = (uint8_t)keyLength;
+  put16(entry + 1, tombstone ? TOMBSTONE : (uint16_t)length);
+  memcpy(entry + ENTRY_HEADER, key, keyLength);
+  if (!tombstone && length > 0) memcpy(entry + ENTRY_HEADER + keyLength, value, length);
+  staged_ += entrySize;
+  return true;
+}
+
+bool StateStore::sync(uint32_t nowMs) {
+  return staged_ == 0 || commitStaged(nowMs);
+}
+
+void StateStore::step(uint32_t nowMs, bool idle) {
+  if (!ready()) return;
+  rollDay(nowMs);
+  if (staged_ > 0 && nowMs - stagedAt_ >= commitMs_) {
+    // A deferred batch is tried again after another commitMs
+    if (!commitStaged(nowMs)) stagedAt_ = nowMs;
+    return;
+  }
+  // Ahead of need, so a commit rarely waits on an erase. Not in a minimum
+  // ring: with half of it free, the oldest sector is still mostly live and
+  // compacting it early only adds erases.
+  if (idle && sectorCount_ > STATE_MIN_SECTORS && freeSectors() <= 2 &&
+      dayBytes_ < dailyBytes_) {
+    compactOldest();
+  }
+}
+
+bool StateStore::commitStaged(uint32_t nowMs) {
+  rollDay(nowMs);
+  if (dayBytes_ + BATCH_HEADER + padded(staged_) > dailyBytes_) {
+    stats_.deferred++;
+    return false;
+  }
+
+  uint64_t started = benchMicros();
+  if (!append(staging_, staged_, false)) return false;
+  staged_ = 0;
+  stats_.commits++;
+  commitMicros_.add((uint32_t)(benchMicros() - started));
+  return true;
+}
+
+void StateStore::rollDay(uint32_t nowMs) {
+  if (nowMs - dayStartedAt_ >= DAY_MS) {
+    dayStartedAt_ = nowMs;
+    dayBytes_ = 0;
+  }
+}
+
+// Everything programmed counts against the day, compaction copies too
+void StateStore::programmed(uint32_t bytes) {
+  stats_.programmedBytes += bytes;
+  dayBytes_ += bytes;
+}
+
+// ============================================================================
+// Log
+// ============================================================================
+
+bool StateStore::append(const uint8_t* entries, size_t length, bool compacting) {
+  size_t need = BATCH_HEADER + padded(length);
+  // Only a compaction cut short by a power loss leaves no sector free.
+  // Finish it first, before commits take the room its copies need.
+  if (!compacting && freeSectors() == 0 && !compactOldest()) return false;
+
+  int index = newest();
+  if (!fits(index, need)) {
+    if (index >= 0) sectors_[index].sealed = true;
+    // A new sector must leave one free for compaction to copy into. The
+    // copies may open one themselves, and the batch goes there if it fits.
+    for (uint8_t i = 0; !compacting && i < sectorCount_ && freeSectors() <= 1; i++) {
+      if (!compactOldest()) break;
+    }
+    index = newest();
+  }
+  if (!fits(index, need)) {
+    if (index >= 0) sectors_[index].sealed = true;
+    if ((!compacting && freeSectors() <= 1) || !openSector()) return false;
+    index = newest();
+  }
+
+  Sector& sector = sectors_[index];
+  uint8_t* batch = buffer_;
+  put16(batch, (uint16_t)length);
+  put16(batch + 2, (uint16_t)~length);
+  put32(batch + 4, crc32(entries, length));
+  memcpy(batch + BATCH_HEADER, entries, length);
+  memset(batch + BATCH_HEADER + length, 0xFF, need - BATCH_HEADER - length);
+  if (!flash_->write(index * sectorSize_ + sector.used, batch, need)) {
+    sector.sealed = true;  // Whatever landed would fail its CRC
+    return false;
+  }
+  apply(index, sector.used + BATCH_HEADER, entries, length);
+  sector.used += need;
+  programmed(need);
+  return true;
+}
+
+bool StateStore::fits(int index, size_t need) const {
+  return index >= 0 && !sectors_[index].sealed && sectors_[index].used + need <= sectorSize_;
+}
+
+bool StateStore::openSector() {
+  int pick = -1;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (sectors_[i].inLog) continue;
+    if (pick < 0 || sectors_[i].eraseCount < sectors_[pick].eraseCount) pick = i;
+  }
+  if (pick < 0) return false;
+
+  Sector& sector = sectors_[pick];
+  if (!sector.blank) {
+    if (!flash_->erase(pick)) return false;
+    sector.eraseCount++;
+    stats_.erases++;
+  }
+  uint8_t header[SECTOR_HEADER];
+  put32(header, SECTOR_MAGIC);
+  put32(header + 4, nextSeq_);
+  put32(header + 8, sector.eraseCount);
+  put32(header + 12, crc32(header, 12));
+  sector.blank = false;
+  if (!flash_->write(pick * sectorSize_, header, sizeof(header))) return false;
+  sector.inLog = true;
+  sector.sealed = false;
+  sector.seq = nextSeq_++;
+  sector.used = SECTOR_HEADER;
+  programmed(SECTOR_HEADER);
+  refreshEraseStats();
+  return true;
+}
+
+bool StateStore::compactOldest() {
+  int old = oldest();
+  if (old < 0 || old == newest()) return false;
+
+  // Live entries forward in batches; each batch moves its keys out of
+  // `old` as it is appended
+  size_t length = 0;
+  for (size_t i = 0; i <= keyCount_; i++) {
+    bool flush = i == keyCount_;
+    size_t entrySize = 0;
+    if (!flush) {
+      if (keys_[i].sector != old) continue;
+      entrySize = ENTRY_HEADER + strlen(keys_[i].name) + keys_[i].length;
+      flush = length + entrySize > STATE_BATCH_BYTES;
+    }
+    if (flush && length > 0) {
+      // The index changes under the loop only for keys already copied
+      if (!append(copy_, length, true)) return false;
+      length = 0;
+    }
+    if (i == keyCount_) break;
+
+    const Key& key = keys_[i];
+    size_t keyLength = strlen(key.name);
+    copy_[length] = (uint8_t)keyLength;
+    put16(copy_ + length + 1, key.length);
+    memcpy(copy_ + length + ENTRY_HEADER, key.name, keyLength);
+    if (!flash_->read(old * sectorSize_ + key.offset, copy_ + length + ENTRY_HEADER + keyLength,
+                      key.length)) {
+      return false;
+    }
+    length += entrySize;
+  }
+
+  // Zero the magic first: an erase cut short then never looks like a log
+  uint8_t zero[4] = {0, 0, 0, 0};
+  flash_->write(old * sectorSize_, zero, sizeof(zero));
+  programmed(sizeof(zero));
+  Sector& sector = sectors_[old];
+  sector.inLog = false;
+  sector.sealed = false;
+  sector.blank = false;
+  if (flash_->erase(old)) {
+    sector.blank = true;
+    sector.eraseCount++;
+    stats_.erases++;
+  }
+  stats_.compactions++;
+  refreshEraseStats();
+  return true;
+}
+
+int StateStore::newest() const {
+  int found = -1;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (sectors_[i].inLog && (found < 0 || sectors_[i].seq > sectors_[found].seq)) found = i;
+  }
+  return found;
+}
+
+int StateStore::oldest() const {
+  int found = -1;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (sectors_[i].inLog && (found < 0 || sectors_[i].seq < sectors_[found].seq)) found = i;
+  }
+  return found;
+}
+
+size_t StateStore::freeSectors() const {
+  size_t count = 0;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    if (!sectors_[i].inLog) count++;
+  }
+  return count;
+}
+
+size_t StateStore::liveBytes() const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < keyCount_; i++) {
+    bytes += ENTRY_HEADER + strlen(keys_[i].name) + keys_[i].length;
+  }
+  return bytes;
+}
+
+size_t StateStore::capacityBytes() const {
+  // Two sectors short: one for compaction to copy into, one lost to
+  // batches that did not fit at the ends of the others
+  if (sectorCount_ < STATE_MIN_SECTORS) return 0;
+  return (sectorCount_ - 2) * (sectorSize_ - SECTOR_HEADER - BATCH_HEADER - STATE_BATCH_BYTES);
+}
+
+void StateStore::refreshEraseStats() {
+  stats_.minEraseCount = UINT32_MAX;
+  stats_.maxEraseCount = 0;
+  for (uint8_t i = 0; i < sectorCount_; i++) {
+    uint32_t count = sectors_[i].eraseCount;
+    if (count < stats_.minEraseCount) stats_.minEraseCount = count;
+    if (count > stats_.maxEraseCount) stats_.maxEraseCount = count;
+  }
+}
+
+// ============================================================================
+// Partition Flash
+// ============================================================================
+
+#ifdef ESP_PLATFORM
+
+bool PartitionStateFlash::begin(const char* label) {
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                        label);
+  return partition_ != nullptr;
+}
+
+size_t PartitionStateFlash::sectorCount() const {
+  if (partition_ == nullptr) return 0;
+  return ((const esp_partition_t*)partition_)->size / sectorSize();
+}
+
+bool PartitionStateFlash::read(size_t address, void* out, size_t length) {
+  return partition_ != nullptr &&
+         esp_partition_read((const esp_partition_t*)partition_, address, out, length) == ESP_OK;
+}
+
+bool PartitionStateFlash::write(size_t address, const void* data, size_t length) {
+  return partition_ != nullptr &&
+         esp_partition_write((const esp_partition_t*)partition_, address, data, length) ==
+             ESP_OK;
+}
+
+bool PartitionStateFlash::erase(size_t sector) {
+  return partition_ != nullptr &&
+         esp_partition_erase_range((const esp_partition_t*)partition_, sector * sectorSize(),
+                                   sectorSize()) == ESP_OK;
+}
+
+#endif
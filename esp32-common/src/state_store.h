@@ -0,0 +1,185 @@
+// Lumina Bridge Common - Log-Structured State Store
+//
+// Small key/value state that has to survive a restart (journals, cursors,
+// dedup IDs, caches) in one place on flash, rather than in a file per
+// feature rewritten on every change. Changes are staged in RAM and
+// committed together: a batch is one append, so a burst of commands costs
+// one flash write, not one per key.
+//
+// Flash is a ring of sectors, each a log of batches. A batch carries a
+// CRC-32 over its length and entries, and recovery replays batches oldest
+// sector first, so a batch cut short by a brownout fails its CRC and is
+// skipped whole: after a power cut the store holds exactly the batches
+// that finished. The oldest sector is compacted when free sectors run
+// short (its live entries are copied forward, then it is erased), in the
+// background when the bridge says it is idle and the ring is larger than
+// the minimum. Sectors are reused least
+// erased first.
+//
+// Bytes programmed (commits and compaction copies) are counted per
+// 24-hour window; a commit that would go past `dailyBytes` is deferred and
+// its changes stay staged, where later writes to the same keys replace
+// them. That bounds erases per day however chatty the callers are.
+//
+// Keys are strings up to STATE_KEY_MAX bytes. get() sees staged changes.
+
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latency_stats.h"
+
+#define STATE_KEY_MAX 31       // Bytes, without the terminator
+#define STATE_VALUE_MAX 255
+#define STATE_MAX_KEYS 64
+#define STATE_MAX_SECTORS 16
+#define STATE_MIN_SECTORS 4
+#define STATE_BATCH_BYTES 512  // Staged changes; also the largest batch
+
+// NOR flash, addressed from the start of the store's region. write() may
+// only clear bits; erase() sets a whole sector to 0xFF.
+class StateFlash {
+ public:
+  virtual ~StateFlash() {}
+  virtual size_t sectorSize() const = 0;
+  virtual size_t sectorCount() const = 0;
+  virtual bool read(size_t address, void* out, size_t length) = 0;
+  virtual bool write(size_t address, const void* data, size_t length) = 0;
+  virtual bool erase(size_t sector) = 0;
+};
+
+#ifdef ESP_PLATFORM
+// A data partition (partitions.csv) found by label
+class PartitionStateFlash : public StateFlash {
+ public:
+  PartitionStateFlash() : partition_(nullptr) {}
+
+  bool begin(const char* label);
+
+  size_t sectorSize() const override { return 4096; }
+  size_t sectorCount() const override;
+  bool read(size_t address, void* out, size_t length) override;
+  bool write(size_t address, const void* data, size_t length) override;
+  bool erase(size_t sector) override;
+
+ private:
+  const void* partition_;  // esp_partition_t, kept out of this header
+};
+#endif
+
+struct StateStoreStats {
+  uint32_t commits;
+  uint32_t programmedBytes;  // Commits and compaction copies
+  uint32_t erases;
+  uint32_t compactions;
+  uint32_t coalesced;        // Staged changes replaced by a newer one to the same key
+  uint32_t deferred;         // Commits held back by the daily budget
+  uint32_t rejected;         // Changes refused: staging or store full
+  uint32_t tornBatches;      // Found by recovery
+  uint32_t recoveryMicros;   // begin(), scan and replay
+  uint32_t minEraseCount;
+  uint32_t maxEraseCount;
+};
+
+class StateStore {
+ public:
+  // `commitMs` after the first staged change, the batch is committed
+  StateStore(uint32_t commitMs, uint32_t dailyBytes);
+
+  // Replays the log on `flash`, which must outlive the store; a region
+  // with no store on it becomes an empty one. False if the flash has
+  // fewer than STATE_MIN_SECTORS sectors or cannot be read.
+  bool begin(StateFlash& flash, uint32_t nowMs);
+  bool ready() const { return flash_ != nullptr; }
+
+  // Staged. False if the key or value is too long, staging is full (over
+  // the daily budget, say), or the store would hold more than it can
+  // compact into.
+  bool put(const char* key, const void* value, size_t length, uint32_t nowMs);
+  bool remove(const char* key, uint32_t nowMs);
+
+  // The value's length, copied into `out` up to `size`; -1 if absent
+  int get(const char* key, void* out, size_t size);
+
+  // Commits the staged changes now, if the budget allows
+  bool sync(uint32_t nowMs);
+
+  // From the loop: commits a batch that is due, and while `idle` compacts
+  // one sector if free ones are short
+  void step(uint32_t nowMs, bool idle);
+
+  size_t stagedBytes() const { return staged_; }
+  size_t keyCount() const { return keyCount_; }
+  size_t liveBytes() const;
+  size_t capacityBytes() const;  // Live bytes the store accepts
+  size_t freeSectors() const;
+  uint32_t dayBytes() const { return dayBytes_; }
+  const StateStoreStats& stats() const { return stats_; }
+
+  // Per commit, including any compaction it had to do first
+  const LatencyStats& commitMicros() const { return commitMicros_; }
+  void clearCommitMicros() { commitMicros_.clear(); }
+
+ private:
+  struct Key {
+    char name[STATE_KEY_MAX + 1];
+    uint8_t sector;
+    uint16_t offset;  // Of the value, within the sector
+    uint16_t length;
+  };
+
+  struct Sector {
+    bool inLog;       // Holds a valid header
+    bool blank;       // Known erased since begin()
+    bool sealed;      // No more appends: full, or not the newest
+    uint32_t seq;
+    uint32_t eraseCount;
+    uint16_t used;    // Append offset
+  };
+
+  bool replay(uint8_t sector);
+  int readBatch(uint8_t sector, size_t offset, uint16_t& length);
+  bool restErased(uint8_t sector, size_t offset);
+  int lastProgrammed(uint8_t sector, size_t offset);
+  void apply(uint8_t sector, size_t base, const uint8_t* entries, size_t length);
+  bool commitStaged(uint32_t nowMs);
+  bool append(const uint8_t* entries, size_t length, bool compacting);
+  bool fits(int sector, size_t need) const;
+  bool openSector();
+  bool compactOldest();
+  int newest() const;
+  int oldest() const;
+  int findKey(const char* key) const;
+  int findStaged(const char* key, size_t& at, size_t& size) const;
+  bool stage(const char* key, const void* value, size_t length, bool tombstone,
+             uint32_t nowMs);
+  void rollDay(uint32_t nowMs);
+  void programmed(uint32_t bytes);
+  void refreshEraseStats();
+
+  uint32_t commitMs_;
+  uint32_t dailyBytes_;
+  StateFlash* flash_;
+  size_t sectorSize_;
+  uint8_t sectorCount_;
+  Sector sectors_[STATE_MAX_SECTORS];
+  uint32_t nextSeq_;
+
+  Key keys_[STATE_MAX_KEYS];
+  size_t keyCount_;
+
+  uint8_t staging_[STATE_BATCH_BYTES];
+  size_t staged_;
+  uint32_t stagedAt_;
+
+  uint8_t buffer_[STATE_BATCH_BYTES + 8];  // Batch being written or replayed
+  uint8_t copy_[STATE_BATCH_BYTES];        // Compaction's batch
+  uint32_t dayStartedAt_;
+  uint32_t dayBytes_;
+  StateStoreStats stats_;
+  LatencyStats commitMicros_;
+};
+
+#endif // STATE_STORE_H
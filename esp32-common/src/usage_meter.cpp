@@ -0,0 +1,94 @@
+/**
+ * Lumina Bridge Common - Cloud Usage Meter
+ *
+ * A ring of 24 hourly buckets. Nothing here allocates; the meter is
+ * about 1 KB of static state.
+ */
+
+#include "usage_meter.h"
+
+#include <string.h>
+
+uint32_t UsageTotals::cloudBytes() const {
+  uint32_t total = 0;
+  for (int t = 0; t < USAGE_TRANSPORT_COUNT; t++) {
+    if (t == USAGE_WLED) continue;
+    total += bytesUp[t] + bytesDown[t];
+  }
+  return total;
+}
+
+void UsageTotals::add(const UsageTotals& other) {
+  for (int t = 0; t < USAGE_TRANSPORT_COUNT; t++) {
+    bytesUp[t] += other.bytesUp[t];
+    bytesDown[t] += other.bytesDown[t];
+  }
+  for (int op = 0; op < FIRESTORE_OP_COUNT; op++) {
+    firestoreOps[op] += other.firestoreOps[op];
+  }
+}
+
+void UsageTotals::clear() {
+  memset(this, 0, sizeof(*this));
+}
+
+UsageMeter::UsageMeter() : hour_(0), index_(0), metered_(false) {
+  for (int i = 0; i < HISTORY_HOURS; i++) {
+    buckets_[i].clear();
+  }
+}
+
+void UsageMeter::setHour(uint32_t hour) {
+  if (hour == hour_) return;
+
+  // A clock that went backwards (or a long gap) invalidates the history
+  if (hour < hour_ || hour - hour_ >= (uint32_t)HISTORY_HOURS) {
+    for (int i = 0; i < HISTORY_HOURS; i++) {
+      buckets_[i].clear();
+    }
+    hour_ = hour;
+    return;
+  }
+
+  while (hour_ < hour) {
+    hour_++;
+    index_ = (index_ + 1) % HISTORY_HOURS;
+    buckets_[index_].clear();
+  }
+}
+
+void UsageMeter::addBytes(UsageTransport transport, uint32_t up, uint32_t down) {
+  buckets_[index_].bytesUp[transport] += up;
+  buckets_[index_].bytesDown[transport] += down;
+}
+
+void UsageMeter::addFirestoreOps(FirestoreOp op, uint32_t count) {
+  buckets_[index_].firestoreOps[op] += count;
+}
+
+UsageTotals UsageMeter::lastHours(int hours) const {
+  UsageTotals totals;
+  totals.clear();
+
+  if (hours > HISTORY_HOURS) hours = HISTORY_HOURS;
+  for (int i = 0; i < hours; i++) {
+    totals.add(buckets_[(index_ - i + HISTORY_HOURS) % HISTORY_HOURS]);
+  }
+  return totals;
+}
+
+bool UsageMeter::updateMetered(MeteredMode mode, uint32_t dailyBudgetBytes) {
+  if (mode == METERED_OFF) {
+    metered_ = false;
+  } else if (mode == METERED_ON) {
+    metered_ = true;
+  } else {
+    uint32_t used = lastHours(HISTORY_HOURS).cloudBytes();
+    if (!metered_ && used >= dailyBudgetBytes) {
+      metered_ = true;
+    } else if (metered_ && used < dailyBudgetBytes / 10 * 8) {
+      metered_ = false;
+    }
+  }
+  return metered_;
+}
@@ -0,0 +1,77 @@
+// Lumina Bridge Common - Cloud Usage Meter
+//
+// Counts application-layer bytes per transport and billed Firestore
+// operations in hourly buckets, so customers on capped backhaul (cellular
+// home internet behind CGNAT) can see what the bridge costs them, and the
+// bridge can switch itself into a frugal "metered" mode.
+
+#ifndef USAGE_METER_H
+#define USAGE_METER_H
+
+#include <stdint.h>
+
+enum UsageTransport : uint8_t {
+  USAGE_FIRESTORE = 0,  // HTTPS to firestore.googleapis.com
+  USAGE_MQTT,           // TLS MQTT to the cloud broker
+  USAGE_WLED,           // HTTP/UDP to controllers on the LAN (not billed)
+  USAGE_TRANSPORT_COUNT
+};
+
+enum FirestoreOp : uint8_t {
+  FIRESTORE_READ = 0,
+  FIRESTORE_WRITE,
+  FIRESTORE_DELETE,
+  FIRESTORE_OP_COUNT
+};
+
+enum MeteredMode : uint8_t {
+  METERED_OFF = 0,   // Normal settings
+  METERED_ON = 1,    // Always use the frugal settings
+  METERED_AUTO = 2,  // Frugal once the daily cloud byte budget is reached
+};
+
+struct UsageTotals {
+  uint32_t bytesUp[USAGE_TRANSPORT_COUNT];
+  uint32_t bytesDown[USAGE_TRANSPORT_COUNT];
+  uint32_t firestoreOps[FIRESTORE_OP_COUNT];
+
+  // Bytes that cross the customer's backhaul (everything except the LAN)
+  uint32_t cloudBytes() const;
+
+  void add(const UsageTotals& other);
+  void clear();
+};
+
+class UsageMeter {
+ public:
+  static const int HISTORY_HOURS = 24;
+
+  UsageMeter();
+
+  // Advance to `hour` (any monotonic hour counter), rolling buckets over.
+  // Call before recording; hours that passed without traffic stay zero.
+  void setHour(uint32_t hour);
+
+  void addBytes(UsageTransport transport, uint32_t up, uint32_t down);
+  void addFirestoreOps(FirestoreOp op, uint32_t count = 1);
+
+  uint32_t hour() const { return hour_; }
+  const UsageTotals& currentHour() const { return buckets_[index_]; }
+
+  // Sum of the last `hours` buckets, including the current one
+  UsageTotals lastHours(int hours) const;
+
+  // Whether the frugal settings apply. METERED_AUTO turns on once the last
+  // 24 hours used `dailyBudgetBytes` of cloud traffic, and off again below
+  // 80% of it so the mode does not flap at the boundary.
+  bool updateMetered(MeteredMode mode, uint32_t dailyBudgetBytes);
+  bool metered() const { return metered_; }
+
+ private:
+  UsageTotals buckets_[HISTORY_HOURS];
+  uint32_t hour_;
+  int index_;
+  bool metered_;
+};
+
+#endif // USAGE_METER_H
@@ -0,0 +1,140 @@
+/**
+ * Lumina Bridge Common - Payload Dictionary, Version 1
+ *
+ * Generated by tools/make_dict.py from 600 generated payloads (seed 1).
+ * Do not edit: frames name this version, so its bytes are fixed.
+ */
+
+#include "dict_codec.h"
+
+extern const uint8_t WLED_DICT_V1[] = {
+    0x7b, 0x22, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x22, 0x6f, 0x31, 0x22, 0x3a, 0x66, 0x61, 0x6c,
+    0x73, 0x65, 0x2c, 0x22, 0x6f, 0x32, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x6f,
+    0x33, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x73, 0x69, 0x22, 0x3a, 0x30, 0x2c,
+    0x65, 0x64, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x22, 0x3a, 0x31, 0x35,
+    0x30, 0x2c, 0x22, 0x70, 0x77, 0x72, 0x22, 0x3a, 0x31, 0x33, 0x32, 0x2c, 0x22, 0x66, 0x70, 0x73,
+    0x22, 0x3a, 0x33, 0x30, 0x2c, 0x22, 0x6d, 0x61, 0x72, 0x22, 0x3a, 0x35, 0x30, 0x30, 0x30, 0x2c,
+    0x22, 0x6d, 0x61, 0x78, 0x73, 0x65, 0x67, 0x22, 0x3a, 0x33, 0x32, 0x2c, 0x22, 0x73, 0x65, 0x67,
+    0x6c, 0x63, 0x22, 0x3a, 0x5b, 0x31, 0x5d, 0x2c, 0x22, 0x6c, 0x63, 0x22, 0x3a, 0x31, 0x2c, 0x22,
+    0x64, 0x22, 0x3a, 0x32, 0x2c, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x30, 0x2c, 0x22,
+    0x73, 0x74, 0x6f, 0x70, 0x22, 0x3a, 0x31, 0x34, 0x34, 0x2c, 0x22, 0x6c, 0x65, 0x6e, 0x22, 0x3a,
+    0x31, 0x34, 0x34, 0x2c, 0x22, 0x67, 0x72, 0x70, 0x72, 0x72, 0x6f, 0x72, 0x22, 0x3a, 0x22, 0x45,
+    0x52, 0x52, 0x4f, 0x52, 0x3a, 0x20, 0x48, 0x54, 0x54, 0x50, 0x20, 0x2d, 0x31, 0x31, 0x22, 0x2c,
+    0x22, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x67, 0x65, 0x74, 0x53, 0x74, 0x61,
+    0x72, 0x69, 0x22, 0x3a, 0x31, 0x32, 0x38, 0x2c, 0x22, 0x63, 0x63, 0x74, 0x22, 0x3a, 0x31, 0x32,
+    0x37, 0x2c, 0x22, 0x73, 0x65, 0x74, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x63, 0x6f, 0x6c, 0x22, 0x3a,
+    0x5b, 0x5b, 0x37, 0x37, 0x2c, 0x32, 0x33, 0x36, 0x22, 0x2c, 0x22, 0x72, 0x73, 0x73, 0x69, 0x22,
+    0x3a, 0x2d, 0x34, 0x37, 0x2c, 0x22, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x6c, 0x22, 0x3a, 0x36, 0x32,
+    0x2c, 0x22, 0x63, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x22, 0x3a, 0x36, 0x7d, 0x2c, 0x22, 0x66,
+    0x71, 0x74, 0x74, 0x22, 0x2c, 0x22, 0x5f, 0x75, 0x70, 0x74, 0x69, 0x6d, 0x65, 0x22, 0x3a, 0x36,
+    0x38, 0x38, 0x37, 0x36, 0x30, 0x2c, 0x22, 0x5f, 0x63, 0x6f, 0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x73,
+    0x22, 0x3a, 0x32, 0x38, 0x39, 0x39, 0x38, 0x7d, 0x6f, 0x6e, 0x22, 0x2c, 0x22, 0x70, 0x61, 0x79,
+    0x6c, 0x6f, 0x61, 0x64, 0x22, 0x3a, 0x7b, 0x22, 0x62, 0x72, 0x69, 0x22, 0x3a, 0x35, 0x35, 0x2c,
+    0x22, 0x74, 0x72, 0x61, 0x6e, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x30, 0x2c, 0x22,
+    0x65, 0x72, 0x22, 0x3a, 0x22, 0x77, 0x6c, 0x65, 0x64, 0x2f, 0x39, 0x35, 0x62, 0x30, 0x35, 0x31,
+    0x22, 0x2c, 0x22, 0x6f, 0x6b, 0x22, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x61, 0x63, 0x6b,
+    0x4d, 0x73, 0x22, 0x3a, 0x33, 0x31, 0x34, 0x7d, 0x7b, 0x22, 0x69, 0x64, 0x22, 0x3a, 0x32, 0x2c,
+    0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73, 0x74, 0x6f, 0x70, 0x22,
+    0x3a, 0x36, 0x30, 0x2c, 0x22, 0x6c, 0x65, 0x6e, 0x22, 0x3a, 0x36, 0x30, 0x2c, 0x22, 0x67, 0x72,
+    0x31, 0x2c, 0x22, 0x75, 0x70, 0x74, 0x69, 0x6d, 0x65, 0x22, 0x3a, 0x31, 0x39, 0x38, 0x38, 0x37,
+    0x32, 0x36, 0x2c, 0x22, 0x74, 0x69, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x32, 0x30, 0x32, 0x35, 0x2d,
+    0x31, 0x31, 0x2d, 0x31, 0x33, 0x2c, 0x20, 0x31, 0x63, 0x63, 0x74, 0x22, 0x3a, 0x30, 0x7d, 0x2c,
+    0x22, 0x73, 0x74, 0x72, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x6e, 0x61, 0x6d,
+    0x65, 0x22, 0x3a, 0x22, 0x4b, 0x69, 0x74, 0x63, 0x68, 0x65, 0x6e, 0x22, 0x2c, 0x22, 0x75, 0x64,
+    0x30, 0x5d, 0x5d, 0x2c, 0x22, 0x66, 0x78, 0x22, 0x3a, 0x32, 0x38, 0x2c, 0x22, 0x73, 0x78, 0x22,
+    0x3a, 0x32, 0x33, 0x2c, 0x22, 0x69, 0x78, 0x22, 0x3a, 0x33, 0x35, 0x2c, 0x22, 0x70, 0x61, 0x6c,
+    0x22, 0x3a, 0x30, 0x2c, 0x22, 0x63, 0x31, 0x22, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x67, 0x65, 0x74,
+    0x49, 0x6e, 0x66, 0x6f, 0x22, 0x2c, 0x22, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e, 0x22, 0x3a,
+    0x31, 0x37, 0x34, 0x32, 0x34, 0x34, 0x32, 0x36, 0x31, 0x30, 0x39, 0x34, 0x33, 0x2c, 0x22, 0x63,
+    0x2c, 0x22, 0x6c, 0x6f, 0x72, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x6d, 0x61, 0x69, 0x6e, 0x73, 0x65,
+    0x67, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73, 0x65, 0x67, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x69, 0x64,
+    0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73, 0x74, 0x61, 0x69, 0x64, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x63,
+    0x6f, 0x6c, 0x22, 0x3a, 0x5b, 0x5b, 0x32, 0x32, 0x35, 0x2c, 0x31, 0x37, 0x38, 0x2c, 0x32, 0x31,
+    0x38, 0x5d, 0x5d, 0x2c, 0x22, 0x66, 0x78, 0x22, 0x3a, 0x33, 0x38, 0x2c, 0x22, 0x73, 0x78, 0x22,
+    0x6c, 0x69, 0x76, 0x65, 0x73, 0x65, 0x67, 0x22, 0x3a, 0x2d, 0x31, 0x2c, 0x22, 0x6c, 0x6d, 0x22,
+    0x3a, 0x22, 0x22, 0x2c, 0x22, 0x6c, 0x69, 0x70, 0x22, 0x3a, 0x22, 0x22, 0x2c, 0x22, 0x77, 0x73,
+    0x22, 0x3a, 0x31, 0x2c, 0x22, 0x66, 0x78, 0x63, 0x69, 0x64, 0x22, 0x3a, 0x32, 0x32, 0x30, 0x38,
+    0x32, 0x32, 0x32, 0x2c, 0x22, 0x6c, 0x65, 0x64, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x63, 0x6f, 0x75,
+    0x6e, 0x74, 0x22, 0x3a, 0x33, 0x30, 0x30, 0x2c, 0x22, 0x70, 0x77, 0x72, 0x22, 0x3a, 0x32, 0x33,
+    0x22, 0x63, 0x33, 0x22, 0x3a, 0x31, 0x36, 0x2c, 0x22, 0x73, 0x65, 0x6c, 0x22, 0x3a, 0x66, 0x61,
+    0x6c, 0x73, 0x65, 0x2c, 0x22, 0x72, 0x65, 0x76, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c,
+    0x22, 0x6d, 0x69, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x3a, 0x22, 0x46, 0x4f, 0x53, 0x53, 0x22, 0x2c,
+    0x22, 0x6d, 0x61, 0x63, 0x22, 0x3a, 0x22, 0x32, 0x64, 0x66, 0x66, 0x61, 0x66, 0x33, 0x66, 0x61,
+    0x34, 0x33, 0x32, 0x22, 0x2c, 0x22, 0x69, 0x70, 0x22, 0x3a, 0x22, 0x31, 0x39, 0x32, 0x2e, 0x31,
+    0x73, 0x78, 0x22, 0x3a, 0x36, 0x2c, 0x22, 0x69, 0x78, 0x22, 0x3a, 0x31, 0x39, 0x33, 0x2c, 0x22,
+    0x70, 0x61, 0x6c, 0x22, 0x3a, 0x31, 0x31, 0x7d, 0x5d, 0x2c, 0x22, 0x5f, 0x64, 0x65, 0x6c, 0x74,
+    0x61, 0x22, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x7d, 0x32, 0x22, 0x2c, 0x22, 0x6c, 0x77, 0x69, 0x70,
+    0x22, 0x3a, 0x30, 0x2c, 0x22, 0x66, 0x72, 0x65, 0x65, 0x68, 0x65, 0x61, 0x70, 0x22, 0x3a, 0x31,
+    0x35, 0x30, 0x35, 0x37, 0x39, 0x2c, 0x22, 0x75, 0x70, 0x74, 0x69, 0x6d, 0x65, 0x22, 0x3a, 0x32,
+    0x22, 0x66, 0x78, 0x22, 0x3a, 0x39, 0x2c, 0x22, 0x73, 0x78, 0x22, 0x3a, 0x31, 0x33, 0x34, 0x2c,
+    0x22, 0x69, 0x78, 0x22, 0x3a, 0x38, 0x36, 0x2c, 0x22, 0x70, 0x61, 0x6c, 0x22, 0x3a, 0x36, 0x2c,
+    0x22, 0x63, 0x31, 0x22, 0x3a, 0x31, 0x32, 0x38, 0x34, 0x39, 0x2c, 0x22, 0x73, 0x69, 0x67, 0x6e,
+    0x61, 0x6c, 0x22, 0x3a, 0x38, 0x34, 0x2c, 0x22, 0x63, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x22,
+    0x3a, 0x31, 0x31, 0x7d, 0x2c, 0x22, 0x66, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x75, 0x22, 0x3a, 0x32,
+    0x7b, 0x22, 0x76, 0x65, 0x72, 0x22, 0x3a, 0x22, 0x30, 0x2e, 0x31, 0x33, 0x2e, 0x33, 0x22, 0x2c,
+    0x22, 0x76, 0x69, 0x64, 0x22, 0x3a, 0x32, 0x34, 0x30, 0x35, 0x31, 0x38, 0x30, 0x2c, 0x22, 0x6c,
+    0x65, 0x64, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x63, 0x31, 0x2c, 0x22, 0x72, 0x67, 0x62, 0x77, 0x22,
+    0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x77, 0x76, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x63,
+    0x63, 0x74, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x22, 0x73, 0x74, 0x72, 0x22, 0x3a, 0x66, 0x61, 0x6c,
+    0x31, 0x35, 0x37, 0x5d, 0x2c, 0x5b, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x5d, 0x2c, 0x5b, 0x30, 0x2c,
+    0x30, 0x2c, 0x30, 0x5d, 0x5d, 0x2c, 0x22, 0x66, 0x78, 0x22, 0x3a, 0x36, 0x35, 0x2c, 0x22, 0x73,
+    0x78, 0x22, 0x3a, 0x32, 0x30, 0x34, 0x2c, 0x22, 0x5d, 0x2c, 0x22, 0x66, 0x78, 0x22, 0x3a, 0x32,
+    0x2c, 0x22, 0x73, 0x78, 0x22, 0x3a, 0x31, 0x39, 0x37, 0x2c, 0x22, 0x69, 0x78, 0x22, 0x3a, 0x32,
+    0x30, 0x2c, 0x22, 0x70, 0x61, 0x6c, 0x22, 0x3a, 0x30, 0x7d, 0x5d, 0x7d, 0x2c, 0x22, 0x76, 0x65,
+    0x22, 0x2c, 0x22, 0x75, 0x64, 0x70, 0x70, 0x6f, 0x72, 0x74, 0x22, 0x3a, 0x32, 0x31, 0x33, 0x32,
+    0x34, 0x2c, 0x22, 0x6c, 0x69, 0x76, 0x65, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22,
+    0x6c, 0x69, 0x76, 0x65, 0x73, 0x65, 0x67, 0x22, 0x22, 0x3a, 0x33, 0x38, 0x2c, 0x22, 0x74, 0x22,
+    0x3a, 0x39, 0x38, 0x33, 0x2c, 0x22, 0x70, 0x6d, 0x74, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x22, 0x6e,
+    0x64, 0x63, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x61, 0x72, 0x63, 0x68, 0x22, 0x3a, 0x22, 0x65, 0x73,
+    0x75, 0x6e, 0x74, 0x22, 0x3a, 0x37, 0x31, 0x2c, 0x22, 0x63, 0x70, 0x61, 0x6c, 0x63, 0x6f, 0x75,
+    0x6e, 0x74, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x77, 0x69, 0x66, 0x69, 0x22, 0x3a, 0x7b, 0x22, 0x62,
+    0x73, 0x73, 0x69, 0x64, 0x22, 0x3a, 0x22, 0x42, 0x3a, 0x22, 0x22, 0x2c, 0x22, 0x6c, 0x69, 0x70,
+    0x22, 0x3a, 0x22, 0x22, 0x2c, 0x22, 0x77, 0x73, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x66, 0x78, 0x63,
+    0x6f, 0x75, 0x6e, 0x74, 0x22, 0x3a, 0x31, 0x38, 0x37, 0x2c, 0x22, 0x70, 0x61, 0x6c, 0x63, 0x6f,
+    0x65, 0x73, 0x70, 0x33, 0x32, 0x22, 0x2c, 0x22, 0x63, 0x6f, 0x72, 0x65, 0x22, 0x3a, 0x22, 0x76,
+    0x33, 0x2e, 0x33, 0x2e, 0x36, 0x2d, 0x31, 0x36, 0x2d, 0x67, 0x63, 0x63, 0x35, 0x34, 0x34, 0x30,
+    0x66, 0x36, 0x61, 0x32, 0x22, 0x2c, 0x22, 0x6c, 0x22, 0x2c, 0x22, 0x6f, 0x70, 0x74, 0x22, 0x3a,
+    0x37, 0x39, 0x2c, 0x22, 0x62, 0x72, 0x61, 0x6e, 0x64, 0x22, 0x3a, 0x22, 0x57, 0x4c, 0x45, 0x44,
+    0x22, 0x2c, 0x22, 0x70, 0x72, 0x6f, 0x64, 0x75, 0x63, 0x74, 0x22, 0x3a, 0x22, 0x46, 0x4f, 0x53,
+    0x2c, 0x22, 0x6d, 0x61, 0x78, 0x70, 0x77, 0x72, 0x22, 0x3a, 0x35, 0x30, 0x30, 0x30, 0x2c, 0x22,
+    0x6d, 0x61, 0x78, 0x73, 0x65, 0x67, 0x22, 0x3a, 0x33, 0x32, 0x2c, 0x22, 0x73, 0x65, 0x67, 0x6c,
+    0x63, 0x22, 0x3a, 0x5b, 0x31, 0x5d, 0x2c, 0x22, 0x32, 0x22, 0x3a, 0x30, 0x7d, 0x5d, 0x2c, 0x22,
+    0x5f, 0x62, 0x72, 0x69, 0x64, 0x67, 0x65, 0x22, 0x3a, 0x22, 0x65, 0x73, 0x70, 0x33, 0x32, 0x2d,
+    0x6d, 0x71, 0x74, 0x74, 0x22, 0x2c, 0x22, 0x5f, 0x75, 0x70, 0x74, 0x69, 0x6d, 0x65, 0x22, 0x3a,
+    0x7b, 0x22, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x61, 0x70, 0x70, 0x6c, 0x79,
+    0x4a, 0x73, 0x6f, 0x6e, 0x22, 0x2c, 0x22, 0x63, 0x6f, 0x6e, 0x74, 0x72, 0x6f, 0x6c, 0x6c, 0x65,
+    0x72, 0x22, 0x3a, 0x22, 0x77, 0x6c, 0x65, 0x64, 0x73, 0x65, 0x2c, 0x22, 0x6f, 0x31, 0x22, 0x3a,
+    0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x6f, 0x32, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65,
+    0x2c, 0x22, 0x6f, 0x33, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x73, 0x69, 0x22,
+    0x2c, 0x22, 0x74, 0x72, 0x61, 0x6e, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x37, 0x2c,
+    0x22, 0x70, 0x73, 0x22, 0x3a, 0x2d, 0x31, 0x2c, 0x22, 0x70, 0x6c, 0x22, 0x3a, 0x2d, 0x31, 0x2c,
+    0x22, 0x6e, 0x6c, 0x22, 0x3a, 0x7b, 0x22, 0x6f, 0x30, 0x2c, 0x22, 0x6c, 0x65, 0x6e, 0x22, 0x3a,
+    0x31, 0x35, 0x30, 0x2c, 0x22, 0x67, 0x72, 0x70, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x73, 0x70, 0x63,
+    0x22, 0x3a, 0x30, 0x2c, 0x22, 0x6f, 0x66, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x6f, 0x6e, 0x22, 0x3a,
+    0x72, 0x65, 0x6d, 0x22, 0x3a, 0x2d, 0x31, 0x7d, 0x2c, 0x22, 0x75, 0x64, 0x70, 0x6e, 0x22, 0x3a,
+    0x7b, 0x22, 0x73, 0x65, 0x6e, 0x64, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x72,
+    0x65, 0x63, 0x76, 0x22, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x66, 0x72, 0x7a, 0x22, 0x3a,
+    0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x62, 0x72, 0x69, 0x22, 0x3a, 0x32, 0x35, 0x35, 0x2c,
+    0x22, 0x63, 0x63, 0x74, 0x22, 0x3a, 0x31, 0x32, 0x37, 0x2c, 0x22, 0x73, 0x65, 0x74, 0x22, 0x3a,
+    0x3a, 0x30, 0x2c, 0x22, 0x6d, 0x31, 0x32, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x7b, 0x22, 0x69, 0x64,
+    0x22, 0x3a, 0x31, 0x2c, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73,
+    0x74, 0x6f, 0x70, 0x22, 0x3a, 0x33, 0x30, 0x30, 0x32, 0x38, 0x2c, 0x22, 0x63, 0x32, 0x22, 0x3a,
+    0x31, 0x32, 0x38, 0x2c, 0x22, 0x63, 0x33, 0x22, 0x3a, 0x31, 0x36, 0x2c, 0x22, 0x73, 0x65, 0x6c,
+    0x22, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x72, 0x65, 0x76, 0x22, 0x3a, 0x66, 0x61, 0x6c,
+    0x6c, 0x73, 0x65, 0x2c, 0x22, 0x64, 0x75, 0x72, 0x22, 0x3a, 0x36, 0x30, 0x2c, 0x22, 0x6d, 0x6f,
+    0x64, 0x65, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x74, 0x62, 0x72, 0x69, 0x22, 0x3a, 0x30, 0x2c, 0x22,
+    0x72, 0x65, 0x6d, 0x22, 0x3a, 0x2d, 0x31, 0x7d, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x73, 0x67, 0x72,
+    0x70, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x72, 0x67, 0x72, 0x70, 0x22, 0x3a, 0x31, 0x7d, 0x2c, 0x22,
+    0x6c, 0x6f, 0x72, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x6d, 0x61, 0x69, 0x6e, 0x73, 0x65, 0x67, 0x22,
+    0x22, 0x6f, 0x6e, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x22, 0x74, 0x72, 0x61, 0x6e,
+    0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x22, 0x76, 0x65, 0x72, 0x73,
+    0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x31, 0x37, 0x33, 0x5b, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x5d, 0x5d,
+    0x2c, 0x22, 0x66, 0x78, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73, 0x78, 0x22, 0x3a, 0x31, 0x32, 0x38,
+    0x2c, 0x22, 0x69, 0x78, 0x22, 0x3a, 0x31, 0x32, 0x38, 0x2c, 0x22, 0x70, 0x61, 0x6c, 0x22, 0x3a,
+    0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x62, 0x72, 0x69, 0x22, 0x3a, 0x31, 0x30, 0x2c, 0x22,
+    0x73, 0x65, 0x67, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x69, 0x64, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x63,
+    0x6f, 0x6c, 0x22, 0x3a, 0x5b, 0x5b, 0x31, 0x39, 0x22, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x22,
+    0x3a, 0x22, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x22, 0x2c, 0x22, 0x70, 0x61, 0x79,
+    0x6c, 0x6f, 0x61, 0x64, 0x22, 0x3a, 0x7b, 0x22, 0x6f, 0x6e, 0x22, 0x3a, 0x74, 0x72, 0x75, 0x65,
+};
+extern const size_t WLED_DICT_V1_LEN = sizeof(WLED_DICT_V1);
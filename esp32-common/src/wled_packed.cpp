@@ -0,0 +1,531 @@
+/**
+ * Lumina Bridge Common - Packed WLED State
+ *
+ * The parser reads the JSON text once, front to back: known keys go
+ * straight into their packed fields and everything else is skipped.
+ * Numbers are clamped to their field's range, as WLED clamps them, and
+ * fractions are dropped. A segment object is scanned once for its "id"
+ * before its fields are applied, since "id" need not come first.
+ */
+
+#include "wled_packed.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Keys longer than this are truncated and so never match a known one
+static const size_t KEY_LEN = 16;
+
+// WLED's colour for a new segment (orange)
+static const uint32_t DEFAULT_COLOR = 0x00FFA000;
+
+struct PackedReader {
+  const char* p;
+  const char* end;
+
+  void space() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+  }
+  bool peek(char c) {
+    space();
+    return p < end && *p == c;
+  }
+  bool take(char c) {
+    if (!peek(c)) return false;
+    p++;
+    return true;
+  }
+};
+
+// Reads a string into `out`, truncated to `size`. Escaped characters are
+// kept without their backslash, which is enough for keys and hex colours.
+static bool readString(PackedReader& r, char* out, size_t size) {
+  if (!r.take('"')) return false;
+  size_t n = 0;
+  while (r.p < r.end && *r.p != '"') {
+    if (*r.p == '\\' && ++r.p >= r.end) return false;
+    if (n + 1 < size) out[n++] = *r.p;
+    r.p++;
+  }
+  if (r.p >= r.end) return false;
+  r.p++;
+  if (size > 0) out[n] = '\0';
+  return true;
+}
+
+static bool literal(PackedReader& r, const char* word) {
+  r.space();
+  size_t length = strlen(word);
+  if ((size_t)(r.end - r.p) < length || strncmp(r.p, word, length) != 0) return false;
+  r.p += length;
+  return true;
+}
+
+static bool skipValue(PackedReader& r, int depth = 0) {
+  r.space();
+  if (r.p >= r.end || depth > 16) return false;
+  char open = *r.p;
+  if (open == '"') return readString(r, nullptr, 0);
+  if (open == '{' || open == '[') {
+    char close = open == '{' ? '}' : ']';
+    r.p++;
+    if (r.take(close)) return true;
+    do {
+      if (open == '{' && (!readString(r, nullptr, 0) || !r.take(':'))) return false;
+      if (!skipValue(r, depth + 1)) return false;
+    } while (r.take(','));
+    return r.take(close);
+  }
+  // Number, true, false or null
+  const char* start = r.p;
+  while (r.p < r.end && *r.p != ',' && *r.p != '}' && *r.p != ']' && *r.p != ' ' &&
+         *r.p != '\n' && *r.p != '\r' && *r.p != '\t') {
+    r.p++;
+  }
+  return r.p > start;
+}
+
+static bool readNumber(PackedReader& r, long& value) {
+  r.space();
+  bool negative = r.p < r.end && *r.p == '-';
+  if (negative) r.p++;
+  long magnitude = 0;
+  bool digits = false;
+  while (r.p < r.end && *r.p >= '0' && *r.p <= '9') {
+    if (magnitude < 10000000) magnitude = magnitude * 10 + (*r.p - '0');
+    digits = true;
+    r.p++;
+  }
+  while (r.p < r.end && (*r.p == '.' || *r.p == 'e' || *r.p == 'E' || *r.p == '+' ||
+                         *r.p == '-' || (*r.p >= '0' && *r.p <= '9'))) {
+    r.p++;
+  }
+  value = negative ? -magnitude : magnitude;
+  return digits;
+}
+
+template <typename T>
+static bool readInt(PackedReader& r, T& field, long min, long max) {
+  long value;
+  if (!readNumber(r, value)) return false;
+  field = (T)(value < min ? min : value > max ? max : value);
+  return true;
+}
+
+// true, false, or "t" to toggle
+static bool readFlag(PackedReader& r, uint8_t& flags, uint8_t bit) {
+  if (literal(r, "true")) {
+    flags |= bit;
+  } else if (literal(r, "false")) {
+    flags &= ~bit;
+  } else if (literal(r, "\"t\"")) {
+    flags ^= bit;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename Member>
+static bool readObject(PackedReader& r, Member member) {
+  if (!r.take('{')) return false;
+  if (r.take('}')) return true;
+  char key[KEY_LEN];
+  do {
+    if (!readString(r, key, sizeof(key)) || !r.take(':') || !member(key)) return false;
+  } while (r.take(','));
+  return r.take('}');
+}
+
+template <typename Element>
+static bool readArray(PackedReader& r, Element element) {
+  if (!r.take('[')) return false;
+  if (r.take(']')) return true;
+  size_t index = 0;
+  do {
+    if (!element(index++)) return false;
+  } while (r.take(','));
+  return r.take(']');
+}
+
+// [r, g, b], [r, g, b, w], "RRGGBB" or "WWRRGGBB"; [] keeps the colour
+static bool readColor(PackedReader& r, uint32_t& color, uint8_t& flags) {
+  if (r.peek('"')) {
+    char hex[12];
+    if (!readString(r, hex, sizeof(hex))) return false;
+    size_t length = strlen(hex);
+    char* end;
+    unsigned long value = strtoul(hex, &end, 16);
+    if ((length != 6 && length != 8) || *end != '\0') return false;
+    color = (uint32_t)value;
+    if (length == 8) flags |= WLED_SEG_RGBW;
+    return true;
+  }
+
+  uint8_t channels[4] = {0, 0, 0, 0};
+  size_t count = 0;
+  bool ok = readArray(r, [&](size_t i) -> bool {
+    uint8_t channel;
+    if (!readInt(r, channel, 0, 255)) return false;
+    if (i < 4) channels[i] = channel;
+    count = i + 1;
+    return true;
+  });
+  if (!ok) return false;
+  if (count == 0) return true;
+  if (count >= 4) flags |= WLED_SEG_RGBW;
+  color = (uint32_t)channels[3] << 24 | (uint32_t)channels[0] << 16 |
+          (uint32_t)channels[1] << 8 | channels[2];
+  return true;
+}
+
+// The "id" of the segment object at the cursor, without consuming it; -1
+// if it has none
+static long segmentId(PackedReader r) {
+  long id = -1;
+  readObject(r, [&](const char* key) -> bool {
+    if (strcmp(key, "id") == 0) return readNumber(r, id);
+    return skipValue(r);
+  });
+  return id;
+}
+
+// The segment with `id`, inserted in id order with WLED's defaults if new;
+// nullptr if the id is out of range or the state is full
+static WledSegment* segmentSlot(WledState& state, long id) {
+  if (id < 0 || id > 255) return nullptr;
+  uint8_t i = 0;
+  while (i < state.segCount && state.seg[i].id < id) i++;
+  if (i < state.segCount && state.seg[i].id == id) return &state.seg[i];
+  if (state.segCount >= WLED_PACKED_MAX_SEGMENTS) return nullptr;
+
+  memmove(&state.seg[i + 1], &state.seg[i], (state.segCount - i) * sizeof(WledSegment));
+  state.segCount++;
+  WledSegment& seg = state.seg[i];
+  memset(&seg, 0, sizeof(seg));
+  seg.id = (uint8_t)id;
+  seg.col[0] = DEFAULT_COLOR;
+  seg.grp = 1;
+  seg.bri = 255;
+  seg.cct = 127;
+  seg.sx = 128;
+  seg.ix = 128;
+  seg.c1 = 128;
+  seg.c2 = 128;
+  seg.c3 = 16;
+  seg.flags = WLED_SEG_ON;
+  return &seg;
+}
+
+static void removeSegment(WledState& state, WledSegment* seg) {
+  size_t i = seg - state.seg;
+  memmove(&state.seg[i], &state.seg[i + 1], (state.segCount - i - 1) * sizeof(WledSegment));
+  state.segCount--;
+  memset(&state.seg[state.segCount], 0, sizeof(WledSegment));
+}
+
+static bool readSegment(PackedReader& r, WledState& state, long defaultId) {
+  long id = segmentId(r);
+  WledSegment* seg = segmentSlot(state, id >= 0 ? id : defaultId);
+  if (seg == nullptr) return false;
+
+  long length = -1;
+  bool ok = readObject(r, [&](const char* key) -> bool {
+    if (strcmp(key, "start") == 0) return readInt(r, seg->start, 0, 65535);
+    if (strcmp(key, "stop") == 0) return readInt(r, seg->stop, 0, 65535);
+    if (strcmp(key, "len") == 0) return readInt(r, length, 0, 65535);
+    if (strcmp(key, "of") == 0) return readInt(r, seg->of, 0, 65535);
+    if (strcmp(key, "grp") == 0) return readInt(r, seg->grp, 0, 255);
+    if (strcmp(key, "spc") == 0) return readInt(r, seg->spc, 0, 255);
+    if (strcmp(key, "bri") == 0) return readInt(r, seg->bri, 0, 255);
+    if (strcmp(key, "cct") == 0) return readInt(r, seg->cct, 0, 255);
+    if (strcmp(key, "fx") == 0) return readInt(r, seg->fx, 0, 255);
+    if (strcmp(key, "sx") == 0) return readInt(r, seg->sx, 0, 255);
+    if (strcmp(key, "ix") == 0) return readInt(r, seg->ix, 0, 255);
+    if (strcmp(key, "pal") == 0) return readInt(r, seg->pal, 0, 255);
+    if (strcmp(key, "c1") == 0) return readInt(r, seg->c1, 0, 255);
+    if (strcmp(key, "c2") == 0) return readInt(r, seg->c2, 0, 255);
+    if (strcmp(key, "c3") == 0) return readInt(r, seg->c3, 0, 31);
+    if (strcmp(key, "on") == 0) return readFlag(r, seg->flags, WLED_SEG_ON);
+    if (strcmp(key, "frz") == 0) return readFlag(r, seg->flags, WLED_SEG_FRZ);
+    if (strcmp(key, "sel") == 0) return readFlag(r, seg->flags, WLED_SEG_SEL);
+    if (strcmp(key, "rev") == 0) return readFlag(r, seg->flags, WLED_SEG_REV);
+    if (strcmp(key, "mi") == 0) return readFlag(r, seg->flags, WLED_SEG_MI);
+    if (strcmp(key, "col") == 0) {
+      return readArray(r, [&](size_t i) -> bool {
+        uint32_t extra;
+        return readColor(r, i < 3 ? seg->col[i] : extra, seg->flags);
+      });
+    }
+    return skipValue(r);
+  });
+  if (!ok) return false;
+
+  if (length >= 0) seg->stop = seg->start + length > 65535 ? 65535 : seg->start + length;
+  // "stop": 0 deletes a segment; a new one without bounds is ignored
+  if (seg->stop <= seg->start) removeSegment(state, seg);
+  return true;
+}
+
+void wledPackedClear(WledState& state) {
+  memset(&state, 0, sizeof(state));
+  state.ps = -1;
+  state.pl = -1;
+}
+
+bool wledPackedParse(const char* json, size_t length, WledState& state) {
+  PackedReader r = {json, json + length};
+  return readObject(r, [&](const char* key) -> bool {
+    if (strcmp(key, "on") == 0) return readFlag(r, state.flags, WLED_STATE_ON);
+    if (strcmp(key, "bri") == 0) return readInt(r, state.bri, 0, 255);
+    if (strcmp(key, "transition") == 0) return readInt(r, state.transition, 0, 65535);
+    if (strcmp(key, "ps") == 0) return readInt(r, state.ps, -1, 32767);
+    if (strcmp(key, "pl") == 0) return readInt(r, state.pl, -1, 32767);
+    if (strcmp(key, "lor") == 0) return readInt(r, state.lor, 0, 2);
+    if (strcmp(key, "mainseg") == 0) return readInt(r, state.mainseg, 0, 255);
+    if (strcmp(key, "nl") == 0) {
+      return readObject(r, [&](const char* nlKey) -> bool {
+        if (strcmp(nlKey, "on") == 0) return readFlag(r, state.flags, WLED_STATE_NL_ON);
+        if (strcmp(nlKey, "dur") == 0) return readInt(r, state.nlDur, 0, 255);
+        if (strcmp(nlKey, "mode") == 0) return readInt(r, state.nlMode, 0, 3);
+        if (strcmp(nlKey, "tbri") == 0) return readInt(r, state.nlTbri, 0, 255);
+        return skipValue(r);
+      });
+    }
+    if (strcmp(key, "udpn") == 0) {
+      return readObject(r, [&](const char* udpnKey) -> bool {
+        if (strcmp(udpnKey, "send") == 0) return readFlag(r, state.flags, WLED_STATE_UDPN_SEND);
+        if (strcmp(udpnKey, "recv") == 0) return readFlag(r, state.flags, WLED_STATE_UDPN_RECV);
+        return skipValue(r);
+      });
+    }
+    if (strcmp(key, "seg") == 0) {
+      if (!r.peek('[')) return readSegment(r, state, state.mainseg);
+      return readArray(r, [&](size_t i) -> bool { return readSegment(r, state, (long)i); });
+    }
+    return skipValue(r);
+  });
+}
+
+// ============================================================================
+// Emit
+// ============================================================================
+
+struct PackedWriter {
+  char* out;
+  size_t size;
+  size_t length;
+  bool ok;
+  bool comma;  // The next member needs a separator
+};
+
+// Appends text, NUL-terminated; on overflow the writer stops
+static void text(PackedWriter& w, const char* s, size_t length) {
+  if (!w.ok || w.length + length >= w.size) {
+    w.ok = false;
+    return;
+  }
+  memcpy(w.out + w.length, s, length);
+  w.length += length;
+  w.out[w.length] = '\0';
+}
+
+static void text(PackedWriter& w, const char* s) {
+  text(w, s, strlen(s));
+}
+
+static void integer(PackedWriter& w, long value) {
+  char digits[12];
+  size_t n = sizeof(digits);
+  unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+  do {
+    digits[--n] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) digits[--n] = '-';
+  text(w, digits + n, sizeof(digits) - n);
+}
+
+static void key(PackedWriter& w, const char* name) {
+  if (w.comma) text(w, ",", 1);
+  text(w, "\"", 1);
+  text(w, name);
+  text(w, "\":", 2);
+  w.comma = true;
+}
+
+static void number(PackedWriter& w, const char* name, long value) {
+  key(w, name);
+  integer(w, value);
+}
+
+static void boolean(PackedWriter& w, const char* name, bool value) {
+  key(w, name);
+  text(w, value ? "true" : "false");
+}
+
+// Opens an object or array, as a member `name` or, with nullptr, as the
+// next array element
+static void begin(PackedWriter& w, const char* name, char bracket) {
+  if (name != nullptr) {
+    key(w, name);
+  } else if (w.comma) {
+    text(w, ",", 1);
+  }
+  text(w, &bracket, 1);
+  w.comma = false;
+}
+
+static void end(PackedWriter& w, char bracket) {
+  text(w, &bracket, 1);
+  w.comma = true;
+}
+
+static void emitSegment(PackedWriter& w, const WledSegment& seg) {
+  begin(w, nullptr, '{');
+  number(w, "id", seg.id);
+  number(w, "start", seg.start);
+  number(w, "stop", seg.stop);
+  number(w, "len", seg.stop - seg.start);
+  number(w, "grp", seg.grp);
+  number(w, "spc", seg.spc);
+  number(w, "of", seg.of);
+  boolean(w, "on", seg.flags & WLED_SEG_ON);
+  boolean(w, "frz", seg.flags & WLED_SEG_FRZ);
+  number(w, "bri", seg.bri);
+  number(w, "cct", seg.cct);
+  begin(w, "col", '[');
+  for (int i = 0; i < 3; i++) {
+    uint32_t c = seg.col[i];
+    begin(w, nullptr, '[');
+    integer(w, c >> 16 & 0xFF);
+    text(w, ",", 1);
+    integer(w, c >> 8 & 0xFF);
+    text(w, ",", 1);
+    integer(w, c & 0xFF);
+    if (seg.flags & WLED_SEG_RGBW) {
+      text(w, ",", 1);
+      integer(w, c >> 24);
+    }
+    end(w, ']');
+  }
+  end(w, ']');
+  number(w, "fx", seg.fx);
+  number(w, "sx", seg.sx);
+  number(w, "ix", seg.ix);
+  number(w, "pal", seg.pal);
+  number(w, "c1", seg.c1);
+  number(w, "c2", seg.c2);
+  number(w, "c3", seg.c3);
+  boolean(w, "sel", seg.flags & WLED_SEG_SEL);
+  boolean(w, "rev", seg.flags & WLED_SEG_REV);
+  boolean(w, "mi", seg.flags & WLED_SEG_MI);
+  end(w, '}');
+}
+
+size_t wledPackedEmit(const WledState& state, char* out, size_t size, uint32_t mask) {
+  PackedWriter w = {out, size, 0, true, false};
+  begin(w, nullptr, '{');
+  if (mask & WLED_CHANGED_ON) boolean(w, "on", state.flags & WLED_STATE_ON);
+  if (mask & WLED_CHANGED_BRI) number(w, "bri", state.bri);
+  if (mask & WLED_CHANGED_TRANSITION) number(w, "transition", state.transition);
+  if (mask & WLED_CHANGED_PRESET) {
+    number(w, "ps", state.ps);
+    number(w, "pl", state.pl);
+  }
+  if (mask & WLED_CHANGED_NIGHTLIGHT) {
+    begin(w, "nl", '{');
+    boolean(w, "on", state.flags & WLED_STATE_NL_ON);
+    number(w, "dur", state.nlDur);
+    number(w, "mode", state.nlMode);
+    number(w, "tbri", state.nlTbri);
+    end(w, '}');
+  }
+  if (mask & WLED_CHANGED_SYNC) {
+    begin(w, "udpn", '{');
+    boolean(w, "send", state.flags & WLED_STATE_UDPN_SEND);
+    boolean(w, "recv", state.flags & WLED_STATE_UDPN_RECV);
+    end(w, '}');
+  }
+  if (mask & WLED_CHANGED_MAINSEG) {
+    number(w, "lor", state.lor);
+    number(w, "mainseg", state.mainseg);
+  }
+
+  bool segments = false;
+  for (uint8_t i = 0; i < state.segCount; i++) {
+    if (!(mask & (WLED_CHANGED_SEG0 << i))) continue;
+    if (!segments) begin(w, "seg", '[');
+    segments = true;
+    emitSegment(w, state.seg[i]);
+  }
+  if (segments) end(w, ']');
+  end(w, '}');
+  return w.ok ? w.length : 0;
+}
+
+// ============================================================================
+// Compare and Hash
+// ============================================================================
+
+uint16_t wledSegmentCompare(const WledSegment& a, const WledSegment& b) {
+  static const uint8_t FLAG_BITS = WLED_SEG_ON | WLED_SEG_FRZ | WLED_SEG_SEL | WLED_SEG_REV |
+                                   WLED_SEG_MI;
+  uint16_t changed = 0;
+  if (a.id != b.id || a.start != b.start || a.stop != b.stop || a.of != b.of ||
+      a.grp != b.grp || a.spc != b.spc) {
+    changed |= WLED_SEG_CHANGED_BOUNDS;
+  }
+  if ((a.flags ^ b.flags) & FLAG_BITS) changed |= WLED_SEG_CHANGED_FLAGS;
+  if (a.bri != b.bri || a.cct != b.cct) changed |= WLED_SEG_CHANGED_BRI;
+  if (memcmp(a.col, b.col, sizeof(a.col)) != 0 || ((a.flags ^ b.flags) & WLED_SEG_RGBW)) {
+    changed |= WLED_SEG_CHANGED_COLOR;
+  }
+  if (a.fx != b.fx) changed |= WLED_SEG_CHANGED_FX;
+  if (a.sx != b.sx) changed |= WLED_SEG_CHANGED_SPEED;
+  if (a.ix != b.ix) changed |= WLED_SEG_CHANGED_INTENS;
+  if (a.pal != b.pal) changed |= WLED_SEG_CHANGED_PALETTE;
+  if (a.c1 != b.c1 || a.c2 != b.c2 || a.c3 != b.c3) changed |= WLED_SEG_CHANGED_OPTIONS;
+  return changed;
+}
+
+uint32_t wledPackedCompare(const WledState& a, const WledState& b) {
+  static const uint8_t NL_BITS = WLED_STATE_NL_ON;
+  static const uint8_t SYNC_BITS = WLED_STATE_UDPN_SEND | WLED_STATE_UDPN_RECV;
+  uint8_t flags = a.flags ^ b.flags;
+  uint32_t changed = 0;
+
+  if (flags & WLED_STATE_ON) changed |= WLED_CHANGED_ON;
+  if (a.bri != b.bri) changed |= WLED_CHANGED_BRI;
+  if (a.transition != b.transition) changed |= WLED_CHANGED_TRANSITION;
+  if (a.ps != b.ps || a.pl != b.pl) changed |= WLED_CHANGED_PRESET;
+  if ((flags & NL_BITS) || a.nlDur != b.nlDur || a.nlMode != b.nlMode ||
+      a.nlTbri != b.nlTbri) {
+    changed |= WLED_CHANGED_NIGHTLIGHT;
+  }
+  if (flags & SYNC_BITS) changed |= WLED_CHANGED_SYNC;
+  if (a.mainseg != b.mainseg || a.lor != b.lor) changed |= WLED_CHANGED_MAINSEG;
+  if (a.segCount != b.segCount) changed |= WLED_CHANGED_SEGMENTS;
+
+  uint8_t count = a.segCount > b.segCount ? a.segCount : b.segCount;
+  for (uint8_t i = 0; i < count; i++) {
+    if (i >= a.segCount || i >= b.segCount || wledSegmentCompare(a.seg[i], b.seg[i]) != 0) {
+      changed |= WLED_CHANGED_SEG0 << i;
+    }
+  }
+  return changed;
+}
+
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint32_t wledPackedHash(const WledState& state) {
+  uint32_t hash = fnv1a(2166136261u, &state, offsetof(WledState, seg));
+  return fnv1a(hash, state.seg, state.segCount * sizeof(WledSegment));
+}
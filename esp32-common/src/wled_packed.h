@@ -0,0 +1,146 @@
+// Lumina Bridge Common - Packed WLED State
+//
+// A WLED state in a fixed 16 + 32 * WLED_PACKED_MAX_SEGMENTS bytes (272 by
+// default), for bridges that keep a state per controller. A JsonDocument
+// of the same state takes a few KB, and comparing two means walking both.
+//
+// Kept: the global fields, nightlight, sync, and per segment its bounds,
+// flags, brightness, colours (0xWWRRGGBB, as WLED stores them), effect,
+// speed, intensity, palette and effect options. Dropped: segment names,
+// live/realtime fields and anything newer WLED versions add. Use the DOM
+// where those matter.
+//
+// wledPackedParse() reads WLED JSON text directly, without a DOM, and
+// applies it on top of what the state already holds, as WLED applies a
+// request. Parsing a command onto a copy of a controller's state
+// therefore predicts the state it will answer with, except for requests
+// that load a preset or playlist ("ps", "pl"), which change more than
+// they say.
+//
+// No JSON library, so the same code runs on the host.
+
+#ifndef WLED_PACKED_H
+#define WLED_PACKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef WLED_PACKED_MAX_SEGMENTS
+#define WLED_PACKED_MAX_SEGMENTS 8
+#endif
+
+enum WledStateFlag : uint8_t {
+  WLED_STATE_ON        = 1 << 0,
+  WLED_STATE_NL_ON     = 1 << 1,
+  WLED_STATE_UDPN_SEND = 1 << 2,
+  WLED_STATE_UDPN_RECV = 1 << 3,
+};
+
+enum WledSegmentFlag : uint8_t {
+  WLED_SEG_ON   = 1 << 0,
+  WLED_SEG_FRZ  = 1 << 1,
+  WLED_SEG_SEL  = 1 << 2,
+  WLED_SEG_REV  = 1 << 3,
+  WLED_SEG_MI   = 1 << 4,
+  WLED_SEG_RGBW = 1 << 5,  // Colours carry white; emitted as [r,g,b,w]
+};
+
+struct WledSegment {
+  uint32_t col[3];  // Primary, secondary, tertiary: 0xWWRRGGBB
+  uint16_t start;
+  uint16_t stop;
+  uint16_t of;
+  uint8_t id;
+  uint8_t grp;
+  uint8_t spc;
+  uint8_t bri;
+  uint8_t cct;
+  uint8_t fx;
+  uint8_t sx;
+  uint8_t ix;
+  uint8_t pal;
+  uint8_t c1;
+  uint8_t c2;
+  uint8_t c3;
+  uint8_t flags;  // WledSegmentFlag
+  uint8_t reserved;
+};
+
+// No padding, so wledPackedHash() can hash the bytes
+struct WledState {
+  uint16_t transition;
+  int16_t ps;
+  int16_t pl;
+  uint8_t bri;
+  uint8_t flags;  // WledStateFlag
+  uint8_t nlDur;
+  uint8_t nlMode;
+  uint8_t nlTbri;
+  uint8_t lor;
+  uint8_t mainseg;
+  uint8_t segCount;
+  uint16_t reserved;
+  WledSegment seg[WLED_PACKED_MAX_SEGMENTS];  // Sorted by id
+};
+
+static_assert(sizeof(WledSegment) == 32, "WledSegment has padding");
+static_assert(sizeof(WledState) == 16 + 32 * WLED_PACKED_MAX_SEGMENTS, "WledState has padding");
+static_assert(WLED_PACKED_MAX_SEGMENTS <= 16, "Change masks have 16 segment bits");
+
+// Change mask bits from wledPackedCompare(); also selects what
+// wledPackedEmit() writes
+enum WledChange : uint32_t {
+  WLED_CHANGED_ON         = 1UL << 0,
+  WLED_CHANGED_BRI        = 1UL << 1,
+  WLED_CHANGED_TRANSITION = 1UL << 2,
+  WLED_CHANGED_PRESET     = 1UL << 3,  // "ps", "pl"
+  WLED_CHANGED_NIGHTLIGHT = 1UL << 4,
+  WLED_CHANGED_SYNC       = 1UL << 5,  // "udpn"
+  WLED_CHANGED_MAINSEG    = 1UL << 6,  // "mainseg", "lor"
+  WLED_CHANGED_SEGMENTS   = 1UL << 7,  // Segments added or removed
+  WLED_CHANGED_SEG0       = 1UL << 16, // Segment at index i: WLED_CHANGED_SEG0 << i
+};
+
+#define WLED_CHANGED_ALL 0xFFFFFFFFUL
+
+// Per-segment field mask from wledSegmentCompare()
+enum WledSegmentChange : uint16_t {
+  WLED_SEG_CHANGED_BOUNDS  = 1 << 0,  // start, stop, grp, spc, of
+  WLED_SEG_CHANGED_FLAGS   = 1 << 1,  // on, frz, sel, rev, mi
+  WLED_SEG_CHANGED_BRI     = 1 << 2,  // bri, cct
+  WLED_SEG_CHANGED_COLOR   = 1 << 3,
+  WLED_SEG_CHANGED_FX      = 1 << 4,
+  WLED_SEG_CHANGED_SPEED   = 1 << 5,  // sx
+  WLED_SEG_CHANGED_INTENS  = 1 << 6,  // ix
+  WLED_SEG_CHANGED_PALETTE = 1 << 7,
+  WLED_SEG_CHANGED_OPTIONS = 1 << 8,  // c1, c2, c3
+};
+
+// An empty state (off, no segments), zeroed so it hashes consistently
+void wledPackedClear(WledState& state);
+
+// Applies WLED state JSON (a /json/state response, or a request to it) on
+// top of `state`. Segments are matched by "id", else by array position; a
+// segment object outside an array goes to mainseg, and one left with
+// stop <= start is removed. Returns false on malformed JSON, a value it
+// cannot represent ("bri": "~10") or more than WLED_PACKED_MAX_SEGMENTS
+// segments; `state` is then partly updated and should be fetched again.
+bool wledPackedParse(const char* json, size_t length, WledState& state);
+
+// Writes the fields selected by `mask` as WLED JSON: global fields by
+// their WLED_CHANGED_* bit, and each segment whose index bit is set as a
+// whole segment object. Returns the length written, or 0 if it did not
+// fit in `size` (including the terminating NUL).
+size_t wledPackedEmit(const WledState& state, char* out, size_t size,
+                      uint32_t mask = WLED_CHANGED_ALL);
+
+// What differs between two states; 0 if they are equal. Segments are
+// compared by index, so an added or removed segment also sets the bits of
+// the segments after it.
+uint32_t wledPackedCompare(const WledState& a, const WledState& b);
+uint16_t wledSegmentCompare(const WledSegment& a, const WledSegment& b);
+
+// FNV-1a over the global fields and the segments in use
+uint32_t wledPackedHash(const WledState& state);
+
+#endif // WLED_PACKED_H
@@ -0,0 +1,135 @@
+/**
+ * Lumina Bridge Common - WLED State Deltas
+ *
+ * Flattened, a state like
+ *
+ *   {"on":true,"bri":128,"nl":{"dur":60},"seg":[{"id":0,"fx":9,"col":[[255,0,0]]}]}
+ *
+ * becomes the leaves on=true, bri=128, nl.dur=60, seg.0.fx=9 and
+ * seg.0.col=[[255,0,0]]. Arrays other than "seg" stay whole.
+ */
+
+#include "wled_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t wledStateDiff(JsonObjectConst previous, JsonObjectConst current, JsonObject delta) {
+  size_t changed = 0;
+  for (JsonPairConst kv : current) {
+    if (previous[kv.key()] != kv.value()) {
+      delta[kv.key()] = kv.value();
+      changed++;
+    }
+  }
+  return changed;
+}
+
+void wledStateMerge(JsonObject state, JsonObjectConst delta) {
+  for (JsonPairConst kv : delta) {
+    if (kv.key().c_str()[0] == '_') continue;
+    state[kv.key()] = kv.value();
+  }
+}
+
+static bool emitLeaf(WledLeafFn leaf, void* context, const char* path, JsonVariantConst value,
+                     size_t valueMax) {
+  char text[128];
+  size_t length = measureJson(value);
+  if (length >= valueMax || length >= sizeof(text)) return false;
+  serializeJson(value, text, sizeof(text));
+  return leaf(context, path, text);
+}
+
+bool wledStateFlatten(JsonObjectConst state, WledLeafFn leaf, void* context, size_t valueMax) {
+  char path[48];
+  bool ok = true;
+
+  for (JsonPairConst kv : state) {
+    const char* key = kv.key().c_str();
+    JsonVariantConst value = kv.value();
+
+    if (strcmp(key, "seg") == 0) {
+      // A single segment object is segment 0 (or its own "id")
+      JsonArrayConst segments = value.as<JsonArrayConst>();
+      size_t count = value.is<JsonArrayConst>() ? segments.size() : 1;
+      for (size_t i = 0; i < count; i++) {
+        JsonObjectConst segment = value.is<JsonArrayConst>() ? segments[i].as<JsonObjectConst>()
+                                                             : value.as<JsonObjectConst>();
+        int id = segment["id"] | (int)i;
+        for (JsonPairConst field : segment) {
+          if (strcmp(field.key().c_str(), "id") == 0) continue;
+          snprintf(path, sizeof(path), "seg.%d.%s", id, field.key().c_str());
+          ok = emitLeaf(leaf, context, path, field.value(), valueMax) && ok;
+        }
+      }
+    } else if (value.is<JsonObjectConst>()) {
+      for (JsonPairConst field : value.as<JsonObjectConst>()) {
+        snprintf(path, sizeof(path), "%s.%s", key, field.key().c_str());
+        ok = emitLeaf(leaf, context, path, field.value(), valueMax) && ok;
+      }
+    } else {
+      ok = emitLeaf(leaf, context, key, value, valueMax) && ok;
+    }
+  }
+  return ok;
+}
+
+bool wledStateSetPath(JsonObject request, const char* path, const char* value) {
+  JsonDocument parsed;
+  if (deserializeJson(parsed, value)) return false;
+
+  char head[24];
+  const char* dot = strchr(path, '.');
+  if (dot == nullptr) {
+    request[path] = parsed.as<JsonVariantConst>();
+    return true;
+  }
+  size_t headLength = dot - path;
+  if (headLength >= sizeof(head)) return false;
+  memcpy(head, path, headLength);
+  head[headLength] = '\0';
+
+  if (strcmp(head, "seg") != 0) {
+    JsonObject object = request[head].is<JsonObject>() ? request[head].as<JsonObject>()
+                                                       : request[head].to<JsonObject>();
+    object[dot + 1] = parsed.as<JsonVariantConst>();
+    return true;
+  }
+
+  const char* field = strchr(dot + 1, '.');
+  if (field == nullptr) return false;
+  int id = atoi(dot + 1);
+
+  JsonArray segments = request["seg"].is<JsonArray>() ? request["seg"].as<JsonArray>()
+                                                      : request["seg"].to<JsonArray>();
+  JsonObject segment;
+  for (JsonObject candidate : segments) {
+    if ((candidate["id"] | -1) == id) segment = candidate;
+  }
+  if (segment.isNull()) {
+    segment = segments.add<JsonObject>();
+    segment["id"] = id;
+  }
+  segment[field + 1] = parsed.as<JsonVariantConst>();
+  return true;
+}
+
+bool wledStateIsAction(const char* path, JsonVariantConst value) {
+  static const char* const ACTIONS[] = {"psave", "pdel", "rb", "np", "tt", "v", "time",
+                                        "nn", "playlist", "ib", "sb", "ps", "pl"};
+  const char* key = strrchr(path, '.');
+  key = key != nullptr ? key + 1 : path;
+  for (const char* action : ACTIONS) {
+    if (strcmp(path, action) == 0) return true;
+  }
+  if (strncmp(path, "playlist.", 9) == 0) return true;
+
+  // Toggles ("t") and relative steps ("~10", "~-5", "4~8~") in place of a value
+  if (value.is<const char*>() && strcmp(key, "n") != 0) {
+    const char* text = value.as<const char*>();
+    return strcmp(text, "t") == 0 || strchr(text, '~') != nullptr;
+  }
+  return false;
+}
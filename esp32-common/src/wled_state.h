@@ -0,0 +1,39 @@
+// Lumina Bridge Common - WLED State Deltas
+//
+// A metered bridge publishes only the top-level state keys that changed
+// since its last publish; whoever holds the last full state merges the
+// delta back in. Keys starting with '_' are bridge metadata ("_delta",
+// "_uptime") and are never merged.
+//
+// The reconciler (reconciler.h) works on the same state as flat leaves.
+
+#ifndef WLED_STATE_H
+#define WLED_STATE_H
+
+#include <ArduinoJson.h>
+
+// Copies the top-level keys of `current` that differ from `previous` into
+// `delta` and returns how many there were
+size_t wledStateDiff(JsonObjectConst previous, JsonObjectConst current, JsonObject delta);
+
+// Applies a delta from wledStateDiff() to a full state
+void wledStateMerge(JsonObject state, JsonObjectConst delta);
+
+// Leaves of a state as paths, for the reconciler: "bri", "nl.dur" (one
+// level of object), "seg.{id}.fx" (segments by "id", else position).
+// Values are their compact JSON text; longer than `valueMax` returns
+// false after the leaves that fit.
+typedef bool (*WledLeafFn)(void* context, const char* path, const char* value);
+bool wledStateFlatten(JsonObjectConst state, WledLeafFn leaf, void* context,
+                      size_t valueMax = 64);
+
+// Puts one leaf back into a request body: the inverse of the above
+bool wledStateSetPath(JsonObject request, const char* path, const char* value);
+
+// Requests that act rather than set state ("psave", "tt", "on": "t",
+// "bri": "~10"), and presets and playlists ("ps", "pl"), which WLED moves
+// on from by itself: sent once, never compared against the controller.
+// A null `value` checks the path alone.
+bool wledStateIsAction(const char* path, JsonVariantConst value);
+
+#endif // WLED_STATE_H
@@ -0,0 +1,183 @@
+/**
+ * Lumina Bridge Common - Command Backlog Drain Simulation
+ *
+ * Simulates the Firestore bridge's loop working off a backlog of pending
+ * commands and compares the fixed page (MAX_COMMANDS_PER_POLL every
+ * POLL_INTERVAL_MS) with PollSizer. The model follows the firmware: a
+ * poll blocks the loop for a round trip plus a little per returned
+ * document, then one queued command runs per loop pass. Commands that find
+ * their controller's queue full stay pending and are read again by a later
+ * poll, as Firestore bills them.
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -I../src backlog_sim.cpp ../src/poll_sizer.cpp -o backlog_sim
+ *   ./backlog_sim --commands 60 --controllers 8 --exec-ms 60
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+#include "poll_sizer.h"
+
+struct Options {
+  int commands = 60;       // Backlog waiting when the bridge comes back
+  int stormCommands = 0;   // Further commands arriving during the run
+  int stormSec = 5;        // ... spread evenly over this many seconds
+  int controllers = 8;
+  int queueDepth = 4;      // COMMAND_QUEUE_DEPTH
+  int execMs = 60;         // WLED request per command
+  int rttMs = 300;         // Firestore runQuery round trip
+  int perDocUs = 3000;     // Download and parse per returned document
+  int intervalMs = 2000;   // POLL_INTERVAL_MS
+  int baseLimit = 5;       // MAX_COMMANDS_PER_POLL
+  int maxLimit = 40;       // POLL_MAX_COMMANDS
+  int heapBytes = 80000;   // Heap one poll may use
+  int bytesPerCommand = 2048;
+};
+
+struct Schedule {
+  const char* name;
+  bool adaptive;
+};
+
+struct Result {
+  uint32_t fetchedMs;  // Last command queued
+  uint32_t drainedMs;  // Last command executed
+  uint32_t polls;
+  uint32_t reads;      // Documents billed, empty results as one
+  uint16_t maxLimit;
+};
+
+struct Command {
+  uint32_t arrivesMs;
+  int controller;
+};
+
+static Result run(const Options& options, const Schedule& schedule) {
+  std::vector<Command> all;
+  for (int i = 0; i < options.commands; i++) all.push_back({0, i % options.controllers});
+  for (int i = 0; i < options.stormCommands; i++) {
+    uint32_t at = (uint32_t)((uint64_t)i * options.stormSec * 1000 / options.stormCommands);
+    all.push_back({at, (options.commands + i) % options.controllers});
+  }
+
+  std::deque<size_t> pending;  // Firestore order; indexes into `all`
+  size_t arrived = 0;
+  std::vector<std::deque<size_t>> queues(options.controllers);
+  int queued = 0;
+  int nextController = 0;
+
+  PollSizer sizer(options.baseLimit, options.maxLimit, options.bytesPerCommand);
+  Result result = {0, 0, 0, 0, 0};
+  uint32_t now = 0;
+  uint32_t lastPoll = 0;
+  uint32_t pollDelay = 0;  // The bridge's first poll runs at once
+  size_t executed = 0;
+  size_t fetched = 0;
+
+  while (executed < all.size() && now < 3600000) {
+    while (arrived < all.size() && all[arrived].arrivesMs <= now) pending.push_back(arrived++);
+
+    if (now - lastPoll >= pollDelay) {
+      lastPoll = now;
+      size_t room = (size_t)(options.controllers * options.queueDepth - queued);
+      uint16_t limit = schedule.adaptive ? sizer.limit(options.heapBytes, room)
+                                         : (uint16_t)options.baseLimit;
+      size_t returned = pending.size() < limit ? pending.size() : limit;
+      now += options.rttMs + (uint32_t)(returned * options.perDocUs / 1000);
+      result.polls++;
+      result.reads += returned > 0 ? returned : 1;
+      if (limit > result.maxLimit) result.maxLimit = limit;
+
+      // Queue what fits; the rest stays pending in Firestore order
+      std::deque<size_t> left;
+      for (size_t n = 0; n < returned; n++) {
+        size_t index = pending.front();
+        pending.pop_front();
+        std::deque<size_t>& queue = queues[all[index].controller];
+        if ((int)queue.size() < options.queueDepth) {
+          queue.push_back(index);
+          queued++;
+          fetched++;
+          if (fetched == all.size()) result.fetchedMs = now;
+        } else {
+          left.push_back(index);
+        }
+      }
+      pending.insert(pending.begin(), left.begin(), left.end());
+
+      pollDelay = options.intervalMs;
+      if (schedule.adaptive) {
+        sizer.polled(limit, (uint16_t)returned, (uint16_t)left.size());
+        room = (size_t)(options.controllers * options.queueDepth - queued);
+        if (sizer.backlog()) {
+          // Counted from the end of this poll, as the firmware does
+          uint32_t wait = sizer.backlogDelayMs(room);
+          pollDelay = wait < (uint32_t)options.intervalMs ? wait : options.intervalMs;
+          lastPoll = now;
+        }
+      }
+    }
+
+    // One queued command per loop pass, controllers in turn
+    bool ran = false;
+    for (int n = 0; n < options.controllers && !ran; n++) {
+      std::deque<size_t>& queue = queues[(nextController + n) % options.controllers];
+      if (queue.empty()) continue;
+      queue.pop_front();
+      queued--;
+      executed++;
+      nextController = (nextController + n + 1) % options.controllers;
+      now += options.execMs;
+      sizer.executed(options.execMs * 1000);
+      ran = true;
+    }
+    if (executed == all.size()) result.drainedMs = now;
+    now += 10;  // delay(10) at the end of loop()
+  }
+  return result;
+}
+
+static void parseArgs(int argc, char** argv, Options& options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    int value = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--commands") == 0) options.commands = value;
+    else if (strcmp(argv[i], "--storm") == 0) options.stormCommands = value;
+    else if (strcmp(argv[i], "--storm-sec") == 0) options.stormSec = value;
+    else if (strcmp(argv[i], "--controllers") == 0) options.controllers = value;
+    else if (strcmp(argv[i], "--depth") == 0) options.queueDepth = value;
+    else if (strcmp(argv[i], "--exec-ms") == 0) options.execMs = value;
+    else if (strcmp(argv[i], "--rtt-ms") == 0) options.rttMs = value;
+    else if (strcmp(argv[i], "--max-limit") == 0) options.maxLimit = value;
+    else if (strcmp(argv[i], "--heap") == 0) options.heapBytes = value;
+    else fprintf(stderr, "Unknown option %s\n", argv[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  parseArgs(argc, argv, options);
+
+  printf("%d commands waiting, %d arriving over %d s; %d controllers x %d queued; "
+         "%d ms per command, %d ms poll RTT\n\n",
+         options.commands, options.stormCommands, options.stormSec, options.controllers,
+         options.queueDepth, options.execMs, options.rttMs);
+  printf("%-26s %10s %10s %6s %6s %9s\n", "Schedule", "Fetched", "Drained", "Polls", "Reads",
+         "Max page");
+
+  const Schedule schedules[] = {
+      {"Fixed page", false},
+      {"Adaptive (PollSizer)", true},
+  };
+  for (const Schedule& schedule : schedules) {
+    Result result = run(options, schedule);
+    printf("%-26s %8.1f s %8.1f s %6u %6u %9u\n", schedule.name, result.fetchedMs / 1000.0,
+           result.drainedMs / 1000.0, result.polls, result.reads, result.maxLimit);
+  }
+  return 0;
+}
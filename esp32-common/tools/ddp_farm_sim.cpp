@@ -0,0 +1,281 @@
+/**
+ * Lumina Bridge Common - DDP Device Farm Simulation
+ *
+ * Measures how far apart a row of controllers latches the same frame. Each
+ * simulated controller is a UDP socket on localhost with its own receive
+ * thread that behaves like WLED's DDP handler: data packets are buffered,
+ * a packet with the PUSH flag shows the frame, and the arrival time of that
+ * packet is the controller's latch time. Per frame, skew is the latest
+ * latch minus the earliest.
+ *
+ * Loopback is far faster than WiFi, so the sender models the one radio
+ * every packet has to go through: each datagram occupies the air for
+ * --overhead microseconds plus its bytes at --mbps before the next one can
+ * start. --jitter adds a random delivery delay of up to that many
+ * microseconds per packet and controller (retries, the AP's queue).
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -pthread -I../src ddp_farm_sim.cpp ../src/ddp_sync.cpp \
+ *       ../src/ddp.cpp -o ddp_farm_sim
+ *   ./ddp_farm_sim --controllers 4 --pixels 600 --fps 40 --frames 400
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ddp.h"
+#include "ddp_sync.h"
+
+struct Options {
+  int controllers = 4;
+  int pixels = 600;        // Per controller
+  int fps = 40;
+  int frames = 400;
+  double mbps = 20.0;      // Effective WiFi throughput
+  int overheadUs = 120;    // Per datagram: preamble, MAC headers, ACK, backoff
+  int jitterUs = 300;
+};
+
+struct Mode {
+  const char* name;
+  bool deferred;
+  bool broadcast;
+};
+
+static uint32_t nowUs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void spinUntil(uint32_t us) {
+  while ((int32_t)(nowUs() - us) < 0) {
+  }
+}
+
+// ============================================================================
+// Simulated Controllers
+// ============================================================================
+
+struct Controller {
+  int fd;
+  uint16_t port;
+  uint32_t expectBytes;
+  std::vector<uint32_t> latchUs;  // One per frame shown
+  uint32_t incomplete;            // Frames shown with data missing
+  std::thread thread;
+};
+
+static std::atomic<bool> running(true);
+
+static void receive(Controller* c) {
+  uint8_t packet[sizeof(uint32_t) + DDP_HEADER_LEN + DDP_MAX_DATA_LEN];
+  uint32_t received = 0;
+  while (running) {
+    ssize_t n = recv(c->fd, packet, sizeof(packet), 0);
+    if (n < (ssize_t)(sizeof(uint32_t) + DDP_HEADER_LEN)) continue;
+
+    // Arrival time travels in front of the datagram (see Farm::send)
+    uint32_t arrival;
+    memcpy(&arrival, packet, sizeof(arrival));
+    received += (packet[8 + 4] << 8) | packet[9 + 4];
+    if (packet[4] & 0x01) {
+      c->latchUs.push_back(arrival);
+      if (received < c->expectBytes) c->incomplete++;
+      received = 0;
+    }
+  }
+}
+
+// ============================================================================
+// Farm
+// ============================================================================
+
+struct Farm {
+  Options opt;
+  std::vector<Controller*> controllers;
+  int sender;
+  uint32_t airFreeUs;
+  std::mt19937 rng;
+
+  bool open() {
+    sender = socket(AF_INET, SOCK_DGRAM, 0);
+    for (int i = 0; i < opt.controllers; i++) {
+      Controller* c = new Controller();
+      c->fd = socket(AF_INET, SOCK_DGRAM, 0);
+      sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = 0;
+      if (bind(c->fd, (sockaddr*)&addr, sizeof(addr)) != 0) return false;
+      socklen_t len = sizeof(addr);
+      getsockname(c->fd, (sockaddr*)&addr, &len);
+      c->port = ntohs(addr.sin_port);
+      timeval timeout = {0, 100000};
+      setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      c->expectBytes = opt.pixels * 3;
+      c->incomplete = 0;
+      controllers.push_back(c);
+    }
+    for (Controller* c : controllers) c->thread = std::thread(receive, c);
+    return true;
+  }
+
+  void stop() {
+    running = false;
+    for (Controller* c : controllers) {
+      c->thread.join();
+      ::close(c->fd);
+    }
+    ::close(sender);
+  }
+
+  ~Farm() {
+    for (Controller* c : controllers) delete c;
+  }
+
+  // "10.0.0.N" is controller N; "10.0.0.255" reaches all of them with one
+  // transmission, as a broadcast does on WiFi
+  static bool send(void* context, const char* ip, const uint8_t* packet, size_t length) {
+    Farm* farm = (Farm*)context;
+    int index = atoi(strrchr(ip, '.') + 1);
+
+    // Wait for the air, then occupy it for this datagram
+    uint32_t start = std::max(nowUs(), farm->airFreeUs);
+    uint32_t airtime = farm->opt.overheadUs + (uint32_t)((length + 28) * 8 / farm->opt.mbps);
+    farm->airFreeUs = start + airtime;
+    spinUntil(farm->airFreeUs);
+
+    uint8_t framed[sizeof(uint32_t) + DDP_HEADER_LEN + DDP_MAX_DATA_LEN];
+    memcpy(framed + sizeof(uint32_t), packet, length);
+    std::uniform_int_distribution<int> jitter(0, farm->opt.jitterUs);
+
+    for (size_t i = 0; i < farm->controllers.size(); i++) {
+      if (index != 255 && (size_t)index != i) continue;
+      Controller* c = farm->controllers[i];
+      uint32_t arrival = farm->airFreeUs + jitter(farm->rng);
+      memcpy(framed, &arrival, sizeof(arrival));
+      sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = htons(c->port);
+      if (sendto(farm->sender, framed, sizeof(uint32_t) + length, 0, (sockaddr*)&addr,
+                 sizeof(addr)) < 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+struct Result {
+  uint32_t p50, p99, max;
+  uint32_t incomplete;
+  uint32_t shown;
+  uint32_t skipped;
+};
+
+static Result run(const Options& opt, const Mode& mode) {
+  running = true;
+  Farm farm;
+  farm.opt = opt;
+  farm.airFreeUs = 0;
+  farm.rng.seed(7);
+  if (!farm.open()) {
+    fprintf(stderr, "could not open controller sockets\n");
+    exit(1);
+  }
+
+  DdpFrameSync sync(Farm::send, &farm);
+  char ip[24];
+  for (int i = 0; i < opt.controllers; i++) {
+    snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+    sync.addOutput(ip, opt.pixels);
+  }
+  sync.setDeferredPush(mode.deferred);
+  sync.setBroadcastPush(mode.broadcast ? "10.0.0.255" : nullptr);
+
+  std::vector<uint8_t> frame(sync.framePixels() * 3);
+  sync.start(nowUs(), opt.fps);
+  for (int f = 0; f < opt.frames; f++) {
+    spinUntil(nowUs() + sync.usUntilDue(nowUs()));
+    std::fill(frame.begin(), frame.end(), (uint8_t)f);
+    sync.sendFrame(frame.data(), frame.size(), nowUs());
+  }
+  usleep(200000);
+  farm.stop();
+
+  Result result = {};
+  std::vector<uint32_t> skews;
+  size_t shown = SIZE_MAX;
+  for (Controller* c : farm.controllers) shown = std::min(shown, c->latchUs.size());
+  for (size_t f = 0; f < shown; f++) {
+    uint32_t first = farm.controllers[0]->latchUs[f], last = first;
+    for (Controller* c : farm.controllers) {
+      if ((int32_t)(c->latchUs[f] - first) < 0) first = c->latchUs[f];
+      if ((int32_t)(c->latchUs[f] - last) > 0) last = c->latchUs[f];
+    }
+    skews.push_back(last - first);
+  }
+  for (Controller* c : farm.controllers) result.incomplete += c->incomplete;
+  std::sort(skews.begin(), skews.end());
+  if (!skews.empty()) {
+    result.p50 = skews[skews.size() / 2];
+    result.p99 = skews[(skews.size() * 99) / 100 < skews.size() ? (skews.size() * 99) / 100
+                                                                : skews.size() - 1];
+    result.max = skews.back();
+  }
+  result.shown = shown;
+  result.skipped = sync.stats().skipped;
+  return result;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--controllers") == 0) opt.controllers = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--pixels") == 0) opt.pixels = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--fps") == 0) opt.fps = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--frames") == 0) opt.frames = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--mbps") == 0) opt.mbps = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--overhead") == 0) opt.overheadUs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--jitter") == 0) opt.jitterUs = atoi(argv[i + 1]);
+  }
+  if (opt.controllers < 1 || opt.controllers > DDP_SYNC_MAX_OUTPUTS || opt.pixels < 1 ||
+      opt.pixels > 65535) {
+    fprintf(stderr, "1-%d controllers of 1-65535 pixels\n", DDP_SYNC_MAX_OUTPUTS);
+    return 1;
+  }
+
+  const Mode modes[] = {
+      {"push per controller", false, false},
+      {"deferred, unicast push", true, false},
+      {"deferred, broadcast push", true, true},
+  };
+
+  printf("%d controllers x %d pixels at %d fps, %d frames; %.0f Mbit/s, %d us/packet, "
+         "%d us jitter\n\n",
+         opt.controllers, opt.pixels, opt.fps, opt.frames, opt.mbps, opt.overheadUs,
+         opt.jitterUs);
+  printf("%-26s %9s %9s %9s %7s %11s\n", "mode", "skew p50", "skew p99", "skew max", "shown",
+         "incomplete");
+  for (const Mode& mode : modes) {
+    Result r = run(opt, mode);
+    printf("%-26s %7uus %7uus %7uus %7u %11u\n", mode.name, r.p50, r.p99, r.max, r.shown,
+           r.incomplete);
+    if (r.skipped > 0) printf("  (%u frame slots skipped: sender could not keep up)\n", r.skipped);
+  }
+  return 0;
+}
@@ -0,0 +1,426 @@
+/**
+ * Lumina Bridge Common - LAN Broker vs HTTP Simulation
+ *
+ * Sends the same state commands to a row of simulated WLED controllers on
+ * localhost two ways and compares them:
+ *
+ * - HTTP: what the bridges do today. One connection per command, a POST to
+ *   /json/state, and the loop waits for the answer.
+ * - MQTT: LanBroker with every controller connected once. A command is a
+ *   publish to "{topic}/api"; the controller applies it and publishes its
+ *   brightness to "{topic}/g", which the bridge takes as the acknowledgement.
+ *
+ * Each controller is a thread that behaves like WLED: it applies a command
+ * (--apply-ms of work) and answers. Loopback has no air time, so the
+ * controllers model the WiFi link: a message takes half of --rtt-ms to
+ * arrive, and an HTTP request first waits one --rtt-ms for the TCP
+ * handshake. "Apply" is when the controller applied the command, from when
+ * the bridge started sending it; "round trip" is when the bridge knew.
+ * "Loop blocked" is the time the bridge's loop spent in the call.
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -pthread -I../src lan_broker_sim.cpp ../src/lan_broker.cpp \
+ *       ../src/mqtt_packet.cpp -o lan_broker_sim
+ *   ./lan_broker_sim --controllers 8 --commands 400 --rtt-ms 6
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lan_broker.h"
+#include "mqtt_packet.h"
+
+struct Options {
+  int controllers = 8;
+  int commands = 400;    // Spread over the controllers in turn
+  int rttMs = 6;         // WiFi round trip between bridge and controller
+  int applyMs = 3;       // WLED parsing and applying a state command
+  int brokerPort = 18830;
+  int httpPort = 18900;  // First controller's; the rest follow
+};
+
+static uint64_t nowUs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void sleepUs(uint64_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static int connectTo(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool sendAll(int fd, const void* data, size_t length) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (length > 0) {
+    ssize_t n = send(fd, p, length, 0);
+    if (n <= 0) return false;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+// "seq":N from a command body
+static int commandSeq(const char* body, size_t length) {
+  std::string text(body, length);
+  size_t at = text.find("\"seq\":");
+  return at == std::string::npos ? -1 : atoi(text.c_str() + at + 6);
+}
+
+// When each command was applied, by sequence number
+static std::vector<std::atomic<uint64_t>>* appliedAt;
+
+static void applyCommand(int seq, const Options& options) {
+  sleepUs(options.applyMs * 1000ULL);
+  if (seq >= 0 && seq < (int)appliedAt->size()) (*appliedAt)[seq] = nowUs();
+}
+
+// ============================================================================
+// Simulated Controllers
+// ============================================================================
+
+// WLED's MQTT client: subscribes to its device and group topics, applies
+// what arrives on "/api" and publishes its brightness back
+static void mqttController(int number, const Options& options) {
+  int fd = connectTo(options.brokerPort);
+  if (fd < 0) return;
+
+  char topic[32];
+  snprintf(topic, sizeof(topic), "wled/c%d", number);
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "WLED-%06X", number);
+
+  uint8_t packet[256];
+  sendAll(fd, packet, mqttBuildConnect(packet, sizeof(packet), clientId, "", "", 60));
+  const char* suffixes[] = {"", "/col", "/api"};
+  uint16_t packetId = 1;
+  for (const char* base : {(const char*)topic, "wled/all"}) {
+    for (const char* suffix : suffixes) {
+      char filter[48];
+      snprintf(filter, sizeof(filter), "%s%s", base, suffix);
+      sendAll(fd, packet, mqttBuildSubscribe(packet, sizeof(packet), packetId++, filter));
+    }
+  }
+
+  std::vector<uint8_t> buffer;
+  uint8_t chunk[2048];
+  for (;;) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) break;
+    buffer.insert(buffer.end(), chunk, chunk + n);
+
+    for (;;) {
+      size_t headerLength = 0;
+      int32_t length = mqttPacketLength(buffer.data(), buffer.size(), headerLength);
+      if (length <= 0 || (size_t)length > buffer.size()) break;
+
+      MqttPublish message;
+      if ((buffer[0] >> 4) == MQTT_PUBLISH &&
+          mqttParsePublish(buffer[0], buffer.data() + headerLength, length - headerLength,
+                           message) &&
+          message.topic.length > 4 &&
+          memcmp(message.topic.data + message.topic.length - 4, "/api", 4) == 0) {
+        sleepUs(options.rttMs * 500ULL);  // Bridge to controller
+        applyCommand(commandSeq((const char*)message.payload, message.payloadLength), options);
+        sleepUs(options.rttMs * 500ULL);  // Controller to bridge
+
+        char pushTopic[40];
+        snprintf(pushTopic, sizeof(pushTopic), "%s/g", topic);
+        uint8_t push[64];
+        sendAll(fd, push, mqttBuildPublish(push, sizeof(push), pushTopic, (const uint8_t*)"128",
+                                           3, false));
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + length);
+    }
+  }
+  close(fd);
+}
+
+// WLED's web server: one request per connection, answered and closed
+static void httpController(int listenFd, const Options& options) {
+  for (;;) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) break;
+    sleepUs(options.rttMs * 1000ULL);  // TCP handshake
+
+    std::string request;
+    char chunk[2048];
+    size_t headerEnd = std::string::npos;
+    size_t contentLength = 0;
+    while (headerEnd == std::string::npos || request.size() < headerEnd + 4 + contentLength) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) break;
+      request.append(chunk, n);
+      if (headerEnd == std::string::npos) {
+        headerEnd = request.find("\r\n\r\n");
+        size_t at = request.find("Content-Length: ");
+        if (at != std::string::npos) contentLength = atoi(request.c_str() + at + 16);
+      }
+    }
+    if (headerEnd != std::string::npos) {
+      sleepUs(options.rttMs * 500ULL);
+      applyCommand(commandSeq(request.c_str() + headerEnd, request.size() - headerEnd), options);
+      sleepUs(options.rttMs * 500ULL);
+      const char* response =
+          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 16\r\n"
+          "Connection: close\r\n\r\n{\"success\":true}";
+      sendAll(fd, response, strlen(response));
+    }
+    close(fd);
+  }
+}
+
+// ============================================================================
+// Bridge Side
+// ============================================================================
+
+// Every sample kept; LatencyStats stops at 64
+struct Samples {
+  std::vector<uint32_t> values;
+  int failures = 0;
+
+  void add(uint32_t us) { values.push_back(us); }
+  void addFailure() { failures++; }
+  double percentileMs(int p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (values.size() * p + 99) / 100;
+    return values[rank > 0 ? rank - 1 : 0] / 1000.0;
+  }
+};
+
+struct Result {
+  Samples blockedUs;
+  Samples applyUs;
+  Samples roundTripUs;
+  uint32_t connections;
+  uint64_t bytes;
+  size_t memoryPerController;
+};
+
+static void commandBody(char* out, size_t size, int seq) {
+  snprintf(out, size, "{\"on\":true,\"bri\":%d,\"seg\":[{\"fx\":%d}],\"seq\":%d}", seq % 256,
+           seq % 100, seq);
+}
+
+static Result runHttp(const Options& options) {
+  Result result;
+  result.connections = 0;
+  result.bytes = 0;
+  std::vector<int> listeners;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.controllers; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.httpPort + i);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+      fprintf(stderr, "Cannot listen on port %d\n", options.httpPort + i);
+      exit(1);
+    }
+    listeners.push_back(fd);
+    threads.emplace_back(httpController, fd, std::cref(options));
+  }
+
+  for (int seq = 0; seq < options.commands; seq++) {
+    char body[128];
+    commandBody(body, sizeof(body), seq);
+    char request[512];
+    int length = snprintf(request, sizeof(request),
+                          "POST /json/state HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                          "Content-Type: application/json\r\nContent-Length: %zu\r\n"
+                          "Connection: close\r\n\r\n%s",
+                          strlen(body), body);
+
+    uint64_t started = nowUs();
+    int fd = connectTo(options.httpPort + seq % options.controllers);
+    if (fd < 0) {
+      result.roundTripUs.addFailure();
+      continue;
+    }
+    result.connections++;
+    sendAll(fd, request, length);
+    result.bytes += length;
+    char response[512];
+    ssize_t n;
+    while ((n = recv(fd, response, sizeof(response), 0)) > 0) result.bytes += n;
+    close(fd);
+
+    uint64_t finished = nowUs();
+    result.blockedUs.add((uint32_t)(finished - started));
+    result.roundTripUs.add((uint32_t)(finished - started));
+    result.applyUs.add((uint32_t)((*appliedAt)[seq] - started));
+  }
+
+  for (int fd : listeners) shutdown(fd, SHUT_RDWR);
+  for (std::thread& thread : threads) thread.join();
+  for (int fd : listeners) close(fd);
+  result.memoryPerController = 0;
+  return result;
+}
+
+struct Ack {
+  char topic[40];
+  std::atomic<bool> seen;
+};
+
+static void onPublish(int client, const char* topic, const uint8_t* payload, size_t length,
+                      void* context) {
+  (void)client;
+  (void)payload;
+  (void)length;
+  Ack* ack = (Ack*)context;
+  if (strcmp(topic, ack->topic) == 0) ack->seen = true;
+}
+
+static Result runMqtt(const Options& options) {
+  Result result;
+  result.connections = 0;
+  result.bytes = 0;
+  LanBroker broker;
+  if (!broker.begin(options.brokerPort, "", "")) {
+    fprintf(stderr, "Cannot listen on port %d\n", options.brokerPort);
+    exit(1);
+  }
+  Ack ack;
+  ack.seen = false;
+  broker.setHandler(onPublish, &ack);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.controllers; i++) {
+    threads.emplace_back(mqttController, i, std::cref(options));
+  }
+
+  // Until every controller has subscribed to its /api topic
+  uint64_t deadline = nowUs() + 5000000;
+  int ready = 0;
+  while (ready < options.controllers && nowUs() < deadline) {
+    broker.poll((uint32_t)(nowUs() / 1000));
+    ready = 0;
+    for (int i = 0; i < options.controllers; i++) {
+      char topic[32];
+      snprintf(topic, sizeof(topic), "wled/c%d", i);
+      if (broker.findByTopic(topic) >= 0) ready++;
+    }
+    sleepUs(100);
+  }
+  uint32_t bytesBefore = broker.stats().bytesIn + broker.stats().bytesOut;
+
+  for (int seq = 0; seq < options.commands; seq++) {
+    int controller = seq % options.controllers;
+    char body[128];
+    commandBody(body, sizeof(body), seq);
+    char topic[40];
+    snprintf(topic, sizeof(topic), "wled/c%d/api", controller);
+    snprintf(ack.topic, sizeof(ack.topic), "wled/c%d/g", controller);
+    ack.seen = false;
+
+    uint64_t started = nowUs();
+    size_t delivered = broker.publish(topic, (const uint8_t*)body, strlen(body));
+    result.blockedUs.add((uint32_t)(nowUs() - started));
+    if (delivered == 0) {
+      result.roundTripUs.addFailure();
+      continue;
+    }
+
+    // The bridge's loop would run other work here; the sim only polls
+    uint64_t giveUp = started + 2000000;
+    while (!ack.seen && nowUs() < giveUp) {
+      broker.poll((uint32_t)(nowUs() / 1000));
+      sleepUs(50);
+    }
+    if (!ack.seen) {
+      result.roundTripUs.addFailure();
+      continue;
+    }
+    result.roundTripUs.add((uint32_t)(nowUs() - started));
+    result.applyUs.add((uint32_t)((*appliedAt)[seq] - started));
+  }
+
+  result.connections = broker.stats().accepted;
+  result.bytes = broker.stats().bytesIn + broker.stats().bytesOut - bytesBefore;
+  result.memoryPerController = LanBroker::clientBytes();
+  broker.end();
+  for (std::thread& thread : threads) thread.join();
+  return result;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static void parseArgs(int argc, char** argv, Options& options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    int value = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--controllers") == 0) options.controllers = value;
+    else if (strcmp(argv[i], "--commands") == 0) options.commands = value;
+    else if (strcmp(argv[i], "--rtt-ms") == 0) options.rttMs = value;
+    else if (strcmp(argv[i], "--apply-ms") == 0) options.applyMs = value;
+    else if (strcmp(argv[i], "--port") == 0) options.brokerPort = value;
+    else fprintf(stderr, "Unknown option %s\n", argv[i]);
+  }
+  if (options.controllers > LAN_BROKER_MAX_CLIENTS) options.controllers = LAN_BROKER_MAX_CLIENTS;
+}
+
+static void printRow(const char* name, Result result, int commands) {
+  printf("%-6s %11u %8.2f %8.1f %8.1f %8.1f %8.1f %9.0f %10zu\n", name, result.connections,
+         result.blockedUs.percentileMs(50), result.applyUs.percentileMs(50),
+         result.applyUs.percentileMs(99), result.roundTripUs.percentileMs(50),
+         result.roundTripUs.percentileMs(99), (double)result.bytes / commands,
+         result.memoryPerController);
+  if (result.roundTripUs.failures > 0) {
+    printf("       %d commands not acknowledged\n", result.roundTripUs.failures);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  parseArgs(argc, argv, options);
+
+  std::vector<std::atomic<uint64_t>> applied(options.commands);
+  appliedAt = &applied;
+
+  printf("%d controllers, %d commands; %d ms WiFi RTT, %d ms to apply\n\n", options.controllers,
+         options.commands, options.rttMs, options.applyMs);
+  printf("%-6s %11s %8s %8s %8s %8s %8s %9s %10s\n", "Path", "Connections", "Blocked", "Apply",
+         "Apply", "Trip", "Trip", "Bytes per", "Bridge RAM");
+  printf("%-6s %11s %8s %8s %8s %8s %8s %9s %10s\n", "", "opened", "p50 ms", "p50 ms", "p99 ms",
+         "p50 ms", "p99 ms", "command", "per ctrl");
+
+  printRow("HTTP", runHttp(options), options.commands);
+  printRow("MQTT", runMqtt(options), options.commands);
+  return 0;
+}
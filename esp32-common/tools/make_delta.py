@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""
+Lumina Bridge - Firmware Delta Generator
+
+Builds a compressed binary delta that turns the firmware a bridge is
+running (SOURCE) into a new build (TARGET), for the bridge's delta OTA
+command. See esp32-common/src/delta_patch.h for the file format.
+
+Usage:
+    python3 make_delta.py SOURCE.bin TARGET.bin -k signing.pem -o update.ldlt
+    python3 make_delta.py --full TARGET.bin -k signing.pem -o update.ldlt
+    python3 make_delta.py --public-key signing.pem   # OTA_SIGNING_KEY line
+
+The header is signed with an Ed25519 key (create one with `openssl genpkey
+-algorithm ed25519 -out signing.pem` and keep it off the build machines);
+bridges accept only deltas signed by the key in their OTA_SIGNING_KEY.
+Signing uses the openssl command line (3.0 or later).
+
+The delta is verified by applying it in Python, and its signature checked,
+before it is written. Upload it anywhere the bridge can fetch over HTTPS
+and send the bridge an `otaUpdate` command with its URL.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import zlib
+
+MAGIC = b"LDLT"
+FORMAT_VERSION = 2
+FLAG_ZLIB = 0x01
+SIGNATURE_SIZE = 64
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_ADD = 0x02
+OP_INSERT = 0x03
+
+# Shortest exact match worth a COPY op (9 bytes of op overhead)
+MIN_MATCH = 24
+# Source offsets indexed every INDEX_STEP bytes; matches shorter than
+# BLOCK + INDEX_STEP can be missed
+BLOCK = 16
+INDEX_STEP = 4
+# A gap is sent as ADD against the previous match's alignment when at
+# least this fraction of its bytes already match the source there
+ADD_THRESHOLD = 0.5
+
+
+def build_index(source):
+    index = {}
+    for off in range(0, len(source) - BLOCK + 1, INDEX_STEP):
+        index.setdefault(source[off:off + BLOCK], off)
+    return index
+
+
+def match_length(source, src_off, target, tgt_off):
+    n = 0
+    limit = min(len(source) - src_off, len(target) - tgt_off)
+    # Compare in slices first, then byte by byte
+    step = 256
+    while n + step <= limit and source[src_off + n:src_off + n + step] == target[tgt_off + n:tgt_off + n + step]:
+        n += step
+    while n < limit and source[src_off + n] == target[tgt_off + n]:
+        n += 1
+    return n
+
+
+def emit_gap(ops, source, target, start, end, delta):
+    """Encode target[start:end] as ADD against the last alignment, or INSERT."""
+    if start >= end:
+        return
+    if delta is not None and 0 <= start + delta and end + delta <= len(source):
+        src_start = start + delta
+        same = sum(1 for i in range(start, end) if target[i] == source[i + delta])
+        if same >= (end - start) * ADD_THRESHOLD:
+            diff = bytes((target[i] - source[i + delta]) & 0xFF for i in range(start, end))
+            ops.append(struct.pack("<BII", OP_ADD, src_start, end - start) + diff)
+            return
+    ops.append(struct.pack("<BI", OP_INSERT, end - start) + target[start:end])
+
+
+def make_ops(source, target):
+    ops = []
+    if not source:
+        ops.append(struct.pack("<BI", OP_INSERT, len(target)) + target)
+        ops.append(bytes([OP_END]))
+        return b"".join(ops)
+
+    index = build_index(source)
+    pos = 0
+    gap_start = 0
+    delta = None  # source offset - target offset of the last match
+
+    while pos <= len(target) - BLOCK:
+        best_off, best_len = None, 0
+
+        # Prefer continuing the previous alignment (code that did not move)
+        if delta is not None and 0 <= pos + delta < len(source):
+            n = match_length(source, pos + delta, target, pos)
+            if n >= MIN_MATCH:
+                best_off, best_len = pos + delta, n
+
+        if best_len == 0:
+            off = index.get(target[pos:pos + BLOCK])
+            if off is not None:
+                n = match_length(source, off, target, pos)
+                if n >= MIN_MATCH:
+                    best_off, best_len = off, n
+
+        if best_len == 0:
+            pos += 1
+            continue
+
+        emit_gap(ops, source, target, gap_start, pos, delta)
+        ops.append(struct.pack("<BII", OP_COPY, best_off, best_len))
+        delta = best_off - pos
+        pos += best_len
+        gap_start = pos
+
+    emit_gap(ops, source, target, gap_start, len(target), delta)
+    ops.append(bytes([OP_END]))
+    return b"".join(ops)
+
+
+def apply_ops(source, ops, target_size):
+    out = bytearray()
+    pos = 0
+    while True:
+        op = ops[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            off, n = struct.unpack_from("<II", ops, pos)
+            pos += 8
+            out += source[off:off + n]
+        elif op == OP_ADD:
+            off, n = struct.unpack_from("<II", ops, pos)
+            pos += 8
+            out += bytes((source[off + i] + ops[pos + i]) & 0xFF for i in range(n))
+            pos += n
+        elif op == OP_INSERT:
+            (n,) = struct.unpack_from("<I", ops, pos)
+            pos += 4
+            out += ops[pos:pos + n]
+            pos += n
+        else:
+            raise ValueError("bad op 0x%02x at %d" % (op, pos - 1))
+    if len(out) != target_size:
+        raise ValueError("patched size %d != %d" % (len(out), target_size))
+    return bytes(out)
+
+
+def openssl(*args, data=None):
+    result = subprocess.run(("openssl",) + args, input=data, capture_output=True)
+    if result.returncode != 0:
+        sys.exit("openssl %s failed: %s" % (args[0], result.stderr.decode().strip()))
+    return result.stdout
+
+
+def public_key(key_path):
+    """Raw 32-byte Ed25519 public key (the last 32 bytes of its DER form)."""
+    der = openssl("pkey", "-in", key_path, "-pubout", "-outform", "DER")
+    if len(der) != 44:
+        sys.exit("%s is not an Ed25519 key" % key_path)
+    return der[-32:]
+
+
+def sign(key_path, message):
+    """Ed25519 signature of `message`, checked against the public key."""
+    with tempfile.TemporaryDirectory() as tmp:
+        message_path = os.path.join(tmp, "header.bin")
+        signature_path = os.path.join(tmp, "header.sig")
+        public_path = os.path.join(tmp, "public.pem")
+        with open(message_path, "wb") as f:
+            f.write(message)
+        openssl("pkeyutl", "-sign", "-rawin", "-inkey", key_path,
+                "-in", message_path, "-out", signature_path)
+        openssl("pkey", "-in", key_path, "-pubout", "-out", public_path)
+        openssl("pkeyutl", "-verify", "-rawin", "-pubin", "-inkey", public_path,
+                "-in", message_path, "-sigfile", signature_path)
+        with open(signature_path, "rb") as f:
+            signature = f.read()
+    if len(signature) != SIGNATURE_SIZE:
+        sys.exit("unexpected signature size %d" % len(signature))
+    return signature
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a Lumina bridge firmware delta")
+    parser.add_argument("source", nargs="?", help="firmware.bin the bridge is running")
+    parser.add_argument("target", nargs="?", help="new firmware.bin")
+    parser.add_argument("-o", "--output", help="delta file to write")
+    parser.add_argument("-k", "--key", help="Ed25519 private key (PEM) to sign with")
+    parser.add_argument("--full", action="store_true", help="no source; embed the whole image")
+    parser.add_argument("--level", type=int, default=9, help="zlib level (default 9)")
+    parser.add_argument("--public-key", metavar="KEY", help="print the OTA_SIGNING_KEY for KEY")
+    args = parser.parse_args()
+
+    if args.public_key:
+        raw = public_key(args.public_key)
+        print("#define OTA_SIGNING_KEY {%s}" % ", ".join("0x%02x" % b for b in raw))
+        return
+
+    # With --full the one image given is the target
+    if args.full and args.target is None:
+        args.source, args.target = None, args.source
+    if args.target is None or args.full == (args.source is not None):
+        parser.error("give SOURCE and TARGET, or --full and TARGET")
+    if not args.output or not args.key:
+        parser.error("-o and -k are required")
+
+    source = b"" if args.full else open(args.source, "rb").read()
+    target = open(args.target, "rb").read()
+
+    started = time.time()
+    ops = make_ops(source, target)
+    patched = apply_ops(source, ops, len(target))
+    if hashlib.sha256(patched).digest() != hashlib.sha256(target).digest():
+        sys.exit("verification failed: patched image does not match target")
+
+    body = zlib.compress(ops, args.level)
+    header = MAGIC + struct.pack("<BBHII", FORMAT_VERSION, FLAG_ZLIB, 0, len(source), len(target))
+    header += hashlib.sha256(source).digest() + hashlib.sha256(target).digest()
+    assert len(header) == 80
+    signature = sign(args.key, header)
+
+    with open(args.output, "wb") as f:
+        f.write(header + signature + body)
+
+    total = len(header) + len(signature) + len(body)
+    print("source   %9d bytes" % len(source))
+    print("target   %9d bytes" % len(target))
+    print("ops      %9d bytes (uncompressed)" % len(ops))
+    print("delta    %9d bytes (%.1f%% of target)" % (total, 100.0 * total / len(target)))
+    print("built in %.1f s, verified and signed" % (time.time() - started))
+
+
+if __name__ == "__main__":
+    main()
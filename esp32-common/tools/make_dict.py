@@ -0,0 +1,401 @@
+#!/usr/bin/env python3
+"""
+Lumina Bridge - Payload Dictionary Trainer
+
+Builds the static dictionary the MQTT bridge compresses command and status
+payloads against (see esp32-common/src/dict_codec.h), and writes it as a
+C++ source file for the firmware.
+
+Usage:
+    python3 make_dict.py --version 2 captured.jsonl -o ../src/wled_dict_v2.cpp
+    python3 make_dict.py --version 1 --synthetic 600 -o ../src/wled_dict_v1.cpp
+
+Samples are JSON lines, one payload per line: what the backend publishes
+to lumina/{id}/command and what the bridge publishes to its status topic.
+--synthetic adds payloads generated from WLED's JSON API (state, info,
+partial state commands) and the bridge's own status messages, for when no
+captures are at hand. Every fifth sample is held out of training; the
+report compares them as JSON, MessagePack, LZ4 and LZ4 with the
+dictionary, with the firmware's own LZ4 compressor.
+
+A released version's dictionary must never change: bridges and backends
+decode with the version named in each frame. Train a new version instead
+and keep the old file in the build until nothing sends it.
+"""
+
+import argparse
+import json
+import random
+import struct
+import sys
+import time
+
+# Substrings of DMER bytes are what the trainer counts; the dictionary is
+# made of SEGMENT-byte windows rich in frequent ones (the COVER method)
+DMER = 6
+SEGMENT = 40
+DEFAULT_SIZE = 2048
+
+# Must match lz4_block.cpp
+MIN_MATCH = 4
+LAST_LITERALS = 5
+MATCH_FIND_LIMIT = 12
+TABLE_BITS = 10
+
+
+# ----------------------------------------------------------------------------
+# Synthetic samples
+# ----------------------------------------------------------------------------
+
+def wled_segment(rng, index, full):
+    length = rng.choice([30, 60, 144, 150, 300])
+    seg = {"id": index}
+    if full:
+        seg.update({"start": 0, "stop": length, "len": length, "grp": 1, "spc": 0, "of": 0})
+        seg["on"] = rng.random() < 0.9
+        seg["frz"] = False
+        seg["bri"] = rng.choice([255, 255, 128, rng.randint(1, 255)])
+        seg["cct"] = 127
+        seg["set"] = 0
+    seg["col"] = [[rng.randint(0, 255) for _ in range(3)],
+                  [0, 0, 0] if full else [rng.randint(0, 255) for _ in range(3)],
+                  [0, 0, 0]]
+    if not full and rng.random() < 0.5:
+        seg["col"] = seg["col"][:1]
+    seg["fx"] = rng.choice([0, 0, 2, 9, 28, 38, 65, rng.randint(0, 186)])
+    seg["sx"] = rng.choice([128, rng.randint(0, 255)])
+    seg["ix"] = rng.choice([128, rng.randint(0, 255)])
+    seg["pal"] = rng.choice([0, 0, 6, 11, rng.randint(0, 70)])
+    if full:
+        seg.update({"c1": 128, "c2": 128, "c3": 16, "sel": index == 0, "rev": False,
+                    "mi": False, "o1": False, "o2": False, "o3": False, "si": 0, "m12": 0})
+    return seg
+
+
+def wled_state(rng):
+    return {
+        "on": rng.random() < 0.85,
+        "bri": rng.randint(1, 255),
+        "transition": 7,
+        "ps": rng.choice([-1, -1, rng.randint(1, 16)]),
+        "pl": -1,
+        "nl": {"on": False, "dur": 60, "mode": 1, "tbri": 0, "rem": -1},
+        "udpn": {"send": False, "recv": True, "sgrp": 1, "rgrp": 1},
+        "lor": 0,
+        "mainseg": 0,
+        "seg": [wled_segment(rng, i, True) for i in range(rng.choice([1, 1, 1, 2, 3]))],
+    }
+
+
+def wled_info(rng):
+    return {
+        "ver": rng.choice(["0.14.4", "0.15.0", "0.13.3"]),
+        "vid": rng.choice([2405180, 2412100, 2208222]),
+        "leds": {"count": rng.choice([60, 150, 300]), "pwr": rng.randint(0, 4000),
+                 "fps": rng.randint(20, 60), "maxpwr": 5000, "maxseg": 32, "seglc": [1],
+                 "lc": 1, "rgbw": False, "wv": 0, "cct": 0},
+        "str": False,
+        "name": rng.choice(["WLED", "Porch", "Roofline", "Kitchen"]),
+        "udpport": 21324,
+        "live": False,
+        "liveseg": -1,
+        "lm": "",
+        "lip": "",
+        "ws": rng.randint(0, 2),
+        "fxcount": 187,
+        "palcount": 71,
+        "cpalcount": 0,
+        "wifi": {"bssid": ":".join("%02X" % rng.randint(0, 255) for _ in range(6)),
+                 "rssi": rng.randint(-85, -40), "signal": rng.randint(30, 100),
+                 "channel": rng.choice([1, 6, 11])},
+        "fs": {"u": rng.randint(8, 40), "t": 983, "pmt": 0},
+        "ndc": 0,
+        "arch": "esp32",
+        "core": "v3.3.6-16-gcc5440f6a2",
+        "lwip": 0,
+        "freeheap": rng.randint(80000, 200000),
+        "uptime": rng.randint(10, 3000000),
+        "time": "2025-%d-%d, %02d:%02d:%02d" % (rng.randint(1, 12), rng.randint(1, 28),
+                                                 rng.randint(0, 23), rng.randint(0, 59),
+                                                 rng.randint(0, 59)),
+        "opt": 79,
+        "brand": "WLED",
+        "product": "FOSS",
+        "mac": "".join("%02x" % rng.randint(0, 255) for _ in range(6)),
+        "ip": "192.168.%d.%d" % (rng.choice([0, 1, 50]), rng.randint(2, 254)),
+    }
+
+
+def partial_state(rng):
+    state = {}
+    if rng.random() < 0.6:
+        state["on"] = rng.random() < 0.8
+    if rng.random() < 0.7:
+        state["bri"] = rng.randint(1, 255)
+    if rng.random() < 0.2:
+        state["transition"] = rng.choice([0, 7, 20])
+    if rng.random() < 0.15:
+        state["ps"] = rng.randint(1, 16)
+    elif rng.random() < 0.6:
+        state["seg"] = [wled_segment(rng, i, False) for i in range(rng.choice([1, 1, 2]))]
+    return state or {"on": True}
+
+
+def command(rng):
+    action = rng.choice(["setState"] * 6 + ["applyJson"] * 2 + ["getState", "getInfo"])
+    message = {"action": action}
+    if action in ("setState", "applyJson"):
+        message["payload"] = partial_state(rng)
+    if rng.random() < 0.8:
+        message["version"] = 1735689600000 + rng.randint(0, 10 ** 10)
+    if rng.random() < 0.15:
+        message["controller"] = "wled/%06x" % rng.randint(0, 0xFFFFFF)
+    return message
+
+
+def status(rng):
+    kind = rng.random()
+    if kind < 0.35:
+        state = wled_state(rng)
+        if rng.random() < 0.5:
+            state.update({"_bridge": "esp32-mqtt", "_uptime": rng.randint(10, 10 ** 6),
+                          "_commands": rng.randint(0, 50000)})
+        return state
+    if kind < 0.55:
+        delta = partial_state(rng)
+        delta["_delta"] = True
+        return delta
+    if kind < 0.65:
+        return {"success": True}
+    if kind < 0.75:
+        return {"action": rng.choice(["setState", "applyJson"]),
+                "controller": "wled/%06x" % rng.randint(0, 0xFFFFFF), "ok": True,
+                "ackMs": rng.randint(5, 400)}
+    if kind < 0.85:
+        return {"error": rng.choice(["ERROR: HTTP 503", "ERROR: Connection refused",
+                                     "ERROR: HTTP -11", "ERROR: read Timeout"]),
+                "action": rng.choice(["setState", "getState", "getInfo"])}
+    return wled_info(rng)
+
+
+def synthetic(count, seed):
+    rng = random.Random(seed)
+    samples = []
+    for i in range(count):
+        message = command(rng) if i % 2 == 0 else status(rng)
+        samples.append(json.dumps(message, separators=(",", ":")).encode())
+    return samples
+
+
+# ----------------------------------------------------------------------------
+# Training
+# ----------------------------------------------------------------------------
+
+def dmer_counts(samples):
+    # In how many samples each d-mer occurs; a d-mer repeated within one
+    # sample is something LZ4 finds without a dictionary
+    counts = {}
+    for sample in samples:
+        for dmer in {sample[i:i + DMER] for i in range(len(sample) - DMER + 1)}:
+            counts[dmer] = counts.get(dmer, 0) + 1
+    return counts
+
+
+def best_segment(sample, counts):
+    # Highest sum of distinct d-mer counts over SEGMENT-byte windows
+    positions = len(sample) - DMER + 1
+    if positions <= 0:
+        return 0, 0
+    window = SEGMENT - DMER + 1
+    active = {}
+    score = best = best_at = 0
+    for i in range(positions):
+        dmer = sample[i:i + DMER]
+        active[dmer] = active.get(dmer, 0) + 1
+        if active[dmer] == 1:
+            score += counts.get(dmer, 0)
+        if i >= window:
+            old = sample[i - window:i - window + DMER]
+            active[old] -= 1
+            if active[old] == 0:
+                score -= counts.get(old, 0)
+        if score > best:
+            best, best_at = score, max(0, i - window + 1)
+    return best, best_at
+
+
+def train(samples, size):
+    counts = dmer_counts(samples)
+    segments = []
+    used = 0
+    # Greedy: the best window in the corpus, then its d-mers count for
+    # nothing, until the dictionary is full
+    candidates = sorted(set(samples), key=len, reverse=True)
+    while used < size:
+        best = None
+        for sample in candidates:
+            score, at = best_segment(sample, counts)
+            if score > 0 and (best is None or score > best[0]):
+                best = (score, sample[at:at + SEGMENT])
+        if best is None:
+            break
+        segment = best[1][:size - used]
+        for i in range(len(segment) - DMER + 1):
+            counts[segment[i:i + DMER]] = 0
+        segments.append(segment)
+        used += len(segment)
+    # Best last: LZ4 offsets cost the same at any distance, but the primed
+    # hash table keeps the later of two colliding entries
+    return b"".join(reversed(segments))
+
+
+# ----------------------------------------------------------------------------
+# Evaluation (the firmware's compressor, for identical sizes)
+# ----------------------------------------------------------------------------
+
+def hash_of(sequence):
+    return ((sequence * 2654435761) & 0xFFFFFFFF) >> (32 - TABLE_BITS)
+
+
+def lz4_compress(data, dictionary=b""):
+    window = dictionary + data
+    base = len(dictionary)
+    table = [0] * (1 << TABLE_BITS)
+    for i in range(len(dictionary) - MIN_MATCH + 1):
+        table[hash_of(struct.unpack_from("<I", dictionary, i)[0])] = i
+    out = 0
+    anchor = 0
+
+    def sequence_size(literals, match):
+        size = 1 + literals + (literals - 15) // 255 + 1 if literals >= 15 else 1 + literals
+        if match:
+            size += 2
+            if match - MIN_MATCH >= 15:
+                size += (match - MIN_MATCH - 15) // 255 + 1
+        return size
+
+    length = len(data)
+    if length > MATCH_FIND_LIMIT:
+        match_limit = length - LAST_LITERALS
+        ip = 0
+        while ip + MATCH_FIND_LIMIT < length:
+            sequence = struct.unpack_from("<I", data, ip)[0]
+            h = hash_of(sequence)
+            ref = table[h]
+            table[h] = (base + ip) & 0xFFFF
+            if ref >= base + ip or window[ref:ref + 4] != data[ip:ip + 4]:
+                ip += 1
+                continue
+            match = MIN_MATCH
+            while ip + match < match_limit and window[ref + match] == data[ip + match]:
+                match += 1
+            out += sequence_size(ip - anchor, match)
+            ip += match
+            anchor = ip
+    return out + sequence_size(length - anchor, 0)
+
+
+def msgpack_size(value):
+    # Bytes ArduinoJson's serializeMsgPack() gives for the same document
+    if value is None or isinstance(value, bool):
+        return 1
+    if isinstance(value, int):
+        if -32 <= value <= 127:
+            return 1
+        for limit, size in ((0xFF, 2), (0xFFFF, 3), (0xFFFFFFFF, 5)):
+            if (0 <= value <= limit) or (value < 0 and -value <= (limit + 1) // 2):
+                return size
+        return 9
+    if isinstance(value, float):
+        return 5 if struct.unpack("<f", struct.pack("<f", value))[0] == value else 9
+    if isinstance(value, str):
+        n = len(value.encode())
+        return n + (1 if n < 32 else 2 if n < 256 else 3 if n < 65536 else 5)
+    header = 1 if len(value) < 16 else 3
+    if isinstance(value, list):
+        return header + sum(msgpack_size(v) for v in value)
+    return header + sum(msgpack_size(k) + msgpack_size(v) for k, v in value.items())
+
+
+def report(samples, dictionary):
+    totals = {"json": 0, "msgpack": 0, "lz4": 0, "dict": 0}
+    started = time.time()
+    for sample in samples:
+        totals["json"] += len(sample)
+        totals["msgpack"] += msgpack_size(json.loads(sample))
+        totals["lz4"] += lz4_compress(sample)
+        # dict_codec.h frame: magic, version, raw length
+        totals["dict"] += 4 + lz4_compress(sample, dictionary)
+    print("held out  %d samples, %.0f bytes mean JSON" % (len(samples),
+                                                           totals["json"] / len(samples)))
+    for name in ("json", "msgpack", "lz4", "dict"):
+        print("  %-8s %8d bytes  %5.1f%% of JSON" % (name, totals[name],
+                                                     100.0 * totals[name] / totals["json"]))
+    print("evaluated in %.1f s" % (time.time() - started))
+
+
+# ----------------------------------------------------------------------------
+# Output
+# ----------------------------------------------------------------------------
+
+def write_source(path, dictionary, version, sources):
+    lines = []
+    for i in range(0, len(dictionary), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in dictionary[i:i + 16]) + ",")
+    with open(path, "w") as f:
+        f.write("/**\n")
+        f.write(" * Lumina Bridge Common - Payload Dictionary, Version %d\n" % version)
+        f.write(" *\n")
+        f.write(" * Generated by tools/make_dict.py from %s.\n" % sources)
+        f.write(" * Do not edit: frames name this version, so its bytes are fixed.\n")
+        f.write(" */\n\n")
+        f.write("#include \"dict_codec.h\"\n\n")
+        f.write("extern const uint8_t WLED_DICT_V%d[] = {\n" % version)
+        f.write("\n".join(lines) + "\n")
+        f.write("};\n")
+        f.write("extern const size_t WLED_DICT_V%d_LEN = sizeof(WLED_DICT_V%d);\n"
+                % (version, version))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Train a Lumina bridge payload dictionary")
+    parser.add_argument("samples", nargs="*", help="JSON lines files of captured payloads")
+    parser.add_argument("--version", type=int, required=True, help="dictionary version (1-255)")
+    parser.add_argument("-o", "--output", help="C++ source to write")
+    parser.add_argument("--size", type=int, default=DEFAULT_SIZE,
+                        help="dictionary bytes (default %d)" % DEFAULT_SIZE)
+    parser.add_argument("--synthetic", type=int, default=0,
+                        help="add this many generated WLED payloads")
+    parser.add_argument("--seed", type=int, default=1, help="for --synthetic")
+    args = parser.parse_args()
+
+    if not 1 <= args.version <= 255:
+        parser.error("--version must be 1-255")
+    samples = []
+    for path in args.samples:
+        with open(path, "rb") as f:
+            samples.extend(line.strip() for line in f if line.strip())
+    samples.extend(synthetic(args.synthetic, args.seed))
+    if len(samples) < 10:
+        parser.error("need at least 10 samples (files or --synthetic)")
+
+    held_out = samples[4::5]
+    training = [s for i, s in enumerate(samples) if i % 5 != 4]
+
+    started = time.time()
+    dictionary = train(training, args.size)
+    print("dictionary %d bytes from %d samples in %.1f s" % (len(dictionary), len(training),
+                                                             time.time() - started))
+    report(held_out, dictionary)
+
+    if args.output:
+        sources = ", ".join(args.samples) if args.samples else ""
+        if args.synthetic:
+            generated = "%d generated payloads (seed %d)" % (args.synthetic, args.seed)
+            sources = sources + " and " + generated if sources else generated
+        write_source(args.output, dictionary, args.version, sources)
+        print("wrote %s" % args.output)
+
+
+if __name__ == "__main__":
+    main()
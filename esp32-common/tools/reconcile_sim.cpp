@@ -0,0 +1,314 @@
+/**
+ * Lumina Bridge Common - Reconciliation Simulation
+ *
+ * Drives one simulated WLED controller for an hour of commands and
+ * compares fire-and-forget forwarding (the bridges before Reconciler: one
+ * POST per command, a newer queued command replacing an older one, no
+ * retry) with Reconciler.
+ *
+ * The controller answers after --latency ms, fails --loss percent of
+ * requests, reboots every --reboot s (offline 8 s, then its boot state and
+ * a fresh uptime), and every --local s someone changes one setting at the
+ * controller itself. That change is wanted: it becomes part of the state
+ * to hold until the next command for that setting. Commands: a brightness slider drag (20 updates 50 ms
+ * apart) every 30 s and a four-setting scene every 20 s.
+ *
+ * Convergence is judged from outside: the controller's state against what
+ * it should be (every command and local change so far, merged). A change
+ * converges when they match again.
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -I../src reconcile_sim.cpp ../src/reconciler.cpp \
+ *       ../src/reconnect_backoff.cpp -o reconcile_sim
+ *   ./reconcile_sim --loss 5 --reboot 600 --local 90
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "reconciler.h"
+
+struct Options {
+  int seconds = 3600;
+  int latencyMs = 40;
+  int lossPercent = 5;
+  int rebootSec = 600;
+  int localSec = 90;
+  int settleMs = 50;
+  int auditMs = 15000;
+};
+
+typedef std::map<std::string, std::string> State;
+
+static uint32_t rng = 12345;
+static uint32_t randomBelow(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng % n;
+}
+
+static State bootState() {
+  return {{"on", "true"}, {"bri", "128"}, {"seg.0.fx", "0"}, {"seg.0.sx", "128"},
+          {"seg.0.pal", "0"}, {"seg.0.col", "[[255,160,0]]"}};
+}
+
+struct Controller {
+  State state = bootState();
+  uint32_t bootedAt = 0;
+  uint32_t offlineUntil = 0;
+  uint32_t requests = 0;
+
+  bool online(uint32_t now) const { return (int32_t)(now - offlineUntil) >= 0; }
+  uint32_t uptimeSec(uint32_t now) const { return (now - bootedAt) / 1000 + 1; }
+};
+
+// A command: settings the app sent at `at`
+struct Command {
+  uint32_t at;
+  State settings;
+};
+
+static std::vector<Command> workload(const Options& opt) {
+  std::vector<Command> commands;
+  static const char* const COLORS[] = {"[[255,0,0]]", "[[0,255,0]]", "[[0,0,255]]",
+                                       "[[255,160,0]]"};
+  for (uint32_t t = 5000; t < (uint32_t)opt.seconds * 1000; t += 20000) {
+    commands.push_back({t,
+                        {{"on", "true"},
+                         {"seg.0.fx", std::to_string(randomBelow(100))},
+                         {"seg.0.pal", std::to_string(randomBelow(50))},
+                         {"seg.0.col", COLORS[randomBelow(4)]}}});
+  }
+  for (uint32_t t = 12000; t < (uint32_t)opt.seconds * 1000; t += 30000) {
+    for (int i = 0; i < 20; i++) {
+      commands.push_back({t + i * 50, {{"bri", std::to_string(20 + i * 10)}}});
+    }
+  }
+  std::sort(commands.begin(), commands.end(),
+            [](const Command& a, const Command& b) { return a.at < b.at; });
+  return commands;
+}
+
+struct Result {
+  uint32_t commands;
+  uint32_t requests;
+  uint32_t changes;      // Times the desired state moved away from the actual one
+  uint32_t converged;
+  std::vector<uint32_t> convergeMs;
+  uint64_t divergedMs;
+};
+
+// The controller, the cloud's idea of it, and what an observer measures.
+// Each run steps it 1 ms at a time.
+struct World {
+  Options opt;
+  Controller controller;
+  State desired;  // Commands and local changes, merged
+  Result result = {};
+  bool diverged = false;
+  uint32_t divergedAt = 0;
+
+  bool matches() const {
+    for (const auto& kv : desired) {
+      auto it = controller.state.find(kv.first);
+      if (it == controller.state.end() || it->second != kv.second) return false;
+    }
+    return true;
+  }
+
+  void events(uint32_t now) {
+    if (opt.rebootSec > 0 && now > 0 && now % (opt.rebootSec * 1000) == 0) {
+      controller.offlineUntil = now + 8000;
+      controller.bootedAt = now + 8000;
+      controller.state = bootState();
+    }
+    if (opt.localSec > 0 && now > 0 && now % (opt.localSec * 1000) == 7000 % (opt.localSec * 1000)) {
+      controller.state["seg.0.fx"] = std::to_string(100 + randomBelow(50));
+      desired["seg.0.fx"] = controller.state["seg.0.fx"];
+    }
+  }
+
+  void track(uint32_t now) {
+    bool match = matches();
+    if (!match && !diverged) {
+      diverged = true;
+      divergedAt = now;
+      result.changes++;
+    } else if (match && diverged) {
+      diverged = false;
+      result.converged++;
+      result.convergeMs.push_back(now - divergedAt);
+    }
+    if (diverged) result.divergedMs++;
+  }
+
+  // One request from the bridge; false if it failed
+  bool request(uint32_t now) {
+    controller.requests++;
+    result.requests++;
+    return controller.online(now) && randomBelow(100) >= (uint32_t)opt.lossPercent;
+  }
+};
+
+// ============================================================================
+// Fire and Forget
+// ============================================================================
+
+static Result runForward(const Options& opt, const std::vector<Command>& commands) {
+  World world;
+  world.opt = opt;
+  size_t nextCommand = 0;
+  bool queued = false;
+  State queuedSettings;
+  bool inFlight = false;
+  uint32_t doneAt = 0;
+  bool ok = false;
+  State sending;
+
+  for (uint32_t now = 0; now < (uint32_t)opt.seconds * 1000; now++) {
+    world.events(now);
+    while (nextCommand < commands.size() && commands[nextCommand].at == now) {
+      for (const auto& kv : commands[nextCommand].settings) world.desired[kv.first] = kv.second;
+      // A newer state write replaces the queued one
+      if (queued) {
+        for (const auto& kv : commands[nextCommand].settings) queuedSettings[kv.first] = kv.second;
+      } else {
+        queuedSettings = commands[nextCommand].settings;
+        queued = true;
+      }
+      nextCommand++;
+    }
+    if (inFlight && now >= doneAt) {
+      if (ok) {
+        for (const auto& kv : sending) world.controller.state[kv.first] = kv.second;
+      }
+      inFlight = false;
+    }
+    if (!inFlight && queued) {
+      sending = queuedSettings;
+      queued = false;
+      ok = world.request(now);
+      inFlight = true;
+      doneAt = now + opt.latencyMs;
+    }
+    world.track(now);
+  }
+  world.result.requests = world.controller.requests;
+  world.result.commands = commands.size();
+  return world.result;
+}
+
+// ============================================================================
+// Reconciler
+// ============================================================================
+
+static Result runReconciler(const Options& opt, const std::vector<Command>& commands) {
+  World world;
+  world.opt = opt;
+  Reconciler reconciler(opt.settleMs, opt.auditMs, 500, 10000);
+  int c = reconciler.controller("192.168.1.50", true);
+  size_t nextCommand = 0;
+  ReconcileAction inFlight = RECONCILE_NONE;
+  uint32_t doneAt = 0;
+  bool ok = false;
+
+  for (uint32_t now = 0; now < (uint32_t)opt.seconds * 1000; now++) {
+    world.events(now);
+    while (nextCommand < commands.size() && commands[nextCommand].at == now) {
+      for (const auto& kv : commands[nextCommand].settings) {
+        world.desired[kv.first] = kv.second;
+        reconciler.setDesired(c, kv.first.c_str(), kv.second.c_str(), false, now);
+      }
+      nextCommand++;
+    }
+
+    if (inFlight != RECONCILE_NONE && now >= doneAt) {
+      Controller& controller = world.controller;
+      if (ok && inFlight == RECONCILE_APPLY) {
+        // WLED applies the sent entries and answers with its full state
+        for (size_t i = 0; i < reconciler.entryCount(c); i++) {
+          const ReconcileEntry& entry = reconciler.entry(c, i);
+          if (entry.sending) controller.state[entry.path] = entry.value;
+        }
+        for (const auto& kv : controller.state) {
+          reconciler.actualValue(c, kv.first.c_str(), kv.second.c_str());
+        }
+        reconciler.finishApply(c, true, now);
+      } else if (ok) {
+        reconciler.auditUptime(c, controller.uptimeSec(now));
+        for (const auto& kv : controller.state) {
+          reconciler.actualValue(c, kv.first.c_str(), kv.second.c_str());
+        }
+        reconciler.finishAudit(c, true, now);
+      } else if (inFlight == RECONCILE_APPLY) {
+        reconciler.finishApply(c, false, now);
+      } else {
+        reconciler.finishAudit(c, false, now);
+      }
+      inFlight = RECONCILE_NONE;
+    }
+
+    int next;
+    if (inFlight == RECONCILE_NONE) {
+      inFlight = reconciler.next(now, next);
+      if (inFlight != RECONCILE_NONE) {
+        ok = world.request(now);
+        doneAt = now + opt.latencyMs;
+      }
+    }
+    world.track(now);
+  }
+  world.result.requests = world.controller.requests;
+  world.result.commands = commands.size();
+
+  const ReconcileStats& stats = reconciler.stats();
+  printf("  reconciler: %u applies, %u audits, %u failures, %u reboots, %u drifts\n",
+         stats.applies, stats.audits, stats.failures, stats.reboots, stats.drifts);
+  return world.result;
+}
+
+static void report(const char* name, Result& r, const Options& opt) {
+  std::sort(r.convergeMs.begin(), r.convergeMs.end());
+  uint32_t p50 = r.convergeMs.empty() ? 0 : r.convergeMs[r.convergeMs.size() / 2];
+  uint32_t p99 = r.convergeMs.empty() ? 0 : r.convergeMs[r.convergeMs.size() * 99 / 100];
+  printf("%-18s %8u %8.2f %8u %9u %10.2f %6ums %6ums %8.2f%%\n", name, r.requests,
+         (double)r.requests / r.commands, r.changes, r.converged,
+         r.converged > 0 ? (double)r.requests / r.converged : 0.0, p50, p99,
+         100.0 * r.divergedMs / (opt.seconds * 1000.0));
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--seconds") == 0) opt.seconds = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--latency") == 0) opt.latencyMs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--loss") == 0) opt.lossPercent = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--reboot") == 0) opt.rebootSec = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--local") == 0) opt.localSec = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--settle") == 0) opt.settleMs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--audit") == 0) opt.auditMs = atoi(argv[i + 1]);
+  }
+
+  std::vector<Command> commands = workload(opt);
+  printf("%u commands over %d s; %d ms latency, %d%% loss, reboot every %d s, local change "
+         "every %d s\n\n",
+         (unsigned)commands.size(), opt.seconds, opt.latencyMs, opt.lossPercent, opt.rebootSec,
+         opt.localSec);
+
+  Result forward = runForward(opt, commands);
+  Result reconciled = runReconciler(opt, commands);
+
+  printf("\n%-18s %8s %8s %8s %9s %10s %8s %8s %9s\n", "bridge", "requests", "per cmd",
+         "changes", "converged", "per change", "p50", "p99", "diverged");
+  report("fire and forget", forward, opt);
+  report("reconciler", reconciled, opt);
+  return 0;
+}
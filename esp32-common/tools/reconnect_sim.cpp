@@ -0,0 +1,149 @@
+/**
+ * Lumina Bridge Common - Fleet Reconnect Simulation
+ *
+ * Simulates a fleet of bridges losing the cloud at the same moment and
+ * compares the fixed retry schedule the bridges used to have with
+ * ReconnectBackoff. The cloud is down for --outage seconds, then accepts
+ * at most --capacity connection attempts per second; attempts over that
+ * fail as if refused, which is what turns a synchronised fleet into a
+ * storm.
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -I../src reconnect_sim.cpp ../src/reconnect_backoff.cpp -o reconnect_sim
+ *   ./reconnect_sim --bridges 1000 --outage 120 --capacity 100
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "reconnect_backoff.h"
+
+struct Options {
+  int bridges = 1000;
+  int outageSec = 120;
+  int capacityPerSec = 100;
+  int simulateSec = 900;
+};
+
+struct Schedule {
+  const char* name;
+  uint32_t fixedMs;   // Fixed retry interval; 0 = ReconnectBackoff
+  uint32_t baseMs;
+  uint32_t capMs;
+  uint32_t spreadMs;
+};
+
+struct Result {
+  int peakPerSec;          // Most attempts in one second after the outage
+  int peakDuringOutage;    // Most attempts in one second during it
+  long attempts;           // All attempts
+  double allBackSec;       // Seconds after recovery until every bridge is connected
+  double p99BackSec;
+};
+
+static const uint32_t STEP_MS = 10;
+
+static Result simulate(const Options& opt, const Schedule& schedule) {
+  std::vector<ReconnectBackoff> backoff;
+  std::vector<uint32_t> nextAt(opt.bridges);
+  std::vector<bool> connected(opt.bridges, false);
+  std::vector<uint32_t> loopPhase(opt.bridges);
+
+  srand(42);
+  for (int i = 0; i < opt.bridges; i++) {
+    backoff.push_back(ReconnectBackoff(schedule.baseMs, schedule.capMs, schedule.spreadMs));
+    char id[48];
+    snprintf(id, sizeof(id), "%08x-%04x-bridge-%d", rand(), rand() & 0xffff, i);
+    backoff[i].begin(id, rand());
+    loopPhase[i] = rand() % STEP_MS;  // Where each bridge's loop() falls in a step
+
+    // Every bridge notices the loss at t = 0
+    if (schedule.fixedMs > 0) {
+      nextAt[i] = 0;
+    } else {
+      backoff[i].failed(0);
+    }
+  }
+
+  uint32_t outageMs = opt.outageSec * 1000;
+  uint32_t endMs = opt.simulateSec * 1000;
+  std::vector<int> attemptsPerSec(opt.simulateSec + 1, 0);
+  Result result = {};
+  int back = 0;
+  int p99 = (opt.bridges * 99 + 99) / 100;
+
+  for (uint32_t now = 0; now < endMs && back < opt.bridges; now += STEP_MS) {
+    int second = now / 1000;
+    for (int i = 0; i < opt.bridges; i++) {
+      if (connected[i]) continue;
+      uint32_t t = now + loopPhase[i];
+      bool due = schedule.fixedMs > 0 ? t >= nextAt[i] : backoff[i].due(t);
+      if (!due) continue;
+
+      result.attempts++;
+      bool accepted = now >= outageMs && attemptsPerSec[second] < opt.capacityPerSec;
+      attemptsPerSec[second]++;
+
+      if (accepted) {
+        connected[i] = true;
+        back++;
+        double since = (now - outageMs) / 1000.0;
+        if (back == p99) result.p99BackSec = since;
+        if (back == opt.bridges) result.allBackSec = since;
+      } else if (schedule.fixedMs > 0) {
+        nextAt[i] = t + schedule.fixedMs;
+      } else {
+        backoff[i].failed(t);
+      }
+    }
+  }
+
+  for (int s = 0; s <= opt.simulateSec; s++) {
+    int n = attemptsPerSec[s];
+    if (s < opt.outageSec) {
+      if (n > result.peakDuringOutage) result.peakDuringOutage = n;
+    } else if (n > result.peakPerSec) {
+      result.peakPerSec = n;
+    }
+  }
+  if (back < opt.bridges) result.allBackSec = -1;
+  return result;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--bridges") == 0) opt.bridges = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--outage") == 0) opt.outageSec = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--capacity") == 0) opt.capacityPerSec = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--seconds") == 0) opt.simulateSec = atoi(argv[i + 1]);
+  }
+
+  // Mirrors the bridges' config.h defaults
+  const Schedule schedules[] = {
+      {"mqtt fixed 5 s", 5000, 0, 0, 0},
+      {"mqtt backoff", 0, 2000, 30000, 30000},
+      {"poll fixed 2 s", 2000, 0, 0, 0},
+      {"poll backoff", 0, 2000, 30000, 10000},
+  };
+
+  printf("%d bridges, %d s outage, cloud accepts %d attempts/s\n\n", opt.bridges,
+         opt.outageSec, opt.capacityPerSec);
+  printf("%-16s %12s %12s %10s %10s %10s\n", "schedule", "peak/s after", "peak/s during",
+         "attempts", "p99 back", "all back");
+  for (const Schedule& schedule : schedules) {
+    Result r = simulate(opt, schedule);
+    printf("%-16s %12d %12d %10ld %9.1fs ", schedule.name, r.peakPerSec, r.peakDuringOutage,
+           r.attempts, r.p99BackSec);
+    if (r.allBackSec < 0) {
+      printf("%10s\n", "never");
+    } else {
+      printf("%9.1fs\n", r.allBackSec);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,364 @@
+/**
+ * Lumina Bridge Common - State Store Simulation
+ *
+ * Runs StateStore on simulated NOR flash: 4 KB sectors that read back
+ * 0xFF after an erase, and a write that can only clear bits.
+ *
+ * Power loss: each cycle cuts the power after a random number of bytes
+ * programmed or partway into an erase. The byte at the cut gets a random
+ * part of its bits. So do a few random bytes later in the same 256-byte
+ * page, since a page program does not set its bytes in order. An erase
+ * cut short leaves its sector with random bits set. The store is then
+ * recovered on the same flash and must hold exactly what it held after
+ * one of two points:
+ * - the last commit that returned
+ * - the commit that was under way
+ * Anything else, a lost or half-applied batch or a resurrected value,
+ * counts as a failure. The workload continues on the recovered store,
+ * so appends after a recovery are checked too.
+ *
+ * Timing: flash costs come from typical W25Q32 SPI NOR figures. A page
+ * program is 0.4 ms, a sector erase 45 ms, and a read 10 us plus
+ * 0.1 us a byte. benchMicros() is defined here as that modeled clock, so
+ * the store's own commit and recovery timings come out in flash time.
+ *
+ * Build and run on a host:
+ *
+ *   g++ -O2 -std=c++11 -I../src state_store_sim.cpp ../src/state_store.cpp \
+ *       ../src/latency_stats.cpp -o state_store_sim
+ *   ./state_store_sim --cycles 2000 --sectors 8
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "state_store.h"
+
+struct Options {
+  int cycles = 2000;
+  int sectors = 8;
+  int keys = 40;
+  uint32_t seed = 12345;
+};
+
+static uint32_t rng = 12345;
+static uint32_t randomBelow(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng % n;
+}
+
+static const uint32_t PAGE_PROGRAM_US = 400;
+static const uint32_t SECTOR_ERASE_US = 45000;
+static const size_t PAGE = 256;
+
+static uint64_t flashClock = 0;
+
+uint64_t benchMicros() { return flashClock; }
+
+class SimFlash : public StateFlash {
+ public:
+  SimFlash(size_t sectors) : data_(sectors * 4096, 0xFF), cutAt_(0), dead_(false) {}
+
+  size_t sectorSize() const override { return 4096; }
+  size_t sectorCount() const override { return data_.size() / 4096; }
+
+  bool read(size_t address, void* out, size_t length) override {
+    if (dead_ || address + length > data_.size()) return false;
+    memcpy(out, &data_[address], length);
+    flashClock += 10 + length / 10;
+    return true;
+  }
+
+  bool write(size_t address, const void* data, size_t length) override {
+    if (dead_ || address + length > data_.size()) return false;
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+      if (cutAt_ > 0 && --cutAt_ == 0) {
+        // Part of this byte, and stray bytes later in its page
+        data_[address + i] &= bytes[i] | (uint8_t)randomBelow(256);
+        size_t pageEnd = (address + i) / PAGE * PAGE + PAGE;
+        for (size_t j = address + i + 1; j < address + length && j < pageEnd; j++) {
+          if (randomBelow(4) == 0) data_[j] &= bytes[j - address] | (uint8_t)randomBelow(256);
+        }
+        dead_ = true;
+        return false;
+      }
+      data_[address + i] &= bytes[i];
+      programmed++;
+    }
+    flashClock += ((address + length - 1) / PAGE - address / PAGE + 1) * PAGE_PROGRAM_US;
+    return true;
+  }
+
+  bool erase(size_t sector) override {
+    if (dead_ || sector >= sectorCount()) return false;
+    uint8_t* begin = &data_[sector * 4096];
+    if (cutErase_) {
+      for (size_t i = 0; i < 4096; i++) begin[i] |= (uint8_t)randomBelow(256);
+      dead_ = true;
+      return false;
+    }
+    memset(begin, 0xFF, 4096);
+    flashClock += SECTOR_ERASE_US;
+    erases++;
+    return true;
+  }
+
+  // Power fails at the `bytes`th byte programmed from now, or at the next
+  // erase if `erase`
+  void cutAfter(uint32_t bytes, bool erase) {
+    cutAt_ = erase ? 0 : bytes;
+    cutErase_ = erase;
+  }
+  void powerOn() {
+    cutAt_ = 0;
+    cutErase_ = false;
+    dead_ = false;
+  }
+  bool dead() const { return dead_; }
+
+  uint64_t programmed = 0;
+  uint64_t erases = 0;
+
+ private:
+  std::vector<uint8_t> data_;
+  uint32_t cutAt_;
+  bool cutErase_ = false;
+  bool dead_;
+};
+
+typedef std::map<std::string, std::string> Model;
+
+// A change: value, or removal when `remove`
+struct Change {
+  std::string key;
+  std::string value;
+  bool remove;
+};
+
+static void applyChanges(Model& model, const std::vector<Change>& changes) {
+  for (const Change& change : changes) {
+    if (change.remove) {
+      model.erase(change.key);
+    } else {
+      model[change.key] = change.value;
+    }
+  }
+}
+
+static Model readBack(StateStore& store, int keys) {
+  Model model;
+  char key[16];
+  char value[STATE_VALUE_MAX];
+  for (int i = 0; i < keys; i++) {
+    snprintf(key, sizeof(key), "key/%02d", i);
+    int length = store.get(key, value, sizeof(value));
+    if (length >= 0) model[key] = std::string(value, length);
+  }
+  return model;
+}
+
+static std::string randomValue() {
+  std::string value(1 + randomBelow(60), ' ');
+  for (char& c : value) c = 'a' + randomBelow(26);
+  return value;
+}
+
+// ============================================================================
+// Power Loss
+// ============================================================================
+
+static bool powerLoss(const Options& opt) {
+  SimFlash flash(opt.sectors);
+  StateStore* store = new StateStore(500, UINT32_MAX);
+  uint32_t now = 0;
+  store->begin(flash, now);
+
+  Model committed;
+  std::vector<Change> pending;  // Staged since the last commit
+  int failures = 0, recoveries = 0, inFlight = 0, cutInErase = 0;
+  uint64_t tornSeen = 0;
+
+  for (int cycle = 0; cycle < opt.cycles; cycle++) {
+    bool erase = randomBelow(10) == 0;
+    flash.cutAfter(1 + randomBelow(6000), erase);
+    cutInErase += erase;
+
+    // Run until the power fails
+    for (int op = 0; op < 5000 && !flash.dead(); op++) {
+      now += randomBelow(300);
+      uint32_t commits = store->stats().commits;
+      Change change;
+      if (randomBelow(5) < 4) {
+        char key[16];
+        snprintf(key, sizeof(key), "key/%02d", (int)randomBelow(opt.keys));
+        change.key = key;
+        change.remove = randomBelow(8) == 0;
+        if (!change.remove) change.value = randomValue();
+        bool ok = change.remove
+                      ? store->remove(change.key.c_str(), now)
+                      : store->put(change.key.c_str(), change.value.data(), change.value.size(),
+                                   now);
+        if (store->stats().commits != commits) {
+          // Committed what was staged before this change
+          applyChanges(committed, pending);
+          pending.clear();
+        }
+        if (ok) pending.push_back(change);
+      } else {
+        store->step(now, randomBelow(2) == 0);
+        if (store->stats().commits != commits) {
+          applyChanges(committed, pending);
+          pending.clear();
+        }
+      }
+    }
+    if (!flash.dead()) continue;
+
+    // Power back: a fresh store on the same flash
+    flash.powerOn();
+    delete store;
+    store = new StateStore(500, UINT32_MAX);
+    if (!store->begin(flash, now)) {
+      printf("cycle %d: recovery failed\n", cycle);
+      failures++;
+      break;
+    }
+    recoveries++;
+    tornSeen += store->stats().tornBatches;
+
+    Model recovered = readBack(*store, opt.keys);
+    Model withPending = committed;
+    applyChanges(withPending, pending);
+    if (recovered == committed) {
+      // The batch under way was lost whole
+    } else if (!pending.empty() && recovered == withPending) {
+      committed = withPending;  // It had landed whole
+      inFlight++;
+    } else {
+      failures++;
+      if (failures <= 3) {
+        printf("cycle %d: recovered %u keys, expected %u (or %u)\n", cycle,
+               (unsigned)recovered.size(), (unsigned)committed.size(),
+               (unsigned)withPending.size());
+      }
+      committed = recovered;
+    }
+    pending.clear();
+  }
+
+  printf("power loss: %d cuts (%d during an erase), %d recovered, %d failures\n",
+         opt.cycles, cutInErase, recoveries, failures);
+  printf("  batch under way landed whole %d times; torn batches skipped %llu times over all recoveries\n",
+         inFlight, (unsigned long long)tornSeen);
+  printf("  final store: %u keys, %u live bytes of %u, %u free sectors\n\n",
+         (unsigned)store->keyCount(), (unsigned)store->liveBytes(),
+         (unsigned)store->capacityBytes(), (unsigned)store->freeSectors());
+  delete store;
+  return failures == 0;
+}
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+// One command every `everyMs` for a day: a journal slot (about 60 bytes,
+// 32 slots in turn) and a cursor, the writes a bridge makes per command
+static void writeLoad(const char* name, const Options& opt, uint32_t commitMs, uint32_t everyMs,
+                      bool idle, uint32_t dailyBytes) {
+  SimFlash flash(opt.sectors);
+  StateStore store(commitMs, dailyBytes);
+  store.begin(flash, 0);
+  std::vector<uint32_t> commitUs;
+  uint32_t rejected = 0;
+  uint32_t slot = 0;
+  uint32_t next = 0;
+  char key[16];
+
+  for (uint32_t now = 0; now < 24UL * 3600 * 1000; now += 10) {
+    if (now >= next) {
+      next = now + everyMs;
+      snprintf(key, sizeof(key), "done/%02u", (unsigned)(slot++ % 32));
+      std::string value = "c" + std::to_string(slot) + "/" + randomValue();
+      if (!store.put(key, value.data(), value.size(), now)) rejected++;
+      std::string cursor = std::to_string(now);
+      if (!store.put("cursor", cursor.data(), cursor.size(), now)) rejected++;
+    }
+    uint32_t commits = store.stats().commits;
+    uint64_t started = flashClock;
+    if (commitMs == 0) {
+      store.sync(now);
+    } else {
+      store.step(now, false);
+    }
+    if (store.stats().commits != commits) commitUs.push_back((uint32_t)(flashClock - started));
+    // Compaction between commands, when the bridge would be idle
+    if (idle && now + 10 < next) store.step(now, true);
+  }
+
+  std::sort(commitUs.begin(), commitUs.end());
+  auto pct = [&commitUs](int p) -> double {
+    if (commitUs.empty()) return 0;
+    return commitUs[std::min(commitUs.size() - 1, commitUs.size() * p / 100)] / 1000.0;
+  };
+  const StateStoreStats& stats = store.stats();
+  printf("%-26s %7u %9llu %6llu %7.1f %7.1f %7.1f %8u %8u\n", name, (unsigned)stats.commits,
+         (unsigned long long)flash.programmed, (unsigned long long)flash.erases, pct(50), pct(99),
+         pct(100), (unsigned)stats.maxEraseCount, (unsigned)(stats.coalesced + rejected));
+}
+
+static void recoveryTime(const Options& opt) {
+  SimFlash flash(opt.sectors);
+  StateStore store(0, UINT32_MAX);
+  store.begin(flash, 0);
+  char key[16];
+  // Full of live keys and overwritten history, every sector in use
+  for (uint32_t i = 0; i < 4000; i++) {
+    snprintf(key, sizeof(key), "key/%02u", (unsigned)(i % opt.keys));
+    std::string value = randomValue();
+    store.put(key, value.data(), value.size(), i);
+    if (i % 3 == 0) store.sync(i);
+  }
+  store.sync(4000);
+
+  StateStore recovered(0, UINT32_MAX);
+  recovered.begin(flash, 0);
+  printf("recovery: %u sectors (%u in use), %u keys, %u live bytes: %.1f ms modeled\n",
+         (unsigned)opt.sectors, (unsigned)(opt.sectors - recovered.freeSectors()),
+         (unsigned)recovered.keyCount(), (unsigned)recovered.liveBytes(),
+         recovered.stats().recoveryMicros / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--cycles") == 0) opt.cycles = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--sectors") == 0) opt.sectors = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--keys") == 0) opt.keys = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--seed") == 0) opt.seed = strtoul(argv[i + 1], nullptr, 10);
+  }
+  rng = opt.seed;
+
+  bool ok = powerLoss(opt);
+
+  printf("a day of commands, %d sectors; commit times in modeled ms\n", opt.sectors);
+  printf("%-26s %7s %9s %6s %7s %7s %7s %8s %8s\n", "schedule", "commits", "programmed",
+         "erases", "p50", "p99", "max", "maxwear", "merged");
+  writeLoad("1/s, commit each", opt, 0, 1000, false, UINT32_MAX);
+  writeLoad("1/s, group 500 ms", opt, 500, 1000, false, UINT32_MAX);
+  writeLoad("1/s, group 5 s", opt, 5000, 1000, false, UINT32_MAX);
+  writeLoad("1/s, group 5 s, idle gc", opt, 5000, 1000, true, UINT32_MAX);
+  writeLoad("10/s, group 500 ms", opt, 500, 100, true, UINT32_MAX);
+  writeLoad("10/s, 500 ms, 256 KB/day", opt, 500, 100, true, 256 * 1024);
+  printf("\n");
+  recoveryTime(opt);
+  return ok ? 0 : 1;
+}
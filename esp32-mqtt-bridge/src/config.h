@@ -66,6 +66,15 @@
 
 #define MQTT_TOPIC_COMMAND "lumina/" DEVICE_ID "/command"
 #define MQTT_TOPIC_STATUS "lumina/" DEVICE_ID "/status"
+#define MQTT_TOPIC_STATUS_MSGPACK "lumina/" DEVICE_ID "/status/msgpack"
+#define MQTT_TOPIC_STATUS_DICT "lumina/" DEVICE_ID "/status/lz4d"
+#define MQTT_TOPIC_USAGE "lumina/" DEVICE_ID "/usage"
+#define MQTT_TOPIC_LOGS "lumina/" DEVICE_ID "/logs"
+
+// Retained fleet-wide reconnect hint, e.g. {"spreadMs": 60000, "minMs": 5000,
+// "maxMs": 120000}, published by the backend when the broker needs the fleet
+// to come back more slowly
+#define MQTT_TOPIC_FLEET_BACKOFF "lumina/fleet/backoff"
 
 // Client ID for MQTT connection (must be unique per device)
 #define MQTT_CLIENT_ID "lumina-bridge-" DEVICE_ID
@@ -77,6 +86,15 @@
 // How often to send MQTT keepalive (seconds)
 #define MQTT_KEEPALIVE 60
 
+// Reconnect backoff. After the connection drops, the first retry waits a
+// per-device offset up to RECONNECT_SPREAD_MS, so a fleet that lost the
+// broker together does not return together; later retries wait a random
+// RECONNECT_BASE_MS to 3x the previous wait, up to RECONNECT_CAP_MS.
+// esp32-common/tools/reconnect_sim.cpp compares this with a fixed interval.
+#define RECONNECT_BASE_MS 2000
+#define RECONNECT_CAP_MS 30000
+#define RECONNECT_SPREAD_MS 30000
+
 // Timeout for HTTP requests to WLED (milliseconds)
 #define WLED_HTTP_TIMEOUT_MS 10000
 
@@ -86,6 +104,189 @@
 // LED pin for status indication (built-in LED on most ESP32 dev boards)
 #define STATUS_LED_PIN 2
 
+// ============================================================================
+// Command Queue
+// ============================================================================
+// Commands are queued as they arrive and run from the main loop, so the MQTT
+// connection keeps being serviced during a burst. A state write replaces
+// queued state writes it fully overwrites. Queue memory is fixed at build
+// time (COMMAND_QUEUE_DEPTH x COMMAND_PAYLOAD_MAX_LEN).
+
+// Commands waiting at once; more are refused with an error status
+#define COMMAND_QUEUE_DEPTH 4
+
+// Largest command message that can be queued
+#define COMMAND_PAYLOAD_MAX_LEN 2048
+
+// ============================================================================
+// State Reconciliation
+// ============================================================================
+// setState and applyJson update the controller's desired state instead of
+// going to WLED as they are. The bridge sends only what WLED lacks, keeps
+// settings changed at the controller, and resends everything after a
+// reboot (see esp32-common reconciler.h).
+
+// 0 sends every state write to WLED as it comes, as older firmware did
+#define RECONCILE_STATE 1
+
+// Changes that arrive this long after the first unsent one share a request
+#define RECONCILE_SETTLE_MS 50
+
+// An idle controller is checked for reboots and local changes this often
+#define RECONCILE_AUDIT_MS 15000
+
+// Retry delay after a failed request: random, growing from base to cap
+#define RECONCILE_RETRY_BASE_MS 500
+#define RECONCILE_RETRY_CAP_MS 10000
+
+// Accepted state writes are acknowledged once WLED has them; after this
+// long they are reported failed instead (the bridge keeps converging)
+#define RECONCILE_COMMAND_TIMEOUT_MS 30000
+
+// ============================================================================
+// LAN Broker
+// ============================================================================
+// The bridge runs a small MQTT broker on the LAN (esp32-common lan_broker.h).
+// Point a WLED controller's MQTT settings (Config > Sync Interfaces > MQTT)
+// at the bridge's IP and LAN_BROKER_PORT, and it keeps one connection open:
+// state writes go to it as publishes to "{topic}/api", and its own publishes
+// tell the bridge about changes made at the controller. Controllers that
+// are not connected are reached over HTTP as before. Reads (getState,
+// getInfo) always use HTTP, since WLED does not answer them over MQTT.
+
+// 0 = off
+#define LAN_BROKER 1
+#define LAN_BROKER_PORT 1883
+
+// Credentials controllers must send; empty accepts any client on the LAN
+#define LAN_BROKER_USERNAME ""
+#define LAN_BROKER_PASSWORD ""
+
+// A controller's first publish after a command sent to it acknowledges the
+// command; none within this long and the command is reported failed
+#define LAN_ACK_TIMEOUT_MS 2000
+
+// WLED publishes brightness, color and state one after another. Publishes
+// this soon after an acknowledgement belong to the same change; later ones
+// are changes made at the controller, and the bridge audits it at once.
+#define LAN_ECHO_MS 500
+
+// WLED_IP's controller's brightness and color, as it publishes them, go to
+// the status topic once it has been quiet this long. They replace the
+// routine STATUS_PUBLISH_INTERVAL_MS refresh while it is connected.
+#define LAN_STATE_SETTLE_MS 300
+
+// ============================================================================
+// Latency Canary
+// ============================================================================
+// Every CANARY_INTERVAL_MS the bridge publishes a getInfo command to its own
+// command topic and times it through the broker, the queue and WLED, as a
+// backend command travels. The series goes out with the usage totals.
+
+// 0 = off. 300000 (5 minutes) gives 12 samples an hour.
+#define CANARY_INTERVAL_MS 0
+
+// A canary not answered by then counts as failed
+#define CANARY_TIMEOUT_MS 30000
+
+// ============================================================================
+// Controller Health
+// ============================================================================
+// Every HEALTH_SAMPLE_MS the bridge reads /json/info from WLED_IP and from
+// the LAN broker controllers it has commanded: frame rate, free heap, WiFi
+// signal, uptime and LED current, plus the request's round trip. Reads
+// wait while commands are queued. Rollups go out with the usage totals,
+// flagged against the thresholds below.
+
+// 0 = off. 60000 fills the hour between usage publishes (60 samples).
+#define HEALTH_SAMPLE_MS 60000
+
+// Timeout of a health read; short, so a dead controller does not hold the loop
+#define HEALTH_HTTP_TIMEOUT_MS 1500
+
+// Flagged when a window's mean is below these
+#define HEALTH_MIN_FPS 15
+#define HEALTH_MIN_FREE_HEAP 12000
+#define HEALTH_MIN_RSSI -75
+
+// ============================================================================
+// Remote Logs
+// ============================================================================
+// Lines from the MQTT callback, the queue and command processing are
+// printed as before and also kept in a RAM ring, then published to
+// lumina/{deviceId}/logs LZ4-compressed. A batch goes every
+// LOG_SHIP_INTERVAL_MS, when the ring is half full, or on a `shipLogs`
+// command. Shipping waits while a command is queued.
+
+// 0 = off (lines are only printed)
+#define REMOTE_LOGS 1
+
+// Lines kept: 0 errors, 1 + warnings, 2 + info, 3 + debug. A shipLogs
+// command can change it until the next restart.
+#define LOG_CAPTURE_LEVEL 2
+
+// Per call site: a burst of LOG_SITE_BURST lines, refilled one per
+// LOG_SITE_REFILL_MS; past that one line in LOG_SAMPLE_EVERY is kept.
+// Errors are always kept.
+#define LOG_SITE_BURST 20
+#define LOG_SITE_REFILL_MS 3000
+#define LOG_SAMPLE_EVERY 10
+
+// Microseconds per second logging may spend (formatting, storing,
+// compressing) before lines other than errors are dropped
+#define LOG_CPU_BUDGET_US 5000
+
+// Compressed bytes shipped per 24 hours
+#define LOG_DAILY_BYTES (256UL * 1024)
+
+#define LOG_SHIP_INTERVAL_MS 900000UL
+#define LOG_SHIP_BATCH_BYTES 2048   // Text per batch, before compression
+
+// ============================================================================
+// Usage Metering
+// ============================================================================
+// The bridge counts MQTT and WLED bytes per hour and publishes the totals,
+// retained, to lumina/{deviceId}/usage.
+
+// 0 = off, 1 = always metered, 2 = metered once the daily budget is used
+#define METERED_MODE 2
+
+// Cloud bytes per 24 hours before METERED_MODE 2 switches to frugal settings
+#define METERED_DAILY_BUDGET_BYTES (20UL * 1024 * 1024)
+
+// MQTT keepalive while metered (seconds)
+#define METERED_MQTT_KEEPALIVE 300
+
+// Set to 1 to publish metered state deltas as MessagePack on status/msgpack
+#define METERED_BINARY_STATUS 1
+
+// How often to publish usage totals (milliseconds)
+#define USAGE_PUBLISH_INTERVAL_MS 3600000UL
+
+// ============================================================================
+// Dictionary Compression
+// ============================================================================
+// Commands may arrive as frames compressed against a dictionary in the
+// firmware (esp32-common/src/dict_codec.h). Status messages are sent that
+// way, on status/lz4d, only after a setEncoding command asks for it; until
+// then, and after every reconnect, they are plain JSON.
+
+// Set to 0 to refuse compressed commands and setEncoding
+#define DICT_COMPRESSION 1
+
+// ============================================================================
+// Firmware Updates
+// ============================================================================
+// `otaUpdate` installs only deltas fetched over HTTPS and signed with the
+// Ed25519 key whose public half is below. Print it with
+// `esp32-common/tools/make_delta.py --public-key signing.pem`. All zeros
+// refuses every update.
+
+#define OTA_SIGNING_KEY {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+
 // ============================================================================
 // Debug Configuration
 // ============================================================================
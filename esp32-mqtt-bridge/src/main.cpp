@@ -11,8 +11,11 @@
  * 3. When a command arrives, makes HTTP request to WLED
  * 4. Publishes WLED's response to `lumina/{deviceId}/status`
  *
+ * Controllers whose MQTT client is pointed at the bridge's LAN broker get
+ * state writes over that connection instead (see LAN Broker below).
+ *
  * This works with T-Mobile Home Internet and other CGNAT situations
- * because it only makes outbound connections.
+ * because it only makes outbound connections to the cloud.
  */
 
 #include <Arduino.h>
@@ -22,6 +25,24 @@
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
+#include <usage_meter.h>
+#include <delta_ota.h>
+#include <command_queue.h>
+#include <field_groups.h>
+#include <file_spool.h>
+#include <reconnect_backoff.h>
+#include <wled_state.h>
+#include <kernel_bench.h>
+#include <reconciler.h>
+#include <reconcile_wled.h>
+#include <latency_canary.h>
+#include <latency_stats.h>
+#include <lan_broker.h>
+#include <health_series.h>
+#include <log_ring.h>
+#include <lz4_block.h>
+#include <dict_codec.h>
+#include <stdarg.h>
 
 #include "config.h"
 
@@ -70,17 +91,116 @@ emyPxgcYxn/eR44/KJ4EBs+lVDR3veyJm+kXQ99b21/+jh5Xos1AnX5iItreGCc=
 WiFiClientSecure espClient;
 PubSubClient mqttClient(espClient);
 
+// Resumable file transfers to WLED /edit, spooled to LittleFS
+FileSpool fileSpool;
+
 // State
 bool wifiConnected = false;
 bool mqttConnected = false;
 unsigned long lastStatusPublish = 0;
-unsigned long lastReconnectAttempt = 0;
+ReconnectBackoff mqttBackoff(RECONNECT_BASE_MS, RECONNECT_CAP_MS, RECONNECT_SPREAD_MS);
 int commandsProcessed = 0;
 int commandsFailed = 0;
 
 // LED blink state
 unsigned long lastBlinkTime = 0;
 
+// Synthetic getInfo commands through the broker, timed end to end
+LatencyCanary canary(CANARY_INTERVAL_MS, CANARY_TIMEOUT_MS);
+
+// MQTT broker for WLED controllers on the LAN
+LanBroker lanBroker;
+
+// Commands sent to a connected controller, waiting for its first publish
+// back. Commands sent before that publish share it.
+struct LanAck {
+  uint32_t sentAt;   // The earliest waiting command
+  uint32_t ackedAt;
+  uint8_t commands;  // Backend commands waiting; reconciler applies are not reported
+  bool waiting;
+  char action[16];
+};
+LanAck lanAcks[LAN_BROKER_MAX_CLIENTS];
+
+// State writes the reconciler accepted for WLED_IP, acknowledged together
+// once it converges
+struct ReconcileAck {
+  uint32_t acceptedAt;  // The earliest waiting command
+  uint8_t commands;
+  char action[16];
+};
+ReconcileAck reconcileAck;
+
+// WLED_IP's controller's state as it publishes it ("/g", "/c")
+struct LanPushedState {
+  int bri;
+  char color[12];  // "#RRGGBB" or "#WWRRGGBB"
+  bool dirty;
+  uint32_t changedAt;
+};
+LanPushedState lanPushed = {-1, "", false, 0};
+
+// Round trips since the last usage publish: a publish to a controller on
+// the LAN broker until it answers, and a whole HTTP request to WLED
+LatencyStats lanAckMs;
+LatencyStats httpRequestMs;
+
+// /json/info samples of the controllers, rolled up per usage publish
+HealthSeries healthSeries(HEALTH_SAMPLE_MS);
+
+// Diagnostic lines kept for publishing to MQTT_TOPIC_LOGS, by call site
+enum LogSite : uint8_t { SITE_MQTT, SITE_QUEUE, SITE_PROCESS, LOG_SITE_COUNT };
+const char* const LOG_SITE_NAMES[LOG_SITE_COUNT] = {"mqtt", "queue", "process"};
+LogRing remoteLog(LOG_SITE_NAMES, LOG_SITE_COUNT, (LogLevel)LOG_CAPTURE_LEVEL, LOG_SITE_BURST,
+                  LOG_SITE_REFILL_MS, LOG_SAMPLE_EVERY, LOG_CPU_BUDGET_US, LOG_DAILY_BYTES);
+unsigned long lastLogShip = 0;
+uint32_t logShipSeq = 0;
+bool logShipRequested = false;  // A shipLogs command: ship everything now
+
+// Status messages compressed against a dictionary, once the backend has
+// asked with setEncoding; plain JSON again after every reconnect
+DictCodec statusCodec;
+
+// Dictionary frames since the last usage publish, each way: how many, and
+// their bytes as JSON and as sent
+struct DictTally {
+  uint32_t frames;
+  uint32_t jsonBytes;
+  uint32_t frameBytes;
+};
+DictTally dictSent = {0, 0, 0};
+DictTally dictReceived = {0, 0, 0};
+
+// Cloud and LAN bytes per hour
+UsageMeter usageMeter;
+unsigned long lastUsagePublish = 0;
+
+// Desired state of the controller, converged by stepReconciler()
+Reconciler reconciler(RECONCILE_SETTLE_MS, RECONCILE_AUDIT_MS, RECONCILE_RETRY_BASE_MS,
+                      RECONCILE_RETRY_CAP_MS);
+int wledController = -1;
+
+// Last routine state refresh, for delta refreshes in metered mode
+DynamicJsonDocument lastPublishedState(2048);
+
+// A command message waiting to run. The bridge drives one controller, so
+// there is a single queue keyed by WLED_IP.
+struct QueuedCommand {
+  char controller[16];
+  uint64_t version;
+  FieldWrites writes;
+  bool overwritable;  // State write; a newer one may replace it in the queue
+  uint16_t length;
+  char payload[COMMAND_PAYLOAD_MAX_LEN];
+};
+
+// MQTT commands carry no ID
+CommandQueues<QueuedCommand, 1, COMMAND_QUEUE_DEPTH, CommandWithoutId> commandQueue;
+
+// Staging for push/pop, kept off the loop task's stack
+QueuedCommand incomingCommand;
+QueuedCommand dispatchedCommand;
+
 // ============================================================================
 // Function Declarations
 // ============================================================================
@@ -89,10 +209,42 @@ void setupWiFi();
 void setupMQTT();
 bool connectMQTT();
 void mqttCallback(char* topic, byte* payload, unsigned int length);
+void enqueueCommand(const char* payload, unsigned int length);
+void enqueueFramedCommand(const uint8_t* frame, unsigned int length);
+void applyFleetBackoffHint(const char* payload, unsigned int length);
+void dispatchQueuedCommand();
 void processCommand(const char* payload, unsigned int length);
+void stepReconciler();
+void finishReconciledCommands();
+void stepLanBroker();
+void onLanPublish(int client, const char* topic, const uint8_t* payload, size_t length,
+                  void* context);
+bool sendLanCommand(int client, const char* action, const String& body, bool report);
+void finishLanAck(int client, bool ok);
+void runLanCommand(const char* target, const char* action, bool stateWrite, JsonObject payload);
+void publishLanState();
+void runOtaUpdate(const char* url);
+void runFileCommand(const char* action, JsonObject payload);
+String kernelBenchReport(uint32_t iterations);
+void checkSerialCommand();
 String makeWledRequest(const String& method, const String& endpoint, const String& body);
 void publishStatus(const String& status);
 void publishDeviceState();
+void publishStateRefresh(JsonDocument& state);
+bool publishMqtt(const char* topic, const uint8_t* payload, size_t length, bool retained);
+void updateMeteredMode();
+void publishUsage();
+void publishUsageSection(const char* topic, DynamicJsonDocument& doc);
+void sendCanary();
+void sampleControllerHealth();
+void logLine(LogLevel level, LogSite site, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void shipLogs();
+void runShipLogsCommand(JsonObject payload);
+void runSetEncodingCommand(JsonObject payload);
+void addDictVersions(JsonArray versions);
+void publishEncodingError(const char* error, const char* action, int version);
+void addHealthFields(JsonObject entry, size_t controller);
 void blinkLed(int times, int delayMs);
 void statusBlink();
 
@@ -128,6 +280,22 @@ void setup() {
   // Setup MQTT
   setupMQTT();
 
+  if (LAN_BROKER) {
+    if (lanBroker.begin(LAN_BROKER_PORT, LAN_BROKER_USERNAME, LAN_BROKER_PASSWORD)) {
+      lanBroker.setHandler(onLanPublish, nullptr);
+      Serial.print("LAN broker listening on port ");
+      Serial.println(LAN_BROKER_PORT);
+    } else {
+      Serial.println("LAN broker could not listen; controllers use HTTP");
+    }
+  }
+
+  if (!fileSpool.begin()) {
+    Serial.println("LittleFS unavailable; file transfers disabled");
+  }
+  wledController = reconciler.controller(WLED_IP, true);
+  healthSeries.controller(WLED_IP, true);
+
   Serial.println();
   Serial.println("Bridge initialized!");
   Serial.println();
@@ -146,27 +314,66 @@ void loop() {
   // Status blink
   statusBlink();
 
+  checkSerialCommand();
+  updateMeteredMode();
+
   // Handle MQTT
   if (!mqttClient.connected()) {
-    unsigned long now = millis();
-    if (now - lastReconnectAttempt > 5000) {
-      lastReconnectAttempt = now;
+    if (mqttConnected) {
+      // Just lost the broker: wait this device's share of the spread
+      mqttConnected = false;
+      mqttBackoff.failed(millis());
+      Serial.print("MQTT connection lost, reconnecting in ");
+      Serial.print(mqttBackoff.lastDelayMs());
+      Serial.println(" ms");
+    } else if (mqttBackoff.due(millis())) {
       if (connectMQTT()) {
-        lastReconnectAttempt = 0;
+        mqttBackoff.succeeded();
+      } else {
+        mqttBackoff.failed(millis());
+        Serial.print("Retrying in ");
+        Serial.print(mqttBackoff.lastDelayMs());
+        Serial.println(" ms");
       }
     }
   } else {
     mqttClient.loop();
   }
 
-  // Periodically publish device status
-  if (STATUS_PUBLISH_INTERVAL_MS > 0 && mqttClient.connected()) {
+  if (LAN_BROKER) stepLanBroker();
+
+  // Run one queued command per pass so MQTT keeps being serviced
+  dispatchQueuedCommand();
+  stepReconciler();
+  finishReconciledCommands();
+
+  // Periodically publish device status (no routine refreshes when metered,
+  // nor while the controller publishes its own changes to the LAN broker)
+  if (STATUS_PUBLISH_INTERVAL_MS > 0 && mqttClient.connected() && !usageMeter.metered() &&
+      lanBroker.findByIp(WLED_IP) < 0) {
     if (millis() - lastStatusPublish > STATUS_PUBLISH_INTERVAL_MS) {
       lastStatusPublish = millis();
       publishDeviceState();
     }
   }
 
+  if (mqttClient.connected() && canary.due(millis())) {
+    sendCanary();
+  }
+
+  // Health reads and log batches only fill idle time
+  if (healthSeries.enabled() && commandQueue.empty()) {
+    sampleControllerHealth();
+  }
+  if (REMOTE_LOGS && mqttClient.connected() && commandQueue.empty()) {
+    shipLogs();
+  }
+
+  if (mqttClient.connected() && millis() - lastUsagePublish > USAGE_PUBLISH_INTERVAL_MS) {
+    lastUsagePublish = millis();
+    publishUsage();
+  }
+
   delay(10);
 }
 
@@ -266,16 +473,21 @@ void setupMQTT() {
   // Configure MQTT client
   mqttClient.setServer(MQTT_BROKER, MQTT_PORT);
   mqttClient.setCallback(mqttCallback);
-  mqttClient.setBufferSize(2048); // Larger buffer for JSON payloads
-  mqttClient.setKeepAlive(MQTT_KEEPALIVE);
+  mqttClient.setBufferSize(4096); // JSON payloads, usage reports and log batches
+
+  mqttBackoff.begin(DEVICE_ID, esp_random());
+  canary.begin(millis(), CANARY_INTERVAL_MS > 0 ? esp_random() % CANARY_INTERVAL_MS : 0);
 
   // Connect
-  connectMQTT();
+  if (!connectMQTT()) mqttBackoff.failed(millis());
 }
 
 bool connectMQTT() {
   Serial.print("Connecting to HiveMQ Cloud...");
 
+  // Fewer keepalive pings on a metered link; applies from this connect on
+  mqttClient.setKeepAlive(usageMeter.metered() ? METERED_MQTT_KEEPALIVE : MQTT_KEEPALIVE);
+
   if (mqttClient.connect(MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD)) {
     Serial.println(" Connected!");
     mqttConnected = true;
@@ -284,15 +496,24 @@ bool connectMQTT() {
     Serial.print("Subscribing to: ");
     Serial.println(MQTT_TOPIC_COMMAND);
     mqttClient.subscribe(MQTT_TOPIC_COMMAND);
-
-    // Publish online status
-    publishStatus("{\"online\": true, \"bridge\": \"esp32-mqtt\"}");
+    mqttClient.subscribe(MQTT_TOPIC_FLEET_BACKOFF);
+
+    // Publish online status, in plain JSON until the backend asks again;
+    // "dicts" lists the dictionary versions this firmware can use
+    statusCodec.select(0);
+    DynamicJsonDocument online(256);
+    online["online"] = true;
+    online["bridge"] = "esp32-mqtt";
+    if (usageMeter.metered()) online["metered"] = true;
+    if (DICT_COMPRESSION) addDictVersions(online.createNestedArray("dicts"));
+    String json;
+    serializeJson(online, json);
+    publishStatus(json);
 
     return true;
   } else {
     Serial.print(" Failed, rc=");
-    Serial.print(mqttClient.state());
-    Serial.println(" - will retry in 5 seconds");
+    Serial.println(mqttClient.state());
     mqttConnected = false;
     return false;
   }
@@ -303,15 +524,113 @@ bool connectMQTT() {
 // ============================================================================
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  // MQTT fixed header + topic length prefix
+  usageMeter.addBytes(USAGE_MQTT, 0, length + strlen(topic) + 4);
+
+  Serial.println();
+  logLine(LOG_INFO, SITE_MQTT, "Message received on topic: %s", topic);
+
+  if (strcmp(topic, MQTT_TOPIC_FLEET_BACKOFF) == 0) {
+    applyFleetBackoffHint((const char*)payload, length);
+    return;
+  }
+
+  if (dictFramed(payload, length)) {
+    enqueueFramedCommand(payload, length);
+    return;
+  }
+  enqueueCommand((const char*)payload, length);
+}
+
+// Retained on the broker, so every bridge has the latest hint as soon as it
+// connects and uses it for the next outage. An empty message clears it.
+void applyFleetBackoffHint(const char* payload, unsigned int length) {
+  DynamicJsonDocument doc(256);
+  if (length > 0 && deserializeJson(doc, payload, length)) {
+    Serial.println("Ignoring malformed fleet backoff hint");
+    return;
+  }
+  mqttBackoff.setFleetHint(doc["spreadMs"] | 0UL, doc["minMs"] | 0UL, doc["maxMs"] | 0UL);
+  Serial.print("Fleet backoff hint: ");
+  Serial.write((const uint8_t*)payload, length);
   Serial.println();
-  Serial.print("Message received on topic: ");
-  Serial.println(topic);
+}
+
+// ============================================================================
+// Command Queue
+// ============================================================================
+
+void enqueueCommand(const char* payload, unsigned int length) {
+  if (length >= COMMAND_PAYLOAD_MAX_LEN) {
+    publishStatus("{\"error\": \"Command too large\"}");
+    commandsFailed++;
+    return;
+  }
+
+  // Classify the command; processCommand() reports parse errors later
+  DynamicJsonDocument doc(2048);
+  deserializeJson(doc, payload, length);
+  const char* action = doc["action"] | "setState";
+  if (doc["canary"].is<uint32_t>()) canary.received(doc["canary"].as<uint32_t>(), millis());
+
+  QueuedCommand& cmd = incomingCommand;
+  memset(&cmd, 0, sizeof(cmd));
+  strncpy(cmd.controller, WLED_IP, sizeof(cmd.controller) - 1);
+  cmd.version = (uint64_t)(doc["version"] | 0.0);  // ms timestamps exceed 32 bits
+  cmd.overwritable = strcmp(action, "setState") == 0 || strcmp(action, "applyJson") == 0;
+  cmd.writes = cmd.overwritable ? fieldWritesForState(doc["payload"].as<JsonObjectConst>())
+                                : fieldWritesOpaque();
+  cmd.length = length;
+  memcpy(cmd.payload, payload, length);
+
+  switch (commandQueue.push(cmd)) {
+    case QUEUE_ADDED:
+      break;
+    case QUEUE_REPLACED:
+    case QUEUE_COVERED:
+      logLine(LOG_DEBUG, SITE_QUEUE, "Coalesced with a queued state command");
+      break;
+    case QUEUE_FULL:
+      logLine(LOG_WARN, SITE_QUEUE, "Command queue full, dropping command");
+      publishStatus("{\"error\": \"Command queue full\"}");
+      commandsFailed++;
+      break;
+  }
+}
+
+// A command compressed against a dictionary (dict_codec.h); queued as the
+// JSON it decodes to
+void enqueueFramedCommand(const uint8_t* frame, unsigned int length) {
+  uint8_t version = dictFrameVersion(frame);
+  size_t dictLength;
+  if (!DICT_COMPRESSION || dictData(version, dictLength) == nullptr) {
+    logLine(LOG_WARN, SITE_MQTT, "Command uses unknown dictionary %u", (unsigned)version);
+    publishEncodingError("Unsupported dictionary", nullptr, version);
+    commandsFailed++;
+    return;
+  }
+
+  static uint8_t json[COMMAND_PAYLOAD_MAX_LEN];  // Kept off the loop task's stack
+  size_t jsonLength = dictDecode(frame, length, json, sizeof(json) - 1);
+  if (jsonLength == 0) {
+    logLine(LOG_WARN, SITE_MQTT, "Undecodable command frame (%u bytes)", length);
+    publishStatus("{\"error\": \"Malformed or oversized compressed command\"}");
+    commandsFailed++;
+    return;
+  }
+  dictReceived.frames++;
+  dictReceived.jsonBytes += jsonLength;
+  dictReceived.frameBytes += length;
+  enqueueCommand((const char*)json, jsonLength);
+}
+
+void dispatchQueuedCommand() {
+  if (!commandQueue.popNext(dispatchedCommand)) return;
 
   // LED on while processing
   digitalWrite(STATUS_LED_PIN, HIGH);
 
-  // Process the command
-  processCommand((const char*)payload, length);
+  processCommand(dispatchedCommand.payload, dispatchedCommand.length);
 
   digitalWrite(STATUS_LED_PIN, LOW);
 }
@@ -326,8 +645,7 @@ void processCommand(const char* payload, unsigned int length) {
   DeserializationError error = deserializeJson(doc, payload, length);
 
   if (error) {
-    Serial.print("JSON parse error: ");
-    Serial.println(error.c_str());
+    logLine(LOG_ERROR, SITE_PROCESS, "JSON parse error: %s", error.c_str());
     publishStatus("{\"error\": \"JSON parse error\"}");
     commandsFailed++;
     return;
@@ -337,8 +655,58 @@ void processCommand(const char* payload, unsigned int length) {
   const char* action = doc["action"] | "setState";
   JsonObject cmdPayload = doc["payload"].as<JsonObject>();
 
-  Serial.print("Action: ");
-  Serial.println(action);
+  logLine(LOG_INFO, SITE_PROCESS, "Action: %s", action);
+
+  // Firmware update is handled by the bridge itself
+  if (strcmp(action, "otaUpdate") == 0) {
+    runOtaUpdate(cmdPayload["url"] | "");
+    return;
+  }
+
+  // So are file transfers to WLED /edit
+  if (strncmp(action, "file", 4) == 0) {
+    runFileCommand(action, cmdPayload);
+    return;
+  }
+
+  // And requests for the log ring
+  if (strcmp(action, "shipLogs") == 0) {
+    runShipLogsCommand(cmdPayload);
+    return;
+  }
+
+  // And the choice of status encoding
+  if (strcmp(action, "setEncoding") == 0) {
+    runSetEncodingCommand(cmdPayload);
+    return;
+  }
+
+  // State writes join the desired state; stepReconciler() sends them
+  bool stateWrite = strcmp(action, "setState") == 0 || strcmp(action, "applyJson") == 0;
+
+  // A command naming a controller's MQTT device topic goes to that
+  // controller on the LAN broker instead of WLED_IP
+  const char* target = doc["controller"] | "";
+  if (target[0] != '\0') {
+    runLanCommand(target, action, stateWrite, cmdPayload);
+    return;
+  }
+
+  if (RECONCILE_STATE && stateWrite &&
+      reconcileCommand(reconciler, wledController, cmdPayload, millis())) {
+    // finishReconciledCommands() reports it
+    if (reconcileAck.commands == 0) reconcileAck.acceptedAt = millis();
+    if (reconcileAck.commands < UINT8_MAX) reconcileAck.commands++;
+    strlcpy(reconcileAck.action, action, sizeof(reconcileAck.action));
+    return;
+  }
+
+  // Kernel timings (see kernel_bench.h); payload {"iterations": 200}
+  if (strcmp(action, "benchmark") == 0) {
+    publishStatus(kernelBenchReport(cmdPayload["iterations"] | 200));
+    commandsProcessed++;
+    return;
+  }
 
   // Determine endpoint and method based on action
   String endpoint;
@@ -363,23 +731,32 @@ void processCommand(const char* payload, unsigned int length) {
     serializeJson(cmdPayload, body);
   }
 
-  Serial.print("-> ");
-  Serial.print(method);
-  Serial.print(" http://");
-  Serial.print(WLED_IP);
-  Serial.println(endpoint);
+  logLine(LOG_INFO, SITE_PROCESS, "-> %s http://%s%s", method.c_str(), WLED_IP,
+          endpoint.c_str());
+  if (body.length() > 0) logLine(LOG_DEBUG, SITE_PROCESS, "Body: %s", body.c_str());
 
-  if (body.length() > 0) {
-    Serial.print("Body: ");
-    Serial.println(body);
+  // A state write to a controller on the LAN broker goes over its open
+  // connection; finishLanAck() reports it
+  int lanClient = LAN_BROKER ? lanBroker.findByIp(WLED_IP) : -1;
+  if (lanClient >= 0 && method == "POST" && endpoint == "/json/state" &&
+      sendLanCommand(lanClient, action, body, true)) {
+    logLine(LOG_INFO, SITE_PROCESS, "-> LAN broker %s", lanBroker.deviceTopic(lanClient));
+    return;
   }
 
   // Make the HTTP request to WLED
+  uint32_t started = millis();
   String response = makeWledRequest(method, endpoint, body);
 
+  // A canary only times the trip; its answer is not published
+  uint32_t canarySequence = doc["canary"] | 0UL;
+  if (canarySequence > 0) {
+    canary.finished(canarySequence, !response.startsWith("ERROR:"), millis());
+    return;
+  }
+
   if (response.startsWith("ERROR:")) {
-    Serial.print("Request failed: ");
-    Serial.println(response);
+    logLine(LOG_ERROR, SITE_PROCESS, "%s failed: %s", action, response.c_str());
 
     // Publish error status
     DynamicJsonDocument errDoc(256);
@@ -390,14 +767,414 @@ void processCommand(const char* payload, unsigned int length) {
     publishStatus(errJson);
     commandsFailed++;
   } else {
-    Serial.println("Request successful!");
+    logLine(LOG_INFO, SITE_PROCESS, "Request successful (%lu ms)",
+            (unsigned long)(millis() - started));
     commandsProcessed++;
 
-    // Publish the WLED response as status
+    // Publish the WLED response as status, always in full: it is this
+    // command's result, not a state refresh
     publishStatus(response);
   }
 }
 
+String kernelBenchReport(uint32_t iterations) {
+  KernelBenchConfig config = {};
+  config.iterations = iterations;
+  config.tlsHost = MQTT_BROKER;
+  config.tlsPort = MQTT_PORT;
+  config.wledIp = WLED_IP;
+  config.networkTries = 5;
+
+  DynamicJsonDocument report(1024);
+  runKernelBench(config, report.to<JsonObject>());
+  report["action"] = "benchmark";
+  String json;
+  serializeJson(report, json);
+  return json;
+}
+
+// Serial console: "bench [iterations]" prints the kernel report
+void checkSerialCommand() {
+  if (!Serial.available()) return;
+  String line = Serial.readStringUntil('\n');
+  line.trim();
+  if (!line.startsWith("bench")) return;
+
+  unsigned long iterations = 200;
+  sscanf(line.c_str(), "bench %lu", &iterations);
+  Serial.println(kernelBenchReport(iterations));
+}
+
+// Makes the one WLED request the reconciler wants next, if any. Publishes
+// the state WLED answers an apply with, and the first of a run of failures.
+void stepReconciler() {
+  int controller;
+  ReconcileAction action = reconciler.next(millis(), controller);
+  if (action == RECONCILE_NONE) return;
+
+  String response;
+  if (action == RECONCILE_APPLY) {
+    DynamicJsonDocument body(1024);
+    reconcileRequestBody(reconciler, controller, body);
+    String json;
+    serializeJson(body, json);
+
+    // Over the LAN broker there is no answer to adopt; the controller's
+    // publish back confirms it, and audits still run over HTTP
+    int lanClient = LAN_BROKER ? lanBroker.findByIp(reconciler.ip(controller)) : -1;
+    if (lanClient >= 0 && sendLanCommand(lanClient, "reconcile", json, false)) {
+      reconcileResponse(reconciler, controller, action, true, "{}", millis());
+      return;
+    }
+    response = makeWledRequest("POST", "/json/state", json);
+  } else {
+    response = makeWledRequest("GET", "/json/si", "");
+  }
+
+  bool ok = !response.startsWith("ERROR:");
+  reconcileResponse(reconciler, controller, action, ok, response.c_str(), millis());
+
+  if (!ok) {
+    if (reconciler.failures(controller) == 1) {
+      DynamicJsonDocument errDoc(256);
+      errDoc["error"] = response;
+      errDoc["action"] = "reconcile";
+      String errJson;
+      serializeJson(errDoc, errJson);
+      publishStatus(errJson);
+      commandsFailed++;
+    }
+    return;
+  }
+
+  // WLED's full state after the desired state was applied; a refresh, not
+  // the result of any one command
+  if (action == RECONCILE_APPLY) {
+    DynamicJsonDocument state(2048);
+    if (deserializeJson(state, response) == DeserializationError::Ok &&
+        state.is<JsonObject>()) {
+      publishStateRefresh(state);
+    }
+  }
+}
+
+// Acknowledges the accepted state writes once WLED_IP has converged (WLED
+// took the apply, or already had the values), or reports them failed
+// after RECONCILE_COMMAND_TIMEOUT_MS
+void finishReconciledCommands() {
+  if (reconcileAck.commands == 0) return;
+
+  uint32_t elapsed = millis() - reconcileAck.acceptedAt;
+  bool ok = reconciler.converged(wledController);
+  if (!ok && elapsed < RECONCILE_COMMAND_TIMEOUT_MS) return;
+
+  DynamicJsonDocument result(256);
+  result["action"] = reconcileAck.action;
+  if (ok) {
+    result["ok"] = true;
+    result["ackMs"] = elapsed;
+    commandsProcessed += reconcileAck.commands;
+  } else {
+    result["error"] = "Controller unreachable (the bridge keeps retrying)";
+    commandsFailed += reconcileAck.commands;
+  }
+  result["commands"] = reconcileAck.commands;
+  reconcileAck.commands = 0;
+  String json;
+  serializeJson(result, json);
+  publishStatus(json);
+}
+
+// ============================================================================
+// LAN Broker
+// ============================================================================
+
+void stepLanBroker() {
+  lanBroker.poll(millis());
+
+  for (int i = 0; i < LAN_BROKER_MAX_CLIENTS; i++) {
+    if (lanAcks[i].waiting && millis() - lanAcks[i].sentAt > LAN_ACK_TIMEOUT_MS) {
+      finishLanAck(i, false);
+    }
+  }
+
+  if (lanPushed.dirty && millis() - lanPushed.changedAt >= LAN_STATE_SETTLE_MS) {
+    lanPushed.dirty = false;
+    publishLanState();
+  }
+}
+
+// Publishes a JSON state body to "{deviceTopic}/api". False if the
+// controller is no longer connected.
+bool sendLanCommand(int client, const char* action, const String& body, bool report) {
+  char topic[LAN_BROKER_FILTER_LEN + 4];
+  snprintf(topic, sizeof(topic), "%s/api", lanBroker.deviceTopic(client));
+  if (lanBroker.publish(topic, (const uint8_t*)body.c_str(), body.length()) == 0) return false;
+  // MQTT fixed header + topic length prefix
+  usageMeter.addBytes(USAGE_WLED, body.length() + strlen(topic) + 4, 0);
+
+  LanAck& ack = lanAcks[client];
+  if (!ack.waiting) {
+    ack.waiting = true;
+    ack.sentAt = millis();
+    ack.commands = 0;
+  }
+  if (report) {
+    ack.commands++;
+    strlcpy(ack.action, action, sizeof(ack.action));
+  }
+  return true;
+}
+
+// The controller published after commands were sent to it, or did not
+// within LAN_ACK_TIMEOUT_MS
+void finishLanAck(int client, bool ok) {
+  LanAck& ack = lanAcks[client];
+  ack.waiting = false;
+  uint32_t elapsed = millis() - ack.sentAt;
+  if (ok) {
+    ack.ackedAt = millis();
+    lanAckMs.add(elapsed);
+  } else {
+    lanAckMs.addFailure();
+  }
+  if (ack.commands == 0) return;
+
+  DynamicJsonDocument result(256);
+  result["action"] = ack.action;
+  result["controller"] = lanBroker.deviceTopic(client);
+  if (ok) {
+    result["ok"] = true;
+    result["ackMs"] = elapsed;
+    commandsProcessed += ack.commands;
+  } else {
+    result["error"] = "No answer from controller";
+    commandsFailed += ack.commands;
+  }
+  ack.commands = 0;
+  String json;
+  serializeJson(result, json);
+  publishStatus(json);
+}
+
+// Everything a LAN client publishes. A controller's "/g", "/c" and "/v"
+// answer the commands sent to it; when none are waiting they are changes
+// made at the controller.
+void onLanPublish(int client, const char* topic, const uint8_t* payload, size_t length,
+                  void* context) {
+  (void)context;
+  // MQTT fixed header + topic length prefix
+  usageMeter.addBytes(USAGE_WLED, 0, length + strlen(topic) + 4);
+
+  const char* deviceTopic = lanBroker.deviceTopic(client);
+  size_t topicLength = strlen(deviceTopic);
+  if (topicLength == 0 || strncmp(topic, deviceTopic, topicLength) != 0 ||
+      topic[topicLength] != '/') {
+    return;
+  }
+  const char* suffix = topic + topicLength + 1;
+
+  if (strcmp(suffix, "status") == 0) {
+    Serial.print("LAN controller ");
+    Serial.print(deviceTopic);
+    Serial.print(": ");
+    Serial.write(payload, length);
+    Serial.println();
+    return;
+  }
+  bool bri = strcmp(suffix, "g") == 0;
+  bool color = strcmp(suffix, "c") == 0;
+  if (!bri && !color && strcmp(suffix, "v") != 0) return;
+
+  LanAck& ack = lanAcks[client];
+  bool echo = ack.ackedAt != 0 && millis() - ack.ackedAt < LAN_ECHO_MS;
+  if (ack.waiting) {
+    finishLanAck(client, true);
+  } else if (!echo && strcmp(lanBroker.ip(client), WLED_IP) == 0) {
+    // Changed at the controller: take it into the desired state now
+    DEBUG_PRINTLN("Controller changed locally");
+    reconciler.auditSoon(wledController, millis());
+  }
+
+  if (strcmp(lanBroker.ip(client), WLED_IP) != 0 || (!bri && !color)) return;
+  char value[12];
+  size_t copied = length < sizeof(value) ? length : sizeof(value) - 1;
+  memcpy(value, payload, copied);
+  value[copied] = '\0';
+  if (bri) {
+    lanPushed.bri = atoi(value);
+  } else {
+    strlcpy(lanPushed.color, value, sizeof(lanPushed.color));
+  }
+  lanPushed.dirty = true;
+  lanPushed.changedAt = millis();
+}
+
+// A command with "controller": "{deviceTopic}" for a controller on the
+// LAN broker. Only state writes: WLED does not answer reads over MQTT.
+void runLanCommand(const char* target, const char* action, bool stateWrite, JsonObject payload) {
+  const char* error = nullptr;
+  int client = LAN_BROKER ? lanBroker.findByTopic(target) : -1;
+  String body;
+  serializeJson(payload, body);
+  if (!stateWrite) {
+    error = "Only state writes can name a controller";
+  } else if (client < 0) {
+    error = "Controller not connected";
+  } else if (!sendLanCommand(client, action, body, true)) {
+    error = "Controller not connected";
+  }
+  if (error == nullptr) {
+    healthSeries.controller(lanBroker.ip(client), true);
+    return;
+  }
+
+  DynamicJsonDocument errDoc(256);
+  errDoc["error"] = error;
+  errDoc["action"] = action;
+  errDoc["controller"] = target;
+  String errJson;
+  serializeJson(errDoc, errJson);
+  publishStatus(errJson);
+  commandsFailed++;
+}
+
+// Brightness and primary color as WLED_IP's controller last published them
+void publishLanState() {
+  DynamicJsonDocument state(256);
+  if (lanPushed.bri >= 0) {
+    state["on"] = lanPushed.bri > 0;
+    state["bri"] = lanPushed.bri;
+  }
+  // "#RRGGBB", or "#WWRRGGBB" with a white channel
+  size_t digits = strlen(lanPushed.color) - 1;
+  if (lanPushed.color[0] == '#' && (digits == 6 || digits == 8)) {
+    uint32_t value = strtoul(lanPushed.color + 1, nullptr, 16);
+    JsonObject segment = state.createNestedArray("seg").createNestedObject();
+    JsonArray col = segment.createNestedArray("col").createNestedArray();
+    col.add((value >> 16) & 0xFF);
+    col.add((value >> 8) & 0xFF);
+    col.add(value & 0xFF);
+    if (digits == 8) col.add(value >> 24);
+  }
+  if (state.size() == 0) return;
+  state["_lan"] = true;
+
+  // Partial, so never diffed against or kept as the last refresh
+  String json;
+  serializeJson(state, json);
+  publishStatus(json);
+}
+
+// Firmware update from a signed delta against the running image. Payload:
+// {"url": "https://.../mqtt-bridge-1.1-from-1.0.ldlt"}. Publishes the
+// transfer size and time, then restarts into the new image on success.
+void runOtaUpdate(const char* url) {
+  if (strlen(url) == 0) {
+    publishStatus("{\"error\": \"No update URL specified\", \"action\": \"otaUpdate\"}");
+    commandsFailed++;
+    return;
+  }
+
+  Serial.print("Delta OTA from ");
+  Serial.println(url);
+
+  static const uint8_t signingKey[32] = OTA_SIGNING_KEY;
+  DeltaOtaResult ota = runDeltaOta(url, signingKey);
+  // Counted with the rest of the cloud traffic
+  usageMeter.addBytes(USAGE_MQTT, 0, ota.bytesDownloaded);
+
+  DynamicJsonDocument result(256);
+  result["action"] = "otaUpdate";
+  result["ok"] = ota.ok;
+  if (!ota.ok) result["error"] = ota.error;
+  result["downloaded"] = ota.bytesDownloaded;
+  result["written"] = ota.bytesWritten;
+  result["elapsedMs"] = ota.elapsedMs;
+  String json;
+  serializeJson(result, json);
+  Serial.println(json);
+  publishStatus(json);
+
+  if (!ota.ok) {
+    commandsFailed++;
+    return;
+  }
+
+  commandsProcessed++;
+  Serial.println("Restarting into new firmware...");
+  mqttClient.loop();
+  delay(500);
+  ESP.restart();
+}
+
+// File transfer to WLED /edit, in actions sharing a transferId:
+//   fileBegin  {"transferId", "path": "/ledmap.json", "size", "chunkSize", "sha256"}
+//   fileChunk  {"transferId", "index", "data": "<base64>"}
+//   fileCommit {"transferId"} checks the hash, then uploads to WLED_IP
+//   fileAbort  {"transferId"}
+// Commands are capped at COMMAND_PAYLOAD_MAX_LEN, so chunks are at most
+// 1024 bytes here. Each status carries the received-chunk bitmap ("have")
+// so the sender resends only what is missing.
+void runFileCommand(const char* action, JsonObject payload) {
+  const char* transferId = payload["transferId"] | "";
+  String error;
+  bool ok = false;
+
+  DynamicJsonDocument report(512);
+  report["action"] = action;
+  report["transferId"] = transferId;
+
+  if (strcmp(action, "fileBegin") == 0) {
+    ok = fileSpool.open(transferId, payload["path"] | "", payload["size"] | 0,
+                        payload["chunkSize"] | 0, payload["sha256"] | "", error);
+  } else if (strcmp(action, "fileChunk") == 0) {
+    ok = fileSpool.writeChunk(transferId, payload["index"] | 0, payload["data"] | "", error);
+    report["index"] = payload["index"] | 0;
+  } else if (strcmp(action, "fileAbort") == 0) {
+    fileSpool.abort(transferId);
+    ok = true;
+  } else if (strcmp(action, "fileCommit") == 0) {
+    ok = fileSpool.verify(transferId, error);
+    if (ok) {
+      FileUploadResult upload = fileSpool.uploadToWled(WLED_IP);
+      usageMeter.addBytes(USAGE_WLED, upload.bytes, 0);
+
+      report["httpCode"] = upload.httpCode;
+      report["bytes"] = upload.bytes;
+      report["elapsedMs"] = upload.elapsedMs;
+      report["bytesPerSec"] =
+          upload.elapsedMs > 0 ? (uint32_t)((uint64_t)upload.bytes * 1000 / upload.elapsedMs) : 0;
+      report["heapUsed"] = upload.heapUsed;
+      ok = upload.ok;
+      if (ok) {
+        fileSpool.discard();
+      } else {
+        error = upload.error;
+      }
+    }
+  } else {
+    error = "Unknown file action";
+  }
+
+  report["ok"] = ok;
+  if (!ok) report["error"] = error;
+  if (fileSpool.active()) {
+    report["chunks"] = fileSpool.chunks();
+    report["received"] = fileSpool.receivedChunks();
+    report["have"] = fileSpool.receivedHex();
+  }
+
+  String json;
+  serializeJson(report, json);
+  publishStatus(json);
+  if (ok) {
+    commandsProcessed++;
+  } else {
+    commandsFailed++;
+  }
+}
+
 // ============================================================================
 // HTTP Request to WLED
 // ============================================================================
@@ -411,6 +1188,7 @@ String makeWledRequest(const String& method, const String& endpoint, const Strin
   DEBUG_PRINT(" ");
   DEBUG_PRINTLN(url);
 
+  uint32_t started = millis();
   http.begin(url);
   http.setTimeout(WLED_HTTP_TIMEOUT_MS);
   http.addHeader("Content-Type", "application/json");
@@ -430,15 +1208,19 @@ String makeWledRequest(const String& method, const String& endpoint, const Strin
     if (httpCode == HTTP_CODE_OK || httpCode == 200) {
       String response = http.getString();
       http.end();
+      usageMeter.addBytes(USAGE_WLED, url.length() + body.length(), response.length());
+      httpRequestMs.add(millis() - started);
       return response;
     } else {
       String error = "ERROR: HTTP " + String(httpCode);
       http.end();
+      httpRequestMs.addFailure();
       return error;
     }
   } else {
     String error = "ERROR: " + http.errorToString(httpCode);
     http.end();
+    httpRequestMs.addFailure();
     return error;
   }
 }
@@ -458,7 +1240,73 @@ void publishStatus(const String& status) {
   Serial.print(": ");
   Serial.println(status.substring(0, 100) + (status.length() > 100 ? "..." : ""));
 
-  mqttClient.publish(MQTT_TOPIC_STATUS, status.c_str(), false);
+  // Compressed once negotiated; a status too short to gain goes plain
+  if (statusCodec.version() != 0) {
+    static uint8_t frame[4096];  // The MQTT buffer; a larger frame could not be sent
+    size_t length = statusCodec.encode((const uint8_t*)status.c_str(), status.length(), frame,
+                                       sizeof(frame));
+    if (length > 0 && publishMqtt(MQTT_TOPIC_STATUS_DICT, frame, length, false)) {
+      dictSent.frames++;
+      dictSent.jsonBytes += status.length();
+      dictSent.frameBytes += length;
+      return;
+    }
+  }
+  publishMqtt(MQTT_TOPIC_STATUS, (const uint8_t*)status.c_str(), status.length(), false);
+}
+
+bool publishMqtt(const char* topic, const uint8_t* payload, size_t length, bool retained) {
+  if (!mqttClient.publish(topic, payload, length, retained)) return false;
+  // MQTT fixed header + topic length prefix
+  usageMeter.addBytes(USAGE_MQTT, length + strlen(topic) + 4, 0);
+  return true;
+}
+
+// Publishes a routine state refresh. In metered mode only the top-level
+// keys that changed since the last refresh are sent, as MessagePack when
+// enabled. Command results never go through here: two identical results
+// must both be published, and a getInfo response is not WLED state.
+void publishStateRefresh(JsonDocument& state) {
+  if (!usageMeter.metered()) {
+    String json;
+    serializeJson(state, json);
+    publishStatus(json);
+    lastPublishedState.set(state);
+    return;
+  }
+
+  DynamicJsonDocument delta(2048);
+  size_t changed = wledStateDiff(lastPublishedState.as<JsonObjectConst>(),
+                                 state.as<JsonObjectConst>(), delta.to<JsonObject>());
+  lastPublishedState.set(state);
+
+  if (changed == 0) {
+    DEBUG_PRINTLN("State unchanged, nothing to publish");
+    return;
+  }
+  delta["_delta"] = true;
+
+  if (!mqttClient.connected()) {
+    Serial.println("Cannot publish - MQTT not connected");
+    return;
+  }
+
+#if METERED_BINARY_STATUS
+  // A negotiated dictionary comes out smaller than MessagePack; see the
+  // README's Dictionary Compression section
+  if (statusCodec.version() == 0) {
+    uint8_t packed[1024];
+    size_t length = serializeMsgPack(delta, packed, sizeof(packed));
+    if (length > 0 && length < sizeof(packed)) {
+      publishMqtt(MQTT_TOPIC_STATUS_MSGPACK, packed, length, false);
+      return;
+    }
+  }
+#endif
+
+  String json;
+  serializeJson(delta, json);
+  publishStatus(json);
 }
 
 void publishDeviceState() {
@@ -473,9 +1321,449 @@ void publishDeviceState() {
     doc["_commands"] = commandsProcessed;
     doc["_errors"] = commandsFailed;
 
-    String enrichedState;
-    serializeJson(doc, enrichedState);
-    publishStatus(enrichedState);
+    publishStateRefresh(doc);
+  }
+}
+
+// ============================================================================
+// Usage Metering
+// ============================================================================
+
+void updateMeteredMode() {
+  usageMeter.setHour(millis() / 3600000UL);
+
+  bool wasMetered = usageMeter.metered();
+  bool metered = usageMeter.updateMetered((MeteredMode)METERED_MODE, METERED_DAILY_BUDGET_BYTES);
+
+  if (metered != wasMetered) {
+    Serial.println(metered ? "Metered mode ON - using frugal settings"
+                           : "Metered mode OFF");
+    // Full state again on the next publish
+    lastPublishedState.clear();
+  }
+}
+
+// Publishes hourly and 24-hour totals, retained, to lumina/{deviceId}/usage,
+// and the LAN, canary and health sections under it as their own messages,
+// each sized for its contents
+void publishUsage() {
+  DynamicJsonDocument doc(1024);
+  doc["uptimeHour"] = usageMeter.hour();
+  doc["metered"] = usageMeter.metered();
+
+  const char* windows[] = {"lastHour", "last24h"};
+  const int hours[] = {1, UsageMeter::HISTORY_HOURS};
+  for (int i = 0; i < 2; i++) {
+    UsageTotals totals = usageMeter.lastHours(hours[i]);
+    JsonObject window = doc.createNestedObject(windows[i]);
+    window["mqttBytesUp"] = totals.bytesUp[USAGE_MQTT];
+    window["mqttBytesDown"] = totals.bytesDown[USAGE_MQTT];
+    window["wledBytesUp"] = totals.bytesUp[USAGE_WLED];
+    window["wledBytesDown"] = totals.bytesDown[USAGE_WLED];
+  }
+
+  CommandQueueStats stats = commandQueue.stats();
+  JsonObject queue = doc.createNestedObject("queue");
+  queue["capacity"] = (uint32_t)commandQueue.CAPACITY;
+  queue["depth"] = stats.depth;
+  queue["highWater"] = stats.highWater;
+  queue["replaced"] = stats.replaced + stats.covered;
+  queue["rejected"] = stats.rejected;
+  queue["dispatched"] = stats.dispatched;
+
+  // Dictionary frames since the last publish: [frames, JSON bytes, bytes
+  // as sent] each way, the field compression ratio
+  if (DICT_COMPRESSION) {
+    JsonObject dict = doc.createNestedObject("dict");
+    dict["status"] = statusCodec.version();
+    const DictTally* tallies[] = {&dictSent, &dictReceived};
+    const char* names[] = {"sent", "received"};
+    for (int i = 0; i < 2; i++) {
+      JsonArray tally = dict.createNestedArray(names[i]);
+      tally.add(tallies[i]->frames);
+      tally.add(tallies[i]->jsonBytes);
+      tally.add(tallies[i]->frameBytes);
+    }
+  }
+  publishUsageSection(MQTT_TOPIC_USAGE, doc);
+  dictSent = {0, 0, 0};
+  dictReceived = {0, 0, 0};
+
+  // LAN broker clients, and round trips to WLED since the last publish
+  // over the broker and over HTTP
+  if (LAN_BROKER) {
+    DynamicJsonDocument lan(512 + LAN_BROKER_MAX_CLIENTS * 128);
+    const LanBrokerStats& broker = lanBroker.stats();
+    lan["clients"] = lanBroker.clientCount();
+    lan["clientBytes"] = LanBroker::clientBytes();
+    lan["connects"] = broker.connects;
+    lan["refused"] = broker.refused;
+    lan["timeouts"] = broker.timeouts;
+    lan["publishesIn"] = broker.publishesIn;
+    lan["publishesOut"] = broker.publishesOut;
+    lan["ackCount"] = lanAckMs.count();
+    lan["ackFailures"] = lanAckMs.failures();
+    lan["ackP50Ms"] = lanAckMs.percentile(50);
+    lan["ackP95Ms"] = lanAckMs.percentile(95);
+    lan["httpCount"] = httpRequestMs.count();
+    lan["httpFailures"] = httpRequestMs.failures();
+    lan["httpP50Ms"] = httpRequestMs.percentile(50);
+    lan["httpP95Ms"] = httpRequestMs.percentile(95);
+    JsonArray controllers = lan.createNestedArray("controllers");
+    for (int i = 0; i < LAN_BROKER_MAX_CLIENTS; i++) {
+      if (!lanBroker.connected(i)) continue;
+      JsonObject controller = controllers.createNestedObject();
+      controller["topic"] = lanBroker.deviceTopic(i);
+      controller["ip"] = lanBroker.ip(i);
+      controller["connectedSec"] = (millis() - lanBroker.connectedAt(i)) / 1000;
+    }
+    publishUsageSection(MQTT_TOPIC_USAGE "/lan", lan);
+    lanAckMs.clear();
+    httpRequestMs.clear();
+  }
+
+  // Canaries since the last publish: round-trip percentiles, and each
+  // one's legs in ms from when it was published (0 = never got that far)
+  if (canary.enabled()) {
+    DynamicJsonDocument canaryStats(256 + canary.count() * 96);
+    const LatencyStats& totals = canary.totals();
+    canaryStats["count"] = totals.count();
+    canaryStats["failures"] = totals.failures();
+    canaryStats["p50Ms"] = totals.percentile(50);
+    canaryStats["p95Ms"] = totals.percentile(95);
+    canaryStats["maxMs"] = totals.max();
+    JsonArray series = canaryStats.createNestedArray("series");
+    for (size_t i = 0; i < canary.count(); i++) {
+      const CanarySample& sample = canary.sample(i);
+      JsonObject entry = series.createNestedObject();
+      entry["uptimeSec"] = sample.startedSec;
+      entry["publishMs"] = sample.sendMs;
+      entry["receiveMs"] = sample.receiveMs;
+      entry["totalMs"] = sample.totalMs;
+    }
+    publishUsageSection(MQTT_TOPIC_USAGE "/canary", canaryStats);
+    canary.clearWindow();
+  }
+
+  // One message per health slot: all eight together outgrow the MQTT buffer
+  if (healthSeries.enabled()) {
+    for (size_t c = 0; c < healthSeries.controllerCount(); c++) {
+      DynamicJsonDocument health(1536);
+      health["sampleSec"] = HEALTH_SAMPLE_MS / 1000;
+      addHealthFields(health.to<JsonObject>(), c);
+      char topic[sizeof(MQTT_TOPIC_USAGE "/health/") + 4];
+      snprintf(topic, sizeof(topic), MQTT_TOPIC_USAGE "/health/%u", (unsigned)c);
+      publishUsageSection(topic, health);
+    }
+    healthSeries.clearWindow();
+  }
+}
+
+// Publishes one usage section, retained. One that ran out of memory or
+// will not fit the MQTT buffer is logged and skipped, never sent cut short.
+void publishUsageSection(const char* topic, DynamicJsonDocument& doc) {
+  size_t length = measureJson(doc);
+  // Fixed header, remaining length and topic length prefix
+  if (doc.overflowed() || length + strlen(topic) + 7 > mqttClient.getBufferSize()) {
+    logLine(LOG_WARN, SITE_MQTT, "Usage %s not published: %u bytes%s", topic,
+            (unsigned)length, doc.overflowed() ? ", incomplete" : "");
+    return;
+  }
+  String json;
+  serializeJson(doc, json);
+  if (!publishMqtt(topic, (const uint8_t*)json.c_str(), json.length(), true)) {
+    logLine(LOG_WARN, SITE_MQTT, "Usage %s not published", topic);
+  }
+}
+
+// Publishes a getInfo command to this bridge's own command topic. It comes
+// back through the broker and runs like any other command, and
+// processCommand() reports when WLED has answered.
+void sendCanary() {
+  uint32_t sequence = canary.start(millis());
+  char message[64];
+  int length = snprintf(message, sizeof(message), "{\"action\":\"getInfo\",\"canary\":%lu}",
+                        (unsigned long)sequence);
+  if (publishMqtt(MQTT_TOPIC_COMMAND, (const uint8_t*)message, length, false)) {
+    canary.sent(sequence, millis());
+  } else {
+    canary.finished(sequence, false, millis());
+  }
+}
+
+// ============================================================================
+// Remote Logs
+// ============================================================================
+
+// A diagnostic line: printed as before (debug lines only with
+// DEBUG_ENABLED), and kept for shipping if the log ring admits it
+void logLine(LogLevel level, LogSite site, const char* format, ...) {
+  bool keep = REMOTE_LOGS && remoteLog.admit(level, site, millis());
+  bool print = level != LOG_DEBUG || DEBUG_ENABLED;
+  if (!keep && !print) return;
+
+  uint32_t started = micros();
+  char line[LOG_LINE_MAX + 1];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length < 0) return;
+  if (length > LOG_LINE_MAX) length = LOG_LINE_MAX;
+
+  if (keep) {
+    remoteLog.add(level, site, line, length, millis());
+    remoteLog.charge(micros() - started, millis());
+  }
+  if (print) Serial.println(line);
+}
+
+// Publishes the oldest LOG_SHIP_BATCH_BYTES of the ring to MQTT_TOPIC_LOGS:
+// a JSON header line, "\n", then the lines as one LZ4 block (binary; MQTT
+// carries it as is). Runs when the interval is up or the ring is half
+// full; after a shipLogs command, and after a batch that left lines
+// behind, one batch per loop pass until the ring is empty.
+void shipLogs() {
+  if (remoteLog.pending() == 0) {
+    logShipRequested = false;
+    return;
+  }
+  // A half-full ring goes early, but not more than once a minute
+  unsigned long sinceLast = millis() - lastLogShip;
+  bool due = sinceLast >= LOG_SHIP_INTERVAL_MS ||
+             (remoteLog.pendingBytes() >= LOG_RING_BYTES / 2 && sinceLast >= 60000);
+  if (!due && !logShipRequested) return;
+  lastLogShip = millis();
+  logShipRequested = false;
+
+  // Static: kept off the loop task's stack
+  static char text[LOG_SHIP_BATCH_BYTES];
+  static uint8_t message[256 + LZ4_BOUND(LOG_SHIP_BATCH_BYTES)];
+  static uint16_t table[LZ4_TABLE_ENTRIES];
+
+  const LogRingStats& stats = remoteLog.stats();
+  uint32_t started = micros();
+  size_t lines;
+  size_t rawBytes = remoteLog.peek(text, sizeof(text), lines);
+  if (lines == 0) return;
+
+  int header = snprintf((char*)message, 256,
+                        "{\"seq\":%lu,\"codec\":\"lz4-block\",\"rawBytes\":%u,\"lines\":%u,"
+                        "\"level\":%d,\"sampledOut\":%lu,\"cpuDropped\":%lu,"
+                        "\"overwritten\":%lu,\"budgetDenied\":%lu,\"uptimeSec\":%lu}\n",
+                        (unsigned long)logShipSeq, (unsigned)rawBytes, (unsigned)lines,
+                        (int)remoteLog.level(), (unsigned long)stats.sampledOut,
+                        (unsigned long)stats.cpuDropped, (unsigned long)stats.overwritten,
+                        (unsigned long)stats.budgetDenied, (unsigned long)(millis() / 1000));
+  if (header <= 0 || header >= 256) return;
+  size_t packedBytes = lz4Compress((const uint8_t*)text, rawBytes, message + header,
+                                   sizeof(message) - header, table);
+  remoteLog.charge(micros() - started, millis());
+  if (packedBytes == 0) return;
+
+  size_t length = header + packedBytes;
+  if (!remoteLog.spend(length, millis())) return;
+
+  if (publishMqtt(MQTT_TOPIC_LOGS, message, length, false)) {
+    remoteLog.release(lines, length);
+    logShipSeq++;
+    logShipRequested = remoteLog.pending() > 0;
+  } else {
+    // Kept in the ring for the next interval
+    DEBUG_PRINTLN("Log batch publish failed");
+  }
+}
+
+// Ships the log ring now. Payload (optional): {"level": "debug"} changes
+// the capture level ("error", "warn", "info", "debug") until a restart.
+void runShipLogsCommand(JsonObject payload) {
+  static const char* const LEVELS[] = {"error", "warn", "info", "debug"};
+  const char* level = payload["level"] | "";
+  for (int i = 0; i <= LOG_DEBUG; i++) {
+    if (strcmp(level, LEVELS[i]) == 0) remoteLog.setLevel((LogLevel)i);
+  }
+  logShipRequested = true;
+
+  DynamicJsonDocument doc(128);
+  doc["action"] = "shipLogs";
+  doc["pending"] = remoteLog.pending();
+  doc["level"] = LEVELS[remoteLog.level()];
+  String json;
+  serializeJson(doc, json);
+  publishStatus(json);
+  commandsProcessed++;
+}
+
+// ============================================================================
+// Dictionary Compression
+// ============================================================================
+
+// Payload {"status": "lz4d", "dict": 1} sends status messages from now on
+// as frames compressed against dictionary 1, on MQTT_TOPIC_STATUS_DICT;
+// {"status": "json"} goes back to plain JSON on MQTT_TOPIC_STATUS. The
+// reply is always plain JSON, and a request this firmware cannot honour
+// leaves status in plain JSON.
+void runSetEncodingCommand(JsonObject payload) {
+  const char* encoding = payload["status"] | "json";
+  bool dict = strcmp(encoding, "lz4d") == 0;
+  int version = dict ? (payload["dict"] | DICT_NEWEST_VERSION) : 0;
+
+  statusCodec.select(0);
+  if (!dict && strcmp(encoding, "json") != 0) {
+    publishEncodingError("Unknown encoding", "setEncoding", -1);
+    commandsFailed++;
+    return;
+  }
+  size_t dictLength;
+  if (dict && (!DICT_COMPRESSION || version < 1 || version > 255 ||
+               dictData(version, dictLength) == nullptr)) {
+    publishEncodingError("Unsupported dictionary", "setEncoding", version);
+    commandsFailed++;
+    return;
+  }
+
+  DynamicJsonDocument doc(128);
+  doc["action"] = "setEncoding";
+  doc["status"] = dict ? "lz4d" : "json";
+  if (dict) doc["dict"] = version;
+  String json;
+  serializeJson(doc, json);
+  publishStatus(json);
+
+  statusCodec.select(version);
+  logLine(LOG_INFO, SITE_PROCESS, "Status encoding: %s", dict ? "lz4d" : "json");
+  commandsProcessed++;
+}
+
+// The dictionary versions this firmware has, for the backend to choose from
+void addDictVersions(JsonArray versions) {
+  size_t length;
+  for (int version = 1; version <= DICT_NEWEST_VERSION; version++) {
+    if (dictData(version, length) != nullptr) versions.add(version);
+  }
+}
+
+// Reported with the versions there are, so the backend can fall back to
+// one of them or to plain JSON. `action` nullptr for a command frame,
+// `version` -1 when there was none.
+void publishEncodingError(const char* error, const char* action, int version) {
+  DynamicJsonDocument doc(256);
+  doc["error"] = error;
+  if (action != nullptr) doc["action"] = action;
+  if (version >= 0) doc["dict"] = version;
+  if (DICT_COMPRESSION) addDictVersions(doc.createNestedArray("dicts"));
+  String json;
+  serializeJson(doc, json);
+  publishStatus(json);
+}
+
+// ============================================================================
+// Controller Health
+// ============================================================================
+
+// Reads the next due controller's /json/info into the health series. The
+// round trip is timed from the request to the last byte of the reply.
+void sampleControllerHealth() {
+  int controller = healthSeries.due(millis());
+  if (controller < 0) return;
+  String ip = healthSeries.ip(controller);
+
+  HTTPClient http;
+  String url = "http://" + ip + ":" + String(WLED_PORT) + "/json/info";
+  http.begin(url);
+  http.setConnectTimeout(HEALTH_HTTP_TIMEOUT_MS);
+  http.setTimeout(HEALTH_HTTP_TIMEOUT_MS);
+
+  uint32_t started = micros();
+  int httpCode = http.GET();
+  if (httpCode != HTTP_CODE_OK) {
+    http.end();
+    healthSeries.failed(controller, millis());
+    DEBUG_PRINTF("Health read of %s failed: %d\n", ip.c_str(), httpCode);
+    return;
+  }
+
+  // Only the fields the series keeps; the rest of /json/info is skipped
+  StaticJsonDocument<128> filter;
+  filter["leds"]["fps"] = true;
+  filter["leds"]["pwr"] = true;
+  filter["freeheap"] = true;
+  filter["wifi"]["rssi"] = true;
+  filter["uptime"] = true;
+
+  DynamicJsonDocument info(256);
+  int size = http.getSize();
+  DeserializationError error =
+      deserializeJson(info, http.getStream(), DeserializationOption::Filter(filter));
+  uint32_t rttUs = micros() - started;
+  http.end();
+  usageMeter.addBytes(USAGE_WLED, url.length(), size > 0 ? size : 0);
+
+  if (error) {
+    healthSeries.failed(controller, millis());
+    return;
+  }
+
+  HealthReading reading;
+  // WLED reports 0 fps while nothing is rendering (off or static), which
+  // says nothing about a starved CPU
+  int32_t fps = info["leds"]["fps"] | 0;
+  reading.value[HEALTH_FPS] = fps > 0 ? fps : HEALTH_MISSING;
+  reading.value[HEALTH_FREE_HEAP] = info["freeheap"] | HEALTH_MISSING;
+  reading.value[HEALTH_RSSI] = info["wifi"]["rssi"] | HEALTH_MISSING;
+  reading.value[HEALTH_POWER] = info["leds"]["pwr"] | HEALTH_MISSING;
+  reading.value[HEALTH_RTT] = rttUs;
+  reading.uptimeSec = info["uptime"] | 0;
+  healthSeries.record(controller, reading, millis());
+}
+
+// One controller's window since the last publish: per metric min, mean,
+// max and HEALTH_ROLLUP_POINTS averaged points, and flags for what is
+// below the HEALTH_MIN_* thresholds
+void addHealthFields(JsonObject entry, size_t c) {
+  static const char* const METRIC_NAMES[HEALTH_METRIC_COUNT] = {
+      "fps", "freeHeap", "rssi", "powerMa", "rttUs"};
+
+  entry["ip"] = healthSeries.ip(c);
+  entry["samples"] = healthSeries.samples(c);
+  entry["failures"] = healthSeries.failures(c);
+  entry["reboots"] = healthSeries.reboots(c);
+  entry["uptimeSec"] = healthSeries.uptimeSec(c);
+
+  HealthRollup rollups[HEALTH_METRIC_COUNT];
+  for (int m = 0; m < HEALTH_METRIC_COUNT; m++) {
+    rollups[m] = healthSeries.rollup(c, (HealthMetric)m);
+    if (rollups[m].samples == 0) continue;
+
+    JsonObject metric = entry.createNestedObject(METRIC_NAMES[m]);
+    metric["min"] = rollups[m].min;
+    metric["mean"] = rollups[m].mean;
+    metric["max"] = rollups[m].max;
+
+    int32_t points[HEALTH_ROLLUP_POINTS];
+    size_t count = healthSeries.downsample(c, (HealthMetric)m, points, HEALTH_ROLLUP_POINTS);
+    JsonArray series = metric.createNestedArray("points");
+    for (size_t i = 0; i < count; i++) {
+      if (points[i] == HEALTH_MISSING) {
+        series.add(nullptr);
+      } else {
+        series.add(points[i]);
+      }
+    }
+  }
+
+  JsonArray flags = entry.createNestedArray("flags");
+  if (healthSeries.samples(c) == 0 && healthSeries.failures(c) > 0) flags.add("unreachable");
+  if (healthSeries.reboots(c) > 0) flags.add("rebooted");
+  if (rollups[HEALTH_FPS].samples > 0 && rollups[HEALTH_FPS].mean < HEALTH_MIN_FPS) {
+    flags.add("lowFps");
+  }
+  if (rollups[HEALTH_FREE_HEAP].samples > 0 &&
+      rollups[HEALTH_FREE_HEAP].mean < HEALTH_MIN_FREE_HEAP) {
+    flags.add("lowHeap");
+  }
+  if (rollups[HEALTH_RSSI].samples > 0 && rollups[HEALTH_RSSI].mean < HEALTH_MIN_RSSI) {
+    flags.add("weakWifi");
   }
 }
 
@@ -7,6 +7,7 @@ import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:flutter_riverpod/flutter_riverpod.dart';
 import 'package:geolocator/geolocator.dart';
+import 'package:nexgen_command/features/wled/cloud_relay_repository.dart';
 import 'package:nexgen_command/features/wled/wled_providers.dart';
 import 'package:nexgen_command/features/wled/wled_repository.dart';
 import 'package:nexgen_command/services/notifications_service.dart';
@@ -44,10 +45,15 @@ class GeofenceState {
 }
 
 class GeofenceMonitor extends Notifier<GeofenceState> {
+  /// Distance, as a multiple of the geofence radius, at which the bridge is
+  /// told to pre-warm for an arrival.
+  static const _prewarmRadiusFactor = 4.0;
+
   StreamSubscription<Position>? _posSub;
   StreamSubscription<DocumentSnapshot<Map<String, dynamic>>>? _cfgSub;
   GeofenceConfig? _config;
   bool _started = false;
+  bool _prewarmSent = false;
 
   @override
   GeofenceState build() {
@@ -130,6 +136,15 @@ class GeofenceMonitor extends Notifier<GeofenceState> {
     final wasInside = state.isInside;
     state = state.copyWith(lastDistance: dist, isInside: inside);
 
+    // Approaching: let the bridge warm up before the arrival command
+    final prewarmRadius = cfg.radiusMeters * _prewarmRadiusFactor;
+    if (!inside && dist <= prewarmRadius && !_prewarmSent) {
+      _prewarmSent = true;
+      unawaited(_sendPrewarmHint(cfg.actionName));
+    } else if (dist > prewarmRadius * 1.25) {
+      _prewarmSent = false;
+    }
+
     if (inside && !wasInside) {
       // Enter transition
       if (cfg.onlyAtNight) {
@@ -143,6 +158,29 @@ class GeofenceMonitor extends Notifier<GeofenceState> {
     }
   }
 
+  Future<void> _sendPrewarmHint(String actionName) async {
+    final repo = ref.read(wledRepositoryProvider);
+    if (repo is! CloudRelayRepository) return; // Only remote control benefits
+    final payload = await _favoritePayload(actionName);
+    await repo.sendPrewarmHint(sceneId: actionName, scene: payload);
+  }
+
+  Future<Map<String, dynamic>?> _favoritePayload(String actionName) async {
+    final uid = FirebaseAuth.instance.currentUser?.uid;
+    if (uid == null) return null;
+    try {
+      final favs = await FirebaseFirestore.instance.collection('users').doc(uid).collection('favorites').where('name', isEqualTo: actionName).limit(1).get();
+      if (favs.docs.isNotEmpty) {
+        final data = favs.docs.first.data();
+        final p = data['payload'];
+        if (p is Map<String, dynamic>) return p;
+      }
+    } catch (e) {
+      debugPrint('Favorites lookup failed: $e');
+    }
+    return null;
+  }
+
   Future<void> _triggerAction(String actionName) async {
     try {
       final repo = ref.read(wledRepositoryProvider);
@@ -150,20 +188,7 @@ class GeofenceMonitor extends Notifier<GeofenceState> {
         debugPrint('No WLED repository available');
         return;
       }
-      final uid = FirebaseAuth.instance.currentUser?.uid;
-      Map<String, dynamic>? payload;
-      if (uid != null) {
-        try {
-          final favs = await FirebaseFirestore.instance.collection('users').doc(uid).collection('favorites').where('name', isEqualTo: actionName).limit(1).get();
-          if (favs.docs.isNotEmpty) {
-            final data = favs.docs.first.data();
-            final p = data['payload'];
-            if (p is Map<String, dynamic>) payload = p;
-          }
-        } catch (e) {
-          debugPrint('Favorites lookup failed: $e');
-        }
-      }
+      final payload = await _favoritePayload(actionName);
 
       if (payload != null) {
         await repo.applyJson(payload);
@@ -656,6 +656,7 @@ Map<String, dynamic> _zoneToJson(ZoneModel zone) => {
       'members': zone.members,
       'ddpSyncEnabled': zone.ddpSyncEnabled,
       'ddpPort': zone.ddpPort,
+      if (zone.segments.isNotEmpty) 'segments': zone.segments,
     };
 
 /// Helper to deserialize ZoneModel from JSON
@@ -665,6 +666,8 @@ ZoneModel _zoneFromJson(Map<String, dynamic> json) => ZoneModel(
       members: List<String>.from(json['members'] as List? ?? []),
       ddpSyncEnabled: json['ddpSyncEnabled'] as bool? ?? false,
       ddpPort: json['ddpPort'] as int? ?? 4048,
+      segments: (json['segments'] as Map<String, dynamic>? ?? {})
+          .map((ip, ids) => MapEntry(ip, List<int>.from(ids as List))),
     );
 
 /// Reset all installer wizard state providers
@@ -521,6 +521,7 @@ class _InstallerSetupWizardState extends ConsumerState<InstallerSetupWizard> {
             'members': z.members,
             'ddpSyncEnabled': z.ddpSyncEnabled,
             'ddpPort': z.ddpPort,
+            if (z.segments.isNotEmpty) 'segments': z.segments,
           }).toList(),
         };
       }
@@ -41,6 +41,10 @@ class Property {
   /// Optional photo URL for the property
   final String? photoUrl;
 
+  /// Site this property belongs to (apartment complex, HOA, etc.), when one
+  /// site bridge serves all of the site's properties
+  final String? siteId;
+
   const Property({
     required this.id,
     required this.name,
@@ -54,6 +58,7 @@ class Property {
     this.timezone,
     this.geofence,
     this.photoUrl,
+    this.siteId,
   });
 
   /// Create an empty property for a user
@@ -97,6 +102,7 @@ class Property {
           ? PropertyGeofence.fromMap(data['geofence'] as Map<String, dynamic>)
           : null,
       photoUrl: data['photo_url'] as String?,
+      siteId: data['site_id'] as String?,
     );
   }
 
@@ -114,6 +120,7 @@ class Property {
       'timezone': timezone,
       if (geofence != null) 'geofence': geofence!.toMap(),
       'photo_url': photoUrl,
+      if (siteId != null) 'site_id': siteId,
     };
   }
 
@@ -130,6 +137,7 @@ class Property {
     String? timezone,
     PropertyGeofence? geofence,
     String? photoUrl,
+    String? siteId,
   }) {
     return Property(
       id: id ?? this.id,
@@ -144,6 +152,7 @@ class Property {
       timezone: timezone ?? this.timezone,
       geofence: geofence ?? this.geofence,
       photoUrl: photoUrl ?? this.photoUrl,
+      siteId: siteId ?? this.siteId,
     );
   }
 
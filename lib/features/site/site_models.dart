@@ -33,20 +33,26 @@ class ZoneModel {
   final bool ddpSyncEnabled;
   final int ddpPort;
 
+  /// Segment IDs per member IP when the zone covers only part of a
+  /// controller. Members not listed here are in the zone whole.
+  final Map<String, List<int>> segments;
+
   const ZoneModel({
     required this.name,
     required this.primaryIp,
     required this.members,
     this.ddpSyncEnabled = false,
     this.ddpPort = 4048,
+    this.segments = const {},
   });
 
-  ZoneModel copyWith({String? name, String? primaryIp, List<String>? members, bool? ddpSyncEnabled, int? ddpPort}) => ZoneModel(
+  ZoneModel copyWith({String? name, String? primaryIp, List<String>? members, bool? ddpSyncEnabled, int? ddpPort, Map<String, List<int>>? segments}) => ZoneModel(
         name: name ?? this.name,
         primaryIp: primaryIp ?? this.primaryIp,
         members: members ?? this.members,
         ddpSyncEnabled: ddpSyncEnabled ?? this.ddpSyncEnabled,
         ddpPort: ddpPort ?? this.ddpPort,
+        segments: segments ?? this.segments,
       );
 
   @override
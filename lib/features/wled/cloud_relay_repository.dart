@@ -1,13 +1,18 @@
 import 'dart:async';
 import 'dart:convert';
+import 'dart:typed_data';
 
 import 'package:cloud_firestore/cloud_firestore.dart';
+import 'package:firebase_storage/firebase_storage.dart';
+import 'package:crypto/crypto.dart';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
+import 'package:nexgen_command/features/site/site_models.dart';
 import 'package:nexgen_command/features/wled/wled_payload_utils.dart';
 import 'package:nexgen_command/features/wled/wled_repository.dart';
 import 'package:nexgen_command/features/wled/wled_service.dart';
 import 'package:nexgen_command/models/remote_command.dart';
+import 'package:nexgen_command/services/lumina_backend_service.dart';
 
 /// WLED Repository implementation for remote (cloud relay) control.
 ///
@@ -37,7 +42,23 @@ class CloudRelayRepository implements WledRepository {
   /// Webhook URL for DIY mode. Leave empty for ESP32 Bridge mode.
   final String webhookUrl;
 
+  /// Site and property of the controller. A site bridge polls every
+  /// property at [siteId] with one query and shares dispatch fairly between
+  /// them by [propertyId].
+  final String? siteId;
+  final String? propertyId;
+
+  /// Hedged delivery: each command also goes out via the Lumina Backend's
+  /// MQTT relay with the same Firestore reference. The bridge runs whichever
+  /// copy arrives first, so a stalled Firestore or MQTT link does not delay
+  /// the command. Null sends via Firestore only.
+  final LuminaBackendService? hedgeBackend;
+
   final FirebaseFirestore _firestore = FirebaseFirestore.instance;
+  final FirebaseStorage _storage = FirebaseStorage.instance;
+
+  /// Version of the zone map the bridge last accepted from this repository.
+  int? _syncedZoneMapVersion;
 
   /// Timeout for waiting for command execution.
   static const _commandTimeout = Duration(seconds: 30);
@@ -45,11 +66,19 @@ class CloudRelayRepository implements WledRepository {
   /// Polling interval when waiting for command completion.
   static const _pollInterval = Duration(milliseconds: 500);
 
+  /// File transfers: how long the bridge may take to download and upload a
+  /// file, and how many times to send the fetch again.
+  static const _fileFetchTimeout = Duration(minutes: 3);
+  static const _fileFetchAttempts = 3;
+
   CloudRelayRepository({
     required this.userId,
     required this.controllerId,
     required this.controllerIp,
     required this.webhookUrl,
+    this.siteId,
+    this.propertyId,
+    this.hedgeBackend,
   });
 
   /// Reference to the commands collection for this user.
@@ -57,7 +86,8 @@ class CloudRelayRepository implements WledRepository {
       _firestore.collection('users').doc(userId).collection('commands');
 
   /// Queue a command and wait for its execution result.
-  Future<Map<String, dynamic>?> _executeCommand(String type, Map<String, dynamic> payload) async {
+  Future<Map<String, dynamic>?> _executeCommand(String type, Map<String, dynamic> payload,
+      {Duration timeout = _commandTimeout}) async {
     try {
       // Create the command document
       final command = RemoteCommand.create(
@@ -66,19 +96,36 @@ class CloudRelayRepository implements WledRepository {
         controllerId: controllerId,
         controllerIp: controllerIp,
         webhookUrl: webhookUrl,
+        siteId: siteId,
+        propertyId: propertyId,
       );
 
       debugPrint('☁️ CloudRelay: Queueing command: $type');
       debugPrint('   Payload: ${jsonEncode(payload)}');
 
-      // Write to Firestore
-      final docRef = await _commandsRef.add(command.toFirestore());
+      // The ID is assigned here, so a hedged copy can carry it before the
+      // Firestore write lands
+      final docRef = _commandsRef.doc();
       final commandId = docRef.id;
+      final hedged = _sendHedged(commandId, command);
+
+      // Write to Firestore. A hedged command does not wait for the write:
+      // the bridge may already have the MQTT copy, and its status is read
+      // below either way.
+      final data = command.toFirestore();
+      if (hedged) {
+        data['hedged'] = true;
+        unawaited(docRef.set(data).catchError((Object e) {
+          debugPrint('☁️ CloudRelay: Hedged Firestore write failed: $e');
+        }));
+      } else {
+        await docRef.set(data);
+      }
 
       debugPrint('☁️ CloudRelay: Command queued with ID: $commandId');
 
       // Wait for the command to complete
-      final result = await _waitForCompletion(commandId);
+      final result = await _waitForCompletion(commandId, timeout);
 
       if (result == null) {
         debugPrint('❌ CloudRelay: Command timed out');
@@ -90,6 +137,10 @@ class CloudRelayRepository implements WledRepository {
       if (result.status == CommandStatus.completed) {
         debugPrint('✅ CloudRelay: Command completed successfully');
         return result.result;
+      } else if (result.status == CommandStatus.superseded) {
+        // A newer command for the same state was applied instead
+        debugPrint('☁️ CloudRelay: Command superseded by a newer command');
+        return result.result ?? const {};
       } else {
         debugPrint('❌ CloudRelay: Command failed: ${result.error}');
         return null;
@@ -100,11 +151,41 @@ class CloudRelayRepository implements WledRepository {
     }
   }
 
+  /// Send the MQTT copy of a hedged command without waiting for it. The
+  /// bridge reports completion in Firestore either way. File transfers are
+  /// not hedged: the bridge runs them from Firestore only.
+  /// Returns whether a copy went out.
+  bool _sendHedged(String commandId, RemoteCommand command) {
+    final backend = hedgeBackend;
+    if (backend == null || !backend.isAuthenticated) return false;
+    if (command.type.startsWith('file')) return false;
+    unawaited(backend
+        .sendCommand(
+      controllerId,
+      action: command.type,
+      payload: command.payload,
+      fields: {
+        'commandRef': '$userId/commands/$commandId',
+        'controllerId': controllerId,
+        'controllerIp': controllerIp,
+        'version': command.version,
+        if (siteId != null) 'siteId': siteId,
+        if (propertyId != null) 'propertyId': propertyId,
+      },
+    )
+        .then((result) {
+      if (!result.success) {
+        debugPrint('☁️ CloudRelay: Hedged MQTT copy not sent: ${result.error}');
+      }
+    }));
+    return true;
+  }
+
   /// Wait for a command to complete by polling Firestore.
-  Future<RemoteCommand?> _waitForCompletion(String commandId) async {
+  Future<RemoteCommand?> _waitForCompletion(String commandId, Duration timeout) async {
     final startTime = DateTime.now();
 
-    while (DateTime.now().difference(startTime) < _commandTimeout) {
+    while (DateTime.now().difference(startTime) < timeout) {
       try {
         final doc = await _commandsRef.doc(commandId).get();
         if (doc.exists) {
@@ -124,6 +205,87 @@ class CloudRelayRepository implements WledRepository {
     return null; // Timeout
   }
 
+  /// Send an arrival pre-warm hint to the bridge without waiting for it.
+  ///
+  /// The bridge switches to fast polling, refreshes its cloud and controller
+  /// connections, and keeps [scene] under [sceneId], so the arrival command
+  /// that follows runs on a warm path instead of an idle one.
+  Future<void> sendPrewarmHint({String? sceneId, Map<String, dynamic>? scene}) async {
+    try {
+      final command = RemoteCommand.create(
+        type: 'prewarm',
+        payload: {
+          if (sceneId != null) 'sceneId': sceneId,
+          if (scene != null) 'scene': normalizeWledPayload(scene),
+        },
+        controllerId: controllerId,
+        controllerIp: controllerIp,
+        webhookUrl: webhookUrl,
+        siteId: siteId,
+        propertyId: propertyId,
+      );
+      await _commandsRef.add(command.toFirestore());
+      debugPrint('☁️ CloudRelay: Pre-warm hint sent');
+    } catch (e) {
+      debugPrint('CloudRelay: Pre-warm hint failed: $e');
+    }
+  }
+
+  /// Send the zone map to the bridge, so a zone command can name a zone
+  /// instead of carrying one command per controller.
+  Future<bool> syncZones(List<ZoneModel> zones) async {
+    final map = zoneMapPayload(zones);
+    final ok = await _executeBool('syncZones', map);
+    if (ok) _syncedZoneMapVersion = map['version'] as int;
+    return ok;
+  }
+
+  /// Apply [state] to every controller and segment of [zone] with one
+  /// command, which the bridge expands into one request per controller.
+  /// [zones] is the whole zone map; it is synced first if the bridge may
+  /// not have this version of it.
+  Future<bool> applyZoneState(
+    ZoneModel zone,
+    List<ZoneModel> zones,
+    Map<String, dynamic> state,
+  ) async {
+    final version = zoneMapPayload(zones)['version'] as int;
+    if (_syncedZoneMapVersion != version && !await syncZones(zones)) return false;
+
+    final payload = {
+      'zoneId': zone.name,
+      'zoneMapVersion': version,
+      'state': normalizeWledPayload(state),
+    };
+    if (await _executeBool('zoneState', payload)) return true;
+
+    // The bridge may hold another map (synced from another phone, or
+    // reflashed); sync and try once more
+    if (!await syncZones(zones)) return false;
+    return _executeBool('zoneState', payload);
+  }
+
+  /// The bridge's zone map format: zones by name, each a list of member IPs
+  /// with their segment IDs when the zone covers only part of a controller.
+  /// The version is taken from the map's hash, so every phone with the same
+  /// zones computes the same one.
+  static Map<String, dynamic> zoneMapPayload(List<ZoneModel> zones) {
+    final entries = <String, dynamic>{
+      for (final zone in zones)
+        zone.name: [
+          for (final ip in zone.members)
+            {
+              'ip': ip,
+              if (zone.segments[ip]?.isNotEmpty ?? false) 'seg': zone.segments[ip],
+            },
+        ],
+    };
+    final digest = sha256.convert(utf8.encode(jsonEncode(entries))).bytes;
+    final version =
+        (digest[0] << 24 | digest[1] << 16 | digest[2] << 8 | digest[3]) & 0x7fffffff;
+    return {'version': version == 0 ? 1 : version, 'zones': entries};
+  }
+
   /// Execute a command and return success/failure boolean.
   Future<bool> _executeBool(String type, Map<String, dynamic> payload) async {
     final result = await _executeCommand(type, payload);
@@ -183,9 +345,58 @@ class CloudRelayRepository implements WledRepository {
 
   @override
   Future<bool> uploadLedMapJson(String jsonContent) async {
-    // LED map upload is complex - for now, return false (not supported remotely)
-    debugPrint('☁️ CloudRelay: LED map upload not supported remotely');
-    return false;
+    return _uploadFile('/ledmap.json', utf8.encode(jsonContent));
+  }
+
+  /// Upload a file to the controller's filesystem through the bridge.
+  ///
+  /// The file goes to Cloud Storage and one `fileFetch` command gives the
+  /// bridge its download URL and hash. The bridge downloads it in ranges,
+  /// checks the hash and uploads it to the controller, so no file bytes pass
+  /// through command documents. The transfer ID is derived from the file's
+  /// hash: a retry resumes from what the bridge already downloaded.
+  Future<bool> _uploadFile(String path, List<int> bytes) async {
+    final hash = sha256.convert(bytes).toString();
+    final transferId = 'f${hash.substring(0, 20)}';
+    final ref = _storage.ref().child('users/$userId/bridge_files/$transferId');
+
+    try {
+      await ref.putData(
+        Uint8List.fromList(bytes),
+        SettableMetadata(contentType: 'application/octet-stream'),
+      );
+      final url = await ref.getDownloadURL();
+
+      for (var attempt = 0; attempt < _fileFetchAttempts; attempt++) {
+        final result = await _executeCommand(
+          'fileFetch',
+          {
+            'transferId': transferId,
+            'url': url,
+            'path': path,
+            'size': bytes.length,
+            'sha256': hash,
+          },
+          timeout: _fileFetchTimeout,
+        );
+        if (result != null) {
+          debugPrint('☁️ CloudRelay: Uploaded $path (${bytes.length} bytes, '
+              '${result['bytesPerSec']} B/s to controller)');
+          return true;
+        }
+      }
+
+      debugPrint('❌ CloudRelay: Upload of $path incomplete');
+      return false;
+    } catch (e) {
+      debugPrint('❌ CloudRelay: Upload of $path failed: $e');
+      return false;
+    } finally {
+      // The bridge has its copy, or the upload is abandoned
+      unawaited(ref.delete().catchError((Object e) {
+        debugPrint('☁️ CloudRelay: Could not delete staged $path: $e');
+      }));
+    }
   }
 
   @override
@@ -14,6 +14,7 @@ import 'package:nexgen_command/features/wled/cloud_relay_repository.dart';
 import 'package:nexgen_command/features/wled/mqtt_relay_repository.dart';
 import 'package:nexgen_command/features/site/user_profile_providers.dart';
 import 'package:nexgen_command/features/site/controllers_providers.dart';
+import 'package:nexgen_command/features/properties/properties_providers.dart';
 import 'package:nexgen_command/services/connectivity_service.dart';
 import 'package:nexgen_command/services/lumina_backend_providers.dart';
 import 'package:nexgen_command/features/wled/zone_providers.dart';
@@ -127,11 +128,15 @@ final wledRepositoryProvider = Provider<WledRepository?>((ref) {
           debugPrint('   Commands will be executed by the local ESP32 bridge');
         }
 
+        final property = ref.watch(selectedPropertyProvider);
         return CloudRelayRepository(
           userId: userId,
           controllerId: controllerId,
           controllerIp: ip,
           webhookUrl: webhookUrl ?? '', // Empty = ESP32 Bridge mode
+          siteId: property?.siteId,
+          propertyId: property?.id,
+          hedgeBackend: userProfile?.hedgedDeliveryEnabled == true ? backendService : null,
         );
       } else {
         debugPrint('⚠️ WledRepository: Remote mode but missing userId or controllerId');
@@ -5,10 +5,12 @@ import 'package:cloud_firestore/cloud_firestore.dart';
 /// Status of a remote command in the queue.
 enum CommandStatus {
   pending,    // Command queued, waiting for Cloud Function
+  queued,     // Accepted by the bridge, waiting in its controller queue
   executing,  // Cloud Function is processing
   completed,  // Command executed successfully
   failed,     // Command failed (network error, device offline, etc.)
   timeout,    // Command timed out waiting for response
+  superseded, // Dropped by the bridge; a newer command overwrote the same state
 }
 
 /// A remote command to be executed via the cloud relay.
@@ -24,10 +26,13 @@ class RemoteCommand {
   final String controllerIp;            // Target controller local IP
   final String webhookUrl;              // User's dynamic DNS webhook URL
   final DateTime createdAt;
+  final int version;                    // Client timestamp (ms); newer wins on the bridge
   final CommandStatus status;
   final Map<String, dynamic>? result;   // Response from WLED device
   final DateTime? completedAt;
   final String? error;                  // Error message if failed
+  final String? siteId;                 // Site served by a site bridge, if any
+  final String? propertyId;             // Property the command is for (site bridge fairness)
 
   const RemoteCommand({
     required this.id,
@@ -37,10 +42,13 @@ class RemoteCommand {
     required this.controllerIp,
     required this.webhookUrl,
     required this.createdAt,
+    this.version = 0,
     required this.status,
     this.result,
     this.completedAt,
     this.error,
+    this.siteId,
+    this.propertyId,
   });
 
   /// Create from Firestore document.
@@ -77,10 +85,13 @@ class RemoteCommand {
       controllerIp: data['controllerIp'] as String? ?? '',
       webhookUrl: data['webhookUrl'] as String? ?? '',
       createdAt: (data['createdAt'] as Timestamp?)?.toDate() ?? DateTime.now(),
+      version: (data['version'] as num?)?.toInt() ?? 0,
       status: _parseStatus(data['status'] as String?),
       result: parsedResult,
       completedAt: (data['completedAt'] as Timestamp?)?.toDate(),
       error: data['error'] as String?,
+      siteId: data['siteId'] as String?,
+      propertyId: data['propertyId'] as String?,
     );
   }
 
@@ -94,10 +105,13 @@ class RemoteCommand {
       'controllerIp': controllerIp,
       'webhookUrl': webhookUrl,
       'createdAt': FieldValue.serverTimestamp(),
+      if (version != 0) 'version': version,
       'status': status.name,
       if (result != null) 'result': jsonEncode(result), // Serialize as JSON string
       if (completedAt != null) 'completedAt': Timestamp.fromDate(completedAt!),
       if (error != null) 'error': error,
+      if (siteId != null) 'siteId': siteId,
+      if (propertyId != null) 'propertyId': propertyId,
     };
   }
 
@@ -108,7 +122,10 @@ class RemoteCommand {
     required String controllerId,
     required String controllerIp,
     required String webhookUrl,
+    String? siteId,
+    String? propertyId,
   }) {
+    final now = DateTime.now();
     return RemoteCommand(
       id: '', // Will be assigned by Firestore
       type: type,
@@ -116,8 +133,11 @@ class RemoteCommand {
       controllerId: controllerId,
       controllerIp: controllerIp,
       webhookUrl: webhookUrl,
-      createdAt: DateTime.now(),
+      createdAt: now,
+      version: now.millisecondsSinceEpoch,
       status: CommandStatus.pending,
+      siteId: siteId,
+      propertyId: propertyId,
     );
   }
 
@@ -129,10 +149,13 @@ class RemoteCommand {
     String? controllerIp,
     String? webhookUrl,
     DateTime? createdAt,
+    int? version,
     CommandStatus? status,
     Map<String, dynamic>? result,
     DateTime? completedAt,
     String? error,
+    String? siteId,
+    String? propertyId,
   }) {
     return RemoteCommand(
       id: id ?? this.id,
@@ -142,18 +165,21 @@ class RemoteCommand {
       controllerIp: controllerIp ?? this.controllerIp,
       webhookUrl: webhookUrl ?? this.webhookUrl,
       createdAt: createdAt ?? this.createdAt,
+      version: version ?? this.version,
       status: status ?? this.status,
       result: result ?? this.result,
       completedAt: completedAt ?? this.completedAt,
       error: error ?? this.error,
+      siteId: siteId ?? this.siteId,
+      propertyId: propertyId ?? this.propertyId,
     );
   }
 
   /// Check if command is still pending execution.
-  bool get isPending => status == CommandStatus.pending || status == CommandStatus.executing;
+  bool get isPending => status == CommandStatus.pending || status == CommandStatus.queued || status == CommandStatus.executing;
 
   /// Check if command has finished (success or failure).
-  bool get isComplete => status == CommandStatus.completed || status == CommandStatus.failed || status == CommandStatus.timeout;
+  bool get isComplete => status == CommandStatus.completed || status == CommandStatus.failed || status == CommandStatus.timeout || status == CommandStatus.superseded;
 
   /// Check if command was successful.
   bool get isSuccess => status == CommandStatus.completed;
@@ -162,6 +188,8 @@ class RemoteCommand {
     switch (status) {
       case 'pending':
         return CommandStatus.pending;
+      case 'queued':
+        return CommandStatus.queued;
       case 'executing':
         return CommandStatus.executing;
       case 'completed':
@@ -170,6 +198,8 @@ class RemoteCommand {
         return CommandStatus.failed;
       case 'timeout':
         return CommandStatus.timeout;
+      case 'superseded':
+        return CommandStatus.superseded;
       default:
         return CommandStatus.pending;
     }
@@ -138,6 +138,9 @@ class UserModel {
   final bool remoteAccessEnabled;
   /// Whether to use MQTT relay via Lumina Backend (vs Firestore/webhook)
   final bool mqttRelayEnabled;
+  /// Whether cloud relay commands are also sent via the Lumina Backend, so
+  /// the bridge runs whichever copy arrives first
+  final bool hedgedDeliveryEnabled;
   /// Lumina Backend URL (for MQTT relay)
   final String? luminaBackendUrl;
 
@@ -257,6 +260,7 @@ class UserModel {
     this.homeSsidHash,
     this.remoteAccessEnabled = false,
     this.mqttRelayEnabled = false,
+    this.hedgedDeliveryEnabled = false,
     String? luminaBackendUrl,
     this.welcomeCompleted = false,
     this.featureTourCompleted = false,
@@ -360,6 +364,7 @@ class UserModel {
       homeSsidHash: json['home_ssid_hash'] as String?,
       remoteAccessEnabled: (json['remote_access_enabled'] as bool?) ?? false,
       mqttRelayEnabled: (json['mqtt_relay_enabled'] as bool?) ?? false,
+      hedgedDeliveryEnabled: (json['hedged_delivery_enabled'] as bool?) ?? false,
       luminaBackendUrl: json['lumina_backend_url'] as String?,
       welcomeCompleted: (json['welcome_completed'] as bool?) ?? false,
       featureTourCompleted: (json['feature_tour_completed'] as bool?) ?? false,
@@ -476,6 +481,7 @@ class UserModel {
       'home_ssid_hash': homeSsidHash,
       'remote_access_enabled': remoteAccessEnabled,
       'mqtt_relay_enabled': mqttRelayEnabled,
+      'hedged_delivery_enabled': hedgedDeliveryEnabled,
       'lumina_backend_url': luminaBackendUrl,
       'welcome_completed': welcomeCompleted,
       'feature_tour_completed': featureTourCompleted,
@@ -547,6 +553,7 @@ class UserModel {
     String? homeSsidHash,
     bool? remoteAccessEnabled,
     bool? mqttRelayEnabled,
+    bool? hedgedDeliveryEnabled,
     String? luminaBackendUrl,
     bool? welcomeCompleted,
     bool? featureTourCompleted,
@@ -615,6 +622,7 @@ class UserModel {
       homeSsidHash: homeSsidHash ?? this.homeSsidHash,
       remoteAccessEnabled: remoteAccessEnabled ?? this.remoteAccessEnabled,
       mqttRelayEnabled: mqttRelayEnabled ?? this.mqttRelayEnabled,
+      hedgedDeliveryEnabled: hedgedDeliveryEnabled ?? this.hedgedDeliveryEnabled,
       luminaBackendUrl: luminaBackendUrl ?? this.luminaBackendUrl,
       welcomeCompleted: welcomeCompleted ?? this.welcomeCompleted,
       featureTourCompleted: featureTourCompleted ?? this.featureTourCompleted,
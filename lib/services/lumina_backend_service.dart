@@ -252,10 +252,14 @@ class LuminaBackendService {
   }
 
   /// Send a command to a device via MQTT (for remote control).
+  ///
+  /// [fields] are added to the MQTT message next to `action` and `payload`,
+  /// e.g. the Firestore reference of a hedged cloud relay command.
   Future<CommandResult> sendCommand(
     String deviceId, {
     required String action,
     Map<String, dynamic>? payload,
+    Map<String, dynamic>? fields,
   }) async {
     if (!isAuthenticated) {
       return const CommandResult(success: false, error: 'Not authenticated');
@@ -268,6 +272,7 @@ class LuminaBackendService {
         body: jsonEncode({
           'action': action,
           if (payload != null) 'payload': payload,
+          ...?fields,
         }),
       );
 